@@ -96,6 +96,8 @@ constexpr auto kSaveCloudDraftTimeout = 1000;
 constexpr auto kSmallDelayMs = 5;
 constexpr auto kReadFeaturedSetsTimeout = crl::time(1000);
 constexpr auto kFileLoaderQueueStopTimeout = crl::time(5000);
+constexpr auto kFileLoaderMaxThreadsCount = 4;
+constexpr auto kFileLoaderPhotoPriority = 1;
 constexpr auto kStickersByEmojiInvalidateTimeout = crl::time(6 * 1000);
 constexpr auto kNotifySettingSaveTimeout = crl::time(1000);
 constexpr auto kDialogsFirstLoad = 20;
@@ -142,6 +144,14 @@ void ShowChannelsLimitBox(not_null<PeerData*> peer) {
 		action.replaceMediaOf);
 }
 
+[[nodiscard]] int FileLoaderThreadsCount() {
+	// Leave one core for the main thread.
+	return std::clamp(
+		QThread::idealThreadCount() - 1,
+		1,
+		kFileLoaderMaxThreadsCount);
+}
+
 [[nodiscard]] QString FormatVideoTimestamp(TimeId seconds) {
 	const auto minutes = seconds / 60;
 	const auto hours = minutes / 60;
@@ -162,7 +172,9 @@ ApiWrap::ApiWrap(not_null<Main::Session*> session)
 , _draftsSaveTimer([=] { saveDraftsToCloud(); })
 , _featuredSetsReadTimer([=] { readFeaturedSets(); })
 , _dialogsLoadState(std::make_unique<DialogsLoadState>())
-, _fileLoader(std::make_unique<TaskQueue>(kFileLoaderQueueStopTimeout))
+, _fileLoader(std::make_unique<TaskQueue>(
+	kFileLoaderQueueStopTimeout,
+	FileLoaderThreadsCount()))
 , _updateNotifyTimer([=] { sendNotifySettingsUpdates(); })
 , _statsSessionKillTimer([=] { checkStatsSessions(); })
 , _authorizations(std::make_unique<Api::Authorizations>(this))
@@ -3719,7 +3731,9 @@ void ApiWrap::sendFiles(
 		album->options = to.options;
 	}
 	auto tasks = std::vector<std::unique_ptr<Task>>();
+	auto priorities = std::vector<int>();
 	tasks.reserve(list.files.size());
+	priorities.reserve(list.files.size());
 	for (auto &file : list.files) {
 		const auto uploadWithType = !album
 			? type
@@ -3727,6 +3741,11 @@ void ApiWrap::sendFiles(
 				&& type != SendMediaType::File)
 			? SendMediaType::Photo
 			: SendMediaType::File;
+
+		// Photos are cheap to prepare and are shown in the album first.
+		priorities.push_back((uploadWithType == SendMediaType::Photo)
+			? kFileLoaderPhotoPriority
+			: 0);
 		tasks.push_back(std::make_unique<FileLoadTask>(
 			&session(),
 			file.path,
@@ -3759,7 +3778,9 @@ void ApiWrap::sendFiles(
 			album->items.emplace_back(task->id());
 		}
 	}
-	_fileLoader->addTasks(std::move(tasks));
+	for (auto i = 0, count = int(tasks.size()); i != count; ++i) {
+		_fileLoader->addTask(std::move(tasks[i]), priorities[i]);
+	}
 }
 
 void ApiWrap::sendFile(
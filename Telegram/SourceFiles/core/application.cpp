@@ -97,6 +97,14 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include <ksandbox.h>
 
+#ifdef Q_OS_WIN
+#include "base/platform/win/base_windows_h.h"
+#else // Q_OS_WIN
+#include <time.h>
+#endif // Q_OS_WIN
+
+#include <chrono>
+
 namespace Core {
 namespace {
 
@@ -128,6 +136,95 @@ void SetCrashAnnotationsGL() {
 #endif // DESKTOP_APP_USE_ANGLE
 }
 
+// CPU time of the calling thread, in microseconds.
+[[nodiscard]] int64 ThreadCpuTime() {
+#ifdef Q_OS_WIN
+	auto creation = FILETIME();
+	auto exit = FILETIME();
+	auto kernel = FILETIME();
+	auto user = FILETIME();
+	if (!GetThreadTimes(
+			GetCurrentThread(),
+			&creation,
+			&exit,
+			&kernel,
+			&user)) {
+		return 0;
+	}
+	const auto value = [](const FILETIME &time) {
+		return (int64(time.dwHighDateTime) << 32)
+			| int64(time.dwLowDateTime);
+	};
+	// FILETIME is measured in 100 ns intervals.
+	return (value(kernel) + value(user)) / 10;
+#else // Q_OS_WIN
+	auto time = timespec();
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+		return 0;
+	}
+	return int64(time.tv_sec) * 1'000'000 + int64(time.tv_nsec) / 1'000;
+#endif // Q_OS_WIN
+}
+
+// Wall and CPU time of the steps before the first window is shown,
+// written to the log with -tracestartup command line argument.
+class StartupTrace final {
+public:
+	StartupTrace()
+	: _enabled(cTraceStartup())
+	, _wall(std::chrono::steady_clock::now())
+	, _cpu(ThreadCpuTime()) {
+	}
+
+	void mark(const char *step) {
+		if (!_enabled) {
+			return;
+		}
+		const auto wall = std::chrono::steady_clock::now();
+		const auto cpu = ThreadCpuTime();
+		_steps.push_back({
+			.name = step,
+			.wall = std::chrono::duration_cast<std::chrono::microseconds>(
+				wall - _wall).count(),
+			.cpu = cpu - _cpu,
+		});
+		_wall = wall;
+		_cpu = cpu;
+	}
+
+	void dump() const {
+		if (!_enabled) {
+			return;
+		}
+		auto wall = int64();
+		auto cpu = int64();
+		for (const auto &step : _steps) {
+			LOG(("Startup Trace: %1 - wall %2 us, cpu %3 us."
+				).arg(step.name
+				).arg(step.wall
+				).arg(step.cpu));
+			wall += step.wall;
+			cpu += step.cpu;
+		}
+		LOG(("Startup Trace: total - wall %1 us, cpu %2 us."
+			).arg(wall
+			).arg(cpu));
+	}
+
+private:
+	struct Step {
+		const char *name = nullptr;
+		int64 wall = 0;
+		int64 cpu = 0;
+	};
+
+	const bool _enabled = false;
+	std::chrono::steady_clock::time_point _wall;
+	int64 _cpu = 0;
+	std::vector<Step> _steps;
+
+};
+
 base::options::toggle OptionSkipUrlSchemeRegister({
 	.id = kOptionSkipUrlSchemeRegister,
 	.name = "Skip URL scheme register",
@@ -255,14 +352,25 @@ Application::~Application() {
 }
 
 void Application::run() {
+	auto trace = StartupTrace();
+
+	// Create mime database, so it won't be slow later.
+	// It doesn't depend on anything, so do it while local storage is read.
+	crl::async([] {
+		QMimeDatabase().mimeTypeForName(u"text/plain"_q);
+	});
+
 	// Depends on OpenSSL on macOS, so on ThirdParty::start().
 	// Depends on notifications settings.
 	_notifications = std::make_unique<Window::Notifications::System>();
+	trace.mark("notifications");
 
 	startLocalStorage();
+	trace.mark("local storage");
 
 	style::SetCustomFont(settings().customFontFamily());
 	style::internal::StartFonts();
+	trace.mark("fonts");
 
 	ValidateScale();
 
@@ -285,20 +393,21 @@ void Application::run() {
 
 	_translator = std::make_unique<Lang::Translator>();
 	QCoreApplication::instance()->installTranslator(_translator.get());
+	trace.mark("proxy, autostart and translator");
 
 	style::StartManager(cScale());
 	Ui::InitTextOptions();
 	Ui::StartCachedCorners();
+	trace.mark("style");
 	Ui::Emoji::Init();
 	Ui::PreloadTextSpoilerMask();
+	trace.mark("emoji");
 	startShortcuts();
+	trace.mark("shortcuts");
 	startEmojiImageLoader();
 	startSystemDarkModeViewer();
 	Media::Player::start(_audio.get());
-
-	if (MediaControlsManager::Supported()) {
-		_mediaControlsManager = std::make_unique<MediaControlsManager>();
-	}
+	trace.mark("emoji loader and media player");
 
 	rpl::combine(
 		_batterySaving->value(),
@@ -320,13 +429,11 @@ void Application::run() {
 
 	DEBUG_LOG(("Application Info: starting app..."));
 
-	// Create mime database, so it won't be slow later.
-	QMimeDatabase().mimeTypeForName(u"text/plain"_q);
-
 	// Check now to avoid re-entrance later.
 	[[maybe_unused]] const auto ivSupported = Iv::ShowButton();
 	[[maybe_unused]] const auto lpAvailable = Ui::LocationPicker::Available(
 		{});
+	trace.mark("iv and location picker checks");
 
 	_windows.emplace(nullptr, std::make_unique<Window::Controller>());
 	setLastActiveWindow(_windows.front().second.get());
@@ -374,16 +481,20 @@ void Application::run() {
 	}, _lifetime);
 
 	DEBUG_LOG(("Application Info: window created..."));
+	trace.mark("window");
 
 	startDomain();
+	trace.mark("domain");
 	startTray();
 
 	_lastActivePrimaryWindow->firstShow();
 
 	startMediaView();
+	trace.mark("tray, first show and media view");
 
 	DEBUG_LOG(("Application Info: showing."));
 	_lastActivePrimaryWindow->finishFirstShow();
+	trace.mark("finish first show");
 
 	if (!_lastActivePrimaryWindow->locked() && cStartToSettings()) {
 		_lastActivePrimaryWindow->showSettings();
@@ -406,15 +517,22 @@ void Application::run() {
 			_mediaView->show(std::move(request));
 		}
 	}, _lifetime);
-	{
+
+	processCreatedWindow(_lastActivePrimaryWindow);
+	trace.mark("after first show");
+	trace.dump();
+
+	// Not needed for the first window to be shown and painted.
+	InvokeQueued(this, [=] {
+		if (MediaControlsManager::Supported()) {
+			_mediaControlsManager = std::make_unique<MediaControlsManager>();
+		}
 		const auto countries = std::make_shared<Countries::Manager>(
 			_domain.get());
 		countries->lifetime().add([=] {
 			[[maybe_unused]] const auto countriesCopy = countries;
 		});
-	}
-
-	processCreatedWindow(_lastActivePrimaryWindow);
+	});
 }
 
 void Application::autoRegisterUrlScheme() {
@@ -534,6 +534,7 @@ void Launcher::processArguments() {
 		{ "-cleanup"        , KeyFormat::NoValues },
 		{ "-noupdate"       , KeyFormat::NoValues },
 		{ "-tosettings"     , KeyFormat::NoValues },
+		{ "-tracestartup"   , KeyFormat::NoValues },
 		{ "-startintray"    , KeyFormat::NoValues },
 		{ "-quit"           , KeyFormat::NoValues },
 		{ "-sendpath"       , KeyFormat::AllLeftValues },
@@ -577,6 +578,7 @@ void Launcher::processArguments() {
 		: LaunchModeNormal;
 	gNoStartUpdate = parseResult.contains("-noupdate");
 	gStartToSettings = parseResult.contains("-tosettings");
+	gTraceStartup = parseResult.contains("-tracestartup");
 	gStartInTray = parseResult.contains("-startintray");
 	gQuit = parseResult.contains("-quit");
 	gSendPaths = parseResult.value("-sendpath", {});
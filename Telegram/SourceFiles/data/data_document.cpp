@@ -292,16 +292,6 @@ bool StickerData::isWebm() const {
 	return (type == StickerType::Webm);
 }
 
-VoiceData::~VoiceData() {
-	if (!waveform.isEmpty()
-		&& waveform[0] == -1
-		&& waveform.size() > int32(sizeof(TaskId))) {
-		auto taskId = TaskId();
-		memcpy(&taskId, waveform.constData() + 1, sizeof(taskId));
-		Local::cancelTask(taskId);
-	}
-}
-
 DocumentData::DocumentData(not_null<Data::Session*> owner, DocumentId id)
 : id(id)
 , _owner(owner) {
@@ -849,6 +839,10 @@ Storage::Cache::Key DocumentData::goodThumbnailCacheKey() const {
 	return Data::DocumentThumbCacheKey(_dc, id);
 }
 
+Storage::Cache::Key DocumentData::waveformCacheKey() const {
+	return Data::DocumentWaveformCacheKey(_dc, id);
+}
+
 bool DocumentData::goodThumbnailChecked() const {
 	return (_goodThumbnailState & GoodThumbnailFlag::Mask)
 		== GoodThumbnailFlag::Checked;
@@ -90,8 +90,6 @@ struct SongData : public DocumentAdditionalData {
 };
 
 struct VoiceData : public DocumentAdditionalData {
-	~VoiceData();
-
 	VoiceWaveform waveform;
 	char wavemax = 0;
 };
@@ -241,6 +239,7 @@ public:
 	}
 
 	[[nodiscard]] Storage::Cache::Key goodThumbnailCacheKey() const;
+	[[nodiscard]] Storage::Cache::Key waveformCacheKey() const;
 	[[nodiscard]] bool goodThumbnailChecked() const;
 	[[nodiscard]] bool goodThumbnailGenerating() const;
 	[[nodiscard]] bool goodThumbnailNoData() const;
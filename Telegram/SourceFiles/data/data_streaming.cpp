@@ -59,7 +59,7 @@ bool PruneDestroyedAndSet(
 		if (video != quality) {
 			if (const auto height = video->resolveVideoQuality()) {
 				result.push_back({
-					.sizeInBytes = uint32(video->size),
+					.sizeInBytes = video->size,
 					.height = uint32(height),
 				});
 			}
@@ -19,6 +19,8 @@ constexpr auto kDocumentCacheMask = 0x00000000000000FFULL;
 constexpr auto kDocumentThumbCacheTag = 0x0000000000000200ULL;
 constexpr auto kDocumentThumbCacheMask = 0x00000000000000FFULL;
 constexpr auto kAudioAlbumThumbCacheTag = 0x0000000000000300ULL;
+constexpr auto kDocumentWaveformCacheTag = 0x0000000000000400ULL;
+constexpr auto kDocumentWaveformCacheMask = 0x00000000000000FFULL;
 constexpr auto kWebDocumentCacheTag = 0x0000020000000000ULL;
 constexpr auto kUrlCacheTag = 0x0000030000000000ULL;
 constexpr auto kGeoPointCacheTag = 0x0000040000000000ULL;
@@ -40,6 +42,14 @@ Storage::Cache::Key DocumentThumbCacheKey(int32 dcId, uint64 id) {
 	};
 }
 
+Storage::Cache::Key DocumentWaveformCacheKey(int32 dcId, uint64 id) {
+	const auto part = (uint64(dcId) & Data::kDocumentWaveformCacheMask);
+	return Storage::Cache::Key{
+		Data::kDocumentWaveformCacheTag | part,
+		id
+	};
+}
+
 Storage::Cache::Key WebDocumentCacheKey(const WebFileLocation &location) {
 	const auto CacheDcId = 4; // The default production value. Doesn't matter.
 	const auto dcId = uint64(CacheDcId) & 0xFFULL;
@@ -46,6 +46,8 @@ namespace Data {
 namespace {
 
 constexpr auto kMaxPerRequest = 100;
+constexpr auto kUnusedPreviewsLimit = 8 * 1024 * 1024;
+constexpr auto kUnusedInstancesLimit = 1024;
 #if 0 // inject-to-on_main
 constexpr auto kUnsubscribeUpdatesDelay = 3 * crl::time(1000);
 #endif
@@ -68,6 +70,74 @@ private:
 
 };
 
+// Lets the manager know when nothing shows the instance anymore.
+class UsedEmoji final : public Ui::Text::CustomEmoji {
+public:
+	UsedEmoji(
+		std::unique_ptr<Ui::CustomEmoji::Object> wrapped,
+		Fn<void()> released);
+	~UsedEmoji();
+
+	int width() override;
+	QString entityData() override;
+	void paint(QPainter &p, const Context &context) override;
+	void unload() override;
+	bool ready() override;
+	bool readyInDefaultState() override;
+
+private:
+	std::unique_ptr<Ui::CustomEmoji::Object> _wrapped;
+	const Fn<void()> _released;
+
+};
+
+UsedEmoji::UsedEmoji(
+	std::unique_ptr<Ui::CustomEmoji::Object> wrapped,
+	Fn<void()> released)
+: _wrapped(std::move(wrapped))
+, _released(std::move(released)) {
+}
+
+UsedEmoji::~UsedEmoji() {
+	// The instance unloads its frames when the last object is destroyed.
+	_wrapped = nullptr;
+	_released();
+}
+
+int UsedEmoji::width() {
+	return _wrapped->width();
+}
+
+QString UsedEmoji::entityData() {
+	return _wrapped->entityData();
+}
+
+void UsedEmoji::paint(QPainter &p, const Context &context) {
+	_wrapped->paint(p, context);
+}
+
+void UsedEmoji::unload() {
+	_wrapped->unload();
+}
+
+bool UsedEmoji::ready() {
+	return _wrapped->ready();
+}
+
+bool UsedEmoji::readyInDefaultState() {
+	return _wrapped->readyInDefaultState();
+}
+
+[[nodiscard]] int64 PreviewBytes(
+		not_null<Ui::CustomEmoji::Instance*> instance) {
+	const auto preview = instance->imagePreview();
+	if (!preview) {
+		return 0;
+	}
+	const auto image = preview.image();
+	return int64(image.bytesPerLine()) * image.height();
+}
+
 [[nodiscard]] ChatHelpers::StickerLottieSize LottieSizeFromTag(SizeTag tag) {
 	// NB! onlyCustomEmoji dimensions caching uses last ::EmojiInteraction-s.
 	using LottieSize = ChatHelpers::StickerLottieSize;
@@ -482,7 +552,8 @@ std::unique_ptr<Ui::Text::CustomEmoji> CustomEmojiManager::create(
 		SizeTag tag,
 		int sizeOverride,
 		LoaderFactory factory) {
-	auto &instances = _instances[SizeIndex(tag)];
+	const auto index = SizeIndex(tag);
+	auto &instances = _instances[index];
 	auto i = instances.find(documentId);
 	if (i == end(instances)) {
 		using Loading = Ui::CustomEmoji::Loading;
@@ -507,9 +578,66 @@ std::unique_ptr<Ui::Text::CustomEmoji> CustomEmojiManager::create(
 			i->second->updatePreview(std::move(preview));
 		}
 	}
-	return std::make_unique<Ui::CustomEmoji::Object>(
-		i->second.get(),
-		std::move(update));
+	instanceUsed(index, documentId);
+	return std::make_unique<UsedEmoji>(
+		std::make_unique<Ui::CustomEmoji::Object>(
+			i->second.get(),
+			std::move(update)),
+		crl::guard(this, [=] { instanceReleased(index, documentId); }));
+}
+
+void CustomEmojiManager::instanceUsed(int index, DocumentId documentId) {
+	const auto key = std::make_pair(index, documentId);
+	if (++_usage[key] == 1) {
+		if (const auto i = _unused.find(key); i != end(_unused)) {
+			_unusedPreviewsSize -= i->second.previewBytes;
+			_unused.erase(i);
+		}
+	}
+}
+
+void CustomEmojiManager::instanceReleased(int index, DocumentId documentId) {
+	const auto key = std::make_pair(index, documentId);
+	const auto i = _usage.find(key);
+	Assert(i != end(_usage) && i->second > 0);
+	if (--i->second > 0) {
+		return;
+	}
+	_usage.erase(i);
+	const auto &instances = _instances[index];
+	const auto j = instances.find(documentId);
+	if (j == end(instances)) {
+		return;
+	}
+	const auto bytes = PreviewBytes(j->second.get());
+	_unused.emplace(key, Unused{ ++_unusedOrder, bytes });
+	_unusedPreviewsSize += bytes;
+	if (_unusedPreviewsSize > kUnusedPreviewsLimit
+		|| _unused.size() > kUnusedInstancesLimit) {
+		evictUnused();
+	}
+}
+
+void CustomEmojiManager::evictUnused() {
+	// Instances with the preview frames of emoji not shown anywhere are
+	// kept up to the limits, the least recently shown go first. Evict
+	// down to three quarters at once, so that this doesn't sort often.
+	auto order = std::vector<std::pair<uint64, std::pair<int, DocumentId>>>();
+	order.reserve(_unused.size());
+	for (const auto &[key, unused] : _unused) {
+		order.emplace_back(unused.order, key);
+	}
+	ranges::sort(order);
+	for (const auto &[released, key] : order) {
+		if (_unusedPreviewsSize <= kUnusedPreviewsLimit * 3 / 4
+			&& _unused.size() <= kUnusedInstancesLimit * 3 / 4) {
+			break;
+		}
+		const auto i = _unused.find(key);
+		_unusedPreviewsSize -= i->second.previewBytes;
+		_unused.erase(i);
+		_instances[key.first].remove(key.second);
+	}
 }
 
 Ui::Text::CustomEmojiFactory CustomEmojiManager::factory(
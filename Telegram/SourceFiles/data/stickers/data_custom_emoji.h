@@ -103,6 +103,10 @@ private:
 		crl::time when = 0;
 		std::vector<base::weak_ptr<Ui::CustomEmoji::Instance>> instances;
 	};
+	struct Unused {
+		uint64 order = 0;
+		int64 previewBytes = 0;
+	};
 	struct LoaderWithSetId {
 		std::unique_ptr<Ui::CustomEmoji::Loader> loader;
 		uint64 setId = 0;
@@ -118,6 +122,10 @@ private:
 		SizeTag tag,
 		int sizeOverride = 0);
 
+	void instanceUsed(int index, DocumentId documentId);
+	void instanceReleased(int index, DocumentId documentId);
+	void evictUnused();
+
 	void request();
 	void requestFinished();
 	void repaintLater(
@@ -155,6 +163,10 @@ private:
 			DocumentId,
 			std::unique_ptr<Ui::CustomEmoji::Instance>>,
 		kSizeCount> _instances;
+	base::flat_map<std::pair<int, DocumentId>, int> _usage;
+	base::flat_map<std::pair<int, DocumentId>, Unused> _unused;
+	int64 _unusedPreviewsSize = 0;
+	uint64 _unusedOrder = 0;
 	std::array<
 		base::flat_map<
 			DocumentId,
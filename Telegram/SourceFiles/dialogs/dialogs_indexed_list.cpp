@@ -10,8 +10,28 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "main/main_session.h"
 #include "data/data_session.h"
 #include "history/history.h"
+#include "core/utils.h"
 
 namespace Dialogs {
+namespace {
+
+constexpr auto kTrigramSize = 3;
+
+[[nodiscard]] uint64 ComputeTrigram(const QChar *chars) {
+	return (uint64(chars[0].unicode()) << 32)
+		| (uint64(chars[1].unicode()) << 16)
+		| uint64(chars[2].unicode());
+}
+
+template <typename Callback>
+void EnumerateTrigrams(const QString &word, Callback &&callback) {
+	const auto chars = word.constData();
+	for (auto i = 0, till = int(word.size()) - kTrigramSize; i <= till; ++i) {
+		callback(ComputeTrigram(chars + i));
+	}
+}
+
+} // namespace
 
 IndexedList::IndexedList(SortMode sortMode, FilterId filterId)
 : _sortMode(sortMode)
@@ -26,6 +46,7 @@ RowsByLetter IndexedList::addToEnd(Key key) {
 	}
 
 	auto result = RowsByLetter{ _list.addToEnd(key) };
+	indexTrigrams(result.main);
 	for (const auto &ch : key.entry()->chatListFirstLetters()) {
 		auto j = _index.find(ch);
 		if (j == _index.cend()) {
@@ -42,6 +63,7 @@ Row *IndexedList::addByName(Key key) {
 	}
 
 	const auto result = _list.addByName(key);
+	indexTrigrams(result);
 	for (const auto &ch : key.entry()->chatListFirstLetters()) {
 		auto j = _index.find(ch);
 		if (j == _index.cend()) {
@@ -126,6 +148,7 @@ void IndexedList::adjustByName(
 
 	const auto mainRow = _list.adjustByName(key);
 	if (!mainRow) return;
+	reindexTrigrams(mainRow);
 
 	auto toRemove = oldLetters;
 	auto toAdd = base::flat_set<QChar>();
@@ -163,6 +186,7 @@ void IndexedList::adjustNames(
 	const auto key = Dialogs::Key(history);
 	auto mainRow = _list.getRow(key);
 	if (!mainRow) return;
+	reindexTrigrams(mainRow);
 
 	auto toRemove = oldLetters;
 	auto toAdd = base::flat_set<QChar>();
@@ -195,6 +219,9 @@ void IndexedList::adjustNames(
 }
 
 void IndexedList::remove(Key key, Row *replacedBy) {
+	if (const auto row = _list.getRow(key)) {
+		unindexTrigrams(row);
+	}
 	if (_list.remove(key, replacedBy)) {
 		for (const auto &ch : key.entry()->chatListFirstLetters()) {
 			if (const auto it = _index.find(ch); it != _index.cend()) {
@@ -207,10 +234,92 @@ void IndexedList::remove(Key key, Row *replacedBy) {
 void IndexedList::clear() {
 	_list.clear();
 	_index.clear();
+	_trigrams.clear();
+	_trigramsByRow.clear();
+	_trigramsReady = false;
+}
+
+void IndexedList::ensureTrigrams() const {
+	if (_trigramsReady) {
+		return;
+	}
+	_trigramsReady = true;
+	_trigramsByRow.reserve(_list.size());
+	for (const auto &row : _list) {
+		indexTrigrams(row);
+	}
+}
+
+void IndexedList::indexTrigrams(not_null<Row*> row) const {
+	if (!_trigramsReady) {
+		return;
+	}
+	auto trigrams = std::vector<Trigram>();
+	for (const auto &name : row->entry()->chatListNameWords()) {
+		EnumerateTrigrams(name, [&](Trigram trigram) {
+			trigrams.push_back(trigram);
+		});
+	}
+	ranges::sort(trigrams);
+	trigrams.erase(
+		std::unique(begin(trigrams), end(trigrams)),
+		end(trigrams));
+	for (const auto trigram : trigrams) {
+		_trigrams[trigram].emplace(row);
+	}
+	_trigramsByRow[row] = std::move(trigrams);
+}
+
+void IndexedList::unindexTrigrams(not_null<Row*> row) const {
+	const auto i = _trigramsByRow.find(row);
+	if (i == end(_trigramsByRow)) {
+		return;
+	}
+	for (const auto trigram : i->second) {
+		const auto j = _trigrams.find(trigram);
+		if (j != end(_trigrams)) {
+			j->second.remove(row);
+			if (j->second.empty()) {
+				_trigrams.erase(j);
+			}
+		}
+	}
+	_trigramsByRow.erase(i);
+}
+
+void IndexedList::reindexTrigrams(not_null<Row*> row) {
+	if (_trigramsReady) {
+		unindexTrigrams(row);
+		indexTrigrams(row);
+	}
 }
 
 std::vector<not_null<Row*>> IndexedList::filtered(
 		const QStringList &words) const {
+	auto variants = std::vector<QStringList>();
+	auto infix = false;
+	for (const auto &word : words) {
+		if (word.isEmpty()) {
+			continue;
+		}
+		auto list = QStringList(word);
+		if (word.size() >= kTrigramSize) {
+			const auto translit = translitRusEng(word);
+			if (translit.size() >= kTrigramSize && translit != word) {
+				list.push_back(translit);
+			}
+			infix = true;
+		}
+		variants.push_back(std::move(list));
+	}
+	if (variants.empty() || empty()) {
+		return {};
+	}
+	return infix ? filteredByTrigrams(variants) : filteredByLetters(words);
+}
+
+std::vector<not_null<Row*>> IndexedList::filteredByLetters(
+		const QStringList &words) const {
 	const auto minimal = [&]() -> const Dialogs::List* {
 		if (empty()) {
 			return nullptr;
@@ -259,4 +368,107 @@ std::vector<not_null<Row*>> IndexedList::filtered(
 	return result;
 }
 
+std::vector<not_null<Row*>> IndexedList::filteredByTrigrams(
+		const std::vector<QStringList> &variants) const {
+	ensureTrigrams();
+
+	// Candidates come from the rarest trigram of each long word variant,
+	// the word with the fewest candidates in total drives the search.
+	const auto none = base::flat_set<not_null<Row*>>();
+	const auto rarest = [&](const QString &word) {
+		auto result = &none;
+		auto first = true;
+		EnumerateTrigrams(word, [&](Trigram trigram) {
+			const auto i = _trigrams.find(trigram);
+			const auto found = (i != end(_trigrams)) ? &i->second : &none;
+			if (first || found->size() < result->size()) {
+				result = found;
+				first = false;
+			}
+		});
+		return result;
+	};
+	auto driver = std::vector<const base::flat_set<not_null<Row*>>*>();
+	auto driverSize = std::numeric_limits<int>::max();
+	for (const auto &list : variants) {
+		if (list.front().size() < kTrigramSize) {
+			continue;
+		}
+		auto sets = std::vector<const base::flat_set<not_null<Row*>>*>();
+		auto size = 0;
+		for (const auto &word : list) {
+			sets.push_back(rarest(word));
+			size += int(sets.back()->size());
+		}
+		if (size < driverSize) {
+			driver = std::move(sets);
+			driverSize = size;
+		}
+	}
+	auto result = std::vector<not_null<Row*>>();
+	if (!driverSize) {
+		return result;
+	}
+	auto candidates = std::vector<not_null<Row*>>();
+	candidates.reserve(driverSize);
+	for (const auto set : driver) {
+		candidates.insert(end(candidates), set->begin(), set->end());
+	}
+	if (driver.size() > 1) {
+		ranges::sort(candidates);
+		candidates.erase(
+			std::unique(begin(candidates), end(candidates)),
+			end(candidates));
+	}
+
+	enum class Match {
+		None,
+		Infix,
+		Prefix,
+	};
+	const auto match = [](
+			const base::flat_set<QString> &names,
+			const QStringList &list) {
+		auto result = Match::None;
+		for (const auto &word : list) {
+			for (const auto &name : names) {
+				if (name.startsWith(word)) {
+					return Match::Prefix;
+				} else if (word.size() >= kTrigramSize
+					&& name.contains(word)) {
+					result = Match::Infix;
+				}
+			}
+		}
+		return result;
+	};
+	auto ranked = std::vector<std::pair<int, not_null<Row*>>>();
+	ranked.reserve(candidates.size());
+	for (const auto row : candidates) {
+		const auto &names = row->entry()->chatListNameWords();
+		auto infix = false;
+		auto found = true;
+		for (const auto &list : variants) {
+			const auto matched = match(names, list);
+			if (matched == Match::None) {
+				found = false;
+				break;
+			} else if (matched == Match::Infix) {
+				infix = true;
+			}
+		}
+		if (found) {
+			ranked.emplace_back(infix ? 1 : 0, row);
+		}
+	}
+	ranges::sort(ranked, ranges::less(), [](const auto &pair) {
+		return std::make_pair(pair.first, pair.second->index());
+	});
+	result.reserve(ranked.size());
+	for (const auto &[rank, row] : ranked) {
+		result.push_back(row);
+	}
+	return result;
+}
+
 } // namespace Dialogs
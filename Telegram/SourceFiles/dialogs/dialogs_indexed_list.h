@@ -51,6 +51,8 @@ public:
 		const auto i = _index.find(ch);
 		return (i != _index.end()) ? &i->second : nullptr;
 	}
+	// Words of three letters and more also match inside of name words
+	// and in transliteration, prefix matches are ranked first.
 	[[nodiscard]] std::vector<not_null<Row*>> filtered(
 		const QStringList &words) const;
 
@@ -85,6 +87,8 @@ public:
 	[[nodiscard]] iterator findByY(int y) { return all().findByY(y); }
 
 private:
+	using Trigram = uint64;
+
 	void adjustByName(
 		Key key,
 		const base::flat_set<QChar> &oldChars);
@@ -93,11 +97,29 @@ private:
 		not_null<History*> history,
 		const base::flat_set<QChar> &oldChars);
 
+	void ensureTrigrams() const;
+	void indexTrigrams(not_null<Row*> row) const;
+	void unindexTrigrams(not_null<Row*> row) const;
+	void reindexTrigrams(not_null<Row*> row);
+	[[nodiscard]] std::vector<not_null<Row*>> filteredByLetters(
+		const QStringList &words) const;
+	[[nodiscard]] std::vector<not_null<Row*>> filteredByTrigrams(
+		const std::vector<QStringList> &variants) const;
+
 	SortMode _sortMode = SortMode();
 	FilterId _filterId = 0;
 	List _list, _empty;
 	base::flat_map<QChar, List> _index;
 
+	// Built by the first infix search and kept up to date after that.
+	mutable std::unordered_map<
+		Trigram,
+		base::flat_set<not_null<Row*>>> _trigrams;
+	mutable std::unordered_map<
+		not_null<Row*>,
+		std::vector<Trigram>> _trigramsByRow;
+	mutable bool _trigramsReady = false;
+
 };
 
 } // namespace Dialogs
@@ -11,6 +11,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "dialogs/ui/chat_search_empty.h"
 #include "dialogs/ui/chat_search_in.h"
 #include "dialogs/ui/dialogs_layout.h"
+#include "dialogs/ui/dialogs_row_cache.h"
 #include "dialogs/ui/dialogs_video_userpic.h"
 #include "dialogs/dialogs_indexed_list.h"
 #include "dialogs/dialogs_widget.h"
@@ -281,6 +282,7 @@ InnerWidget::InnerWidget(
 , _controller(controller)
 , _shownList(controller->session().data().chatsList()->indexed())
 , _st(&st::defaultDialogRow)
+, _rowCache(std::make_unique<Ui::RowCache>())
 , _pinnedShiftAnimation([=](crl::time now) {
 	return pinnedShiftAnimationCallback(now);
 })
@@ -305,6 +307,7 @@ InnerWidget::InnerWidget(
 
 	session().downloaderTaskFinished(
 	) | rpl::start_with_next([=] {
+		_rowCache->clear();
 		update();
 	}, lifetime());
 
@@ -312,6 +315,7 @@ InnerWidget::InnerWidget(
 	) | rpl::start_with_next([=](Window::Notifications::ChangeType change) {
 		if (change == Window::Notifications::ChangeType::CountMessages) {
 			// Folder rows change their unread badge with this setting.
+			_rowCache->clear();
 			update();
 		}
 	}, lifetime());
@@ -440,6 +444,7 @@ InnerWidget::InnerWidget(
 					refresh();
 				}
 			} else {
+				_rowCache->clear();
 				update();
 			}
 		}, _handleChatListEntryTagRefreshesLifetime);
@@ -458,6 +463,7 @@ InnerWidget::InnerWidget(
 			stopReorderPinned();
 		}
 		if (update.flags & Data::HistoryUpdate::Flag::ChatOccupied) {
+			_rowCache->clear();
 			this->update();
 			_updated.fire({});
 		}
@@ -483,6 +489,7 @@ InnerWidget::InnerWidget(
 					updateDialogRow({ history, FullMsgId() });
 				}
 			} else {
+				_rowCache->clear();
 				this->update();
 			}
 			_updated.fire({});
@@ -843,9 +850,11 @@ void InnerWidget::paintEvent(QPaintEvent *e) {
 		.paused = videoPaused,
 		.narrow = (fullWidth < st::columnMinimalWidthLeft / 2),
 	};
+	_rowCache->startPaint(base::take(_scrolledSincePaint));
 	const auto fillGuard = gsl::finally([&] {
 		// We translate painter down, but it'll be cropped below rect.
 		p.fillRect(rect(), context.currentBg);
+		_rowCache->finishPaint();
 	});
 	const auto paintRow = [&](
 			not_null<Row*> row,
@@ -962,7 +971,7 @@ void InnerWidget::paintEvent(QPaintEvent *e) {
 		context.topicJumpSelected = selected
 			&& _selectedTopicJump
 			&& (!_pressed || _pressedTopicJump);
-		Ui::RowPainter::Paint(p, row, validateVideoUserpic(row), context);
+		_rowCache->paint(p, row, validateVideoUserpic(row), context);
 		if (context.quickActionContext) {
 			context.quickActionContext = nullptr;
 		}
@@ -2813,6 +2822,7 @@ int InnerWidget::defaultRowTop(not_null<Row*> row) const {
 void InnerWidget::repaintDialogRow(
 		FilterId filterId,
 		not_null<Row*> row) {
+	_rowCache->invalidate(row->key());
 	if (_state == WidgetState::Default) {
 		if (_filterId == filterId) {
 			if (const auto folder = row->folder()) {
@@ -2874,6 +2884,7 @@ void InnerWidget::updateDialogRow(
 		RowDescriptor row,
 		QRect updateRect,
 		UpdateRowSections sections) {
+	_rowCache->invalidate(row.key);
 	if (IsServerMsgId(-row.fullId.msg)) {
 		if (const auto peer = row.key.peer()) {
 			if (const auto from = peer->migrateFrom()) {
@@ -3773,6 +3784,9 @@ rpl::producer<> InnerWidget::refreshHashtagsRequests() const {
 void InnerWidget::visibleTopBottomUpdated(
 		int visibleTop,
 		int visibleBottom) {
+	if (_visibleTop != visibleTop) {
+		_scrolledSincePaint = true;
+	}
 	_visibleTop = visibleTop;
 	_visibleBottom = visibleBottom;
 	preloadRowsData();
@@ -4021,6 +4035,7 @@ void InnerWidget::refresh(bool toTop) {
 		jumpToTop();
 		preloadRowsData();
 	}
+	_rowCache->clear();
 	update();
 }
 
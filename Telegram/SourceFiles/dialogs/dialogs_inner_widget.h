@@ -67,6 +67,7 @@ struct ReactionId;
 namespace Dialogs::Ui {
 using namespace ::Ui;
 class VideoUserpic;
+class RowCache;
 struct PaintContext;
 struct TopicJumpCache;
 } // namespace Dialogs::Ui
@@ -538,6 +539,7 @@ private:
 	std::vector<std::unique_ptr<CollapsedRow>> _collapsedRows;
 	not_null<const style::DialogRow*> _st;
 	mutable std::unique_ptr<Ui::TopicJumpCache> _topicJumpCache;
+	const std::unique_ptr<Ui::RowCache> _rowCache;
 	bool _selectedChatTypeFilter = false;
 	bool _pressedChatTypeFilter = false;
 	bool _selectedMorePosts = false;
@@ -571,6 +573,7 @@ private:
 
 	int _visibleTop = 0;
 	int _visibleBottom = 0;
+	bool _scrolledSincePaint = false;
 	QString _filter, _hashtagFilter;
 
 	std::vector<std::unique_ptr<HashtagResult>> _hashtagResults;
@@ -239,6 +239,12 @@ bool MessageView::isInTopicJump(int x, int y) const {
 	return _topics && _topics->isInTopicJumpArea(x, y);
 }
 
+bool MessageView::hasPersistentAnimation() const {
+	return _spoiler
+		|| _senderCache.hasPersistentAnimation()
+		|| _textCache.hasPersistentAnimation();
+}
+
 void MessageView::addTopicJumpRipple(
 		QPoint origin,
 		not_null<TopicJumpCache*> topicJumpCache,
@@ -72,6 +72,7 @@ public:
 		const PaintContext &context) const;
 
 	[[nodiscard]] bool isInTopicJump(int x, int y) const;
+	[[nodiscard]] bool hasPersistentAnimation() const;
 	void addTopicJumpRipple(
 		QPoint origin,
 		not_null<TopicJumpCache*> topicJumpCache,
@@ -0,0 +1,159 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "dialogs/ui/dialogs_row_cache.h"
+
+#include "data/data_peer.h"
+#include "data/data_thread.h"
+#include "dialogs/dialogs_common.h"
+#include "dialogs/dialogs_row.h"
+#include "dialogs/ui/dialogs_layout.h"
+#include "history/view/history_view_send_action.h"
+#include "history/history.h"
+#include "ui/painter.h"
+
+namespace Dialogs::Ui {
+namespace {
+
+// Enough for all the rows visible on a tall screen, with some reserve.
+constexpr auto kMaxCachedRows = 32;
+
+} // namespace
+
+void RowCache::startPaint(bool scrolled) {
+	const auto day = QDate::currentDate();
+	if (_day != day) {
+		// Dates in the rows may be shown differently now.
+		_day = day;
+		clear();
+	}
+	_scrolled = scrolled;
+	++_paintIndex;
+}
+
+void RowCache::finishPaint() {
+	if (_cached.size() <= kMaxCachedRows) {
+		return;
+	}
+	auto indices = std::vector<int>();
+	indices.reserve(_cached.size());
+	for (const auto &[key, cached] : _cached) {
+		indices.push_back(cached.paintIndex);
+	}
+	const auto threshold = indices.end() - kMaxCachedRows;
+	ranges::nth_element(indices, threshold);
+	const auto oldest = *threshold;
+	for (auto i = begin(_cached); i != end(_cached);) {
+		if (i->second.paintIndex < oldest) {
+			i = _cached.erase(i);
+		} else {
+			++i;
+		}
+	}
+}
+
+void RowCache::paint(
+		Painter &p,
+		not_null<const Row*> row,
+		VideoUserpic *videoUserpic,
+		const PaintContext &context) {
+	if (!_scrolled || !Cacheable(row, videoUserpic, context)) {
+		_cached.remove(row->key());
+		RowPainter::Paint(p, row, videoUserpic, context);
+		return;
+	}
+	auto key = ComputeKey(row, context);
+	auto &cached = _cached[row->key()];
+	if (cached.image.isNull() || cached.key != key) {
+		const auto ratio = style::DevicePixelRatio();
+		const auto size = QSize(key.width, key.height) * ratio;
+		if (cached.image.size() != size) {
+			cached.image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+			cached.image.setDevicePixelRatio(ratio);
+		}
+		cached.image.fill(Qt::transparent);
+		auto q = Painter(&cached.image);
+		q.setInactive(context.paused);
+		RowPainter::Paint(q, row, nullptr, context);
+		cached.key = std::move(key);
+	}
+	cached.paintIndex = _paintIndex;
+	p.drawImage(0, 0, cached.image);
+}
+
+void RowCache::invalidate(Key key) {
+	_cached.remove(key);
+}
+
+void RowCache::clear() {
+	_cached.clear();
+}
+
+bool RowCache::Cacheable(
+		not_null<const Row*> row,
+		VideoUserpic *videoUserpic,
+		const PaintContext &context) {
+	if (videoUserpic
+		|| context.quickActionContext
+		|| context.topicsExpanded > 0.
+		|| row->hasRipple()
+		|| row->topicJumpRipple()
+		|| (context.rightButton && context.rightButton->ripple)) {
+		return false;
+	} else if (const auto history = row->history()) {
+		// Topic jumps are animated and have their own ripples.
+		if (history->isForum() || history->amMonoforumAdmin()) {
+			return false;
+		}
+	}
+	// Custom emoji in the name, the preview or the draft and emoji
+	// statuses are animated, a cached frame would freeze them.
+	if (row->itemView().hasPersistentAnimation()) {
+		return false;
+	} else if (const auto peer = row->key().peer()) {
+		if (peer->emojiStatusId() || peer->botVerifyDetails()) {
+			return false;
+		}
+	}
+	const auto thread = row->thread();
+	if (thread && thread->cloudDraftTextCache().hasPersistentAnimation()) {
+		return false;
+	}
+	const auto painter = thread ? thread->sendActionPainter() : nullptr;
+	return !painter || !painter->animating();
+}
+
+auto RowCache::ComputeKey(
+		not_null<const Row*> row,
+		const PaintContext &context) -> CacheKey {
+	const QBrush &bg = context.currentBg;
+
+	// Tag images are re-rendered in place, so key on their contents.
+	auto chatsFilterTags = std::vector<qint64>();
+	if (const auto tags = context.chatsFilterTags) {
+		chatsFilterTags.reserve(tags->size());
+		for (const auto tag : *tags) {
+			chatsFilterTags.push_back(tag->cacheKey());
+		}
+	}
+	return {
+		.st = context.st.get(),
+		.chatsFilterTags = std::move(chatsFilterTags),
+		.bg = bg.color().rgba(),
+		.filter = context.filter,
+		.width = context.width,
+		.height = row->height(),
+		.paletteVersion = style::PaletteVersion(),
+		.active = context.active,
+		.selected = context.selected,
+		.paused = context.paused,
+		.search = context.search,
+		.narrow = context.narrow,
+	};
+}
+
+} // namespace Dialogs::Ui
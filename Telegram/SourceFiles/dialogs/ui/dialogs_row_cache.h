@@ -0,0 +1,89 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "dialogs/dialogs_key.h"
+
+class Painter;
+
+namespace style {
+struct DialogRow;
+} // namespace style
+
+namespace Dialogs {
+class Row;
+} // namespace Dialogs
+
+namespace Dialogs::Ui {
+
+using namespace ::Ui;
+
+class VideoUserpic;
+struct PaintContext;
+
+// Keeps rendered chat list rows, so that scrolling the list blits them
+// instead of laying out and painting the names and previews once again.
+//
+// Cached images are reused only in paints that follow a scroll, any other
+// paint of a row means something in it has changed and repaints it.
+// Rows with animated content are never cached.
+class RowCache final {
+public:
+	void startPaint(bool scrolled);
+	void finishPaint();
+
+	void paint(
+		Painter &p,
+		not_null<const Row*> row,
+		VideoUserpic *videoUserpic,
+		const PaintContext &context);
+
+	void invalidate(Key key);
+	void clear();
+
+private:
+	struct CacheKey {
+		const style::DialogRow *st = nullptr;
+		std::vector<qint64> chatsFilterTags;
+		QRgb bg = 0;
+		FilterId filter = 0;
+		int width = 0;
+		int height = 0;
+		int paletteVersion = 0;
+		bool active = false;
+		bool selected = false;
+		bool paused = false;
+		bool search = false;
+		bool narrow = false;
+
+		friend inline bool operator==(
+			const CacheKey &a,
+			const CacheKey &b) = default;
+	};
+	struct Cached {
+		QImage image;
+		CacheKey key;
+		int paintIndex = 0;
+	};
+
+	[[nodiscard]] static bool Cacheable(
+		not_null<const Row*> row,
+		VideoUserpic *videoUserpic,
+		const PaintContext &context);
+	[[nodiscard]] static CacheKey ComputeKey(
+		not_null<const Row*> row,
+		const PaintContext &context);
+
+	base::flat_map<Key, Cached> _cached;
+	QDate _day;
+	int _paintIndex = 0;
+	bool _scrolled = false;
+
+};
+
+} // namespace Dialogs::Ui
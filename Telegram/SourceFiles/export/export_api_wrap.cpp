@@ -11,6 +11,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "export/data/export_data_types.h"
 #include "export/output/export_output_result.h"
 #include "export/output/export_output_file.h"
+#include "export/output/export_output_checkpoint.h"
 #include "mtproto/mtproto_response.h"
 #include "base/bytes.h"
 #include "base/options.h"
@@ -22,9 +23,8 @@ namespace Export {
 namespace {
 
 constexpr auto kUserpicsSliceLimit = 100;
-constexpr auto kFileChunkSize = 128 * 1024;
-constexpr auto kFileRequestsCount = 2;
-//constexpr auto kFileNextRequestDelay = crl::time(20);
+constexpr auto kFileChunkSize = 512 * 1024;
+constexpr auto kFileRequestsCount = 4;
 constexpr auto kChatsSliceLimit = 100;
 constexpr auto kMessagesSliceLimit = 100;
 constexpr auto kTopPeerSliceLimit = 100;
@@ -40,6 +40,9 @@ struct LocationKey {
 	inline bool operator<(const LocationKey &other) const {
 		return std::tie(type, id) < std::tie(other.type, other.id);
 	}
+	inline bool operator==(const LocationKey &other) const {
+		return std::tie(type, id) == std::tie(other.type, other.id);
+	}
 };
 
 LocationKey ComputeLocationKey(const Data::FileLocation &value) {
@@ -67,6 +70,65 @@ LocationKey ComputeLocationKey(const Data::FileLocation &value) {
 	return result;
 }
 
+bool CheckpointLocation(const Data::FileLocation &location) {
+	// Takeout files are generated for each export once again.
+	return location
+		&& (location.data.type() != mtpc_inputTakeoutFileLocation);
+}
+
+Output::Checkpoint::FileKey CheckpointFileKey(
+		const Data::FileLocation &location) {
+	const auto key = ComputeLocationKey(location);
+	return { key.type, key.id };
+}
+
+Data::File::SkipReason FileSkipReason(
+		const Settings &settings,
+		const Data::File &file,
+		const Data::Message *message,
+		const Data::Story *story) {
+	using SkipReason = Data::File::SkipReason;
+	using Type = MediaSettings::Type;
+	const auto media = message
+		? &message->media
+		: story
+		? &story->media
+		: nullptr;
+	const auto type = media ? v::match(media->content, [&](
+			const Data::Document &data) {
+		if (data.isSticker) {
+			return Type::Sticker;
+		} else if (data.isVideoMessage) {
+			return Type::VideoMessage;
+		} else if (data.isVoiceMessage) {
+			return Type::VoiceMessage;
+		} else if (data.isAnimated) {
+			return Type::GIF;
+		} else if (data.isVideoFile) {
+			return Type::Video;
+		} else {
+			return Type::File;
+		}
+	}, [](const auto &data) {
+		return Type::Photo;
+	}) : Type(0);
+
+	const auto fullSize = message
+		? message->file().size
+		: story
+		? story->file().size
+		: file.size;
+	if (message && Data::SkipMessageByDate(*message, settings)) {
+		return SkipReason::DateLimits;
+	} else if (!story && (settings.media.types & type) != type) {
+		return SkipReason::FileType;
+	} else if (!story && fullSize > settings.media.sizeLimit) {
+		// Don't load thumbs for large files that we skip.
+		return SkipReason::FileSize;
+	}
+	return SkipReason::None;
+}
+
 Settings::Type SettingsFromDialogsType(Data::DialogInfo::Type type) {
 	using DialogType = Data::DialogInfo::Type;
 	switch (type) {
@@ -178,9 +240,11 @@ struct ApiWrap::FileProcess {
 	struct Request {
 		int64 offset = 0;
 		QByteArray bytes;
+		mtpRequestId id = 0;
+		bool waitingReference = false;
 	};
 	std::deque<Request> requests;
-	mtpRequestId requestId = 0;
+	mtpRequestId referenceRequestId = 0;
 };
 
 struct ApiWrap::FileProgress {
@@ -227,6 +291,7 @@ struct ApiWrap::ChatProcess {
 	std::optional<Data::MessagesSlice> slice;
 	bool lastSlice = false;
 	int fileIndex = 0;
+	int prefetchIndex = 0;
 };
 
 
@@ -368,11 +433,13 @@ auto ApiWrap::splitRequest(int index, Request &&request) {
 		std::forward<Request>(request)));
 }
 
-auto ApiWrap::fileRequest(const Data::FileLocation &location, int64 offset) {
+auto ApiWrap::fileRequest(
+		uint64 randomId,
+		const Data::FileLocation &location,
+		int64 offset) {
 	Expects(location.dcId != 0
 		|| location.data.type() == mtpc_inputTakeoutFileLocation);
 	Expects(_takeoutId.has_value());
-	Expects(_fileProcess->requestId == 0);
 
 	return std::move(_mtp.request(MTPInvokeWithTakeout<MTPupload_GetFile>(
 		MTP_long(*_takeoutId),
@@ -382,10 +449,23 @@ auto ApiWrap::fileRequest(const Data::FileLocation &location, int64 offset) {
 			MTP_long(offset),
 			MTP_int(kFileChunkSize))
 	)).fail([=](const MTP::Error &result) {
-		_fileProcess->requestId = 0;
+		const auto process = findFileProcess(randomId);
+		if (!process) {
+			return;
+		}
+		using Request = FileProcess::Request;
+		auto &requests = process->requests;
+		const auto i = ranges::find(
+			requests,
+			offset,
+			[](const Request &request) { return request.offset; });
+		Assert(i != end(requests));
+		i->id = 0;
+
 		if (result.type() == u"TAKEOUT_FILE_EMPTY"_q
 			&& _otherDataProcess != nullptr) {
 			filePartDone(
+				process,
 				0,
 				MTP_upload_file(
 					MTP_storage_filePartial(),
@@ -394,10 +474,10 @@ auto ApiWrap::fileRequest(const Data::FileLocation &location, int64 offset) {
 		} else if (result.type() == u"LOCATION_INVALID"_q
 			|| result.type() == u"VERSION_INVALID"_q
 			|| result.type() == u"LOCATION_NOT_AVAILABLE"_q) {
-			filePartUnavailable();
+			filePartUnavailable(process);
 		} else if (result.code() == 400
 			&& result.type().startsWith(u"FILE_REFERENCE_"_q)) {
-			filePartRefreshReference(offset);
+			filePartRefreshReference(process, offset);
 		} else {
 			error(std::move(result));
 		}
@@ -422,12 +502,14 @@ rpl::producer<Output::Result> ApiWrap::ioErrors() const {
 void ApiWrap::startExport(
 		const Settings &settings,
 		Output::Stats *stats,
+		Output::Checkpoint *checkpoint,
 		FnMut<void(StartInfo)> done) {
 	Expects(_settings == nullptr);
 	Expects(_startProcess == nullptr);
 
 	_settings = std::make_unique<Settings>(settings);
 	_stats = stats;
+	_checkpoint = checkpoint;
 	_startProcess = std::make_unique<StartProcess>();
 	_startProcess->done = std::move(done);
 
@@ -1276,9 +1358,9 @@ void ApiWrap::skipFile(uint64 randomId) {
 	}
 	LOG(("Export Info: File skipped."));
 	Assert(!_fileProcess->requests.empty());
-	Assert(_fileProcess->requestId != 0);
-	_mtp.request(base::take(_fileProcess->requestId)).cancel();
-	base::take(_fileProcess)->done(QString());
+	const auto process = _fileProcess.get();
+	cancelFileRequests(process);
+	finishFileProcess(process, QString());
 }
 
 void ApiWrap::cancelExportFast() {
@@ -1714,6 +1796,7 @@ void ApiWrap::loadMessagesFiles(Data::MessagesSlice &&slice) {
 	}
 	_chatProcess->slice = std::move(slice);
 	_chatProcess->fileIndex = 0;
+	_chatProcess->prefetchIndex = 0;
 
 	resolveCustomEmoji();
 }
@@ -1800,12 +1883,19 @@ Data::Message *ApiWrap::currentFileMessage() const {
 
 Data::FileOrigin ApiWrap::currentFileMessageOrigin() const {
 	Expects(_chatProcess != nullptr);
+
+	return messageFileOrigin(_chatProcess->fileIndex);
+}
+
+Data::FileOrigin ApiWrap::messageFileOrigin(int index) const {
+	Expects(_chatProcess != nullptr);
 	Expects(_chatProcess->slice.has_value());
+	Expects(index >= 0 && index < _chatProcess->slice->list.size());
 
 	const auto splitIndex = _chatProcess->info.splits[
 		_chatProcess->localSplitIndex];
 	auto result = Data::FileOrigin();
-	result.messageId = currentFileMessage()->id;
+	result.messageId = _chatProcess->slice->list[index].id;
 	result.split = (splitIndex >= 0)
 		? splitIndex
 		: (int(_splits.size()) + splitIndex);
@@ -1894,6 +1984,7 @@ void ApiWrap::loadNextMessageFile() {
 			[=](const QString &path) { loadMessageFileDone(path); },
 			currentFileMessage());
 		if (!ready) {
+			prefetchMessageFiles();
 			return;
 		}
 		const auto thumbProgress = [=](FileProgress value) {
@@ -1906,16 +1997,61 @@ void ApiWrap::loadNextMessageFile() {
 			[=](const QString &path) { loadMessageThumbDone(path); },
 			currentFileMessage());
 		if (!thumbReady) {
+			prefetchMessageFiles();
 			return;
 		}
 	}
 	finishMessagesSlice();
 }
 
+void ApiWrap::prefetchMessageFiles() {
+	Expects(_settings != nullptr);
+	Expects(_chatProcess != nullptr);
+	Expects(_chatProcess->slice.has_value());
+
+	// The file at fileIndex is loaded by _fileProcess, so only the
+	// following ones are prefetched, each of them at most once.
+	const auto limit = _settings->media.parallelDownloads - 1;
+	auto &list = _chatProcess->slice->list;
+	auto &index = _chatProcess->prefetchIndex;
+	index = std::max(index, _chatProcess->fileIndex + 1);
+	for (; index < list.size(); ++index) {
+		if (int(_prefetchProcesses.size()) >= limit) {
+			return;
+		}
+		const auto &message = list[index];
+		const auto &file = message.file();
+		if (!file.relativePath.isEmpty()
+			|| file.skipReason != Data::File::SkipReason::None
+			|| !file.location
+			|| !file.content.isEmpty()
+			|| findLoadedFile(file.location)
+			|| findFileProcess(file.location)
+			|| (FileSkipReason(*_settings, file, &message, nullptr)
+				!= Data::File::SkipReason::None)) {
+			continue;
+		}
+		auto process = prepareFileProcess(file, messageFileOrigin(index));
+		const auto raw = process.get();
+		_prefetchProcesses.push_back(std::move(process));
+		loadFilePart(raw);
+	}
+}
+
+void ApiWrap::cancelPrefetchProcesses() {
+	for (const auto &process : base::take(_prefetchProcesses)) {
+		cancelFileRequests(process.get());
+		process->file.remove();
+		_reservedPaths.remove(process->relativePath);
+	}
+}
+
 void ApiWrap::finishMessagesSlice() {
 	Expects(_chatProcess != nullptr);
 	Expects(_chatProcess->slice.has_value());
 
+	cancelPrefetchProcesses();
+
 	auto slice = *base::take(_chatProcess->slice);
 	if (!slice.list.empty()) {
 		_chatProcess->largestIdPlusOne = slice.list.back().id + 1;
@@ -2032,51 +2168,25 @@ bool ApiWrap::processFileLoad(
 		return !file.relativePath.isEmpty();
 	}
 
-	using Type = MediaSettings::Type;
-	const auto media = message
-		? &message->media
-		: story
-		? &story->media
-		: nullptr;
-	const auto type = media ? v::match(media->content, [&](
-			const Data::Document &data) {
-		if (data.isSticker) {
-			return Type::Sticker;
-		} else if (data.isVideoMessage) {
-			return Type::VideoMessage;
-		} else if (data.isVoiceMessage) {
-			return Type::VoiceMessage;
-		} else if (data.isAnimated) {
-			return Type::GIF;
-		} else if (data.isVideoFile) {
-			return Type::Video;
-		} else {
-			return Type::File;
-		}
-	}, [](const auto &data) {
-		return Type::Photo;
-	}) : Type(0);
-
-	const auto fullSize = message
-		? message->file().size
-		: story
-		? story->file().size
-		: file.size;
-	if (message && Data::SkipMessageByDate(*message, *_settings)) {
-		file.skipReason = SkipReason::DateLimits;
-		return true;
-	} else if (!story && (_settings->media.types & type) != type) {
-		file.skipReason = SkipReason::FileType;
-		return true;
-	} else if (!story && fullSize > _settings->media.sizeLimit) {
-		// Don't load thumbs for large files that we skip.
-		file.skipReason = SkipReason::FileSize;
+	const auto reason = FileSkipReason(*_settings, file, message, story);
+	if (reason != SkipReason::None) {
+		file.skipReason = reason;
 		return true;
 	}
 	loadFile(file, origin, std::move(progress), std::move(done));
 	return false;
 }
 
+std::optional<QString> ApiWrap::findLoadedFile(
+		const Data::FileLocation &location) const {
+	if (const auto path = _fileCache->find(location)) {
+		return path;
+	} else if (!_checkpoint || !CheckpointLocation(location)) {
+		return std::nullopt;
+	}
+	return _checkpoint->findFile(CheckpointFileKey(location));
+}
+
 bool ApiWrap::writePreloadedFile(
 		Data::File &file,
 		const Data::FileOrigin &origin) {
@@ -2084,11 +2194,12 @@ bool ApiWrap::writePreloadedFile(
 
 	using namespace Output;
 
-	if (const auto path = _fileCache->find(file.location)) {
+	if (const auto path = findLoadedFile(file.location)) {
 		file.relativePath = *path;
 		return true;
 	} else if (!file.content.isEmpty()) {
 		const auto process = prepareFileProcess(file, origin);
+		_reservedPaths.remove(process->relativePath);
 		if (const auto result = process->file.writeBlock(file.content)) {
 			file.relativePath = process->relativePath;
 			_fileCache->save(file.location, file.relativePath);
@@ -2109,7 +2220,10 @@ void ApiWrap::loadFile(
 	Expects(file.location.dcId != 0
 		|| file.location.data.type() == mtpc_inputTakeoutFileLocation);
 
-	_fileProcess = prepareFileProcess(file, origin);
+	_fileProcess = takePrefetchProcess(file.location);
+	if (!_fileProcess) {
+		_fileProcess = prepareFileProcess(file, origin);
+	}
 	_fileProcess->progress = std::move(progress);
 	_fileProcess->done = std::move(done);
 
@@ -2123,20 +2237,24 @@ void ApiWrap::loadFile(
 		}
 	}
 
-	loadFilePart();
+	loadFilePart(_fileProcess.get());
 
-	Ensures(_fileProcess->requestId != 0);
+	Ensures(!_fileProcess->requests.empty());
 }
 
 auto ApiWrap::prepareFileProcess(
 	const Data::File &file,
-	const Data::FileOrigin &origin) const
+	const Data::FileOrigin &origin)
 -> std::unique_ptr<FileProcess> {
 	Expects(_settings != nullptr);
 
+	// Files are written only when their first part arrives, so the names
+	// of the ones being downloaded must be reserved until they finish.
 	const auto relativePath = Output::File::PrepareRelativePath(
 		_settings->path,
-		file.suggestedPath);
+		file.suggestedPath,
+		[&](const QString &path) { return _reservedPaths.contains(path); });
+	_reservedPaths.emplace(relativePath);
 	auto result = std::make_unique<FileProcess>(
 		_settings->path + relativePath,
 		_stats);
@@ -2148,71 +2266,166 @@ auto ApiWrap::prepareFileProcess(
 	return result;
 }
 
-void ApiWrap::loadFilePart() {
-	if (!_fileProcess
-		|| _fileProcess->requestId
-		|| _fileProcess->requests.size() >= kFileRequestsCount
-		|| (_fileProcess->size > 0
-			&& _fileProcess->offset >= _fileProcess->size)) {
-		return;
+auto ApiWrap::takePrefetchProcess(const Data::FileLocation &location)
+-> std::unique_ptr<FileProcess> {
+	if (_prefetchProcesses.empty() || !location) {
+		return nullptr;
 	}
+	const auto key = ComputeLocationKey(location);
+	const auto i = ranges::find_if(_prefetchProcesses, [&](
+			const std::unique_ptr<FileProcess> &process) {
+		return (ComputeLocationKey(process->location) == key);
+	});
+	if (i == end(_prefetchProcesses)) {
+		return nullptr;
+	}
+	auto result = std::move(*i);
+	_prefetchProcesses.erase(i);
+	return result;
+}
 
-	const auto offset = _fileProcess->offset;
-	_fileProcess->requests.push_back({ offset });
-	_fileProcess->requestId = fileRequest(
-		_fileProcess->location,
-		_fileProcess->offset
+ApiWrap::FileProcess *ApiWrap::findFileProcess(uint64 randomId) const {
+	if (_fileProcess && _fileProcess->randomId == randomId) {
+		return _fileProcess.get();
+	}
+	for (const auto &process : _prefetchProcesses) {
+		if (process->randomId == randomId) {
+			return process.get();
+		}
+	}
+	return nullptr;
+}
+
+ApiWrap::FileProcess *ApiWrap::findFileProcess(
+		const Data::FileLocation &location) const {
+	const auto key = ComputeLocationKey(location);
+	const auto matches = [&](const std::unique_ptr<FileProcess> &process) {
+		return process
+			&& process->location
+			&& (ComputeLocationKey(process->location) == key);
+	};
+	if (matches(_fileProcess)) {
+		return _fileProcess.get();
+	}
+	for (const auto &process : _prefetchProcesses) {
+		if (matches(process)) {
+			return process.get();
+		}
+	}
+	return nullptr;
+}
+
+void ApiWrap::loadFilePart(not_null<FileProcess*> process) {
+	// Parts of a file with a known size are requested kFileRequestsCount
+	// at a time, otherwise we wait for an empty part to mark the end.
+	const auto limit = (process->size > 0) ? kFileRequestsCount : 1;
+	while (!process->referenceRequestId
+		&& process->requests.size() < limit
+		&& (process->size > 0
+			? (process->offset < process->size)
+			: process->requests.empty())) {
+		const auto offset = process->offset;
+		process->requests.push_back({ offset });
+		process->requests.back().id = requestFilePart(process, offset);
+		process->offset += kFileChunkSize;
+	}
+}
+
+mtpRequestId ApiWrap::requestFilePart(
+		not_null<FileProcess*> process,
+		int64 offset) {
+	const auto randomId = process->randomId;
+	return fileRequest(
+		randomId,
+		process->location,
+		offset
 	).done([=](const MTPupload_File &result) {
-		_fileProcess->requestId = 0;
-		filePartDone(offset, result);
+		if (const auto process = findFileProcess(randomId)) {
+			filePartDone(process, offset, result);
+		}
 	}).send();
-	_fileProcess->offset += kFileChunkSize;
+}
 
-	if (_fileProcess->size > 0
-		&& _fileProcess->requests.size() < kFileRequestsCount) {
-		// Only one request at a time supported right now.
-		//const auto runner = _runner;
-		//crl::on_main([=] {
-		//	QTimer::singleShot(kFileNextRequestDelay, [=] {
-		//		runner([=] {
-		//			loadFilePart();
-		//		});
-		//	});
-		//});
+void ApiWrap::cancelFileRequests(not_null<FileProcess*> process) {
+	for (auto &request : process->requests) {
+		if (request.id) {
+			_mtp.request(base::take(request.id)).cancel();
+		}
+	}
+	if (process->referenceRequestId) {
+		_mtp.request(base::take(process->referenceRequestId)).cancel();
 	}
 }
 
-void ApiWrap::filePartDone(int64 offset, const MTPupload_File &result) {
-	Expects(_fileProcess != nullptr);
-	Expects(!_fileProcess->requests.empty());
+void ApiWrap::finishFileProcess(
+		not_null<FileProcess*> process,
+		const QString &relativePath) {
+	_reservedPaths.remove(process->relativePath);
+	if (!relativePath.isEmpty()) {
+		_fileCache->save(process->location, relativePath);
+		if (_checkpoint && CheckpointLocation(process->location)) {
+			const auto result = _checkpoint->fileLoaded(
+				CheckpointFileKey(process->location),
+				relativePath,
+				process->file.size());
+			if (!result) {
+				ioError(result);
+				return;
+			}
+		}
+	}
+	if (process.get() == _fileProcess.get()) {
+		base::take(_fileProcess)->done(relativePath);
+		return;
+	}
+	const auto i = ranges::find(
+		_prefetchProcesses,
+		process.get(),
+		&std::unique_ptr<FileProcess>::get);
+	Assert(i != end(_prefetchProcesses));
+	_prefetchProcesses.erase(i);
+
+	// An unavailable prefetched file will be requested once again when
+	// its message is reached, so that the error is handled in one place.
+	if (_chatProcess && _chatProcess->slice) {
+		prefetchMessageFiles();
+	}
+}
+
+void ApiWrap::filePartDone(
+		not_null<FileProcess*> process,
+		int64 offset,
+		const MTPupload_File &result) {
+	Expects(!process->requests.empty());
 
 	if (result.type() == mtpc_upload_fileCdnRedirect) {
 		error("Cdn redirect is not supported.");
 		return;
 	}
+	using Request = FileProcess::Request;
+	auto &requests = process->requests;
+	const auto i = ranges::find(
+		requests,
+		offset,
+		[](const Request &request) { return request.offset; });
+	Assert(i != end(requests));
+	i->id = 0;
+
 	const auto &data = result.c_upload_file();
 	if (data.vbytes().v.isEmpty()) {
-		if (_fileProcess->size > 0) {
+		if (process->size > 0) {
 			error("Empty bytes received in file part.");
 			return;
 		}
-		const auto result = _fileProcess->file.writeBlock({});
+		const auto result = process->file.writeBlock({});
 		if (!result) {
 			ioError(result);
 			return;
 		}
 	} else {
-		using Request = FileProcess::Request;
-		auto &requests = _fileProcess->requests;
-		const auto i = ranges::find(
-			requests,
-			offset,
-			[](const Request &request) { return request.offset; });
-		Assert(i != end(requests));
-
 		i->bytes = data.vbytes().v;
 
-		auto &file = _fileProcess->file;
+		auto &file = process->file;
 		while (!requests.empty() && !requests.front().bytes.isEmpty()) {
 			const auto &bytes = requests.front().bytes;
 			if (const auto result = file.writeBlock(bytes); !result) {
@@ -2222,42 +2435,62 @@ void ApiWrap::filePartDone(int64 offset, const MTPupload_File &result) {
 			requests.pop_front();
 		}
 
-		if (_fileProcess->progress) {
-			_fileProcess->progress(FileProgress{
+		if (process->progress) {
+			process->progress(FileProgress{
 				file.size(),
-				_fileProcess->size });
+				process->size });
 		}
 
 		if (!requests.empty()
-			|| !_fileProcess->size
-			|| _fileProcess->size > _fileProcess->offset) {
-			loadFilePart();
+			|| !process->size
+			|| process->size > process->offset) {
+			loadFilePart(process);
 			return;
 		}
 	}
-
-	auto process = base::take(_fileProcess);
-	const auto relativePath = process->relativePath;
-	_fileCache->save(process->location, relativePath);
-	process->done(process->relativePath);
+	finishFileProcess(process, process->relativePath);
 }
 
-void ApiWrap::filePartRefreshReference(int64 offset) {
-	Expects(_fileProcess != nullptr);
-	Expects(_fileProcess->requestId == 0);
+void ApiWrap::filePartRefreshReference(
+		not_null<FileProcess*> process,
+		int64 offset) {
+	using Request = FileProcess::Request;
+	auto &requests = process->requests;
+	const auto i = ranges::find(
+		requests,
+		offset,
+		[](const Request &request) { return request.offset; });
+	Assert(i != end(requests));
+	Assert(i->id == 0);
+
+	// All parts that failed are sent again after a single refresh.
+	i->waitingReference = true;
+	if (process->referenceRequestId) {
+		return;
+	}
 
-	const auto &origin = _fileProcess->origin;
+	const auto randomId = process->randomId;
+	const auto unavailable = [=](const MTP::Error &error) {
+		if (const auto process = findFileProcess(randomId)) {
+			process->referenceRequestId = 0;
+			filePartUnavailable(process);
+		}
+		return true;
+	};
+	const auto extract = [=](const auto &result) {
+		if (const auto process = findFileProcess(randomId)) {
+			process->referenceRequestId = 0;
+			filePartExtractReference(process, result);
+		}
+	};
+	const auto &origin = process->origin;
 	if (origin.storyId) {
-		_fileProcess->requestId = mainRequest(MTPstories_GetStoriesByID(
-			MTP_inputPeerSelf(),
-			MTP_vector<MTPint>(1, MTP_int(origin.storyId))
-		)).fail([=](const MTP::Error &error) {
-			_fileProcess->requestId = 0;
-			filePartUnavailable();
-			return true;
-		}).done([=](const MTPstories_Stories &result) {
-			_fileProcess->requestId = 0;
-			filePartExtractReference(offset, result);
+		process->referenceRequestId = mainRequest(
+			MTPstories_GetStoriesByID(
+				MTP_inputPeerSelf(),
+				MTP_vector<MTPint>(1, MTP_int(origin.storyId)))
+		).fail(unavailable).done([=](const MTPstories_Stories &result) {
+			extract(result);
 		}).send();
 		return;
 	} else if (!origin.messageId) {
@@ -2274,43 +2507,32 @@ void ApiWrap::filePartRefreshReference(int64 offset) {
 				origin.peer.c_inputPeerChannelFromMessage().vpeer(),
 				origin.peer.c_inputPeerChannelFromMessage().vmsg_id(),
 				origin.peer.c_inputPeerChannelFromMessage().vchannel_id());
-		_fileProcess->requestId = mainRequest(MTPchannels_GetMessages(
+		process->referenceRequestId = mainRequest(MTPchannels_GetMessages(
 			channel,
 			MTP_vector<MTPInputMessage>(
 				1,
 				MTP_inputMessageID(MTP_int(origin.messageId)))
-		)).fail([=](const MTP::Error &error) {
-			_fileProcess->requestId = 0;
-			filePartUnavailable();
-			return true;
-		}).done([=](const MTPmessages_Messages &result) {
-			_fileProcess->requestId = 0;
-			filePartExtractReference(offset, result);
+		)).fail(unavailable).done([=](const MTPmessages_Messages &result) {
+			extract(result);
 		}).send();
 	} else {
-		_fileProcess->requestId = splitRequest(
+		process->referenceRequestId = splitRequest(
 			origin.split,
 			MTPmessages_GetMessages(
 				MTP_vector<MTPInputMessage>(
 					1,
 					MTP_inputMessageID(MTP_int(origin.messageId)))
 			)
-		).fail([=](const MTP::Error &error) {
-			_fileProcess->requestId = 0;
-			filePartUnavailable();
-			return true;
-		}).done([=](const MTPmessages_Messages &result) {
-			_fileProcess->requestId = 0;
-			filePartExtractReference(offset, result);
+		).fail(unavailable).done([=](const MTPmessages_Messages &result) {
+			extract(result);
 		}).send();
 	}
 }
 
 void ApiWrap::filePartExtractReference(
-		int64 offset,
+		not_null<FileProcess*> process,
 		const MTPmessages_Messages &result) {
-	Expects(_fileProcess != nullptr);
-	Expects(_fileProcess->requestId == 0);
+	Expects(process->referenceRequestId == 0);
 
 	result.match([&](const MTPDmessages_messagesNotModified &data) {
 		error("Unexpected messagesNotModified received.");
@@ -2326,68 +2548,65 @@ void ApiWrap::filePartExtractReference(
 			data.vchats(),
 			_chatProcess->info.relativePath);
 		for (const auto &message : messages.list) {
-			if (message.id == _fileProcess->origin.messageId) {
+			if (message.id == process->origin.messageId) {
 				const auto refresh1 = Data::RefreshFileReference(
-					_fileProcess->location,
+					process->location,
 					message.file().location);
 				const auto refresh2 = Data::RefreshFileReference(
-					_fileProcess->location,
+					process->location,
 					message.thumb().file.location);
 				if (refresh1 || refresh2) {
-					_fileProcess->requestId = fileRequest(
-						_fileProcess->location,
-						offset
-					).done([=](const MTPupload_File &result) {
-						_fileProcess->requestId = 0;
-						filePartDone(offset, result);
-					}).send();
+					filePartResendWaiting(process);
 					return;
 				}
 			}
 		}
-		filePartUnavailable();
+		filePartUnavailable(process);
 	});
 }
 
 void ApiWrap::filePartExtractReference(
-		int64 offset,
+		not_null<FileProcess*> process,
 		const MTPstories_Stories &result) {
-	Expects(_fileProcess != nullptr);
-	Expects(_fileProcess->requestId == 0);
+	Expects(process->referenceRequestId == 0);
 
 	const auto stories = Data::ParseStoriesSlice(
 		result.data().vstories(),
 		0);
 	for (const auto &story : stories.list) {
-		if (story.id == _fileProcess->origin.storyId) {
+		if (story.id == process->origin.storyId) {
 			const auto refresh1 = Data::RefreshFileReference(
-				_fileProcess->location,
+				process->location,
 				story.file().location);
 			const auto refresh2 = Data::RefreshFileReference(
-				_fileProcess->location,
+				process->location,
 				story.thumb().file.location);
 			if (refresh1 || refresh2) {
-				_fileProcess->requestId = fileRequest(
-					_fileProcess->location,
-					offset
-				).done([=](const MTPupload_File &result) {
-					_fileProcess->requestId = 0;
-					filePartDone(offset, result);
-				}).send();
+				filePartResendWaiting(process);
 				return;
 			}
 		}
 	}
-	filePartUnavailable();
+	filePartUnavailable(process);
 }
 
-void ApiWrap::filePartUnavailable() {
-	Expects(_fileProcess != nullptr);
-	Expects(!_fileProcess->requests.empty());
+void ApiWrap::filePartResendWaiting(not_null<FileProcess*> process) {
+	for (auto &request : process->requests) {
+		if (request.waitingReference) {
+			request.waitingReference = false;
+			request.id = requestFilePart(process, request.offset);
+		}
+	}
+	loadFilePart(process);
+}
+
+void ApiWrap::filePartUnavailable(not_null<FileProcess*> process) {
+	Expects(!process->requests.empty());
 
 	LOG(("Export Error: File unavailable."));
 
-	base::take(_fileProcess)->done(QString());
+	cancelFileRequests(process);
+	finishFileProcess(process, QString());
 }
 
 void ApiWrap::error(const MTP::Error &error) {
@@ -2403,6 +2622,9 @@ void ApiWrap::ioError(const Output::Result &result) {
 	_ioErrors.fire_copy(result);
 }
 
-ApiWrap::~ApiWrap() = default;
+ApiWrap::~ApiWrap() {
+	// Prefetched files are not in the checkpoint, don't leave them partial.
+	cancelPrefetchProcesses();
+}
 
 } // namespace Export
@@ -34,6 +34,7 @@ struct FileOrigin;
 namespace Output {
 struct Result;
 class Stats;
+class Checkpoint;
 } // namespace Output
 
 struct Settings;
@@ -55,6 +56,7 @@ public:
 	void startExport(
 		const Settings &settings,
 		Output::Stats *stats,
+		Output::Checkpoint *checkpoint,
 		FnMut<void(StartInfo)> done);
 
 	void requestDialogsList(
@@ -185,6 +187,8 @@ private:
 	void resolveCustomEmoji();
 	void loadMessagesFiles(Data::MessagesSlice &&slice);
 	void loadNextMessageFile();
+	void prefetchMessageFiles();
+	void cancelPrefetchProcesses();
 	[[nodiscard]] std::optional<QByteArray> getCustomEmoji(QByteArray &data);
 	bool messageCustomEmojiReady(Data::Message &message);
 	bool loadMessageFileProgress(FileProgress value);
@@ -198,6 +202,7 @@ private:
 
 	[[nodiscard]] Data::Message *currentFileMessage() const;
 	[[nodiscard]] Data::FileOrigin currentFileMessageOrigin() const;
+	[[nodiscard]] Data::FileOrigin messageFileOrigin(int index) const;
 
 	bool processFileLoad(
 		Data::File &file,
@@ -208,7 +213,14 @@ private:
 		Data::Story *story = nullptr);
 	std::unique_ptr<FileProcess> prepareFileProcess(
 		const Data::File &file,
-		const Data::FileOrigin &origin) const;
+		const Data::FileOrigin &origin);
+	std::unique_ptr<FileProcess> takePrefetchProcess(
+		const Data::FileLocation &location);
+	[[nodiscard]] FileProcess *findFileProcess(uint64 randomId) const;
+	[[nodiscard]] FileProcess *findFileProcess(
+		const Data::FileLocation &location) const;
+	[[nodiscard]] std::optional<QString> findLoadedFile(
+		const Data::FileLocation &location) const;
 	bool writePreloadedFile(
 		Data::File &file,
 		const Data::FileOrigin &origin);
@@ -217,16 +229,29 @@ private:
 		const Data::FileOrigin &origin,
 		Fn<bool(FileProgress)> progress,
 		FnMut<void(QString)> done);
-	void loadFilePart();
-	void filePartDone(int64 offset, const MTPupload_File &result);
-	void filePartUnavailable();
-	void filePartRefreshReference(int64 offset);
-	void filePartExtractReference(
+	void loadFilePart(not_null<FileProcess*> process);
+	mtpRequestId requestFilePart(
+		not_null<FileProcess*> process,
+		int64 offset);
+	void cancelFileRequests(not_null<FileProcess*> process);
+	void finishFileProcess(
+		not_null<FileProcess*> process,
+		const QString &relativePath);
+	void filePartDone(
+		not_null<FileProcess*> process,
 		int64 offset,
+		const MTPupload_File &result);
+	void filePartUnavailable(not_null<FileProcess*> process);
+	void filePartRefreshReference(
+		not_null<FileProcess*> process,
+		int64 offset);
+	void filePartExtractReference(
+		not_null<FileProcess*> process,
 		const MTPmessages_Messages &result);
 	void filePartExtractReference(
-		int64 offset,
+		not_null<FileProcess*> process,
 		const MTPstories_Stories &result);
+	void filePartResendWaiting(not_null<FileProcess*> process);
 
 	template <typename Request>
 	class RequestBuilder;
@@ -238,6 +263,7 @@ private:
 	[[nodiscard]] auto splitRequest(int index, Request &&request);
 
 	[[nodiscard]] auto fileRequest(
+		uint64 randomId,
 		const Data::FileLocation &location,
 		int64 offset);
 
@@ -249,6 +275,7 @@ private:
 	std::optional<uint64> _takeoutId;
 	std::optional<UserId> _selfId;
 	Output::Stats *_stats = nullptr;
+	Output::Checkpoint *_checkpoint = nullptr;
 
 	std::unique_ptr<Settings> _settings;
 	MTPInputUser _user = MTP_inputUserSelf();
@@ -260,6 +287,8 @@ private:
 	std::unique_ptr<StoriesProcess> _storiesProcess;
 	std::unique_ptr<OtherDataProcess> _otherDataProcess;
 	std::unique_ptr<FileProcess> _fileProcess;
+	std::vector<std::unique_ptr<FileProcess>> _prefetchProcesses;
+	base::flat_set<QString> _reservedPaths;
 	std::unique_ptr<LeftChannelsProcess> _leftChannelsProcess;
 	std::unique_ptr<DialogsProcess> _dialogsProcess;
 	std::unique_ptr<ChatProcess> _chatProcess;
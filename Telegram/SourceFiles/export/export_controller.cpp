@@ -11,6 +11,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "export/export_settings.h"
 #include "export/data/export_data_types.h"
 #include "export/output/export_output_abstract.h"
+#include "export/output/export_output_checkpoint.h"
 #include "export/output/export_output_result.h"
 #include "export/output/export_output_stats.h"
 #include "mtproto/mtp_instance.h"
@@ -19,6 +20,7 @@ namespace Export {
 namespace {
 
 const auto kNullStateCallback = [](ProcessingState&) {};
+constexpr auto kSpeedSampleDelay = crl::time(1000);
 
 Settings NormalizeSettings(const Settings &settings) {
 	if (!settings.onlySinglePeer()) {
@@ -80,6 +82,8 @@ private:
 	void exportSessions();
 	void exportOtherData();
 	void exportDialogs();
+	void applyCheckpointDialogs();
+	bool saveCheckpoint();
 	void exportNextDialog();
 
 	template <typename Callback = const decltype(kNullStateCallback) &>
@@ -102,6 +106,7 @@ private:
 		const DownloadProgress &progress) const;
 
 	int substepsInStep(Step step) const;
+	[[nodiscard]] int64 countBytesPerSecond() const;
 
 	ApiWrap _api;
 	Settings _settings;
@@ -130,7 +135,14 @@ private:
 	mutable int _substepsPassed = 0;
 	mutable Step _lastProcessingStep = Step::Initializing;
 
+	mutable crl::time _speedSampleTime = 0;
+	mutable int64 _speedSampleBytes = 0;
+	mutable int64 _bytesPerSecond = 0;
+
 	std::unique_ptr<Output::AbstractWriter> _writer;
+	std::unique_ptr<Output::Checkpoint> _checkpoint;
+	std::vector<Output::Checkpoint::Dialog> _dialogsDone;
+	bool _resumeWriter = false;
 	std::vector<Step> _steps;
 	int _stepIndex = -1;
 
@@ -255,6 +267,17 @@ void ControllerObject::startExport(
 
 	_settings.path = Output::NormalizePath(_settings);
 	_writer = Output::CreateWriter(_settings.format);
+	_checkpoint = std::make_unique<Output::Checkpoint>(
+		_settings.path,
+		_settings);
+	if (ioCatchError(_checkpoint->start())) {
+		return;
+	}
+	_resumeWriter = !_checkpoint->writerState().isEmpty()
+		&& (_settings.types & Settings::Type::AnyChatsMask);
+	if (_resumeWriter) {
+		_dialogsDone = _checkpoint->dialogs();
+	}
 	fillExportSteps();
 	exportNext();
 }
@@ -272,6 +295,11 @@ void ControllerObject::fillExportSteps() {
 	if (_settings.types & Type::AnyChatsMask) {
 		_steps.push_back(Step::DialogsList);
 	}
+	if (_resumeWriter) {
+		// Everything before the dialogs was written by the previous run.
+		_steps.push_back(Step::Dialogs);
+		return;
+	}
 	if (_settings.types & Type::PersonalInfo) {
 		_steps.push_back(Step::PersonalInfo);
 	}
@@ -329,6 +357,11 @@ void ControllerObject::fillSubstepsInSteps(const ApiWrap::StartInfo &info) {
 	if (_settings.types & Settings::Type::AnyChatsMask) {
 		push(Step::Dialogs, info.dialogsCount);
 	}
+	for (auto i = 0; i != int(result.size()); ++i) {
+		if (ranges::find(_steps, Step(i)) == end(_steps)) {
+			result[i] = 0;
+		}
+	}
 	_substepsInStep = std::move(result);
 	_substepsTotal = ranges::accumulate(_substepsInStep, 0);
 }
@@ -343,6 +376,7 @@ void ControllerObject::exportNext() {
 		if (ioCatchError(_writer->finish())) {
 			return;
 		}
+		_checkpoint->finish();
 		_api.finishExport([=] {
 			setFinishedState();
 		});
@@ -366,13 +400,22 @@ void ControllerObject::exportNext() {
 
 void ControllerObject::initialize() {
 	setState(stateInitializing());
-	_api.startExport(_settings, &_stats, [=](ApiWrap::StartInfo info) {
+	const auto checkpoint = _checkpoint.get();
+	_api.startExport(_settings, &_stats, checkpoint, [=](
+			ApiWrap::StartInfo info) {
 		initialized(info);
 	});
 }
 
 void ControllerObject::initialized(const ApiWrap::StartInfo &info) {
-	if (ioCatchError(_writer->start(_settings, _environment, &_stats))) {
+	const auto result = _resumeWriter
+		? _writer->resume(
+			_settings,
+			_environment,
+			&_stats,
+			_checkpoint->writerState())
+		: _writer->start(_settings, _environment, &_stats);
+	if (ioCatchError(result)) {
 		return;
 	}
 	fillSubstepsInSteps(info);
@@ -388,6 +431,9 @@ void ControllerObject::collectDialogsList() {
 		return true;
 	}, [=](Data::DialogsInfo &&result) {
 		_dialogsInfo = std::move(result);
+		if (_resumeWriter) {
+			applyCheckpointDialogs();
+		}
 		exportNext();
 	});
 }
@@ -486,16 +532,80 @@ void ControllerObject::exportOtherData() {
 }
 
 void ControllerObject::exportDialogs() {
-	if (ioCatchError(_writer->writeDialogsStart(_dialogsInfo))) {
-		return;
+	if (!_resumeWriter) {
+		if (ioCatchError(_writer->writeDialogsStart(_dialogsInfo))) {
+			return;
+		} else if (!saveCheckpoint()) {
+			return;
+		}
 	}
 
 	exportNextDialog();
 }
 
+void ControllerObject::applyCheckpointDialogs() {
+	// Dialogs could be reordered since the previous run, so those that
+	// are not finished yet get paths not used by the finished ones.
+	auto taken = base::flat_set<QString>();
+	for (const auto &dialog : _dialogsDone) {
+		taken.emplace(dialog.relativePath);
+	}
+	auto number = int(_dialogsInfo.chats.size() + _dialogsInfo.left.size());
+	auto leftStarted = false;
+	const auto apply = [&](Data::DialogInfo &info) {
+		const auto i = ranges::find(
+			_dialogsDone,
+			info.peerId,
+			&Output::Checkpoint::Dialog::peerId);
+		if (i != end(_dialogsDone)) {
+			info.relativePath = i->relativePath;
+			leftStarted = leftStarted || info.isLeftChannel;
+			return;
+		}
+		while (!info.relativePath.isEmpty()
+			&& taken.contains(info.relativePath)) {
+			info.relativePath = "chats/chat_"
+				+ QString::number(++number)
+				+ '/';
+		}
+		taken.emplace(info.relativePath);
+	};
+	ranges::for_each(_dialogsInfo.left, apply);
+	ranges::for_each(_dialogsInfo.chats, apply);
+
+	// The writers can't reopen the chats list after the left one, so new
+	// chats are appended to the left channels list in that case.
+	if (leftStarted) {
+		for (auto &info : _dialogsInfo.chats) {
+			if (!ranges::contains(
+					_dialogsDone,
+					info.peerId,
+					&Output::Checkpoint::Dialog::peerId)) {
+				info.isLeftChannel = true;
+			}
+		}
+	}
+}
+
+bool ControllerObject::saveCheckpoint() {
+	const auto state = _writer->checkpoint();
+	if (state.isEmpty()) {
+		_dialogsDone.clear();
+	}
+	return !ioCatchError(_checkpoint->save(state, _dialogsDone));
+}
+
 void ControllerObject::exportNextDialog() {
-	const auto index = ++_dialogIndex;
-	const auto info = _dialogsInfo.item(index);
+	const auto done = [&](const Data::DialogInfo *info) {
+		return info && ranges::contains(
+			_dialogsDone,
+			info->peerId,
+			&Output::Checkpoint::Dialog::peerId);
+	};
+	auto info = _dialogsInfo.item(++_dialogIndex);
+	while (done(info)) {
+		info = _dialogsInfo.item(++_dialogIndex);
+	}
 	if (info) {
 		_api.requestMessages(*info, [=](const Data::DialogInfo &info) {
 			if (ioCatchError(_writer->writeDialogStart(info))) {
@@ -517,10 +627,14 @@ void ControllerObject::exportNextDialog() {
 			_messagesWritten += result.list.size();
 			setState(stateDialogs(DownloadProgress()));
 			return true;
-		}, [=] {
+		}, [=, peerId = info->peerId, path = info->relativePath] {
 			if (ioCatchError(_writer->writeDialogEnd())) {
 				return;
 			}
+			_dialogsDone.push_back({ peerId, path });
+			if (!saveCheckpoint()) {
+				return;
+			}
 			exportNextDialog();
 		});
 		return;
@@ -546,9 +660,25 @@ ProcessingState ControllerObject::prepareState(
 	result.substepsPassed = _substepsPassed;
 	result.substepsNow = substepsInStep(_lastProcessingStep);
 	result.substepsTotal = _substepsTotal;
+	result.bytesPerSecond = countBytesPerSecond();
 	return result;
 }
 
+int64 ControllerObject::countBytesPerSecond() const {
+	const auto now = crl::now();
+	const auto bytes = _stats.bytesCount();
+	if (!_speedSampleTime) {
+		_speedSampleTime = now;
+		_speedSampleBytes = bytes;
+	} else if (now - _speedSampleTime >= kSpeedSampleDelay) {
+		const auto delta = std::max(bytes - _speedSampleBytes, int64(0));
+		_bytesPerSecond = delta * 1000 / (now - _speedSampleTime);
+		_speedSampleTime = now;
+		_speedSampleBytes = bytes;
+	}
+	return _bytesPerSecond;
+}
+
 ProcessingState ControllerObject::stateInitializing() const {
 	return ProcessingState();
 }
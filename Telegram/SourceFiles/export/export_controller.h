@@ -70,6 +70,7 @@ struct ProcessingState {
 	QString bytesName;
 	int64 bytesLoaded = 0;
 	int64 bytesCount = 0;
+	int64 bytesPerSecond = 0;
 };
 
 struct ApiErrorState {
@@ -13,6 +13,7 @@ namespace Export {
 namespace {
 
 constexpr auto kMaxFileSize = 4000 * int64(1024 * 1024);
+constexpr auto kMaxParallelDownloads = 16;
 
 } // namespace
 
@@ -21,6 +22,9 @@ bool MediaSettings::validate() const {
 		return false;
 	} else if (sizeLimit < 0 || sizeLimit > kMaxFileSize) {
 		return false;
+	} else if (parallelDownloads < 1
+		|| parallelDownloads > kMaxParallelDownloads) {
+		return false;
 	}
 	return true;
 }
@@ -37,7 +41,10 @@ bool Settings::validate() const {
 		return false;
 	} else if ((fullChats & MustNotBeFull) != 0) {
 		return false;
-	} else if (format != Format::Html && format != Format::Json) {
+	} else if (format != Format::Html
+		&& format != Format::Json
+		&& format != Format::HtmlAndJson
+		&& format != Format::JsonLines) {
 		return false;
 	} else if (!media.validate()) {
 		return false;
@@ -36,6 +36,9 @@ struct MediaSettings {
 	Types types = DefaultTypes();
 	int64 sizeLimit = 8 * 1024 * 1024;
 
+	// How many files may be downloaded at the same time.
+	int parallelDownloads = 4;
+
 	static inline Types DefaultTypes() {
 		return Type::Photo;
 	}
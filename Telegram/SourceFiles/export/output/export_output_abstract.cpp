@@ -7,9 +7,11 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #include "export/output/export_output_abstract.h"
 
+#include "export/output/export_output_checkpoint.h"
 #include "export/output/export_output_html_and_json.h"
 #include "export/output/export_output_html.h"
 #include "export/output/export_output_json.h"
+#include "export/output/export_output_json_lines.h"
 #include "export/output/export_output_stats.h"
 #include "export/output/export_output_result.h"
 
@@ -18,6 +20,30 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 namespace Export {
 namespace Output {
+namespace {
+
+// Finds an export with the same settings that was interrupted.
+std::optional<QString> FindResumablePath(
+		const QString &path,
+		const QString &prefix,
+		const Settings &settings) {
+	if (Checkpoint::Resumable(path, settings)) {
+		return path;
+	}
+	const auto list = QDir(path).entryInfoList(
+		{ prefix + '*' },
+		QDir::Dirs | QDir::NoDotAndDotDot,
+		QDir::Time);
+	for (const auto &info : list) {
+		const auto folder = info.absoluteFilePath() + '/';
+		if (Checkpoint::Resumable(folder, settings)) {
+			return folder;
+		}
+	}
+	return std::nullopt;
+}
+
+} // namespace
 
 QString NormalizePath(const Settings &settings) {
 	QDir folder(settings.path);
@@ -31,11 +57,14 @@ QString NormalizePath(const Settings &settings) {
 	if (list.isEmpty() && !settings.forceSubPath) {
 		return result;
 	}
+	const auto prefix = QString(settings.onlySinglePeer()
+		? "ChatExport_"
+		: "DataExport_");
+	if (const auto resumable = FindResumablePath(result, prefix, settings)) {
+		return *resumable;
+	}
 	const auto date = QDate::currentDate();
-	const auto base = QString(settings.onlySinglePeer()
-		? "ChatExport_%1"
-		: "DataExport_%1"
-	).arg(date.toString(Qt::ISODate));
+	const auto base = prefix + date.toString(Qt::ISODate);
 	const auto add = [&](int i) {
 		return base + (i ? " (" + QString::number(i) + ')' : QString());
 	};
@@ -52,6 +81,7 @@ std::unique_ptr<AbstractWriter> CreateWriter(Format format) {
 	case Format::Html: return std::make_unique<HtmlWriter>();
 	case Format::Json: return std::make_unique<JsonWriter>();
 	case Format::HtmlAndJson: return std::make_unique<HtmlAndJsonWriter>();
+	case Format::JsonLines: return std::make_unique<JsonLinesWriter>();
 	}
 	Unexpected("Format in Export::Output::CreateWriter.");
 }
@@ -8,6 +8,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #pragma once
 
 #include <QtCore/QString>
+#include <QtCore/QByteArray>
 
 namespace Export {
 namespace Data {
@@ -38,6 +39,7 @@ enum class Format {
 	Html,
 	Json,
 	HtmlAndJson,
+	JsonLines,
 };
 
 class AbstractWriter {
@@ -86,6 +88,15 @@ public:
 
 	[[nodiscard]] virtual QString mainFilePath() = 0;
 
+	// State between two dialogs, empty if the writer can't continue
+	// from this point. resume() is called instead of start() later.
+	[[nodiscard]] virtual QByteArray checkpoint() const = 0;
+	[[nodiscard]] virtual Result resume(
+		const Settings &settings,
+		const Environment &environment,
+		Stats *stats,
+		const QByteArray &state) = 0;
+
 	virtual ~AbstractWriter() = default;
 
 	Stats produceTestExample(
@@ -0,0 +1,230 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "export/output/export_output_checkpoint.h"
+
+#include "export/output/export_output_file.h"
+#include "export/output/export_output_result.h"
+#include "export/export_settings.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
+
+namespace Export {
+namespace Output {
+namespace {
+
+constexpr auto kCheckpointFolder = ".checkpoint/";
+constexpr auto kStateMagic = quint32(0x54444543);
+constexpr auto kStateVersion = qint32(1);
+
+QByteArray ComputeSettingsKey(const Settings &settings) {
+	auto result = QByteArray();
+	auto stream = QDataStream(&result, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_1);
+	stream
+		<< quint32(settings.types)
+		<< quint32(settings.fullChats)
+		<< quint32(settings.media.types)
+		<< qint64(settings.media.sizeLimit)
+		<< quint32(settings.format)
+		<< quint32(settings.singlePeer.type());
+	settings.singlePeer.match([&](const MTPDinputPeerUser &data) {
+		stream << quint64(data.vuser_id().v);
+	}, [&](const MTPDinputPeerChat &data) {
+		stream << quint64(data.vchat_id().v);
+	}, [&](const MTPDinputPeerChannel &data) {
+		stream << quint64(data.vchannel_id().v);
+	}, [](const auto &data) {
+	});
+	stream
+		<< qint32(settings.singlePeerFrom)
+		<< qint32(settings.singlePeerTill);
+	return result;
+}
+
+} // namespace
+
+Checkpoint::Checkpoint(const QString &folder, const Settings &settings)
+: _folder(folder)
+, _settingsKey(ComputeSettingsKey(settings)) {
+	Expects(folder.endsWith('/'));
+}
+
+Checkpoint::~Checkpoint() = default;
+
+bool Checkpoint::Resumable(const QString &folder, const Settings &settings) {
+	return Checkpoint(folder, settings).readState();
+}
+
+Result Checkpoint::start() {
+	const auto resumed = readState();
+	if (!resumed) {
+		_writerState = QByteArray();
+		_dialogs.clear();
+		_files.clear();
+	}
+	const auto offset = resumed ? readFiles() : int64(0);
+	_filesLog = std::make_unique<File>(filesPath(), nullptr, offset);
+	return resumed ? Result::Success() : writeState();
+}
+
+const QByteArray &Checkpoint::writerState() const {
+	return _writerState;
+}
+
+auto Checkpoint::dialogs() const -> const std::vector<Dialog> & {
+	return _dialogs;
+}
+
+Result Checkpoint::save(
+		const QByteArray &writerState,
+		std::vector<Dialog> dialogs) {
+	_writerState = writerState;
+	_dialogs = std::move(dialogs);
+	return writeState();
+}
+
+Result Checkpoint::fileLoaded(
+		FileKey key,
+		const QString &relativePath,
+		int64 size) {
+	Expects(_filesLog != nullptr);
+
+	_files[key] = LoadedFile{ relativePath, size };
+
+	auto block = QByteArray();
+	auto stream = QDataStream(&block, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_1);
+	stream
+		<< quint64(key.type)
+		<< quint64(key.id)
+		<< qint64(size)
+		<< relativePath;
+	return _filesLog->writeBlock(block);
+}
+
+std::optional<QString> Checkpoint::findFile(FileKey key) const {
+	const auto i = _files.find(key);
+	if (i == end(_files)) {
+		return std::nullopt;
+	}
+	// The file could be removed or changed while we were not running.
+	const auto info = QFileInfo(_folder + i->second.relativePath);
+	if (!info.isFile() || info.size() != i->second.size) {
+		return std::nullopt;
+	}
+	return i->second.relativePath;
+}
+
+void Checkpoint::finish() {
+	_filesLog = nullptr;
+	_files.clear();
+	QDir(_folder + kCheckpointFolder).removeRecursively();
+}
+
+QString Checkpoint::statePath() const {
+	return _folder + kCheckpointFolder + "state";
+}
+
+QString Checkpoint::filesPath() const {
+	return _folder + kCheckpointFolder + "files";
+}
+
+bool Checkpoint::readState() {
+	auto file = QFile(statePath());
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+	auto stream = QDataStream(&file);
+	stream.setVersion(QDataStream::Qt_5_1);
+
+	auto magic = quint32();
+	auto version = qint32();
+	auto settingsKey = QByteArray();
+	auto writerState = QByteArray();
+	auto count = quint32();
+	stream >> magic >> version >> settingsKey >> writerState >> count;
+	if (stream.status() != QDataStream::Ok
+		|| magic != kStateMagic
+		|| version != kStateVersion
+		|| settingsKey != _settingsKey) {
+		return false;
+	}
+	auto dialogs = std::vector<Dialog>();
+	for (auto i = quint32(); i != count; ++i) {
+		auto peerId = quint64();
+		auto relativePath = QString();
+		stream >> peerId >> relativePath;
+		if (stream.status() != QDataStream::Ok) {
+			return false;
+		}
+		dialogs.push_back({ PeerId(peerId), relativePath });
+	}
+	_writerState = std::move(writerState);
+	_dialogs = std::move(dialogs);
+	return true;
+}
+
+int64 Checkpoint::readFiles() {
+	auto file = QFile(filesPath());
+	if (!file.open(QIODevice::ReadOnly)) {
+		return 0;
+	}
+	auto stream = QDataStream(&file);
+	stream.setVersion(QDataStream::Qt_5_1);
+
+	// The last record could be written only partially.
+	auto valid = int64(0);
+	while (!stream.atEnd()) {
+		auto type = quint64();
+		auto id = quint64();
+		auto size = qint64();
+		auto relativePath = QString();
+		stream >> type >> id >> size >> relativePath;
+		if (stream.status() != QDataStream::Ok) {
+			break;
+		}
+		_files[FileKey{ type, id }] = LoadedFile{ relativePath, size };
+		valid = file.pos();
+	}
+	return valid;
+}
+
+Result Checkpoint::writeState() const {
+	auto block = QByteArray();
+	auto stream = QDataStream(&block, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_1);
+	stream
+		<< kStateMagic
+		<< kStateVersion
+		<< _settingsKey
+		<< _writerState
+		<< quint32(_dialogs.size());
+	for (const auto &dialog : _dialogs) {
+		stream << quint64(dialog.peerId.value) << dialog.relativePath;
+	}
+
+	const auto path = statePath();
+	const auto error = Result(Result::Type::Error, path);
+	if (!QDir().mkpath(QFileInfo(path).absolutePath())) {
+		return error;
+	}
+	auto file = QSaveFile(path);
+	if (!file.open(QIODevice::WriteOnly)
+		|| file.write(block) != block.size()
+		|| !file.commit()) {
+		return error;
+	}
+	return Result::Success();
+}
+
+} // namespace Output
+} // namespace Export
@@ -0,0 +1,96 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "data/data_peer_id.h"
+
+#include <QtCore/QString>
+#include <QtCore/QByteArray>
+
+namespace Export {
+
+struct Settings;
+
+namespace Output {
+
+struct Result;
+class File;
+
+// Journal of an unfinished export, kept inside of the export folder.
+//
+// The state part is rewritten after each finished dialog and holds the
+// writer state together with the list of dialogs that are done.
+// The files part is only appended to and lists downloaded files,
+// so that they're not downloaded once again after a restart.
+class Checkpoint {
+public:
+	struct FileKey {
+		uint64 type = 0;
+		uint64 id = 0;
+
+		friend inline auto operator<=>(FileKey, FileKey) = default;
+		friend inline bool operator==(FileKey, FileKey) = default;
+	};
+	struct Dialog {
+		PeerId peerId = 0;
+		QString relativePath;
+	};
+
+	Checkpoint(const QString &folder, const Settings &settings);
+	~Checkpoint();
+
+	[[nodiscard]] static bool Resumable(
+		const QString &folder,
+		const Settings &settings);
+
+	// Reads a journal left by an interrupted export, if there is one,
+	// otherwise starts a new journal.
+	[[nodiscard]] Result start();
+
+	[[nodiscard]] const QByteArray &writerState() const;
+	[[nodiscard]] const std::vector<Dialog> &dialogs() const;
+
+	// An empty writerState means the writer can't be resumed from here.
+	[[nodiscard]] Result save(
+		const QByteArray &writerState,
+		std::vector<Dialog> dialogs);
+
+	[[nodiscard]] Result fileLoaded(
+		FileKey key,
+		const QString &relativePath,
+		int64 size);
+	[[nodiscard]] std::optional<QString> findFile(FileKey key) const;
+
+	// Removes the journal when the export is finished.
+	void finish();
+
+private:
+	struct LoadedFile {
+		QString relativePath;
+		int64 size = 0;
+	};
+
+	[[nodiscard]] QString statePath() const;
+	[[nodiscard]] QString filesPath() const;
+	[[nodiscard]] bool readState();
+	[[nodiscard]] int64 readFiles();
+	[[nodiscard]] Result writeState() const;
+
+	QString _folder;
+	QByteArray _settingsKey;
+
+	QByteArray _writerState;
+	std::vector<Dialog> _dialogs;
+
+	std::map<FileKey, LoadedFile> _files;
+	std::unique_ptr<File> _filesLog;
+
+};
+
+} // namespace Output
+} // namespace Export
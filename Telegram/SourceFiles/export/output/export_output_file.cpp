@@ -22,6 +22,13 @@ namespace Output {
 File::File(const QString &path, Stats *stats) : _path(path), _stats(stats) {
 }
 
+File::File(const QString &path, Stats *stats, int64 offset)
+: _path(path)
+, _offset(offset)
+, _stats(stats) {
+	Expects(offset >= 0);
+}
+
 int64 File::size() const {
 	return _offset;
 }
@@ -38,6 +45,20 @@ Result File::writeBlock(const QByteArray &block) {
 	return result;
 }
 
+void File::remove() {
+	_file.reset();
+	if (!_inStats) {
+		return;
+	}
+	QFile::remove(_path);
+	if (_stats) {
+		_stats->decrementFiles();
+		_stats->decrementBytes(_offset);
+	}
+	_inStats = false;
+	_offset = 0;
+}
+
 Result File::writeBlockAttempt(const QByteArray &block) {
 	if (_stats && !_inStats) {
 		_inStats = true;
@@ -96,8 +117,13 @@ Result File::fatalError() const {
 
 QString File::PrepareRelativePath(
 		const QString &folder,
-		const QString &suggested) {
-	if (!QFile::exists(folder + suggested)) {
+		const QString &suggested,
+		Fn<bool(const QString &relativePath)> reserved) {
+	const auto taken = [&](const QString &relativePath) {
+		return QFile::exists(folder + relativePath)
+			|| (reserved && reserved(relativePath));
+	};
+	if (!taken(suggested)) {
 		return suggested;
 	}
 
@@ -115,7 +141,7 @@ QString File::PrepareRelativePath(
 	auto attempt = 0;
 	while (true) {
 		const auto relativePath = relativePart(++attempt);
-		if (!QFile::exists(folder + relativePath)) {
+		if (!taken(relativePath)) {
 			return relativePath;
 		}
 	}
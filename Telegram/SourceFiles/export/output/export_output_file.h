@@ -23,14 +23,21 @@ class File {
 public:
 	File(const QString &path, Stats *stats);
 
+	// Continues a file written earlier, everything after offset is lost.
+	File(const QString &path, Stats *stats, int64 offset);
+
 	[[nodiscard]] int64 size() const;
 	[[nodiscard]] bool empty() const;
 
 	[[nodiscard]] Result writeBlock(const QByteArray &block);
 
+	// Deletes the file if anything was written to it through this object.
+	void remove();
+
 	[[nodiscard]] static QString PrepareRelativePath(
 		const QString &folder,
-		const QString &suggested);
+		const QString &suggested,
+		Fn<bool(const QString &relativePath)> reserved = nullptr);
 
 	[[nodiscard]] static Result Copy(
 		const QString &source,
@@ -15,6 +15,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include <QtCore/QSize>
 #include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QDataStream>
 #include <QtCore/QDateTime>
 
 namespace Export {
@@ -488,6 +490,29 @@ bool HtmlContext::empty() const {
 	return _tags.empty();
 }
 
+void HtmlContext::serialize(QDataStream &stream) const {
+	stream << quint32(_tags.size());
+	for (const auto &tag : _tags) {
+		stream << tag.name << tag.block;
+	}
+}
+
+bool HtmlContext::deserialize(QDataStream &stream) {
+	auto count = quint32();
+	stream >> count;
+	auto tags = std::vector<Tag>();
+	for (auto i = quint32(); i != count; ++i) {
+		auto tag = Tag();
+		stream >> tag.name >> tag.block;
+		if (stream.status() != QDataStream::Ok) {
+			return false;
+		}
+		tags.push_back(std::move(tag));
+	}
+	_tags = std::move(tags);
+	return (stream.status() == QDataStream::Ok);
+}
+
 } // namespace details
 
 struct HtmlWriter::MessageInfo {
@@ -509,9 +534,17 @@ struct HtmlWriter::MessageInfo {
 
 class HtmlWriter::Wrap {
 public:
-	Wrap(const QString &path, const QString &base, Stats *stats);
+	Wrap(
+		const QString &path,
+		const QString &base,
+		Stats *stats,
+		int64 offset = 0);
 
 	[[nodiscard]] bool empty() const;
+	[[nodiscard]] int64 size() const;
+
+	void serializeContext(QDataStream &stream) const;
+	[[nodiscard]] bool deserializeContext(QDataStream &stream);
 
 	[[nodiscard]] QByteArray pushTag(
 		const QByteArray &tag,
@@ -698,8 +731,9 @@ QString WriteUserpicThumb(
 HtmlWriter::Wrap::Wrap(
 	const QString &path,
 	const QString &base,
-	Stats *stats)
-: _file(path, stats) {
+	Stats *stats,
+	int64 offset)
+: _file(path, stats, offset) {
 	Expects(base.endsWith('/'));
 	Expects(path.startsWith(base));
 
@@ -714,6 +748,18 @@ bool HtmlWriter::Wrap::empty() const {
 	return _file.empty();
 }
 
+int64 HtmlWriter::Wrap::size() const {
+	return _file.size();
+}
+
+void HtmlWriter::Wrap::serializeContext(QDataStream &stream) const {
+	_context.serialize(stream);
+}
+
+bool HtmlWriter::Wrap::deserializeContext(QDataStream &stream) {
+	return _context.deserialize(stream);
+}
+
 QByteArray HtmlWriter::Wrap::pushTag(
 		const QByteArray &tag,
 		std::map<QByteArray, QByteArray> &&attributes) {
@@ -3635,6 +3681,130 @@ Result HtmlWriter::copyFile(
 		_stats);
 }
 
+QByteArray HtmlWriter::checkpoint() const {
+	if (_chat || _delayedPersonalInfo) {
+		return QByteArray();
+	}
+	auto result = QByteArray();
+	auto stream = QDataStream(&result, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_1);
+	stream << quint32(_savedSections.size());
+	for (const auto &section : _savedSections) {
+		stream
+			<< qint32(section.priority)
+			<< section.label
+			<< section.type
+			<< qint32(section.count)
+			<< section.path;
+	}
+	stream
+		<< _summaryNeedDivider
+		<< _haveSections
+		<< quint32(_selfColorIndex)
+		<< qint32(_userpicsCount)
+		<< qint32(_storiesCount)
+		<< _dialogsRelativePath
+		<< qint32(_dialogsMode);
+	const auto wrap = [&](const std::unique_ptr<Wrap> &file) {
+		stream << (file != nullptr);
+		if (file) {
+			stream << qint64(file->size());
+			file->serializeContext(stream);
+		}
+	};
+	wrap(_summary);
+	wrap(_chats);
+	return result;
+}
+
+Result HtmlWriter::resume(
+		const Settings &settings,
+		const Environment &environment,
+		Stats *stats,
+		const QByteArray &state) {
+	Expects(settings.path.endsWith('/'));
+	Expects(_summary == nullptr);
+
+	_settings = base::duplicate(settings);
+	_environment = environment;
+	_stats = stats;
+
+	const auto failed = Result(Result::Type::FatalError, mainFilePath());
+	auto stream = QDataStream(state);
+	stream.setVersion(QDataStream::Qt_5_1);
+	auto count = quint32();
+	stream >> count;
+	for (auto i = quint32(); i != count; ++i) {
+		auto priority = qint32();
+		auto section = SavedSection();
+		auto sectionCount = qint32();
+		stream
+			>> priority
+			>> section.label
+			>> section.type
+			>> sectionCount
+			>> section.path;
+		if (stream.status() != QDataStream::Ok) {
+			return failed;
+		}
+		section.priority = priority;
+		section.count = sectionCount;
+		_savedSections.push_back(std::move(section));
+	}
+	auto selfColorIndex = quint32();
+	auto userpicsCount = qint32();
+	auto storiesCount = qint32();
+	auto dialogsMode = qint32();
+	stream
+		>> _summaryNeedDivider
+		>> _haveSections
+		>> selfColorIndex
+		>> userpicsCount
+		>> storiesCount
+		>> _dialogsRelativePath
+		>> dialogsMode;
+	if (stream.status() != QDataStream::Ok
+		|| dialogsMode < int(DialogsMode::None)
+		|| dialogsMode > int(DialogsMode::Left)) {
+		return failed;
+	}
+	_selfColorIndex = uint8(selfColorIndex);
+	_userpicsCount = userpicsCount;
+	_storiesCount = storiesCount;
+	_dialogsMode = DialogsMode(dialogsMode);
+
+	auto broken = false;
+	const auto wrap = [&](const QString &path) -> std::unique_ptr<Wrap> {
+		auto exists = false;
+		stream >> exists;
+		if (!exists) {
+			return nullptr;
+		}
+		auto offset = qint64();
+		stream >> offset;
+		if (stream.status() != QDataStream::Ok
+			|| offset < 0
+			|| QFileInfo(pathWithRelativePath(path)).size() < offset) {
+			broken = true;
+			return nullptr;
+		}
+		auto result = fileWithRelativePath(path, offset);
+		if (!result->deserializeContext(stream)) {
+			broken = true;
+			return nullptr;
+		}
+		return result;
+	};
+	_summary = wrap(mainFileRelativePath());
+	_chats = wrap(_dialogsRelativePath);
+	if (!_summary && !_settings.onlySinglePeer()) {
+		broken = true;
+	}
+	return (!broken && stream.status() == QDataStream::Ok)
+		? Result::Success()
+		: failed;
+}
+
 QString HtmlWriter::mainFilePath() {
 	return pathWithRelativePath(_settings.onlySinglePeer()
 		? messagesFile(0)
@@ -3663,6 +3833,16 @@ std::unique_ptr<HtmlWriter::Wrap> HtmlWriter::fileWithRelativePath(
 		_stats);
 }
 
+std::unique_ptr<HtmlWriter::Wrap> HtmlWriter::fileWithRelativePath(
+		const QString &path,
+		int64 offset) const {
+	return std::make_unique<Wrap>(
+		pathWithRelativePath(path),
+		_settings.path,
+		_stats,
+		offset);
+}
+
 HtmlWriter::~HtmlWriter() = default;
 
 } // namespace Output
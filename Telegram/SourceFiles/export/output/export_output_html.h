@@ -12,6 +12,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "export/export_settings.h"
 #include "export/data/export_data_types.h"
 
+class QDataStream;
+
 namespace Export {
 namespace Output {
 namespace details {
@@ -25,6 +27,9 @@ public:
 	[[nodiscard]] QByteArray indent() const;
 	[[nodiscard]] bool empty() const;
 
+	void serialize(QDataStream &stream) const;
+	[[nodiscard]] bool deserialize(QDataStream &stream);
+
 private:
 	struct Tag {
 		QByteArray name;
@@ -80,6 +85,13 @@ public:
 
 	QString mainFilePath() override;
 
+	QByteArray checkpoint() const override;
+	Result resume(
+		const Settings &settings,
+		const Environment &environment,
+		Stats *stats,
+		const QByteArray &state) override;
+
 	~HtmlWriter();
 
 private:
@@ -102,6 +114,9 @@ private:
 	[[nodiscard]] QString pathWithRelativePath(const QString &path) const;
 	[[nodiscard]] std::unique_ptr<Wrap> fileWithRelativePath(
 		const QString &path) const;
+	[[nodiscard]] std::unique_ptr<Wrap> fileWithRelativePath(
+		const QString &path,
+		int64 offset) const;
 	[[nodiscard]] QString messagesFile(int index) const;
 
 	[[nodiscard]] Result writeSavedContacts(const Data::ContactsList &data);
@@ -11,6 +11,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "export/output/export_output_json.h"
 #include "export/output/export_output_result.h"
 
+#include <QtCore/QDataStream>
+
 namespace Export::Output {
 
 HtmlAndJsonWriter::HtmlAndJsonWriter() {
@@ -131,6 +133,34 @@ QString HtmlAndJsonWriter::mainFilePath() {
 	return _writers.front()->mainFilePath();
 }
 
+QByteArray HtmlAndJsonWriter::checkpoint() const {
+	auto result = QByteArray();
+	auto stream = QDataStream(&result, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_1);
+	for (const auto &writer : _writers) {
+		const auto state = writer->checkpoint();
+		if (state.isEmpty()) {
+			return QByteArray();
+		}
+		stream << state;
+	}
+	return result;
+}
+
+Result HtmlAndJsonWriter::resume(
+		const Settings &settings,
+		const Environment &environment,
+		Stats *stats,
+		const QByteArray &state) {
+	auto stream = QDataStream(state);
+	stream.setVersion(QDataStream::Qt_5_1);
+	return invoke([&](WriterPtr w) {
+		auto part = QByteArray();
+		stream >> part;
+		return w->resume(settings, environment, stats, part);
+	});
+}
+
 HtmlAndJsonWriter::~HtmlAndJsonWriter() = default;
 
 Result HtmlAndJsonWriter::invoke(Fn<Result(WriterPtr)> method) const {
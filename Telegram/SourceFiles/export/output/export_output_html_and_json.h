@@ -52,6 +52,13 @@ public:
 
 	QString mainFilePath() override;
 
+	QByteArray checkpoint() const override;
+	Result resume(
+		const Settings &settings,
+		const Environment &environment,
+		Stats *stats,
+		const QByteArray &state) override;
+
 	~HtmlAndJsonWriter();
 
 private:
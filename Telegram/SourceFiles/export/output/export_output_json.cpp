@@ -12,6 +12,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "core/utils.h"
 
 #include <QtCore/QDateTime>
+#include <QtCore/QDataStream>
+#include <QtCore/QFileInfo>
 #include <QtCore/QJsonDocument>
 #include <QtCore/QJsonObject>
 #include <QtCore/QJsonArray>
@@ -94,17 +96,21 @@ QByteArray Indentation(const Context &context) {
 	return Indentation(context.nesting.size());
 }
 
-QByteArray SerializeObject(
+QByteArray LineBreak(const Context &context, int nesting) {
+	return context.compact ? QByteArray() : ('\n' + Indentation(nesting));
+}
+
+void AppendObject(
+		QByteArray &result,
 		Context &context,
 		const std::vector<std::pair<QByteArray, QByteArray>> &values) {
-	const auto indent = Indentation(context);
-
-	context.nesting.push_back(Context::kObject);
-	const auto guard = gsl::finally([&] { context.nesting.pop_back(); });
-	const auto next = '\n' + Indentation(context);
+	const auto indent = LineBreak(context, context.nesting.size());
+	const auto next = LineBreak(context, context.nesting.size() + 1);
+	const auto separator = context.compact
+		? QByteArray(":")
+		: QByteArray(": ");
 
 	auto first = true;
-	auto result = QByteArray();
 	result.append('{');
 	for (const auto &[key, value] : values) {
 		if (value.isEmpty()) {
@@ -115,18 +121,25 @@ QByteArray SerializeObject(
 		} else {
 			result.append(',');
 		}
-		result.append(next).append(SerializeString(key)).append(": ", 2);
+		result.append(next).append(SerializeString(key)).append(separator);
 		result.append(value);
 	}
-	result.append('\n').append(indent).append("}");
+	result.append(indent).append("}");
+}
+
+QByteArray SerializeObject(
+		Context &context,
+		const std::vector<std::pair<QByteArray, QByteArray>> &values) {
+	auto result = QByteArray();
+	AppendObject(result, context, values);
 	return result;
 }
 
 QByteArray SerializeArray(
 		Context &context,
 		const std::vector<QByteArray> &values) {
-	const auto indent = Indentation(context.nesting.size());
-	const auto next = '\n' + Indentation(context.nesting.size() + 1);
+	const auto indent = LineBreak(context, context.nesting.size());
+	const auto next = LineBreak(context, context.nesting.size() + 1);
 
 	auto first = true;
 	auto result = QByteArray();
@@ -139,7 +152,7 @@ QByteArray SerializeArray(
 		}
 		result.append(next).append(value);
 	}
-	result.append('\n').append(indent).append("]");
+	result.append(indent).append("]");
 	return result;
 }
 
@@ -232,7 +245,26 @@ QByteArray FormatFilePath(const Data::File &file) {
 	return file.relativePath.toUtf8();
 }
 
-QByteArray SerializeMessage(
+QByteArray DialogTypeString(Data::DialogInfo::Type type) {
+	using Type = Data::DialogInfo::Type;
+	switch (type) {
+	case Type::Unknown: return "";
+	case Type::Self: return "saved_messages";
+	case Type::Replies: return "replies";
+	case Type::VerifyCodes: return "verification_codes";
+	case Type::Personal: return "personal_chat";
+	case Type::Bot: return "bot_chat";
+	case Type::PrivateGroup: return "private_group";
+	case Type::PrivateSupergroup: return "private_supergroup";
+	case Type::PublicSupergroup: return "public_supergroup";
+	case Type::PrivateChannel: return "private_channel";
+	case Type::PublicChannel: return "public_channel";
+	}
+	Unexpected("Dialog type in DialogTypeString.");
+}
+
+void AppendMessage(
+		QByteArray &result,
 		Context &context,
 		const Data::Message &message,
 		const std::map<PeerId, Data::Peer> &peers,
@@ -240,10 +272,11 @@ QByteArray SerializeMessage(
 	using namespace Data;
 
 	if (v::is<UnsupportedMedia>(message.media.content)) {
-		return SerializeObject(context, {
+		AppendObject(result, context, {
 			{ "id", Data::NumberToString(message.id) },
 			{ "type", SerializeString("unsupported") }
 		});
+		return;
 	}
 
 	const auto peer = [&](PeerId peerId) -> const Peer& {
@@ -275,7 +308,7 @@ QByteArray SerializeMessage(
 	context.nesting.push_back(Context::kObject);
 	const auto serialized = [&] {
 		context.nesting.pop_back();
-		return SerializeObject(context, values);
+		AppendObject(result, context, values);
 	};
 
 	const auto pushBare = [&](
@@ -1095,11 +1128,59 @@ QByteArray SerializeMessage(
 		context.nesting.pop_back();
 	}
 
-	return serialized();
+	serialized();
+}
+
+QByteArray SerializeMessage(
+		Context &context,
+		const Data::Message &message,
+		const std::map<PeerId, Data::Peer> &peers,
+		const QString &internalLinksDomain) {
+	auto result = QByteArray();
+	AppendMessage(result, context, message, peers, internalLinksDomain);
+	return result;
 }
 
 } // namespace
 
+namespace details {
+
+void AppendMessageLine(
+		QByteArray &buffer,
+		const Data::Message &message,
+		const std::map<PeerId, Data::Peer> &peers,
+		const QString &internalLinksDomain) {
+	auto context = Context{ .compact = true };
+	AppendMessage(buffer, context, message, peers, internalLinksDomain);
+	buffer.append('\n');
+}
+
+void AppendDialogLine(
+		QByteArray &buffer,
+		const Data::DialogInfo &data,
+		const QString &messagesPath,
+		const QString &columnsPath,
+		int messagesCount) {
+	using Type = Data::DialogInfo::Type;
+	const auto named = (data.type != Type::Self)
+		&& (data.type != Type::Replies)
+		&& (data.type != Type::VerifyCodes);
+
+	auto context = Context{ .compact = true };
+	AppendObject(buffer, context, {
+		{ "id", Data::NumberToString(Data::PeerToBareId(data.peerId)) },
+		{ "type", StringAllowNull(DialogTypeString(data.type)) },
+		{ "name", named ? StringAllowNull(data.name) : QByteArray() },
+		{ "left", data.isLeftChannel ? "true" : "false" },
+		{ "messages", SerializeString(messagesPath.toUtf8()) },
+		{ "columns", SerializeString(columnsPath.toUtf8()) },
+		{ "messages_count", Data::NumberToString(messagesCount) },
+	});
+	buffer.append('\n');
+}
+
+} // namespace details
+
 Result JsonWriter::start(
 		const Settings &settings,
 		const Environment &environment,
@@ -1570,23 +1651,6 @@ Result JsonWriter::writeDialogStart(const Data::DialogInfo &data) {
 	}
 
 	using Type = Data::DialogInfo::Type;
-	const auto TypeString = [](Type type) {
-		switch (type) {
-		case Type::Unknown: return "";
-		case Type::Self: return "saved_messages";
-		case Type::Replies: return "replies";
-		case Type::VerifyCodes: return "verification_codes";
-		case Type::Personal: return "personal_chat";
-		case Type::Bot: return "bot_chat";
-		case Type::PrivateGroup: return "private_group";
-		case Type::PrivateSupergroup: return "private_supergroup";
-		case Type::PublicSupergroup: return "public_supergroup";
-		case Type::PrivateChannel: return "private_channel";
-		case Type::PublicChannel: return "public_channel";
-		}
-		Unexpected("Dialog type in TypeString.");
-	};
-
 	auto block = _settings.onlySinglePeer()
 		? QByteArray()
 		: prepareArrayItemStart();
@@ -1598,7 +1662,7 @@ Result JsonWriter::writeDialogStart(const Data::DialogInfo &data) {
 			+ StringAllowNull(data.name));
 	}
 	block.append(prepareObjectItemStart("type")
-		+ StringAllowNull(TypeString(data.type)));
+		+ StringAllowNull(DialogTypeString(data.type)));
 	block.append(prepareObjectItemStart("id")
 		+ Data::NumberToString(Data::PeerToBareId(data.peerId)));
 	block.append(prepareObjectItemStart("messages"));
@@ -1688,6 +1752,68 @@ Result JsonWriter::finish() {
 	return _output->writeBlock(block);
 }
 
+QByteArray JsonWriter::checkpoint() const {
+	if (!_output) {
+		return QByteArray();
+	}
+	auto result = QByteArray();
+	auto stream = QDataStream(&result, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_1);
+	stream
+		<< qint64(_output->size())
+		<< quint32(_context.nesting.size());
+	for (const auto type : _context.nesting) {
+		stream << bool(type);
+	}
+	stream << _currentNestingHadItem << qint32(_dialogsMode);
+	return result;
+}
+
+Result JsonWriter::resume(
+		const Settings &settings,
+		const Environment &environment,
+		Stats *stats,
+		const QByteArray &state) {
+	Expects(_output == nullptr);
+	Expects(settings.path.endsWith('/'));
+
+	_settings = base::duplicate(settings);
+	_environment = environment;
+	_stats = stats;
+
+	const auto path = pathWithRelativePath(mainFileRelativePath());
+	const auto failed = Result(Result::Type::FatalError, path);
+	auto stream = QDataStream(state);
+	stream.setVersion(QDataStream::Qt_5_1);
+	auto offset = qint64();
+	auto count = quint32();
+	stream >> offset >> count;
+	auto nesting = std::vector<Context::Type>();
+	for (auto i = quint32(); i != count; ++i) {
+		auto type = false;
+		stream >> type;
+		if (stream.status() != QDataStream::Ok) {
+			return failed;
+		}
+		nesting.push_back(type);
+	}
+	auto hadItem = false;
+	auto dialogsMode = qint32();
+	stream >> hadItem >> dialogsMode;
+	if (stream.status() != QDataStream::Ok
+		|| offset < 0
+		|| QFileInfo(path).size() < offset
+		|| dialogsMode < int(DialogsMode::None)
+		|| dialogsMode > int(DialogsMode::Left)) {
+		return failed;
+	}
+	_context.nesting = std::move(nesting);
+	_currentNestingHadItem = hadItem;
+	_dialogsMode = DialogsMode(dialogsMode);
+	_output = std::make_unique<File>(path, _stats, offset);
+	return Result::Success();
+}
+
 QString JsonWriter::mainFilePath() {
 	return pathWithRelativePath(mainFileRelativePath());
 }
@@ -23,8 +23,24 @@ struct JsonContext {
 
 	// Always fun to use std::vector<bool>.
 	std::vector<Type> nesting;
+
+	// Write everything in a single line, without indentation.
+	bool compact = false;
 };
 
+// Both append a single line of JSON, ending with a new line, to the buffer.
+void AppendMessageLine(
+	QByteArray &buffer,
+	const Data::Message &message,
+	const std::map<PeerId, Data::Peer> &peers,
+	const QString &internalLinksDomain);
+void AppendDialogLine(
+	QByteArray &buffer,
+	const Data::DialogInfo &data,
+	const QString &messagesPath,
+	const QString &columnsPath,
+	int messagesCount);
+
 } // namespace details
 
 class JsonWriter : public AbstractWriter {
@@ -64,6 +80,13 @@ public:
 
 	QString mainFilePath() override;
 
+	QByteArray checkpoint() const override;
+	Result resume(
+		const Settings &settings,
+		const Environment &environment,
+		Stats *stats,
+		const QByteArray &state) override;
+
 private:
 	using Context = details::JsonContext;
 	enum class DialogsMode {
@@ -0,0 +1,256 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "export/output/export_output_json_lines.h"
+
+#include "export/output/export_output_json.h"
+#include "export/output/export_output_file.h"
+#include "export/output/export_output_result.h"
+#include "export/data/export_data_types.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QtEndian>
+
+namespace Export::Output {
+namespace {
+
+constexpr auto kIndexFileName = "chats.jsonl";
+constexpr auto kMessagesFileName = "messages.jsonl";
+constexpr auto kColumnsFileName = "messages.columns";
+
+template <typename Type>
+void AppendColumnValue(QByteArray &buffer, Type value) {
+	const auto stored = qToLittleEndian(value);
+	buffer.append(reinterpret_cast<const char*>(&stored), sizeof(stored));
+}
+
+} // namespace
+
+JsonLinesWriter::JsonLinesWriter()
+: _json(std::make_unique<JsonWriter>()) {
+}
+
+Format JsonLinesWriter::format() {
+	return Format::JsonLines;
+}
+
+Result JsonLinesWriter::start(
+		const Settings &settings,
+		const Environment &environment,
+		Stats *stats) {
+	Expects(_index == nullptr);
+	Expects(settings.path.endsWith('/'));
+
+	_settings = base::duplicate(settings);
+	_stats = stats;
+	_internalLinksDomain = environment.internalLinksDomain;
+	_index = fileWithRelativePath(kIndexFileName);
+	return _json->start(settings, environment, stats);
+}
+
+Result JsonLinesWriter::writePersonal(const Data::PersonalInfo &data) {
+	return _json->writePersonal(data);
+}
+
+Result JsonLinesWriter::writeUserpicsStart(const Data::UserpicsInfo &data) {
+	return _json->writeUserpicsStart(data);
+}
+
+Result JsonLinesWriter::writeUserpicsSlice(const Data::UserpicsSlice &data) {
+	return _json->writeUserpicsSlice(data);
+}
+
+Result JsonLinesWriter::writeUserpicsEnd() {
+	return _json->writeUserpicsEnd();
+}
+
+Result JsonLinesWriter::writeStoriesStart(const Data::StoriesInfo &data) {
+	return _json->writeStoriesStart(data);
+}
+
+Result JsonLinesWriter::writeStoriesSlice(const Data::StoriesSlice &data) {
+	return _json->writeStoriesSlice(data);
+}
+
+Result JsonLinesWriter::writeStoriesEnd() {
+	return _json->writeStoriesEnd();
+}
+
+Result JsonLinesWriter::writeContactsList(const Data::ContactsList &data) {
+	return _json->writeContactsList(data);
+}
+
+Result JsonLinesWriter::writeSessionsList(const Data::SessionsList &data) {
+	return _json->writeSessionsList(data);
+}
+
+Result JsonLinesWriter::writeOtherData(const Data::File &data) {
+	return _json->writeOtherData(data);
+}
+
+Result JsonLinesWriter::writeDialogsStart(const Data::DialogsInfo &data) {
+	return Result::Success();
+}
+
+Result JsonLinesWriter::writeDialogStart(const Data::DialogInfo &data) {
+	Expects(_index != nullptr);
+	Expects(_dialog == nullptr);
+
+	_dialog = std::make_unique<Data::DialogInfo>(data);
+	_messagesCount = 0;
+
+	// If an interrupted export is resumed these files are started anew.
+	_messages = fileWithRelativePath(data.relativePath + kMessagesFileName);
+	_columns = fileWithRelativePath(data.relativePath + kColumnsFileName);
+	return Result::Success();
+}
+
+Result JsonLinesWriter::writeDialogSlice(const Data::MessagesSlice &data) {
+	Expects(_messages != nullptr);
+	Expects(_columns != nullptr);
+
+	_linesBuffer.resize(0);
+	_lineOffsets.clear();
+	const auto base = _messages->size();
+	for (const auto &message : data.list) {
+		if (Data::SkipMessageByDate(message, _settings)) {
+			continue;
+		}
+		_lineOffsets.push_back(_linesBuffer.size());
+		details::AppendMessageLine(
+			_linesBuffer,
+			message,
+			data.peers,
+			_internalLinksDomain);
+	}
+	if (_lineOffsets.empty()) {
+		return Result::Success();
+	}
+	const auto count = int(_lineOffsets.size());
+	_lineOffsets.push_back(_linesBuffer.size());
+
+	_columnsBuffer.resize(0);
+	AppendColumnValue(_columnsBuffer, qint32(count));
+	const auto forEachMessage = [&](auto &&callback) {
+		for (const auto &message : data.list) {
+			if (!Data::SkipMessageByDate(message, _settings)) {
+				callback(message);
+			}
+		}
+	};
+	forEachMessage([&](const Data::Message &message) {
+		AppendColumnValue(_columnsBuffer, qint32(message.id));
+	});
+	forEachMessage([&](const Data::Message &message) {
+		AppendColumnValue(_columnsBuffer, qint32(message.date));
+	});
+	forEachMessage([&](const Data::Message &message) {
+		AppendColumnValue(_columnsBuffer, quint64(message.fromId.value));
+	});
+	for (auto i = 0; i != count; ++i) {
+		AppendColumnValue(_columnsBuffer, qint64(base + _lineOffsets[i]));
+	}
+	for (auto i = 0; i != count; ++i) {
+		AppendColumnValue(
+			_columnsBuffer,
+			qint32(_lineOffsets[i + 1] - _lineOffsets[i]));
+	}
+
+	if (const auto result = _messages->writeBlock(_linesBuffer); !result) {
+		return result;
+	}
+	_messagesCount += count;
+	return _columns->writeBlock(_columnsBuffer);
+}
+
+Result JsonLinesWriter::writeDialogEnd() {
+	Expects(_index != nullptr);
+	Expects(_dialog != nullptr);
+
+	auto block = QByteArray();
+	details::AppendDialogLine(
+		block,
+		*_dialog,
+		_dialog->relativePath + kMessagesFileName,
+		_dialog->relativePath + kColumnsFileName,
+		_messagesCount);
+	_dialog = nullptr;
+	_messages = nullptr;
+	_columns = nullptr;
+	return _index->writeBlock(block);
+}
+
+Result JsonLinesWriter::writeDialogsEnd() {
+	return Result::Success();
+}
+
+Result JsonLinesWriter::finish() {
+	return _json->finish();
+}
+
+QString JsonLinesWriter::mainFilePath() {
+	return _settings.onlySinglePeer()
+		? pathWithRelativePath(kIndexFileName)
+		: _json->mainFilePath();
+}
+
+QByteArray JsonLinesWriter::checkpoint() const {
+	if (!_index || _dialog) {
+		return QByteArray();
+	}
+	const auto json = _json->checkpoint();
+	if (json.isEmpty()) {
+		return QByteArray();
+	}
+	auto result = QByteArray();
+	auto stream = QDataStream(&result, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_1);
+	stream << json << qint64(_index->size());
+	return result;
+}
+
+Result JsonLinesWriter::resume(
+		const Settings &settings,
+		const Environment &environment,
+		Stats *stats,
+		const QByteArray &state) {
+	Expects(_index == nullptr);
+	Expects(settings.path.endsWith('/'));
+
+	_settings = base::duplicate(settings);
+	_stats = stats;
+	_internalLinksDomain = environment.internalLinksDomain;
+
+	auto stream = QDataStream(state);
+	stream.setVersion(QDataStream::Qt_5_1);
+	auto json = QByteArray();
+	auto offset = qint64();
+	stream >> json >> offset;
+	if (stream.status() != QDataStream::Ok || offset < 0) {
+		return Result(
+			Result::Type::FatalError,
+			pathWithRelativePath(kIndexFileName));
+	}
+	_index = std::make_unique<File>(
+		pathWithRelativePath(kIndexFileName),
+		_stats,
+		offset);
+	return _json->resume(settings, environment, stats, json);
+}
+
+JsonLinesWriter::~JsonLinesWriter() = default;
+
+QString JsonLinesWriter::pathWithRelativePath(const QString &path) const {
+	return _settings.path + path;
+}
+
+std::unique_ptr<File> JsonLinesWriter::fileWithRelativePath(
+		const QString &path) const {
+	return std::make_unique<File>(pathWithRelativePath(path), _stats);
+}
+
+} // namespace Export::Output
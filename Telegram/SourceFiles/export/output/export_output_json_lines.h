@@ -0,0 +1,100 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "export/output/export_output_abstract.h"
+#include "export/export_settings.h"
+
+namespace Export::Output {
+
+class JsonWriter;
+class File;
+struct Result;
+
+// Everything except the chats goes to result.json, like in JsonWriter.
+//
+// Each chat gets its own messages.jsonl with one message object per line
+// and messages.columns with the same messages in a compact binary form,
+// both listed in chats.jsonl, so that large archives can be processed
+// in parallel without reading the whole export into memory.
+//
+// messages.columns is a sequence of blocks, one for each written slice.
+// A block is a little-endian int32 count followed by the columns of
+// int32 ids, int32 dates, uint64 sender peer ids, int64 line offsets
+// in messages.jsonl and int32 line lengths, count values in each.
+class JsonLinesWriter final : public AbstractWriter {
+public:
+	JsonLinesWriter();
+
+	Format format() override;
+
+	Result start(
+		const Settings &settings,
+		const Environment &environment,
+		Stats *stats) override;
+
+	Result writePersonal(const Data::PersonalInfo &data) override;
+
+	Result writeUserpicsStart(const Data::UserpicsInfo &data) override;
+	Result writeUserpicsSlice(const Data::UserpicsSlice &data) override;
+	Result writeUserpicsEnd() override;
+
+	Result writeStoriesStart(const Data::StoriesInfo &data) override;
+	Result writeStoriesSlice(const Data::StoriesSlice &data) override;
+	Result writeStoriesEnd() override;
+
+	Result writeContactsList(const Data::ContactsList &data) override;
+
+	Result writeSessionsList(const Data::SessionsList &data) override;
+
+	Result writeOtherData(const Data::File &data) override;
+
+	Result writeDialogsStart(const Data::DialogsInfo &data) override;
+	Result writeDialogStart(const Data::DialogInfo &data) override;
+	Result writeDialogSlice(const Data::MessagesSlice &data) override;
+	Result writeDialogEnd() override;
+	Result writeDialogsEnd() override;
+
+	Result finish() override;
+
+	QString mainFilePath() override;
+
+	QByteArray checkpoint() const override;
+	Result resume(
+		const Settings &settings,
+		const Environment &environment,
+		Stats *stats,
+		const QByteArray &state) override;
+
+	~JsonLinesWriter();
+
+private:
+	[[nodiscard]] QString pathWithRelativePath(const QString &path) const;
+	[[nodiscard]] std::unique_ptr<File> fileWithRelativePath(
+		const QString &path) const;
+
+	Settings _settings;
+	Stats *_stats = nullptr;
+	QString _internalLinksDomain;
+
+	std::unique_ptr<JsonWriter> _json;
+	std::unique_ptr<File> _index;
+
+	std::unique_ptr<Data::DialogInfo> _dialog;
+	std::unique_ptr<File> _messages;
+	std::unique_ptr<File> _columns;
+	int _messagesCount = 0;
+
+	// Reused between slices to avoid allocating for each one of them.
+	QByteArray _linesBuffer;
+	QByteArray _columnsBuffer;
+	std::vector<int64> _lineOffsets;
+
+};
+
+} // namespace Export::Output
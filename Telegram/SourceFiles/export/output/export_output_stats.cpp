@@ -23,6 +23,14 @@ void Stats::incrementBytes(int count) {
 	_bytes += count;
 }
 
+void Stats::decrementFiles() {
+	--_files;
+}
+
+void Stats::decrementBytes(int64 count) {
+	_bytes -= count;
+}
+
 int Stats::filesCount() const {
 	return _files;
 }
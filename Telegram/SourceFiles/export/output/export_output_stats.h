@@ -19,6 +19,8 @@ public:
 
 	void incrementFiles();
 	void incrementBytes(int count);
+	void decrementFiles();
+	void decrementBytes(int64 count);
 
 	int filesCount() const;
 	int64 bytesCount() const;
@@ -64,9 +64,17 @@ Content ContentFromState(
 			return;
 		}
 		const auto progress = state.bytesLoaded / float64(state.bytesCount);
-		const auto info = Ui::FormatDownloadText(
+		const auto loaded = Ui::FormatDownloadText(
 			state.bytesLoaded,
 			state.bytesCount);
+		const auto info = (state.bytesPerSecond > 0)
+			? (loaded
+				+ ", "
+				+ tr::lng_export_state_speed(
+					tr::now,
+					lt_size,
+					Ui::FormatSizeText(state.bytesPerSecond)))
+			: loaded;
 		push(id, label, info, progress, randomId);
 	};
 	switch (state.step) {
@@ -77,6 +77,9 @@ void ChooseFormatBox(
 	box->setTitle(tr::lng_export_option_choose_format());
 	addFormatOption(tr::lng_export_option_html(tr::now), Format::Html);
 	addFormatOption(tr::lng_export_option_json(tr::now), Format::Json);
+	addFormatOption(
+		tr::lng_export_option_json_lines(tr::now),
+		Format::JsonLines);
 	addFormatOption(
 		tr::lng_export_option_html_and_json(tr::now),
 		Format::HtmlAndJson);
@@ -285,6 +288,7 @@ void SettingsWidget::setupPathAndFormat(
 	addLocationLabel(container);
 	addFormatOption(tr::lng_export_option_html(tr::now), Format::Html);
 	addFormatOption(tr::lng_export_option_json(tr::now), Format::Json);
+	addFormatOption(tr::lng_export_option_json_lines(tr::now), Format::JsonLines);
 	addFormatOption(tr::lng_export_option_html_and_json(tr::now), Format::HtmlAndJson);
 }
 
@@ -361,6 +365,8 @@ void SettingsWidget::addFormatAndLocationLabel(
 			? "HTML"
 			: (format == Format::Json)
 			? "JSON"
+			: (format == Format::JsonLines)
+			? "JSON Lines"
 			: tr::lng_export_option_html_and_json(tr::now);
 		return Ui::Text::Link(text, u"internal:edit_format"_q);
 	});
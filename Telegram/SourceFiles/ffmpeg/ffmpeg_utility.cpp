@@ -21,6 +21,20 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include <private/qdrawhelper_p.h>
 #endif // LIB_FFMPEG_USE_QT_PRIVATE_API
 
+#if defined _M_X64 || defined __x86_64__
+#define LIB_FFMPEG_USE_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LIB_FFMPEG_AVX2_TARGET
+#else // _MSC_VER
+#define LIB_FFMPEG_AVX2_TARGET __attribute__((target("avx2")))
+#endif // _MSC_VER
+#elif defined __aarch64__ || defined _M_ARM64
+#define LIB_FFMPEG_USE_NEON
+#include <arm_neon.h>
+#endif // _M_X64 || __x86_64__ || __aarch64__ || _M_ARM64
+
 extern "C" {
 #include <libavutil/opt.h>
 #include <libavutil/display.h>
@@ -73,7 +87,7 @@ void AlignedImageBufferCleanupHandler(void* data) {
 		&& !(image.bytesPerLine() % kAlignImageBy);
 }
 
-void UnPremultiplyLine(uchar *dst, const uchar *src, int intsCount) {
+void UnPremultiplyLineGeneric(uchar *dst, const uchar *src, int intsCount) {
 	[[maybe_unused]] const auto udst = reinterpret_cast<uint*>(dst);
 	const auto usrc = reinterpret_cast<const uint*>(src);
 
@@ -87,7 +101,7 @@ void UnPremultiplyLine(uchar *dst, const uchar *src, int intsCount) {
 #endif // LIB_FFMPEG_USE_QT_PRIVATE_API
 }
 
-void PremultiplyLine(uchar *dst, const uchar *src, int intsCount) {
+void PremultiplyLineGeneric(uchar *dst, const uchar *src, int intsCount) {
 	const auto udst = reinterpret_cast<uint*>(dst);
 	[[maybe_unused]] const auto usrc = reinterpret_cast<const uint*>(src);
 
@@ -101,6 +115,298 @@ void PremultiplyLine(uchar *dst, const uchar *src, int intsCount) {
 #endif // LIB_FFMPEG_USE_QT_PRIVATE_API
 }
 
+// Same rounding as qPremultiply() and the BYTE_MUL() of QPainter.
+[[nodiscard]] inline uint MultiplyPixel(uint pixel, uint alpha) {
+	auto rb = (pixel & 0x00FF00FFU) * alpha;
+	rb = ((rb + ((rb >> 8) & 0x00FF00FFU) + 0x00800080U) >> 8) & 0x00FF00FFU;
+	auto ag = ((pixel >> 8) & 0x00FF00FFU) * alpha;
+	ag = (ag + ((ag >> 8) & 0x00FF00FFU) + 0x00800080U) & 0xFF00FF00U;
+	return rb | ag;
+}
+
+void MaskLineGeneric(uchar *dst, const uchar *mask, int intsCount) {
+	const auto udst = reinterpret_cast<uint*>(dst);
+	const auto umask = reinterpret_cast<const uint*>(mask);
+	for (auto i = 0; i != intsCount; ++i) {
+		udst[i] = MultiplyPixel(udst[i], umask[i] >> 24);
+	}
+}
+
+#ifdef LIB_FFMPEG_USE_AVX2
+
+constexpr auto kAvx2Pixels = 8;
+
+[[nodiscard]] bool DetectAvx2() {
+#ifdef _MSC_VER
+	int info[4] = { 0 };
+	__cpuid(info, 1);
+	const auto osxsave = (info[2] & (1 << 27)) != 0;
+	const auto avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 0x06) != 0x06) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else // _MSC_VER
+	return __builtin_cpu_supports("avx2");
+#endif // _MSC_VER
+}
+
+[[nodiscard]] bool HasAvx2() {
+	static const auto result = DetectAvx2();
+	return result;
+}
+
+// (c * f + ((c * f) >> 8) + 0x80) >> 8 for each byte, as MultiplyPixel().
+LIB_FFMPEG_AVX2_TARGET inline __m256i MultiplyBytesAvx2(
+		__m256i values,
+		__m256i factors) {
+	const auto zero = _mm256_setzero_si256();
+	const auto half = _mm256_set1_epi16(0x80);
+	auto low = _mm256_mullo_epi16(
+		_mm256_unpacklo_epi8(values, zero),
+		_mm256_unpacklo_epi8(factors, zero));
+	auto high = _mm256_mullo_epi16(
+		_mm256_unpackhi_epi8(values, zero),
+		_mm256_unpackhi_epi8(factors, zero));
+	low = _mm256_srli_epi16(
+		_mm256_add_epi16(_mm256_add_epi16(low, _mm256_srli_epi16(low, 8)), half),
+		8);
+	high = _mm256_srli_epi16(
+		_mm256_add_epi16(_mm256_add_epi16(high, _mm256_srli_epi16(high, 8)), half),
+		8);
+	return _mm256_packus_epi16(low, high);
+}
+
+LIB_FFMPEG_AVX2_TARGET inline __m256i BroadcastAlphaAvx2(__m256i pixels) {
+	const auto shuffle = _mm256_setr_epi8(
+		3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15,
+		3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+	return _mm256_shuffle_epi8(pixels, shuffle);
+}
+
+LIB_FFMPEG_AVX2_TARGET int PremultiplyLineAvx2(
+		uchar *dst,
+		const uchar *src,
+		int intsCount) {
+	const auto alphaMask = _mm256_set1_epi32(0xFF000000);
+	auto i = 0;
+	for (; i + kAvx2Pixels <= intsCount; i += kAvx2Pixels) {
+		const auto pixels = _mm256_loadu_si256(
+			reinterpret_cast<const __m256i*>(src) + (i / kAvx2Pixels));
+		const auto multiplied = MultiplyBytesAvx2(
+			pixels,
+			BroadcastAlphaAvx2(pixels));
+		_mm256_storeu_si256(
+			reinterpret_cast<__m256i*>(dst) + (i / kAvx2Pixels),
+			_mm256_blendv_epi8(multiplied, pixels, alphaMask));
+	}
+	return i;
+}
+
+// There is no cheap exact division, so only the fully opaque and
+// fully transparent runs are vectorized, the rest goes to the generic code.
+LIB_FFMPEG_AVX2_TARGET int UnPremultiplyLineAvx2(
+		uchar *dst,
+		const uchar *src,
+		int intsCount) {
+	const auto alphaMask = _mm256_set1_epi32(0xFF000000);
+	auto i = 0;
+	for (; i + kAvx2Pixels <= intsCount; i += kAvx2Pixels) {
+		const auto from = reinterpret_cast<const __m256i*>(src)
+			+ (i / kAvx2Pixels);
+		const auto to = reinterpret_cast<__m256i*>(dst) + (i / kAvx2Pixels);
+		const auto pixels = _mm256_loadu_si256(from);
+		const auto alpha = _mm256_and_si256(pixels, alphaMask);
+		if (_mm256_testz_si256(pixels, alphaMask)) {
+			_mm256_storeu_si256(to, _mm256_setzero_si256());
+		} else if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, alphaMask))
+			== -1) {
+			_mm256_storeu_si256(to, pixels);
+		} else {
+			UnPremultiplyLineGeneric(
+				reinterpret_cast<uchar*>(to),
+				reinterpret_cast<const uchar*>(from),
+				kAvx2Pixels);
+		}
+	}
+	return i;
+}
+
+LIB_FFMPEG_AVX2_TARGET int MaskLineAvx2(
+		uchar *dst,
+		const uchar *mask,
+		int intsCount) {
+	auto i = 0;
+	for (; i + kAvx2Pixels <= intsCount; i += kAvx2Pixels) {
+		const auto to = reinterpret_cast<__m256i*>(dst) + (i / kAvx2Pixels);
+		const auto factors = BroadcastAlphaAvx2(_mm256_loadu_si256(
+			reinterpret_cast<const __m256i*>(mask) + (i / kAvx2Pixels)));
+		_mm256_storeu_si256(
+			to,
+			MultiplyBytesAvx2(_mm256_loadu_si256(to), factors));
+	}
+	return i;
+}
+
+#elif defined LIB_FFMPEG_USE_NEON
+
+constexpr auto kNeonPixels = 8;
+
+// (c * f + ((c * f) >> 8) + 0x80) >> 8 for each byte, as MultiplyPixel().
+inline uint8x8_t MultiplyBytesNeon(uint8x8_t values, uint8x8_t factors) {
+	const auto product = vmull_u8(values, factors);
+	return vraddhn_u16(product, vshrq_n_u16(product, 8));
+}
+
+int PremultiplyLineNeon(uchar *dst, const uchar *src, int intsCount) {
+	auto i = 0;
+	for (; i + kNeonPixels <= intsCount; i += kNeonPixels) {
+		auto pixels = vld4_u8(src + i * kPixelBytesSize);
+		const auto alpha = pixels.val[3];
+		pixels.val[0] = MultiplyBytesNeon(pixels.val[0], alpha);
+		pixels.val[1] = MultiplyBytesNeon(pixels.val[1], alpha);
+		pixels.val[2] = MultiplyBytesNeon(pixels.val[2], alpha);
+		vst4_u8(dst + i * kPixelBytesSize, pixels);
+	}
+	return i;
+}
+
+// There is no cheap exact division, so only the fully opaque and
+// fully transparent runs are vectorized, the rest goes to the generic code.
+int UnPremultiplyLineNeon(uchar *dst, const uchar *src, int intsCount) {
+	auto i = 0;
+	for (; i + kNeonPixels <= intsCount; i += kNeonPixels) {
+		const auto from = src + i * kPixelBytesSize;
+		const auto to = dst + i * kPixelBytesSize;
+		const auto pixels = vld4_u8(from);
+		const auto alpha = pixels.val[3];
+		if (vmaxv_u8(alpha) == 0) {
+			vst4_u8(to, { { alpha, alpha, alpha, alpha } });
+		} else if (vminv_u8(alpha) == 0xFF) {
+			vst4_u8(to, pixels);
+		} else {
+			UnPremultiplyLineGeneric(to, from, kNeonPixels);
+		}
+	}
+	return i;
+}
+
+int MaskLineNeon(uchar *dst, const uchar *mask, int intsCount) {
+	auto i = 0;
+	for (; i + kNeonPixels <= intsCount; i += kNeonPixels) {
+		const auto to = dst + i * kPixelBytesSize;
+		const auto alpha = vld4_u8(mask + i * kPixelBytesSize).val[3];
+		auto pixels = vld4_u8(to);
+		pixels.val[0] = MultiplyBytesNeon(pixels.val[0], alpha);
+		pixels.val[1] = MultiplyBytesNeon(pixels.val[1], alpha);
+		pixels.val[2] = MultiplyBytesNeon(pixels.val[2], alpha);
+		pixels.val[3] = MultiplyBytesNeon(pixels.val[3], alpha);
+		vst4_u8(to, pixels);
+	}
+	return i;
+}
+
+#endif // LIB_FFMPEG_USE_AVX2 || LIB_FFMPEG_USE_NEON
+
+void UnPremultiplyLine(uchar *dst, const uchar *src, int intsCount) {
+	auto done = 0;
+#ifdef LIB_FFMPEG_USE_AVX2
+	if (HasAvx2()) {
+		done = UnPremultiplyLineAvx2(dst, src, intsCount);
+	}
+#elif defined LIB_FFMPEG_USE_NEON
+	done = UnPremultiplyLineNeon(dst, src, intsCount);
+#endif // LIB_FFMPEG_USE_AVX2 || LIB_FFMPEG_USE_NEON
+	if (done < intsCount) {
+		UnPremultiplyLineGeneric(
+			dst + done * kPixelBytesSize,
+			src + done * kPixelBytesSize,
+			intsCount - done);
+	}
+}
+
+void PremultiplyLine(uchar *dst, const uchar *src, int intsCount) {
+	auto done = 0;
+#ifdef LIB_FFMPEG_USE_AVX2
+	if (HasAvx2()) {
+		done = PremultiplyLineAvx2(dst, src, intsCount);
+	}
+#elif defined LIB_FFMPEG_USE_NEON
+	done = PremultiplyLineNeon(dst, src, intsCount);
+#endif // LIB_FFMPEG_USE_AVX2 || LIB_FFMPEG_USE_NEON
+	if (done < intsCount) {
+		PremultiplyLineGeneric(
+			dst + done * kPixelBytesSize,
+			src + done * kPixelBytesSize,
+			intsCount - done);
+	}
+}
+
+void MaskLine(uchar *dst, const uchar *mask, int intsCount) {
+	auto done = 0;
+#ifdef LIB_FFMPEG_USE_AVX2
+	if (HasAvx2()) {
+		done = MaskLineAvx2(dst, mask, intsCount);
+	}
+#elif defined LIB_FFMPEG_USE_NEON
+	done = MaskLineNeon(dst, mask, intsCount);
+#endif // LIB_FFMPEG_USE_AVX2 || LIB_FFMPEG_USE_NEON
+	if (done < intsCount) {
+		MaskLineGeneric(
+			dst + done * kPixelBytesSize,
+			mask + done * kPixelBytesSize,
+			intsCount - done);
+	}
+}
+
+using LineMethod = void(*)(uchar *dst, const uchar *src, int intsCount);
+
+void UnPremultiplyWith(QImage &dst, const QImage &src, LineMethod method) {
+	// This creates QImage::Format_ARGB32_Premultiplied, but we use it
+	// as an image in QImage::Format_ARGB32 format.
+	if (!GoodStorageForFrame(dst, src.size())) {
+		dst = CreateFrameStorage(src.size());
+	}
+	const auto srcPerLine = src.bytesPerLine();
+	const auto dstPerLine = dst.bytesPerLine();
+	const auto width = src.width();
+	const auto height = src.height();
+	auto srcBytes = src.bits();
+	auto dstBytes = dst.bits();
+	if (srcPerLine != width * 4 || dstPerLine != width * 4) {
+		for (auto i = 0; i != height; ++i) {
+			method(dstBytes, srcBytes, width);
+			srcBytes += srcPerLine;
+			dstBytes += dstPerLine;
+		}
+	} else {
+		method(dstBytes, srcBytes, width * height);
+	}
+}
+
+void PremultiplyRowsWith(
+		QImage &image,
+		int fromRow,
+		int tillRow,
+		LineMethod method) {
+	Expects(fromRow >= 0 && fromRow <= tillRow);
+	Expects(tillRow <= image.height());
+
+	const auto perLine = image.bytesPerLine();
+	const auto width = image.width();
+	const auto height = tillRow - fromRow;
+	auto bytes = image.bits() + fromRow * perLine;
+	if (perLine != width * 4) {
+		for (auto i = 0; i != height; ++i) {
+			method(bytes, bytes, width);
+			bytes += perLine;
+		}
+	} else {
+		method(bytes, bytes, width * height);
+	}
+}
+
 #if !defined Q_OS_WIN && !defined Q_OS_MAC
 [[nodiscard]] auto CheckHwLibs() {
 	auto list = std::deque{
@@ -748,41 +1054,47 @@ QImage CreateFrameStorage(QSize size) {
 }
 
 void UnPremultiply(QImage &dst, const QImage &src) {
-	// This creates QImage::Format_ARGB32_Premultiplied, but we use it
-	// as an image in QImage::Format_ARGB32 format.
-	if (!GoodStorageForFrame(dst, src.size())) {
-		dst = CreateFrameStorage(src.size());
-	}
-	const auto srcPerLine = src.bytesPerLine();
-	const auto dstPerLine = dst.bytesPerLine();
-	const auto width = src.width();
-	const auto height = src.height();
-	auto srcBytes = src.bits();
-	auto dstBytes = dst.bits();
-	if (srcPerLine != width * 4 || dstPerLine != width * 4) {
-		for (auto i = 0; i != height; ++i) {
-			UnPremultiplyLine(dstBytes, srcBytes, width);
-			srcBytes += srcPerLine;
-			dstBytes += dstPerLine;
-		}
-	} else {
-		UnPremultiplyLine(dstBytes, srcBytes, width * height);
-	}
+	UnPremultiplyWith(dst, src, UnPremultiplyLine);
 }
 
 void PremultiplyInplace(QImage &image) {
+	PremultiplyRowsInplace(image, 0, image.height());
+}
+
+void PremultiplyRowsInplace(QImage &image, int fromRow, int tillRow) {
+	PremultiplyRowsWith(image, fromRow, tillRow, PremultiplyLine);
+}
+
+void UnPremultiplyGeneric(QImage &dst, const QImage &src) {
+	UnPremultiplyWith(dst, src, UnPremultiplyLineGeneric);
+}
+
+void PremultiplyInplaceGeneric(QImage &image) {
+	PremultiplyRowsWith(image, 0, image.height(), PremultiplyLineGeneric);
+}
+
+bool ApplyMaskInplace(QImage &image, const QImage &mask) {
+	if (image.size() != mask.size()
+		|| image.format() != QImage::Format_ARGB32_Premultiplied
+		|| mask.format() != QImage::Format_ARGB32_Premultiplied) {
+		return false;
+	}
 	const auto perLine = image.bytesPerLine();
+	const auto maskPerLine = mask.bytesPerLine();
 	const auto width = image.width();
 	const auto height = image.height();
 	auto bytes = image.bits();
-	if (perLine != width * 4) {
+	auto maskBytes = mask.constBits();
+	if (perLine != width * 4 || maskPerLine != width * 4) {
 		for (auto i = 0; i != height; ++i) {
-			PremultiplyLine(bytes, bytes, width);
+			MaskLine(bytes, maskBytes, width);
 			bytes += perLine;
+			maskBytes += maskPerLine;
 		}
 	} else {
-		PremultiplyLine(bytes, bytes, width * height);
+		MaskLine(bytes, maskBytes, width * height);
 	}
+	return true;
 }
 
 } // namespace FFmpeg
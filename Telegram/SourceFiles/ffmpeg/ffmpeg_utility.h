@@ -251,4 +251,15 @@ void LogError(
 void UnPremultiply(QImage &to, const QImage &from);
 void PremultiplyInplace(QImage &image);
 
+// For images filled band by band, while the band is still in the cache.
+void PremultiplyRowsInplace(QImage &image, int fromRow, int tillRow);
+
+// Same as drawing the mask with QPainter::CompositionMode_DestinationIn.
+// Returns false if the mask size or formats don't allow the fast path.
+[[nodiscard]] bool ApplyMaskInplace(QImage &image, const QImage &mask);
+
+// Without the AVX2 / NEON kernels, for comparison in benchmarks.
+void UnPremultiplyGeneric(QImage &to, const QImage &from);
+void PremultiplyInplaceGeneric(QImage &image);
+
 } // namespace FFmpeg
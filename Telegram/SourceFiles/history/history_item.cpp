@@ -198,6 +198,14 @@ struct HistoryItem::CreateConfig {
 	std::vector<Data::UnavailableReason> restrictions;
 };
 
+struct HistoryItem::RareFields {
+	TimeId ttlDestroyAt = 0;
+	int boostsApplied = 0;
+	int starsPaid = 0;
+	BusinessShortcutId shortcutId = 0;
+	EffectId effectId = 0;
+};
+
 void HistoryItem::FillForwardedInfo(
 		CreateConfig &config,
 		const MTPDmessageFwdHeader &data) {
@@ -405,7 +413,9 @@ HistoryItem::HistoryItem(
 	.starsPaid = int(data.vpaid_message_stars().value_or_empty()),
 	.effectId = data.veffect().value_or_empty(),
 }) {
-	_boostsApplied = data.vfrom_boosts_applied().value_or_empty();
+	if (const auto boosts = data.vfrom_boosts_applied().value_or_empty()) {
+		rare().boostsApplied = boosts;
+	}
 
 	// Called only for server-received messages, not locally created ones.
 	applyInitialEffectWatched();
@@ -756,19 +766,24 @@ HistoryItem::HistoryItem(
 	? history->owner().peer(fields.from)
 	: history->peer)
 , _flags(FinalizeMessageFlags(history, fields.flags))
-, _date(fields.date)
-, _starsPaid(fields.starsPaid)
-, _shortcutId(fields.shortcutId)
-, _effectId(fields.effectId) {
-	Expects(!_shortcutId
+, _date(fields.date) {
+	Expects(!fields.shortcutId
 		|| isSending()
 		|| _history->owner().shortcutMessages().lookupId(this));
 
+	if (fields.starsPaid || fields.shortcutId || fields.effectId) {
+		_rare = std::make_unique<RareFields>(RareFields{
+			.starsPaid = fields.starsPaid,
+			.shortcutId = fields.shortcutId,
+			.effectId = fields.effectId,
+		});
+	}
+
 	if (isHistoryEntry() && IsClientMsgId(id)) {
 		_history->registerClientSideMessage(this);
 	}
-	if (_effectId) {
-		_history->owner().reactions().preloadEffectImageFor(_effectId);
+	if (fields.effectId) {
+		_history->owner().reactions().preloadEffectImageFor(fields.effectId);
 	}
 }
 
@@ -804,7 +819,22 @@ TimeId HistoryItem::date() const {
 }
 
 int HistoryItem::starsPaid() const {
-	return _starsPaid;
+	return _rare ? _rare->starsPaid : 0;
+}
+
+TimeId HistoryItem::ttlDestroyAt() const {
+	return _rare ? _rare->ttlDestroyAt : 0;
+}
+
+int HistoryItem::boostsApplied() const {
+	return _rare ? _rare->boostsApplied : 0;
+}
+
+auto HistoryItem::rare() -> RareFields & {
+	if (!_rare) {
+		_rare = std::make_unique<RareFields>();
+	}
+	return *_rare;
 }
 
 bool HistoryItem::awaitingVideoProcessing() const {
@@ -1832,15 +1862,17 @@ bool HistoryItem::isUserpicSuggestion() const {
 }
 
 BusinessShortcutId HistoryItem::shortcutId() const {
-	return _shortcutId;
+	return _rare ? _rare->shortcutId : 0;
 }
 
 bool HistoryItem::isBusinessShortcut() const {
-	return _shortcutId != 0;
+	return shortcutId() != 0;
 }
 
 void HistoryItem::setRealShortcutId(BusinessShortcutId id) {
-	_shortcutId = id;
+	if (id || _rare) {
+		rare().shortcutId = id;
+	}
 }
 
 void HistoryItem::setCustomServiceLink(ClickHandlerPtr link) {
@@ -3404,13 +3436,18 @@ bool HistoryItem::canUpdateDate() const {
 }
 
 void HistoryItem::applyTTL(TimeId destroyAt) {
-	const auto previousDestroyAt = std::exchange(_ttlDestroyAt, destroyAt);
+	if (!destroyAt && !_rare) {
+		return;
+	}
+	const auto previousDestroyAt = std::exchange(
+		rare().ttlDestroyAt,
+		destroyAt);
 	if (previousDestroyAt) {
 		_history->owner().unregisterMessageTTL(previousDestroyAt, this);
 	}
-	if (!_ttlDestroyAt) {
+	if (!destroyAt) {
 		return;
-	} else if (base::unixtime::now() >= _ttlDestroyAt) {
+	} else if (base::unixtime::now() >= destroyAt) {
 		const auto session = &_history->session();
 		crl::on_main(session, [session, id = fullId()]{
 			if (const auto item = session->data().message(id)) {
@@ -3418,7 +3455,7 @@ void HistoryItem::applyTTL(TimeId destroyAt) {
 			}
 		});
 	} else {
-		_history->owner().registerMessageTTL(_ttlDestroyAt, this);
+		_history->owner().registerMessageTTL(destroyAt, this);
 	}
 }
 
@@ -3698,7 +3735,7 @@ MessageGroupId HistoryItem::groupId() const {
 }
 
 EffectId HistoryItem::effectId() const {
-	return _effectId;
+	return _rare ? _rare->effectId : 0;
 }
 
 QString HistoryItem::computeUnavailableReason() const {
@@ -4087,7 +4124,9 @@ void HistoryItem::createComponents(CreateConfig &&config) {
 
 	if (out() && isSending()) {
 		if (const auto channel = _history->peer->asMegagroup()) {
-			_boostsApplied = channel->mgInfo->boostsApplied;
+			if (const auto boosts = channel->mgInfo->boostsApplied) {
+				rare().boostsApplied = boosts;
+			}
 		}
 	}
 }
@@ -565,18 +565,14 @@ public:
 
 	[[nodiscard]] bool needsUpdateForVideoQualities(const MTPMessage &data);
 
-	[[nodiscard]] TimeId ttlDestroyAt() const {
-		return _ttlDestroyAt;
-	}
-
-	[[nodiscard]] int boostsApplied() const {
-		return _boostsApplied;
-	}
+	[[nodiscard]] TimeId ttlDestroyAt() const;
+	[[nodiscard]] int boostsApplied() const;
 
 	MsgId id;
 
 private:
 	struct CreateConfig;
+	struct RareFields;
 
 	HistoryItem(
 		not_null<History*> history,
@@ -688,6 +684,8 @@ private:
 	void flagSensitiveContent();
 	[[nodiscard]] PeerData *computeDisplayFrom() const;
 
+	[[nodiscard]] RareFields &rare();
+
 	const not_null<History*> _history;
 	const not_null<PeerData*> _from;
 	mutable PeerData *_displayFrom = nullptr;
@@ -699,14 +697,12 @@ private:
 	std::unique_ptr<Data::MessageReactions> _reactions;
 	crl::time _reactionsLastRefreshed = 0;
 
+	// Fields that only a small part of messages has, allocated on demand.
+	std::unique_ptr<RareFields> _rare;
+
 	TimeId _date = 0;
-	TimeId _ttlDestroyAt = 0;
-	int _boostsApplied = 0;
-	int _starsPaid = 0;
-	BusinessShortcutId _shortcutId = 0;
 
 	MessageGroupId _groupId = MessageGroupId();
-	EffectId _effectId = 0;
 	HistoryView::Element *_mainView = nullptr;
 
 	friend class HistoryView::Element;
@@ -49,6 +49,11 @@ public:
 		style::color color,
 		crl::time now);
 
+	// Whether paint() shows an action instead of the last message.
+	[[nodiscard]] bool animating() const {
+		return bool(_sendActionAnimation);
+	}
+
 	bool updateNeedsAnimating(
 		crl::time now,
 		bool force = false);
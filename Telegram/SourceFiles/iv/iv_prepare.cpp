@@ -21,6 +21,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 namespace Iv {
 namespace {
 
+constexpr auto kInitialReserve = 64 * 1024;
+
 struct Attribute {
 	QByteArray name;
 	std::optional<QByteArray> value;
@@ -51,26 +53,70 @@ template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
 	return Number(base::SafeRound(value * 10000.) / 100.);
 };
 
-[[nodiscard]] QByteArray Escape(QByteArray value) {
+void AppendEscaped(QByteArray &to, char ch) {
+	switch (ch) {
+	case '&': to.append("&amp;"); break;
+	case '<': to.append("&lt;"); break;
+	case '>': to.append("&gt;"); break;
+	case '"': to.append("&quot;"); break;
+	case '\'': to.append("&apos;"); break;
+	default: to.append(ch); break;
+	}
+}
+
+void AppendEscaped(QByteArray &to, const QByteArray &value) {
+	for (const auto &ch : value) {
+		AppendEscaped(to, ch);
+	}
+}
+
+[[nodiscard]] QByteArray Escape(const QByteArray &value) {
 	auto result = QByteArray();
 	result.reserve(value.size());
-	for (const auto &ch : value) {
-		switch (ch) {
-		case '&': result.append("&amp;"); break;
-		case '<': result.append("&lt;"); break;
-		case '>': result.append("&gt;"); break;
-		case '"': result.append("&quot;"); break;
-		case '\'': result.append("&apos;"); break;
-		default: result.append(ch); break;
+	AppendEscaped(result, value);
+	return result;
+}
+
+// Appends escaped text with the directional isolates (U+2066 - U+2068)
+// and the isolate terminator (U+2069) replaced by spans.
+void AppendPlain(QByteArray &to, const QByteArray &value) {
+	static const auto replacements = std::array<QByteArray, 4>{
+		"<span dir=\"ltr\">"_q,
+		"<span dir=\"rtl\">"_q,
+		"<span dir=\"auto\">"_q,
+		"</span>"_q,
+	};
+	const auto size = value.size();
+	for (auto i = qsizetype(0); i != size; ++i) {
+		const auto ch = value[i];
+		if (ch == '\xE2'
+			&& i + 2 < size
+			&& value[i + 1] == '\x81'
+			&& uchar(value[i + 2]) >= 0xA6
+			&& uchar(value[i + 2]) <= 0xA9) {
+			to.append(replacements[uchar(value[i + 2]) - 0xA6]);
+			i += 2;
+		} else {
+			AppendEscaped(to, ch);
 		}
 	}
-	return result;
+}
+
+[[nodiscard]] QByteArray MinithumbStyle(const QByteArray &minithumbnail) {
+	const auto bytes = Images::ExpandInlineBytes(minithumbnail);
+	return bytes.isEmpty()
+		? QByteArray()
+		: ("background-image:url('data:image/jpeg;base64,"
+			+ bytes.toBase64()
+			+ "');");
 }
 
 [[nodiscard]] QByteArray Date(TimeId date) {
 	return Escape(langDateTimeFull(base::unixtime::parse(date)).toUtf8());
 }
 
+// Writes the whole page to a single buffer, nested blocks and tags
+// are appended to it in place instead of being concatenated.
 class Parser final {
 public:
 	Parser(const Source &source, const Options &options);
@@ -78,83 +124,97 @@ public:
 	[[nodiscard]] Prepared result();
 
 private:
+	template <typename Body>
+	static constexpr bool IsBody = std::is_invocable_v<Body>;
+
 	void process(const Source &source);
 	void process(const MTPPhoto &photo);
 	void process(const MTPDocument &document);
 
 	template <typename Inner>
-	[[nodiscard]] QByteArray list(const MTPVector<Inner> &data);
+	void list(const MTPVector<Inner> &data);
 
-	[[nodiscard]] QByteArray collage(
+	void collage(
 		const QVector<MTPPageBlock> &list,
-		const std::vector<QSize> &dimensions,
-		int offset = 0);
-	[[nodiscard]] QByteArray slideshow(
+		const std::vector<QSize> &dimensions);
+	void slideshow(
 		const QVector<MTPPageBlock> &list,
 		QSize dimensions);
 
-	[[nodiscard]] QByteArray block(const MTPDpageBlockUnsupported &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockTitle &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockSubtitle &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockAuthorDate &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockHeader &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockSubheader &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockParagraph &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockPreformatted &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockFooter &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockDivider &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockAnchor &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockList &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockBlockquote &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockPullquote &data);
-	[[nodiscard]] QByteArray block(
+	void block(const MTPDpageBlockUnsupported &data);
+	void block(const MTPDpageBlockTitle &data);
+	void block(const MTPDpageBlockSubtitle &data);
+	void block(const MTPDpageBlockAuthorDate &data);
+	void block(const MTPDpageBlockHeader &data);
+	void block(const MTPDpageBlockSubheader &data);
+	void block(const MTPDpageBlockParagraph &data);
+	void block(const MTPDpageBlockPreformatted &data);
+	void block(const MTPDpageBlockFooter &data);
+	void block(const MTPDpageBlockDivider &data);
+	void block(const MTPDpageBlockAnchor &data);
+	void block(const MTPDpageBlockList &data);
+	void block(const MTPDpageBlockBlockquote &data);
+	void block(const MTPDpageBlockPullquote &data);
+	void block(
 		const MTPDpageBlockPhoto &data,
 		const Ui::GroupMediaLayout &layout = {},
 		QSize outer = {});
-	[[nodiscard]] QByteArray block(
+	void block(
 		const MTPDpageBlockVideo &data,
 		const Ui::GroupMediaLayout &layout = {},
 		QSize outer = {});
-	[[nodiscard]] QByteArray block(const MTPDpageBlockCover &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockEmbed &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockEmbedPost &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockCollage &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockSlideshow &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockChannel &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockAudio &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockKicker &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockTable &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockOrderedList &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockDetails &data);
-	[[nodiscard]] QByteArray block(
-		const MTPDpageBlockRelatedArticles &data);
-	[[nodiscard]] QByteArray block(const MTPDpageBlockMap &data);
-
-	[[nodiscard]] QByteArray block(const MTPDpageRelatedArticle &data);
-
-	[[nodiscard]] QByteArray block(const MTPDpageTableRow &data);
-	[[nodiscard]] QByteArray block(const MTPDpageTableCell &data);
-
-	[[nodiscard]] QByteArray block(const MTPDpageListItemText &data);
-	[[nodiscard]] QByteArray block(const MTPDpageListItemBlocks &data);
-
-	[[nodiscard]] QByteArray block(const MTPDpageListOrderedItemText &data);
-	[[nodiscard]] QByteArray block(
-		const MTPDpageListOrderedItemBlocks &data);
-
-	[[nodiscard]] QByteArray wrap(const QByteArray &content, int views);
-
-	[[nodiscard]] QByteArray tag(
+	void block(const MTPDpageBlockCover &data);
+	void block(const MTPDpageBlockEmbed &data);
+	void block(const MTPDpageBlockEmbedPost &data);
+	void block(const MTPDpageBlockCollage &data);
+	void block(const MTPDpageBlockSlideshow &data);
+	void block(const MTPDpageBlockChannel &data);
+	void block(const MTPDpageBlockAudio &data);
+	void block(const MTPDpageBlockKicker &data);
+	void block(const MTPDpageBlockTable &data);
+	void block(const MTPDpageBlockOrderedList &data);
+	void block(const MTPDpageBlockDetails &data);
+	void block(const MTPDpageBlockRelatedArticles &data);
+	void block(const MTPDpageBlockMap &data);
+
+	void block(const MTPDpageRelatedArticle &data);
+
+	void block(const MTPDpageTableRow &data);
+	void block(const MTPDpageTableCell &data);
+
+	void block(const MTPDpageListItemText &data);
+	void block(const MTPDpageListItemBlocks &data);
+
+	void block(const MTPDpageListOrderedItemText &data);
+	void block(const MTPDpageListOrderedItemBlocks &data);
+
+	void wrap(const MTPVector<MTPPageBlock> &blocks, int views);
+
+	// Writes <name attributes>, then body() appends the content in place.
+	template <typename Body, typename = std::enable_if_t<IsBody<Body>>>
+	void tag(
 		const QByteArray &name,
-		const QByteArray &body = {});
-	[[nodiscard]] QByteArray tag(
+		const Attributes &attributes,
+		Body &&body);
+	template <typename Body, typename = std::enable_if_t<IsBody<Body>>>
+	void tag(const QByteArray &name, Body &&body);
+	void tag(const QByteArray &name, const Attributes &attributes = {});
+
+	// Like tag(), but rolls back if body() didn't append anything.
+	template <typename Body, typename = std::enable_if_t<IsBody<Body>>>
+	bool tagIfNotEmpty(
 		const QByteArray &name,
 		const Attributes &attributes,
-		const QByteArray &body = {});
+		Body &&body);
+
+	void openTag(const QByteArray &name, const Attributes &attributes);
+	void closeTag(const QByteArray &name, qsizetype bodyStart);
+
 	[[nodiscard]] QByteArray utf(const MTPstring &text);
 	[[nodiscard]] QByteArray utf(const tl::conditional<MTPstring> &text);
-	[[nodiscard]] QByteArray rich(const MTPRichText &text);
-	[[nodiscard]] QByteArray caption(const MTPPageCaption &caption);
+	void appendUtf(const MTPstring &text);
+	void rich(const MTPRichText &text);
+	void caption(const MTPPageCaption &caption);
 
 	[[nodiscard]] Photo parse(const MTPPhoto &photo);
 	[[nodiscard]] Document parse(const MTPDocument &document);
@@ -184,6 +244,7 @@ private:
 	base::flat_set<QByteArray> _resources;
 
 	Prepared _result;
+	QByteArray _html;
 
 	base::flat_map<uint64, Photo> _photosById;
 	base::flat_map<uint64, Document> _documentsById;
@@ -232,8 +293,9 @@ Parser::Parser(const Source &source, const Options &options)
 	const auto views = std::max(
 		source.page.data().vviews().value_or_empty(),
 		source.updatedCachedViews);
-	const auto content = list(source.page.data().vblocks());
-	_result.content = wrap(content, views);
+	_html.reserve(kInitialReserve);
+	wrap(source.page.data().vblocks(), views);
+	_result.content = base::take(_html);
 }
 
 Prepared Parser::result() {
@@ -269,166 +331,239 @@ void Parser::process(const MTPDocument &document) {
 }
 
 template <typename Inner>
-QByteArray Parser::list(const MTPVector<Inner> &data) {
-	auto result = QByteArrayList();
-	result.reserve(data.v.size());
+void Parser::list(const MTPVector<Inner> &data) {
 	for (const auto &item : data.v) {
-		result.append(item.match([&](const auto &data) {
-			return block(data);
-		}));
+		item.match([&](const auto &data) {
+			block(data);
+		});
 	}
-	return result.join(QByteArray());
 }
 
-QByteArray Parser::collage(
-		const QVector<MTPPageBlock> &list,
-		const std::vector<QSize> &dimensions,
-		int offset) {
-	Expects(list.size() == dimensions.size());
+template <typename Body, typename>
+void Parser::tag(
+		const QByteArray &name,
+		const Attributes &attributes,
+		Body &&body) {
+	openTag(name, attributes);
+	const auto bodyStart = _html.size();
+	body();
+	closeTag(name, bodyStart);
+}
 
-	constexpr auto kPerCollage = 10;
-	const auto last = (offset + kPerCollage >= int(dimensions.size()));
+template <typename Body, typename>
+void Parser::tag(const QByteArray &name, Body &&body) {
+	tag(name, {}, std::forward<Body>(body));
+}
 
-	auto result = QByteArray();
-	auto slice = ((offset > 0) || (dimensions.size() > kPerCollage))
-		? (dimensions
-			| ranges::views::drop(offset)
-			| ranges::views::take(kPerCollage)
-			| ranges::to_vector)
-		: dimensions;
-	const auto layout = Ui::LayoutMediaGroup(
-		slice,
-		st::historyGroupWidthMax,
-		st::historyGroupWidthMin,
-		st::historyGroupSkip);
-	auto size = QSize();
-	for (const auto &part : layout) {
-		const auto &rect = part.geometry;
-		size = QSize(
-			std::max(size.width(), rect.x() + rect.width()),
-			std::max(size.height(), rect.y() + rect.height()));
+void Parser::tag(const QByteArray &name, const Attributes &attributes) {
+	openTag(name, attributes);
+	closeTag(name, _html.size());
+}
+
+template <typename Body, typename>
+bool Parser::tagIfNotEmpty(
+		const QByteArray &name,
+		const Attributes &attributes,
+		Body &&body) {
+	const auto start = _html.size();
+	openTag(name, attributes);
+	const auto bodyStart = _html.size();
+	body();
+	if (_html.size() == bodyStart) {
+		_html.truncate(start);
+		return false;
 	}
-	for (auto i = 0, count = int(layout.size()); i != count; ++i) {
-		const auto &part = layout[i];
-		list[offset + i].match([&](const MTPDpageBlockPhoto &data) {
-			result += block(data, part, size);
-		}, [&](const MTPDpageBlockVideo &data) {
-			result += block(data, part, size);
-		}, [](const auto &) {
-			Unexpected("Block type in collage layout.");
-		});
+	closeTag(name, bodyStart);
+	return true;
+}
+
+void Parser::openTag(const QByteArray &name, const Attributes &attributes) {
+	_html.append('<').append(name);
+	for (const auto &[key, value] : attributes) {
+		_html.append(' ').append(key);
+		if (value) {
+			_html.append("=\"").append(*value).append('"');
+		}
 	}
-	const auto aspectHeight = size.height() / float64(size.width());
-	const auto aspectSkip = st::historyGroupSkip / float64(size.width());
-	auto wrapped = tag("figure", {
-		{ "class", "collage" },
-		{
-			"style",
-			("padding-top: " + Percent(aspectHeight) + "%; "
-				+ "margin-bottom: " + Percent(last ? 0 : aspectSkip) + "%;")
-		},
-	}, result);
-	if (offset + kPerCollage < int(dimensions.size())) {
-		wrapped += collage(list, dimensions, offset + kPerCollage);
+	_html.append('>');
+}
+
+void Parser::closeTag(const QByteArray &name, qsizetype bodyStart) {
+	if (_html.size() == bodyStart && IsVoidElement(name)) {
+		_html.chop(1);
+		_html.append(" />");
+	} else {
+		_html.append("</").append(name).append('>');
 	}
-	return wrapped;
 }
 
-QByteArray Parser::slideshow(
+void Parser::collage(
 		const QVector<MTPPageBlock> &list,
-		QSize dimensions) {
-	auto result = QByteArray();
-	for (auto i = 0, count = int(list.size()); i != count; ++i) {
-		list[i].match([&](const MTPDpageBlockPhoto &data) {
-			result += block(data, {}, dimensions);
-		}, [&](const MTPDpageBlockVideo &data) {
-			result += block(data, {}, dimensions);
-		}, [](const auto &) {
-			Unexpected("Block type in collage layout.");
-		});
-	}
+		const std::vector<QSize> &dimensions) {
+	Expects(list.size() == dimensions.size());
 
-	auto inputs = QByteArrayList();
-	for (auto i = 0; i != int(list.size()); ++i) {
-		auto attributes = Attributes{
-			{ "type", "radio" },
-			{ "name", "s" },
-			{ "value", Number(i) },
-			{ "onchange", "return IV.slideshowSlide(this);" },
-		};
-		if (!i) {
-			attributes.push_back({ "checked", std::nullopt });
+	constexpr auto kPerCollage = 10;
+	const auto count = int(dimensions.size());
+	for (auto offset = 0; offset < count; offset += kPerCollage) {
+		const auto last = (offset + kPerCollage >= count);
+		auto slice = ((offset > 0) || (count > kPerCollage))
+			? (dimensions
+				| ranges::views::drop(offset)
+				| ranges::views::take(kPerCollage)
+				| ranges::to_vector)
+			: dimensions;
+		const auto layout = Ui::LayoutMediaGroup(
+			slice,
+			st::historyGroupWidthMax,
+			st::historyGroupWidthMin,
+			st::historyGroupSkip);
+		auto size = QSize();
+		for (const auto &part : layout) {
+			const auto &rect = part.geometry;
+			size = QSize(
+				std::max(size.width(), rect.x() + rect.width()),
+				std::max(size.height(), rect.y() + rect.height()));
 		}
-		inputs.append(tag("label", tag("input", attributes, tag("i"))));
+		const auto aspectHeight = size.height() / float64(size.width());
+		const auto aspectSkip = st::historyGroupSkip / float64(size.width());
+		tag("figure", {
+			{ "class", "collage" },
+			{
+				"style",
+				("padding-top: " + Percent(aspectHeight) + "%; "
+					+ "margin-bottom: "
+					+ Percent(last ? 0 : aspectSkip)
+					+ "%;")
+			},
+		}, [&] {
+			for (auto i = 0, parts = int(layout.size()); i != parts; ++i) {
+				const auto &part = layout[i];
+				list[offset + i].match([&](const MTPDpageBlockPhoto &data) {
+					block(data, part, size);
+				}, [&](const MTPDpageBlockVideo &data) {
+					block(data, part, size);
+				}, [](const auto &) {
+					Unexpected("Block type in collage layout.");
+				});
+			}
+		});
 	}
-	const auto form = tag(
-		"form",
-		{ { "class", "slideshow-buttons" } },
-		tag("fieldset", inputs.join(QByteArray())));
-	const auto navigation = tag("a", {
-		{ "class", "slideshow-prev" },
-		{ "onclick", "IV.slideshowSlide(this, -1);" },
-	}, ArrowSvg(true)) + tag("a", {
-		{ "class", "slideshow-next" },
-		{ "onclick", "IV.slideshowSlide(this, 1);" },
-	}, ArrowSvg(false));
-	auto wrapStyle = "padding-top: calc(min("
+}
+
+void Parser::slideshow(
+		const QVector<MTPPageBlock> &list,
+		QSize dimensions) {
+	const auto wrapStyle = "padding-top: calc(min("
 		+ Percent(dimensions.height() / float64(dimensions.width()))
 		+ "%, 480px));";
-	result = form + tag("figure", {
-		{ "class", "slideshow" },
-	}, result) + navigation;
-	return tag("figure", {
+	tag("figure", {
 		{ "class", "slideshow-wrap" },
 		{ "style", wrapStyle },
-	}, result);
+	}, [&] {
+		tag("form", { { "class", "slideshow-buttons" } }, [&] {
+			tag("fieldset", [&] {
+				for (auto i = 0; i != int(list.size()); ++i) {
+					auto attributes = Attributes{
+						{ "type", "radio" },
+						{ "name", "s" },
+						{ "value", Number(i) },
+						{ "onchange", "return IV.slideshowSlide(this);" },
+					};
+					if (!i) {
+						attributes.push_back({ "checked", std::nullopt });
+					}
+					tag("label", [&] {
+						tag("input", attributes, [&] {
+							tag("i");
+						});
+					});
+				}
+			});
+		});
+		tag("figure", { { "class", "slideshow" } }, [&] {
+			for (auto i = 0, count = int(list.size()); i != count; ++i) {
+				list[i].match([&](const MTPDpageBlockPhoto &data) {
+					block(data, {}, dimensions);
+				}, [&](const MTPDpageBlockVideo &data) {
+					block(data, {}, dimensions);
+				}, [](const auto &) {
+					Unexpected("Block type in collage layout.");
+				});
+			}
+		});
+		tag("a", {
+			{ "class", "slideshow-prev" },
+			{ "onclick", "IV.slideshowSlide(this, -1);" },
+		}, [&] {
+			_html.append(ArrowSvg(true));
+		});
+		tag("a", {
+			{ "class", "slideshow-next" },
+			{ "onclick", "IV.slideshowSlide(this, 1);" },
+		}, [&] {
+			_html.append(ArrowSvg(false));
+		});
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockUnsupported &data) {
-	return QByteArray();
+void Parser::block(const MTPDpageBlockUnsupported &data) {
 }
 
-QByteArray Parser::block(const MTPDpageBlockTitle &data) {
-	return tag("h1", {
+void Parser::block(const MTPDpageBlockTitle &data) {
+	tag("h1", {
 		{ "class", "title" },
 		{ "dir", "auto" },
-	}, rich(data.vtext()));
+	}, [&] {
+		rich(data.vtext());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockSubtitle &data) {
-	return tag("h2", {
+void Parser::block(const MTPDpageBlockSubtitle &data) {
+	tag("h2", {
 		{ "class", "subtitle" },
 		{ "dir", "auto" },
-	}, rich(data.vtext()));
+	}, [&] {
+		rich(data.vtext());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockAuthorDate &data) {
-	auto inner = rich(data.vauthor());
-	if (const auto date = data.vpublished_date().v) {
-		inner += " \xE2\x80\xA2 " + tag("time", Date(date));
-	}
-	return tag("address", { { "dir", "auto" } }, inner);
+void Parser::block(const MTPDpageBlockAuthorDate &data) {
+	tag("address", { { "dir", "auto" } }, [&] {
+		rich(data.vauthor());
+		if (const auto date = data.vpublished_date().v) {
+			_html.append(" \xE2\x80\xA2 ");
+			tag("time", [&] {
+				_html.append(Date(date));
+			});
+		}
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockHeader &data) {
-	return tag("h3", {
+void Parser::block(const MTPDpageBlockHeader &data) {
+	tag("h3", {
 		{ "class", "header" },
 		{ "dir", "auto" },
-	}, rich(data.vtext()));
+	}, [&] {
+		rich(data.vtext());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockSubheader &data) {
-	return tag("h4", {
+void Parser::block(const MTPDpageBlockSubheader &data) {
+	tag("h4", {
 		{ "class", "subheader" },
 		{ "dir", "auto" },
-	}, rich(data.vtext()));
+	}, [&] {
+		rich(data.vtext());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockParagraph &data) {
-	return tag("p", { { "dir", "auto" } }, rich(data.vtext()));
+void Parser::block(const MTPDpageBlockParagraph &data) {
+	tag("p", { { "dir", "auto" } }, [&] {
+		rich(data.vtext());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockPreformatted &data) {
+void Parser::block(const MTPDpageBlockPreformatted &data) {
 	auto list = Attributes{ { "dir", "auto" } };
 	const auto language = utf(data.vlanguage());
 	if (!language.isEmpty()) {
@@ -436,50 +571,56 @@ QByteArray Parser::block(const MTPDpageBlockPreformatted &data) {
 		list.push_back({ "class", "lang-" + language });
 		_result.hasCode = true;
 	}
-	return tag("pre", list, rich(data.vtext()));
+	tag("pre", list, [&] {
+		rich(data.vtext());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockFooter &data) {
-	return tag("footer", {
+void Parser::block(const MTPDpageBlockFooter &data) {
+	tag("footer", {
 		{ "class", "footer" },
 		{ "dir", "auto" },
-	}, rich(data.vtext()));
+	}, [&] {
+		rich(data.vtext());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockDivider &data) {
-	return tag("hr", Attributes{ { "class", "divider" } });
+void Parser::block(const MTPDpageBlockDivider &data) {
+	tag("hr", Attributes{ { "class", "divider" } });
 }
 
-QByteArray Parser::block(const MTPDpageBlockAnchor &data) {
-	return tag("a", { { "name", utf(data.vname()) } });
+void Parser::block(const MTPDpageBlockAnchor &data) {
+	tag("a", { { "name", utf(data.vname()) } });
 }
 
-QByteArray Parser::block(const MTPDpageBlockList &data) {
-	return tag("ul", list(data.vitems()));
+void Parser::block(const MTPDpageBlockList &data) {
+	tag("ul", [&] {
+		list(data.vitems());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockBlockquote &data) {
-	const auto caption = rich(data.vcaption());
-	const auto cite = caption.isEmpty()
-		? QByteArray()
-		: tag("cite", { { "dir", "auto" } }, caption);
-	return tag("blockquote", {
-		{ "dir", "auto" }
-	}, rich(data.vtext()) + cite);
+void Parser::block(const MTPDpageBlockBlockquote &data) {
+	tag("blockquote", { { "dir", "auto" } }, [&] {
+		rich(data.vtext());
+		tagIfNotEmpty("cite", { { "dir", "auto" } }, [&] {
+			rich(data.vcaption());
+		});
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockPullquote &data) {
-	const auto caption = rich(data.vcaption());
-	const auto cite = caption.isEmpty()
-		? QByteArray()
-		: tag("cite", { { "dir", "auto" } }, caption);
-	return tag("div", {
+void Parser::block(const MTPDpageBlockPullquote &data) {
+	tag("div", {
 		{ "class", "pullquote" },
 		{ "dir", "auto" },
-	}, rich(data.vtext()) + cite);
+	}, [&] {
+		rich(data.vtext());
+		tagIfNotEmpty("cite", { { "dir", "auto" } }, [&] {
+			rich(data.vcaption());
+		});
+	});
 }
 
-QByteArray Parser::block(
+void Parser::block(
 		const MTPDpageBlockPhoto &data,
 		const Ui::GroupMediaLayout &layout,
 		QSize outer) {
@@ -487,7 +628,8 @@ QByteArray Parser::block(
 	const auto slideshow = !collage && !outer.isEmpty();
 	const auto photo = photoById(data.vphoto_id().v);
 	if (!photo.id) {
-		return "Photo not found.";
+		_html.append("Photo not found.");
+		return;
 	}
 	const auto src = photoFullUrl(photo);
 	auto wrapStyle = QByteArray();
@@ -511,42 +653,43 @@ QByteArray Parser::block(
 		: "calc(min(480px, " + Percent(dimension) + "%))";
 	const auto style = "background-image:url('" + src + "');"
 		"padding-top: " + paddingTop + ";";
-	auto inner = tag("div", {
-		{ "class", "photo" },
-		{ "style", style } });
-	const auto minithumb = Images::ExpandInlineBytes(photo.minithumbnail);
-	if (!minithumb.isEmpty()) {
-		const auto image = Images::Read({ .content = minithumb });
-		inner = tag("div", {
-			{ "class", "photo-bg" },
-			{ "style", "background-image:url('data:image/jpeg;base64,"
-				+ minithumb.toBase64()
-				+ "');" },
-		}) + inner;
-	}
-	auto attributes = Attributes{
-		{ "class", "photo-wrap" },
-		{ "style", wrapStyle }
-	};
-	auto result = tag("div", attributes, inner);
-
+	const auto minithumb = MinithumbStyle(photo.minithumbnail);
 	const auto href = data.vurl() ? utf(*data.vurl()) : photoFullUrl(photo);
 	const auto id = Number(photo.id);
-	result = tag("a", {
+	const auto link = Attributes{
 		{ "href", href },
 		{ "oncontextmenu", data.vurl() ? QByteArray() : "return false;" },
 		{ "data-context", data.vurl() ? QByteArray() : "viewer-photo" + id },
-	}, result);
-	if (!slideshow) {
-		result += caption(data.vcaption());
-		if (!collage) {
-			result = tag("div", { { "class", "media-outer" } }, result);
+	};
+	const auto media = [&] {
+		tag("a", link, [&] {
+			tag("div", {
+				{ "class", "photo-wrap" },
+				{ "style", wrapStyle },
+			}, [&] {
+				if (!minithumb.isEmpty()) {
+					tag("div", {
+						{ "class", "photo-bg" },
+						{ "style", minithumb },
+					});
+				}
+				tag("div", {
+					{ "class", "photo" },
+					{ "style", style } });
+			});
+		});
+		if (!slideshow) {
+			caption(data.vcaption());
 		}
+	};
+	if (!slideshow && !collage) {
+		tag("div", { { "class", "media-outer" } }, media);
+	} else {
+		media();
 	}
-	return result;
 }
 
-QByteArray Parser::block(
+void Parser::block(
 		const MTPDpageBlockVideo &data,
 		const Ui::GroupMediaLayout &layout,
 		QSize outer) {
@@ -556,25 +699,10 @@ QByteArray Parser::block(
 		&& (layout.geometry.width() < outer.width());
 	const auto video = documentById(data.vvideo_id().v);
 	if (!video.id) {
-		return "Video not found.";
-	}
-	auto inner = tag("div", {
-		{ "class", "video" },
-		{ "data-src", documentFullUrl(video) },
-		{ "data-autoplay", data.is_autoplay() ? "1" : "0" },
-		{ "data-loop", data.is_loop() ? "1" : "0" },
-		{ "data-small", collageSmall ? "1" : "0" },
-	});
-	const auto minithumb = Images::ExpandInlineBytes(video.minithumbnail);
-	if (!minithumb.isEmpty()) {
-		const auto image = Images::Read({ .content = minithumb });
-		inner = tag("div", {
-			{ "class", "video-bg" },
-			{ "style", "background-image:url('data:image/jpeg;base64,"
-				+ minithumb.toBase64()
-				+ "');" },
-		}) + inner;
+		_html.append("Video not found.");
+		return;
 	}
+	const auto minithumb = MinithumbStyle(video.minithumbnail);
 	auto wrapStyle = QByteArray();
 	if (collage) {
 		const auto wcoef = 1. / outer.width();
@@ -591,36 +719,58 @@ QByteArray Parser::block(
 			+ Percent(dimension)
 			+ "%));";
 	}
-	auto attributes = Attributes{
-		{ "class", "video-wrap" },
-		{ "style", wrapStyle },
+	const auto wrapped = [&] {
+		tag("div", {
+			{ "class", "video-wrap" },
+			{ "style", wrapStyle },
+		}, [&] {
+			if (!minithumb.isEmpty()) {
+				tag("div", {
+					{ "class", "video-bg" },
+					{ "style", minithumb },
+				});
+			}
+			tag("div", {
+				{ "class", "video" },
+				{ "data-src", documentFullUrl(video) },
+				{ "data-autoplay", data.is_autoplay() ? "1" : "0" },
+				{ "data-loop", data.is_loop() ? "1" : "0" },
+				{ "data-small", collageSmall ? "1" : "0" },
+			});
+		});
 	};
-	auto result = tag("div", attributes, inner);
-	if (data.is_autoplay() || collageSmall) {
-		const auto id = Number(video.id);
-		const auto href = resource("video" + id);
-		result = tag("a", {
-			{ "href", href },
-			{ "oncontextmenu", "return false;" },
-			{ "data-context", "viewer-video" + id },
-		}, result);
-	}
-	if (!slideshow) {
-		result += caption(data.vcaption());
-		if (!collage) {
-			result = tag("div", { { "class", "media-outer" } }, result);
+	const auto media = [&] {
+		if (data.is_autoplay() || collageSmall) {
+			const auto id = Number(video.id);
+			const auto href = resource("video" + id);
+			tag("a", {
+				{ "href", href },
+				{ "oncontextmenu", "return false;" },
+				{ "data-context", "viewer-video" + id },
+			}, wrapped);
+		} else {
+			wrapped();
+		}
+		if (!slideshow) {
+			caption(data.vcaption());
 		}
+	};
+	if (!slideshow && !collage) {
+		tag("div", { { "class", "media-outer" } }, media);
+	} else {
+		media();
 	}
-	return result;
 }
 
-QByteArray Parser::block(const MTPDpageBlockCover &data) {
-	return tag("figure", data.vcover().match([&](const auto &data) {
-		return block(data);
-	}));
+void Parser::block(const MTPDpageBlockCover &data) {
+	tag("figure", [&] {
+		data.vcover().match([&](const auto &data) {
+			block(data);
+		});
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockEmbed &data) {
+void Parser::block(const MTPDpageBlockEmbed &data) {
 	_result.hasEmbeds = true;
 	auto eclass = data.is_full_width() ? QByteArray() : "nowide";
 	auto width = QByteArray();
@@ -661,78 +811,99 @@ QByteArray Parser::block(const MTPDpageBlockEmbed &data) {
 	attributes.push_back({ "frameborder", "0" });
 	attributes.push_back({ "allowtransparency", "true" });
 	attributes.push_back({ "allowfullscreen", "true" });
-	auto result = tag("iframe", attributes);
-	if (!autosize) {
-		result = tag("div", {
-			{ "class", "iframe-wrap" },
-			{ "style", "width:" + width },
-		}, tag("div", {
-			{ "style", "padding-bottom: " + height },
-		}, result));
-	}
-	result += caption(data.vcaption());
-	return tag("figure", { { "class", eclass } }, result);
+	tag("figure", { { "class", eclass } }, [&] {
+		if (!autosize) {
+			tag("div", {
+				{ "class", "iframe-wrap" },
+				{ "style", "width:" + width },
+			}, [&] {
+				tag("div", {
+					{ "style", "padding-bottom: " + height },
+				}, [&] {
+					tag("iframe", attributes);
+				});
+			});
+		} else {
+			tag("iframe", attributes);
+		}
+		caption(data.vcaption());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockEmbedPost &data) {
-	auto result = QByteArray();
-	if (!data.vblocks().v.isEmpty()) {
-		auto address = QByteArray();
-		const auto photo = photoById(data.vauthor_photo_id().v);
-		if (photo.id) {
-			const auto src = photoFullUrl(photo);
-			address += tag(
-				"figure",
-				{ { "style", "background-image:url('" + src + "')" } });
-		}
-		address += tag(
-			"a",
-			{ { "rel", "author" }, { "onclick", "return false;" } },
-			utf(data.vauthor()));
-		if (const auto date = data.vdate().v) {
-			const auto parsed = base::unixtime::parse(date);
-			address += tag("time", Date(date));
+void Parser::block(const MTPDpageBlockEmbedPost &data) {
+	tag("figure", [&] {
+		if (!data.vblocks().v.isEmpty()) {
+			tag("blockquote", { { "class", "embed-post" } }, [&] {
+				tag("address", [&] {
+					const auto photo = photoById(data.vauthor_photo_id().v);
+					if (photo.id) {
+						const auto src = photoFullUrl(photo);
+						tag("figure", {
+							{ "style", "background-image:url('" + src + "')" },
+						});
+					}
+					tag(
+						"a",
+						{ { "rel", "author" }, { "onclick", "return false;" } },
+						[&] { appendUtf(data.vauthor()); });
+					if (const auto date = data.vdate().v) {
+						tag("time", [&] {
+							_html.append(Date(date));
+						});
+					}
+				});
+				list(data.vblocks());
+			});
+		} else {
+			const auto url = utf(data.vurl());
+			tag("section", { { "class", "embed-post" } }, [&] {
+				tag("strong", [&] {
+					appendUtf(data.vauthor());
+				});
+				tag("small", [&] {
+					tag("a", { { "href", url } }, [&] {
+						_html.append(url);
+					});
+				});
+			});
 		}
-		const auto inner = tag("address", address) + list(data.vblocks());
-		result = tag("blockquote", { { "class", "embed-post" } }, inner);
-	} else {
-		const auto url = utf(data.vurl());
-		const auto inner = tag("strong", utf(data.vauthor()))
-			+ tag(
-				"small",
-				tag("a", { { "href", url } }, url));
-		result = tag("section", { { "class", "embed-post" } }, inner);
-	}
-	result += caption(data.vcaption());
-	return tag("figure", result);
+		caption(data.vcaption());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockCollage &data) {
+void Parser::block(const MTPDpageBlockCollage &data) {
 	const auto &items = data.vitems().v;
 	const auto dimensions = computeCollageDimensions(items);
 	if (dimensions.empty()) {
-		return tag(
-			"figure",
-			tag("figure", list(data.vitems())) + caption(data.vcaption()));
+		tag("figure", [&] {
+			tag("figure", [&] {
+				list(data.vitems());
+			});
+			caption(data.vcaption());
+		});
+		return;
 	}
 
-	return tag(
-		"figure",
-		{ { "class", "collage-wrap" } },
-		collage(items, dimensions) + caption(data.vcaption()));
+	tag("figure", { { "class", "collage-wrap" } }, [&] {
+		collage(items, dimensions);
+		caption(data.vcaption());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockSlideshow &data) {
+void Parser::block(const MTPDpageBlockSlideshow &data) {
 	const auto &items = data.vitems().v;
 	const auto dimensions = computeSlideshowDimensions(items);
 	if (dimensions.isEmpty()) {
-		return list(data.vitems());
+		list(data.vitems());
+		return;
 	}
-	const auto result = slideshow(items, dimensions);
-	return tag("figure", result + caption(data.vcaption()));
+	tag("figure", [&] {
+		slideshow(items, dimensions);
+		caption(data.vcaption());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockChannel &data) {
+void Parser::block(const MTPDpageBlockChannel &data) {
 	auto name = QByteArray();
 	auto username = QByteArray();
 	auto id = data.vchannel().match([](const auto &data) {
@@ -747,46 +918,58 @@ QByteArray Parser::block(const MTPDpageBlockChannel &data) {
 		name = utf(data.vtitle());
 	}, [](const auto &) {
 	});
-	auto result = tag(
-		"div",
-		{ { "class", "join" }, { "data-context", "join_link" + id } },
-		tag("span")
-	) + tag("h4", name);
 	const auto link = username.isEmpty()
 		? "javascript:alert('Channel Link');"
 		: "https://t.me/" + username;
-	result = tag(
-		"a",
-		{ { "href", link }, { "data-context", "channel" + id } },
-		result);
 	_result.channelIds.emplace(id);
-	return tag("section", {
+	tag("section", {
 		{ "class", "channel joined" },
 		{ "data-context", "channel" + id },
-	}, result);
+	}, [&] {
+		tag(
+			"a",
+			{ { "href", link }, { "data-context", "channel" + id } },
+			[&] {
+				tag("div", {
+					{ "class", "join" },
+					{ "data-context", "join_link" + id },
+				}, [&] {
+					tag("span");
+				});
+				tag("h4", [&] {
+					_html.append(name);
+				});
+			});
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockAudio &data) {
+void Parser::block(const MTPDpageBlockAudio &data) {
 	const auto audio = documentById(data.vaudio_id().v);
 	if (!audio.id) {
-		return "Audio not found.";
+		_html.append("Audio not found.");
+		return;
 	}
 	const auto src = documentFullUrl(audio);
-	return tag("figure", tag("audio", {
-		{ "src", src },
-		{ "oncontextmenu", "return false;" },
-		{ "controls", std::nullopt },
-	}) + caption(data.vcaption()));
+	tag("figure", [&] {
+		tag("audio", {
+			{ "src", src },
+			{ "oncontextmenu", "return false;" },
+			{ "controls", std::nullopt },
+		});
+		caption(data.vcaption());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockKicker &data) {
-	return tag("h5", {
+void Parser::block(const MTPDpageBlockKicker &data) {
+	tag("h5", {
 		{ "class", "kicker" },
 		{ "dir", "auto" },
-	}, rich(data.vtext()));
+	}, [&] {
+		rich(data.vtext());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockTable &data) {
+void Parser::block(const MTPDpageBlockTable &data) {
 	auto classes = QByteArrayList();
 	if (data.is_bordered()) {
 		classes.push_back("bordered");
@@ -798,116 +981,134 @@ QByteArray Parser::block(const MTPDpageBlockTable &data) {
 	if (!classes.isEmpty()) {
 		attibutes.push_back({ "class", classes.join(" ") });
 	}
-	auto title = rich(data.vtitle());
-	if (!title.isEmpty()) {
-		title = tag("caption", { { "dir", "auto" } }, title);
-	}
-	auto result = tag("table", attibutes, title + list(data.vrows()));
-	result = tag("figure", { { "class", "table" } }, result);
-	result = tag("figure", { { "class", "table-wrap" } }, result);
-	return tag("figure", result);
+	tag("figure", [&] {
+		tag("figure", { { "class", "table-wrap" } }, [&] {
+			tag("figure", { { "class", "table" } }, [&] {
+				tag("table", attibutes, [&] {
+					tagIfNotEmpty("caption", { { "dir", "auto" } }, [&] {
+						rich(data.vtitle());
+					});
+					list(data.vrows());
+				});
+			});
+		});
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockOrderedList &data) {
-	return tag("ol", list(data.vitems()));
+void Parser::block(const MTPDpageBlockOrderedList &data) {
+	tag("ol", [&] {
+		list(data.vitems());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockDetails &data) {
+void Parser::block(const MTPDpageBlockDetails &data) {
 	auto attributes = Attributes();
 	if (data.is_open()) {
 		attributes.push_back({ "open", std::nullopt });
 	}
-	return tag(
-		"details",
-		attributes,
-		(tag("summary", { { "dir", "auto" } }, rich(data.vtitle()))
-			+ list(data.vblocks())));
+	tag("details", attributes, [&] {
+		tag("summary", { { "dir", "auto" } }, [&] {
+			rich(data.vtitle());
+		});
+		list(data.vblocks());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageBlockRelatedArticles &data) {
-	const auto result = list(data.varticles());
-	if (result.isEmpty()) {
-		return QByteArray();
-	}
-	auto title = rich(data.vtitle());
-	if (!title.isEmpty()) {
-		title = tag("h4", {
+void Parser::block(const MTPDpageBlockRelatedArticles &data) {
+	const auto start = _html.size();
+	auto empty = false;
+	tag("section", { { "class", "related" } }, [&] {
+		tagIfNotEmpty("h4", {
 			{ "class", "related-title" },
 			{ "dir", "auto" },
-		}, title);
+		}, [&] {
+			rich(data.vtitle());
+		});
+		const auto articles = _html.size();
+		list(data.varticles());
+		empty = (_html.size() == articles);
+	});
+	if (empty) {
+		_html.truncate(start);
 	}
-	return tag("section", { { "class", "related" } }, title + result);
 }
 
-QByteArray Parser::block(const MTPDpageBlockMap &data) {
+void Parser::block(const MTPDpageBlockMap &data) {
 	const auto geo = parse(data.vgeo());
 	if (!geo.access) {
-		return "Map not found.";
+		_html.append("Map not found.");
+		return;
 	}
 	const auto width = 650;
 	const auto height = std::min(450, (data.vh().v * width / data.vw().v));
-	return tag("figure", tag("img", {
-		{ "src", mapUrl(geo, width, height, data.vzoom().v) },
-	}) + caption(data.vcaption()));
+	tag("figure", [&] {
+		tag("img", {
+			{ "src", mapUrl(geo, width, height, data.vzoom().v) },
+		});
+		caption(data.vcaption());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageRelatedArticle &data) {
-	auto result = QByteArray();
-	const auto photo = photoById(data.vphoto_id().value_or_empty());
-	if (photo.id) {
-		const auto src = photoFullUrl(photo);
-		result += tag("i", {
-			{ "class", "related-link-thumb" },
-			{ "style", "background-image:url('" + src + "')" },
-		});
-	}
-	const auto title = data.vtitle();
-	const auto description = data.vdescription();
-	const auto author = data.vauthor();
-	const auto published = data.vpublished_date();
-	if (title || description || author || published) {
-		auto inner = QByteArray();
-		if (title) {
-			inner += tag(
-				"span",
-				{ { "class", "related-link-title" } },
-				utf(*title));
-		}
-		if (description) {
-			inner += tag(
-				"span",
-				{ { "class", "related-link-desc" } },
-				utf(*description));
-		}
-		if (author || published) {
-			inner += tag(
-				"span",
-				{ { "class", "related-link-source" } },
-				((author ? utf(*author) : QByteArray())
-					+ ((author && published) ? ", " : QByteArray())
-					+ (published ? Date(published->v) : QByteArray())));
-		}
-		result += tag("span", {
-			{ "class", "related-link-content" },
-		}, inner);
-	}
+void Parser::block(const MTPDpageRelatedArticle &data) {
 	const auto webpageId = data.vwebpage_id().v;
 	const auto context = webpageId
 		? ("webpage" + Number(webpageId))
 		: QByteArray();
-	return tag("a", {
+	tag("a", {
 		{ "class", "related-link" },
 		{ "href", utf(data.vurl()) },
 		{ "data-context", context },
-	}, result);
+	}, [&] {
+		const auto photo = photoById(data.vphoto_id().value_or_empty());
+		if (photo.id) {
+			const auto src = photoFullUrl(photo);
+			tag("i", {
+				{ "class", "related-link-thumb" },
+				{ "style", "background-image:url('" + src + "')" },
+			});
+		}
+		const auto title = data.vtitle();
+		const auto description = data.vdescription();
+		const auto author = data.vauthor();
+		const auto published = data.vpublished_date();
+		if (!title && !description && !author && !published) {
+			return;
+		}
+		tag("span", { { "class", "related-link-content" } }, [&] {
+			if (title) {
+				tag("span", { { "class", "related-link-title" } }, [&] {
+					appendUtf(*title);
+				});
+			}
+			if (description) {
+				tag("span", { { "class", "related-link-desc" } }, [&] {
+					appendUtf(*description);
+				});
+			}
+			if (author || published) {
+				tag("span", { { "class", "related-link-source" } }, [&] {
+					if (author) {
+						appendUtf(*author);
+					}
+					if (author && published) {
+						_html.append(", ");
+					}
+					if (published) {
+						_html.append(Date(published->v));
+					}
+				});
+			}
+		});
+	});
 }
 
-QByteArray Parser::block(const MTPDpageTableRow &data) {
-	return tag("tr", list(data.vcells()));
+void Parser::block(const MTPDpageTableRow &data) {
+	tag("tr", [&] {
+		list(data.vcells());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageTableCell &data) {
-	const auto text = data.vtext() ? rich(*data.vtext()) : QByteArray();
+void Parser::block(const MTPDpageTableCell &data) {
 	auto style = QByteArray();
 	if (data.is_align_right()) {
 		style += "text-align:right;";
@@ -930,29 +1131,35 @@ QByteArray Parser::block(const MTPDpageTableCell &data) {
 	if (const auto rs = data.vrowspan()) {
 		attributes.push_back({ "rowspan", Number(rs->v) });
 	}
-	return tag(data.is_header() ? "th" : "td", attributes, text);
+	tag(data.is_header() ? "th" : "td", attributes, [&] {
+		if (const auto text = data.vtext()) {
+			rich(*text);
+		}
+	});
 }
 
-QByteArray Parser::block(const MTPDpageListItemText &data) {
-	return tag("li", { { "dir", "auto" } }, rich(data.vtext()));
+void Parser::block(const MTPDpageListItemText &data) {
+	tag("li", { { "dir", "auto" } }, [&] {
+		rich(data.vtext());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageListItemBlocks &data) {
-	return tag("li", list(data.vblocks()));
+void Parser::block(const MTPDpageListItemBlocks &data) {
+	tag("li", [&] {
+		list(data.vblocks());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageListOrderedItemText &data) {
-	return tag(
-		"li",
-		{ { "value", utf(data.vnum()) }, { "dir", "auto" } },
-		rich(data.vtext()));
+void Parser::block(const MTPDpageListOrderedItemText &data) {
+	tag("li", { { "value", utf(data.vnum()) }, { "dir", "auto" } }, [&] {
+		rich(data.vtext());
+	});
 }
 
-QByteArray Parser::block(const MTPDpageListOrderedItemBlocks &data) {
-	return tag(
-		"li",
-		{ { "value", utf(data.vnum()) } },
-		list(data.vblocks()));
+void Parser::block(const MTPDpageListOrderedItemBlocks &data) {
+	tag("li", { { "value", utf(data.vnum()) } }, [&] {
+		list(data.vblocks());
+	});
 }
 
 QByteArray Parser::utf(const MTPstring &text) {
@@ -963,78 +1170,45 @@ QByteArray Parser::utf(const tl::conditional<MTPstring> &text) {
 	return text ? utf(*text) : QByteArray();
 }
 
-QByteArray Parser::wrap(const QByteArray &content, int views) {
+void Parser::appendUtf(const MTPstring &text) {
+	AppendEscaped(_html, text.v);
+}
+
+void Parser::wrap(const MTPVector<MTPPageBlock> &blocks, int views) {
 	const auto sep = " \xE2\x80\xA2 ";
 	const auto viewsText = views
 		? (tr::lng_stories_views(tr::now, lt_count_decimal, views) + sep)
 		: QString();
-	return R"(
+	_html.append(R"(
 <div class="page-slide">
-	<article>)"_q + content + R"(</article>
+	<article>)"_q);
+	list(blocks);
+	_html.append(R"(</article>
 </div>
 <div class="page-footer">
 	<div class="content">
-		)"_q
-		+ viewsText.toUtf8()
-		+ R"(<a class="wrong" data-context="report-iv">)"_q
-		+ tr::lng_iv_wrong_layout(tr::now).toUtf8()
-		+ R"(</a>
+		)"_q);
+	_html.append(viewsText.toUtf8());
+	_html.append(R"(<a class="wrong" data-context="report-iv">)"_q);
+	_html.append(tr::lng_iv_wrong_layout(tr::now).toUtf8());
+	_html.append(R"(</a>
 	</div>
-</div>)"_q;
+</div>)"_q);
 }
 
-QByteArray Parser::tag(
-		const QByteArray &name,
-		const QByteArray &body) {
-	return tag(name, {}, body);
-}
-
-QByteArray Parser::tag(
-		const QByteArray &name,
-		const Attributes &attributes,
-		const QByteArray &body) {
-	auto list = QByteArrayList();
-	list.reserve(attributes.size());
-	for (auto &[name, value] : attributes) {
-		list.push_back(' ' + name + (value ? "=\"" + *value + "\"" : ""));
-	}
-	const auto serialized = list.join(QByteArray());
-	return (IsVoidElement(name) && body.isEmpty())
-		? ('<' + name + serialized + " />")
-		: ('<' + name + serialized + '>' + body + "</" + name + '>');
-}
-
-QByteArray Parser::rich(const MTPRichText &text) {
-	return text.match([&](const MTPDtextEmpty &data) {
-		return QByteArray();
+void Parser::rich(const MTPRichText &text) {
+	text.match([&](const MTPDtextEmpty &data) {
 	}, [&](const MTPDtextPlain &data) {
-		struct Replacement {
-			QByteArray from;
-			QByteArray to;
-		};
-		const auto replacements = std::vector<Replacement>{
-			{ "\xE2\x81\xA6", "<span dir=\"ltr\">" },
-			{ "\xE2\x81\xA7", "<span dir=\"rtl\">" },
-			{ "\xE2\x81\xA8", "<span dir=\"auto\">" },
-			{ "\xE2\x81\xA9", "</span>" },
-		};
-		auto text = utf(data.vtext());
-		for (const auto &[from, to] : replacements) {
-			text.replace(from, to);
-		}
-		return text;
+		AppendPlain(_html, data.vtext().v);
 	}, [&](const MTPDtextConcat &data) {
-		const auto &list = data.vtexts().v;
-		auto result = QByteArrayList();
-		result.reserve(list.size());
-		for (const auto &item : list) {
-			result.append(rich(item));
+		for (const auto &item : data.vtexts().v) {
+			rich(item);
 		}
-		return result.join(QByteArray());
 	}, [&](const MTPDtextImage &data) {
 		const auto image = documentById(data.vdocument_id().v);
 		if (!image.id) {
-			return "Image not found."_q;
+			_html.append("Image not found.");
+			return;
 		}
 		auto attributes = Attributes{
 			{ "class", "pic" },
@@ -1046,62 +1220,71 @@ QByteArray Parser::rich(const MTPRichText &text) {
 		if (const auto height = data.vh().v) {
 			attributes.push_back({ "height", Number(height) });
 		}
-		return tag("img", attributes);
+		tag("img", attributes);
 	}, [&](const MTPDtextBold &data) {
-		return tag("b", rich(data.vtext()));
+		tag("b", [&] { rich(data.vtext()); });
 	}, [&](const MTPDtextItalic &data) {
-		return tag("i", rich(data.vtext()));
+		tag("i", [&] { rich(data.vtext()); });
 	}, [&](const MTPDtextUnderline &data) {
-		return tag("u", rich(data.vtext()));
+		tag("u", [&] { rich(data.vtext()); });
 	}, [&](const MTPDtextStrike &data) {
-		return tag("s", rich(data.vtext()));
+		tag("s", [&] { rich(data.vtext()); });
 	}, [&](const MTPDtextFixed &data) {
-		return tag("code", rich(data.vtext()));
+		tag("code", [&] { rich(data.vtext()); });
 	}, [&](const MTPDtextUrl &data) {
 		const auto webpageId = data.vwebpage_id().v;
 		const auto context = webpageId
 			? ("webpage" + Number(webpageId))
 			: QByteArray();
-		return tag("a", {
+		tag("a", {
 			{ "href", utf(data.vurl()) },
 			{ "class", webpageId ? "internal-iv-link" : "" },
 			{ "data-context", context },
-		}, rich(data.vtext()));
+		}, [&] {
+			rich(data.vtext());
+		});
 	}, [&](const MTPDtextEmail &data) {
-		return tag("a", {
+		tag("a", {
 			{ "href", "mailto:" + utf(data.vemail()) },
-		}, rich(data.vtext()));
+		}, [&] {
+			rich(data.vtext());
+		});
 	}, [&](const MTPDtextSubscript &data) {
-		return tag("sub", rich(data.vtext()));
+		tag("sub", [&] { rich(data.vtext()); });
 	}, [&](const MTPDtextSuperscript &data) {
-		return tag("sup", rich(data.vtext()));
+		tag("sup", [&] { rich(data.vtext()); });
 	}, [&](const MTPDtextMarked &data) {
-		return tag("mark", rich(data.vtext()));
+		tag("mark", [&] { rich(data.vtext()); });
 	}, [&](const MTPDtextPhone &data) {
-		return tag("a", {
+		tag("a", {
 			{ "href", "tel:" + utf(data.vphone()) },
-		}, rich(data.vtext()));
+		}, [&] {
+			rich(data.vtext());
+		});
 	}, [&](const MTPDtextAnchor &data) {
-		const auto inner = rich(data.vtext());
 		const auto name = utf(data.vname());
-		return inner.isEmpty()
-			? tag("a", { { "name", name } })
-			: tag(
-				"span",
-				{ { "class", "reference" } },
-				tag("a", { { "name", name } }) + inner);
+		const auto start = _html.size();
+		auto empty = false;
+		tag("span", { { "class", "reference" } }, [&] {
+			tag("a", { { "name", name } });
+			const auto inner = _html.size();
+			rich(data.vtext());
+			empty = (_html.size() == inner);
+		});
+		if (empty) {
+			_html.truncate(start);
+			tag("a", { { "name", name } });
+		}
 	});
 }
 
-QByteArray Parser::caption(const MTPPageCaption &caption) {
-	auto text = rich(caption.data().vtext());
-	const auto credit = rich(caption.data().vcredit());
-	if (!credit.isEmpty()) {
-		text += tag("cite", { { "dir", "auto" } }, credit);
-	} else if (text.isEmpty()) {
-		return QByteArray();
-	}
-	return tag("figcaption", { { "dir", "auto" } }, text);
+void Parser::caption(const MTPPageCaption &caption) {
+	tagIfNotEmpty("figcaption", { { "dir", "auto" } }, [&] {
+		rich(caption.data().vtext());
+		tagIfNotEmpty("cite", { { "dir", "auto" } }, [&] {
+			rich(caption.data().vcredit());
+		});
+	});
 }
 
 Photo Parser::parse(const MTPPhoto &photo) {
@@ -27,6 +27,14 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include <numeric>
 
+#if defined _M_X64 || defined __x86_64__
+#define TDESKTOP_AUDIO_USE_SSE2
+#include <emmintrin.h>
+#elif defined __aarch64__ || defined _M_ARM64
+#define TDESKTOP_AUDIO_USE_NEON
+#include <arm_neon.h>
+#endif // _M_X64 || __x86_64__ || __aarch64__ || _M_ARM64
+
 Q_DECLARE_METATYPE(AudioMsgId);
 Q_DECLARE_METATYPE(VoiceWaveform);
 
@@ -34,7 +42,6 @@ namespace {
 
 constexpr auto kSuppressRatioAll = 0.2;
 constexpr auto kSuppressRatioSong = 0.05;
-constexpr auto kWaveformCounterBufferSize = 256 * 1024;
 
 QMutex AudioMutex;
 ALCdevice *AudioDevice = nullptr;
@@ -227,6 +234,96 @@ bool SupportsSpeedControl() {
 	return result;
 }
 
+uint16 CountPeak(gsl::span<const uchar> samples) {
+	const auto data = samples.data();
+	const auto size = int(samples.size());
+	auto maximum = uchar(0x80);
+	auto minimum = uchar(0x80);
+	auto i = 0;
+#ifdef TDESKTOP_AUDIO_USE_SSE2
+	constexpr auto kStep = 16;
+	if (size >= kStep) {
+		auto max = _mm_set1_epi8(char(0x80));
+		auto min = max;
+		for (; i + kStep <= size; i += kStep) {
+			const auto values = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(data + i));
+			max = _mm_max_epu8(max, values);
+			min = _mm_min_epu8(min, values);
+		}
+		alignas(16) uchar maxs[kStep];
+		alignas(16) uchar mins[kStep];
+		_mm_store_si128(reinterpret_cast<__m128i*>(maxs), max);
+		_mm_store_si128(reinterpret_cast<__m128i*>(mins), min);
+		maximum = *std::max_element(maxs, maxs + kStep);
+		minimum = *std::min_element(mins, mins + kStep);
+	}
+#elif defined TDESKTOP_AUDIO_USE_NEON
+	constexpr auto kStep = 16;
+	if (size >= kStep) {
+		auto max = vdupq_n_u8(0x80);
+		auto min = max;
+		for (; i + kStep <= size; i += kStep) {
+			const auto values = vld1q_u8(data + i);
+			max = vmaxq_u8(max, values);
+			min = vminq_u8(min, values);
+		}
+		maximum = vmaxvq_u8(max);
+		minimum = vminvq_u8(min);
+	}
+#endif // TDESKTOP_AUDIO_USE_SSE2 || TDESKTOP_AUDIO_USE_NEON
+	for (; i != size; ++i) {
+		accumulate_max(maximum, data[i]);
+		accumulate_min(minimum, data[i]);
+	}
+	return std::max(ReadOneSample(maximum), ReadOneSample(minimum));
+}
+
+uint16 CountPeak(gsl::span<const int16> samples) {
+	const auto data = samples.data();
+	const auto size = int(samples.size());
+	auto maximum = int16(0);
+	auto minimum = int16(0);
+	auto i = 0;
+#ifdef TDESKTOP_AUDIO_USE_SSE2
+	constexpr auto kStep = 8;
+	if (size >= kStep) {
+		auto max = _mm_setzero_si128();
+		auto min = max;
+		for (; i + kStep <= size; i += kStep) {
+			const auto values = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(data + i));
+			max = _mm_max_epi16(max, values);
+			min = _mm_min_epi16(min, values);
+		}
+		alignas(16) int16 maxs[kStep];
+		alignas(16) int16 mins[kStep];
+		_mm_store_si128(reinterpret_cast<__m128i*>(maxs), max);
+		_mm_store_si128(reinterpret_cast<__m128i*>(mins), min);
+		maximum = *std::max_element(maxs, maxs + kStep);
+		minimum = *std::min_element(mins, mins + kStep);
+	}
+#elif defined TDESKTOP_AUDIO_USE_NEON
+	constexpr auto kStep = 8;
+	if (size >= kStep) {
+		auto max = vdupq_n_s16(0);
+		auto min = max;
+		for (; i + kStep <= size; i += kStep) {
+			const auto values = vld1q_s16(data + i);
+			max = vmaxq_s16(max, values);
+			min = vminq_s16(min, values);
+		}
+		maximum = vmaxvq_s16(max);
+		minimum = vminvq_s16(min);
+	}
+#endif // TDESKTOP_AUDIO_USE_SSE2 || TDESKTOP_AUDIO_USE_NEON
+	for (; i != size; ++i) {
+		accumulate_max(maximum, data[i]);
+		accumulate_min(minimum, data[i]);
+	}
+	return std::max(ReadOneSample(maximum), ReadOneSample(minimum));
+}
+
 } // namespace Audio
 
 namespace Player {
@@ -1542,8 +1639,6 @@ public:
 			return false;
 		}
 
-		QByteArray buffer;
-		buffer.reserve(kWaveformCounterBufferSize);
 		const auto samplesCount = samplesFrequency() * duration() / 1000;
 		int64 countbytes = sampleSize() * samplesCount;
 		int64 processed = 0;
@@ -1557,13 +1652,24 @@ public:
 
 		auto fmt = format();
 		auto peak = uint16(0);
-		auto callback = [&](uint16 sample) {
-			accumulate_max(peak, sample);
-			sumbytes += Media::Player::kWaveformSamplesCount;
-			if (sumbytes >= countbytes) {
-				sumbytes -= countbytes;
-				peaks.push_back(peak);
-				peak = 0;
+		const auto step = int64(Media::Player::kWaveformSamplesCount);
+		const auto countPeaks = [&](auto samples) {
+			while (!samples.empty()) {
+				// Each value adds a step, a peak is done on crossing countbytes.
+				const auto left = (countbytes - sumbytes + step - 1) / step;
+				const auto count = std::min(
+					int64(samples.size()),
+					std::max(left, int64(1)));
+				accumulate_max(
+					peak,
+					Media::Audio::CountPeak(samples.subspan(0, count)));
+				sumbytes += count * step;
+				if (sumbytes >= countbytes) {
+					sumbytes -= countbytes;
+					peaks.push_back(peak);
+					peak = 0;
+				}
+				samples = samples.subspan(count);
 			}
 		};
 		while (processed < countbytes) {
@@ -1579,9 +1685,13 @@ public:
 			const auto sampleBytes = v::get<bytes::const_span>(result);
 			Assert(!sampleBytes.empty());
 			if (fmt == AL_FORMAT_MONO8 || fmt == AL_FORMAT_STEREO8) {
-				Media::Audio::IterateSamples<uchar>(sampleBytes, callback);
+				countPeaks(gsl::make_span(
+					reinterpret_cast<const uchar*>(sampleBytes.data()),
+					sampleBytes.size()));
 			} else if (fmt == AL_FORMAT_MONO16 || fmt == AL_FORMAT_STEREO16) {
-				Media::Audio::IterateSamples<int16>(sampleBytes, callback);
+				countPeaks(gsl::make_span(
+					reinterpret_cast<const int16*>(sampleBytes.data()),
+					sampleBytes.size() / sizeof(int16)));
 			}
 			processed += sampleBytes.size();
 		}
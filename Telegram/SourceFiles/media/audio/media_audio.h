@@ -420,5 +420,9 @@ void IterateSamples(bytes::const_span bytes, Callback &&callback) {
 	}
 }
 
+// The largest ReadOneSample() value in the span.
+[[nodiscard]] uint16 CountPeak(gsl::span<const uchar> samples);
+[[nodiscard]] uint16 CountPeak(gsl::span<const int16> samples);
+
 } // namespace Audio
 } // namespace Media
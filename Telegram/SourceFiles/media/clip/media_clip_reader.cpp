@@ -22,6 +22,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include <QtCore/QThread>
 #include <QtCore/QFileInfo>
 
+#include <chrono>
+
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
@@ -33,9 +35,28 @@ namespace Media {
 namespace Clip {
 namespace {
 
-constexpr auto kClipThreadsCount = 8;
-constexpr auto kAverageGifSize = 320 * 240;
+constexpr auto kClipThreadsMax = 8;
 constexpr auto kWaitBeforeGifPause = crl::time(200);
+constexpr auto kLateFrameThreshold = crl::time(20);
+constexpr auto kDecodeAverageWeight = 8;
+
+// Share of a core a clip takes, in decode microseconds per second.
+constexpr auto kInitialLoadShare = 50'000;
+constexpr auto kMaxLoadShare = 1'000'000;
+
+[[nodiscard]] int ClipThreadsCount() {
+	static const auto result = std::clamp(
+		QThread::idealThreadCount(),
+		2,
+		kClipThreadsMax);
+	return result;
+}
+
+[[nodiscard]] int64 MicrosecondsNow() {
+	using namespace std::chrono;
+	return duration_cast<microseconds>(
+		steady_clock::now().time_since_epoch()).count();
+}
 
 QImage PrepareFrame(
 		const FrameRequest &request,
@@ -138,6 +159,8 @@ private:
 	void finish();
 	void callback(Reader *reader, Notification notification);
 	void clear();
+	void updateLoad(ReaderPrivate *reader, int share);
+	void sortByPriority(std::vector<ReaderPrivate*> &readers) const;
 
 	QAtomicInt _loadLevel;
 	using ReaderPointers = QMap<Reader*, QAtomicInt>;
@@ -203,7 +226,7 @@ Reader::Reader(const QByteArray &data, Callback &&callback)
 }
 
 void Reader::init(const Core::FileLocation &location, const QByteArray &data) {
-	if (Workers.size() < kClipThreadsCount) {
+	if (Workers.size() < ClipThreadsCount()) {
 		_threadIndex = Workers.size();
 		Workers.push_back(std::make_unique<Worker>());
 	} else {
@@ -544,6 +567,13 @@ public:
 	}
 
 	ProcessResult finishProcess(crl::time ms) {
+		const auto started = MicrosecondsNow();
+		const auto previousWhen = _nextFrameWhen;
+
+		// The first frame has no deadline to be late for.
+		const auto late = previousWhen
+			&& (ms > previousWhen + kLateFrameThreshold);
+
 		auto frameMs = _seekPositionMs + ms - _animationStarted;
 		auto readResult = _implementation->readFramesTill(frameMs, ms);
 		if (readResult == internal::ReaderImplementation::ReadResult::EndOfFile) {
@@ -564,9 +594,33 @@ public:
 		if (!renderFrame()) {
 			return error();
 		}
+		countDecode(
+			MicrosecondsNow() - started,
+			late,
+			previousWhen ? (_nextFrameWhen - previousWhen) : 0);
 		return ProcessResult::CopyFrame;
 	}
 
+	void countDecode(int64 microseconds, bool late, crl::time interval) {
+		const auto spent = int(std::min(
+			microseconds,
+			int64(std::numeric_limits<int>::max())));
+		_decodeAverage = _decodeFrames
+			? ((_decodeAverage * (kDecodeAverageWeight - 1) + spent)
+				/ kDecodeAverageWeight)
+			: spent;
+		_decodeMaximum = std::max(_decodeMaximum, spent);
+		++_decodeFrames;
+		if (late) {
+			++_decodeLateFrames;
+		}
+		if (interval > 0) {
+			_loadShare = int(std::min(
+				int64(_decodeAverage) * 1000 / interval,
+				int64(kMaxLoadShare)));
+		}
+	}
+
 	bool renderFrame() {
 		Expects(_request.valid());
 
@@ -640,6 +694,14 @@ public:
 	}
 
 	~ReaderPrivate() {
+		if (_decodeFrames > 0) {
+			DEBUG_LOG(("Clip Info: "
+				"%1 frames, decode average %2 us, maximum %3 us, %4 late."
+				).arg(_decodeFrames
+				).arg(_decodeAverage
+				).arg(_decodeMaximum
+				).arg(_decodeLateFrames));
+		}
 		stop();
 		_data.clear();
 	}
@@ -687,6 +749,13 @@ private:
 	bool _started = false;
 	crl::time _videoPausedAtMs = 0;
 
+	int _decodeAverage = 0;
+	int _decodeMaximum = 0;
+	int _decodeFrames = 0;
+	int _decodeLateFrames = 0;
+	int _loadShare = kInitialLoadShare;
+	int _loadShareCounted = kInitialLoadShare;
+
 	friend class Manager;
 
 };
@@ -703,7 +772,7 @@ Manager::Manager(not_null<QThread*> thread) {
 
 void Manager::append(Reader *reader, const Core::FileLocation &location, const QByteArray &data) {
 	reader->_private = new ReaderPrivate(reader, location, data);
-	_loadLevel.fetchAndAddRelaxed(kAverageGifSize);
+	_loadLevel.fetchAndAddRelaxed(reader->_private->_loadShareCounted);
 	update(reader);
 }
 
@@ -783,7 +852,6 @@ bool Manager::handleProcessResult(ReaderPrivate *reader, ProcessResult result, c
 	}
 
 	if (result == ProcessResult::Started) {
-		_loadLevel.fetchAndAddRelaxed(reader->_width * reader->_height - kAverageGifSize);
 		it.key()->_durationMs = reader->_durationMs;
 	}
 	// See if we need to pause GIF because it is not displayed right now.
@@ -795,6 +863,7 @@ bool Manager::handleProcessResult(ReaderPrivate *reader, ProcessResult result, c
 			if (reader->_frames[ishowing].when + kWaitBeforeGifPause < ms || (reader->_frames[iprevious].when && previous->displayed.loadAcquire() <= 0)) {
 				reader->_autoPausedGif = true;
 				it.key()->_autoPausedGif.storeRelease(1);
+				updateLoad(reader, 0);
 				result = ProcessResult::Paused;
 			}
 		}
@@ -809,6 +878,9 @@ bool Manager::handleProcessResult(ReaderPrivate *reader, ProcessResult result, c
 		frame->index = reader->frame()->index;
 		frame->displayed.storeRelease(0);
 		frame->positionMs = reader->frame()->positionMs;
+		if (result == ProcessResult::CopyFrame) {
+			updateLoad(reader, reader->_loadShare);
+		}
 		if (result == ProcessResult::Started) {
 			reader->startedAt(ms);
 			it.key()->moveToNextWrite();
@@ -826,7 +898,7 @@ bool Manager::handleProcessResult(ReaderPrivate *reader, ProcessResult result, c
 
 Manager::ResultHandleState Manager::handleResult(ReaderPrivate *reader, ProcessResult result, crl::time ms) {
 	if (!handleProcessResult(reader, result, ms)) {
-		_loadLevel.fetchAndAddRelaxed(-1 * (reader->_width > 0 ? reader->_width * reader->_height : kAverageGifSize));
+		updateLoad(reader, 0);
 		delete reader;
 		return ResultHandleRemove;
 	}
@@ -894,39 +966,48 @@ void Manager::process() {
 		checkAllReaders = (_readers.size() > _readerPointers.size());
 	}
 
+	auto due = std::vector<ReaderPrivate*>();
 	for (auto i = _readers.begin(), e = _readers.end(); i != e;) {
 		ReaderPrivate *reader = i.key();
 		if (i.value() <= ms) {
-			ResultHandleState state = handleResult(reader, reader->process(ms), ms);
-			if (state == ResultHandleRemove) {
-				i = _readers.erase(i);
-				continue;
-			} else if (state == ResultHandleStop) {
-				_processingInThread = nullptr;
-				return;
-			}
-			ms = crl::now();
-			if (reader->_videoPausedAtMs) {
-				i.value() = ms + 86400 * 1000ULL;
-			} else if (reader->_nextFrameWhen && reader->_started) {
-				i.value() = reader->_nextFrameWhen;
-			} else {
-				i.value() = (ms + 86400 * 1000ULL);
-			}
+			due.push_back(reader);
 		} else if (checkAllReaders) {
 			QMutexLocker lock(&_readerPointersMutex);
 			auto it = constUnsafeFindReaderPointer(reader);
 			if (it == _readerPointers.cend()) {
-				_loadLevel.fetchAndAddRelaxed(-1 * (reader->_width > 0 ? reader->_width * reader->_height : kAverageGifSize));
+				updateLoad(reader, 0);
 				delete reader;
 				i = _readers.erase(i);
 				continue;
 			}
 		}
-		if (!reader->_autoPausedGif && i.value() < minms) {
+		++i;
+	}
+	sortByPriority(due);
+
+	for (const auto reader : due) {
+		ResultHandleState state = handleResult(reader, reader->process(ms), ms);
+		if (state == ResultHandleRemove) {
+			_readers.remove(reader);
+			continue;
+		} else if (state == ResultHandleStop) {
+			_processingInThread = nullptr;
+			return;
+		}
+		ms = crl::now();
+		auto &when = _readers[reader];
+		if (reader->_videoPausedAtMs) {
+			when = ms + 86400 * 1000ULL;
+		} else if (reader->_nextFrameWhen && reader->_started) {
+			when = reader->_nextFrameWhen;
+		} else {
+			when = (ms + 86400 * 1000ULL);
+		}
+	}
+	for (auto i = _readers.cbegin(), e = _readers.cend(); i != e; ++i) {
+		if (!i.key()->_autoPausedGif && i.value() < minms) {
 			minms = i.value();
 		}
-		++i;
 	}
 
 	ms = crl::now();
@@ -940,6 +1021,37 @@ void Manager::process() {
 	_processingInThread = nullptr;
 }
 
+void Manager::updateLoad(ReaderPrivate *reader, int share) {
+	_loadLevel.fetchAndAddRelaxed(share - reader->_loadShareCounted);
+	reader->_loadShareCounted = share;
+}
+
+void Manager::sortByPriority(std::vector<ReaderPrivate*> &readers) const {
+	if (readers.size() < 2) {
+		return;
+	}
+
+	// Clips that are on screen go first, each group by its deadline.
+	auto keys = base::flat_map<ReaderPrivate*, std::pair<bool, crl::time>>();
+	{
+		QMutexLocker lock(&_readerPointersMutex);
+		for (const auto reader : readers) {
+			const auto it = constUnsafeFindReaderPointer(reader);
+			const auto frame = (it != _readerPointers.cend())
+				? it.key()->frameToShow()
+				: nullptr;
+			const auto hidden = !frame
+				|| (frame->displayed.loadAcquire() <= 0);
+			keys.emplace(
+				reader,
+				std::make_pair(hidden, _readers.value(reader)));
+		}
+	}
+	ranges::stable_sort(readers, std::less<>(), [&](ReaderPrivate *reader) {
+		return keys.find(reader)->second;
+	});
+}
+
 void Manager::finish() {
 	_timer.stop();
 	clear();
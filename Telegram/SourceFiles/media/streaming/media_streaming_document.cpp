@@ -202,8 +202,8 @@ bool Document::checkSwitchToHigherQuality() {
 		return false;
 	}
 	const auto size = _player.fileSize();
-	Assert(size >= 0 && size <= std::numeric_limits<uint32>::max());
-	auto to = QualityDescriptor{ .sizeInBytes = uint32(size) };
+	Assert(size >= 0);
+	auto to = QualityDescriptor{ .sizeInBytes = size };
 	const auto duration = _info.video.state.duration / 1000.;
 	const auto speed = _player.speed();
 	const auto multiplier = speed * kSwitchQualityUpSpeedMultiplier;
@@ -229,7 +229,7 @@ bool Document::checkSwitchToLowerQuality() {
 		return false;
 	}
 	const auto size = _player.fileSize();
-	Assert(size >= 0 && size <= std::numeric_limits<uint32>::max());
+	Assert(size >= 0);
 	auto to = QualityDescriptor();
 	for (const auto &descriptor : _otherQualities) {
 		if (descriptor.sizeInBytes < size
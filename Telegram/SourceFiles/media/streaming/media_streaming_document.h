@@ -20,7 +20,7 @@ class Instance;
 class Loader;
 
 struct QualityDescriptor {
-	uint32 sizeInBytes = 0;
+	int64 sizeInBytes = 0;
 	uint32 height = 0;
 };
 
@@ -32,6 +32,30 @@ constexpr auto kMaxQueuedPackets = 1024;
 		).split(QChar(',')).contains(u"webm");
 }
 
+[[nodiscard]] std::vector<KeyframeOffset> CollectKeyframes(
+		not_null<AVFormatContext*> format,
+		const Stream &stream) {
+	const auto info = format->streams[stream.index];
+	const auto count = avformat_index_get_entries_count(info);
+	auto result = std::vector<KeyframeOffset>();
+	result.reserve(count);
+	for (auto i = 0; i != count; ++i) {
+		const auto entry = avformat_index_get_entry(info, i);
+		if (entry
+			&& (entry->flags & AVINDEX_KEYFRAME)
+			&& (entry->pos >= 0)
+			&& (entry->timestamp != AV_NOPTS_VALUE)) {
+			result.push_back({
+				.position = FFmpeg::PtsToTime(
+					entry->timestamp,
+					stream.timeBase),
+				.offset = entry->pos,
+			});
+		}
+	}
+	return result;
+}
+
 } // namespace
 
 File::Context::Context(
@@ -316,10 +340,9 @@ void File::Context::start(StartOptions options) {
 		sendFullInCache(true);
 	}
 	if (options.seekable && (video.codec || audio.codec)) {
-		seekToPosition(
-			format.get(),
-			video.codec ? video : audio,
-			options.position);
+		const auto &main = video.codec ? video : audio;
+		_reader->setKeyframes(CollectKeyframes(format.get(), main));
+		seekToPosition(format.get(), main, options.position);
 	}
 	if (unroll()) {
 		return;
@@ -498,6 +521,10 @@ rpl::producer<SpeedEstimate> File::speedEstimate() const {
 	return _reader->speedEstimate();
 }
 
+void File::prefetchAt(crl::time position) {
+	_reader->prefetchAt(position);
+}
+
 File::~File() {
 	stop();
 }
@@ -45,6 +45,9 @@ public:
 	[[nodiscard]] int64 size() const;
 	[[nodiscard]] rpl::producer<SpeedEstimate> speedEstimate() const;
 
+	// Loads the start of the keyframe before a likely seek target.
+	void prefetchAt(crl::time position);
+
 	~File();
 
 private:
@@ -176,6 +176,12 @@ void Instance::setSpeed(float64 speed) {
 	_shared->player().setSpeed(speed);
 }
 
+void Instance::prefetchAt(crl::time position) {
+	Expects(_shared != nullptr);
+
+	_shared->player().prefetchAt(position);
+}
+
 bool Instance::waitingShown() const {
 	Expects(_shared != nullptr);
 
@@ -70,6 +70,9 @@ public:
 	[[nodiscard]] float64 speed() const;
 	void setSpeed(float64 speed);
 
+	// The user is likely to seek to this position soon.
+	void prefetchAt(crl::time position);
+
 	[[nodiscard]] bool waitingShown() const;
 	[[nodiscard]] float64 waitingOpacity() const;
 	[[nodiscard]] Ui::RadialState waitingState() const;
@@ -147,6 +147,12 @@ void Player::setLoaderPriority(int priority) {
 	_file->setLoaderPriority(priority);
 }
 
+void Player::prefetchAt(crl::time position) {
+	if (_options.seekable) {
+		_file->prefetchAt(position);
+	}
+}
+
 template <typename Track>
 void Player::trackReceivedTill(
 		const Track &track,
@@ -10,6 +10,17 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "media/streaming/media_streaming_common.h"
 #include "media/streaming/media_streaming_loader.h"
 #include "storage/cache/storage_cache_database.h"
+#include "mtproto/mtproto_auth_key.h"
+#include "base/random.h"
+
+#include <QtCore/QTemporaryFile>
+
+#ifdef Q_OS_WIN
+#include "base/platform/win/base_windows_h.h"
+
+#include <io.h>
+#include <winioctl.h>
+#endif // Q_OS_WIN
 
 namespace Media {
 namespace Streaming {
@@ -23,10 +34,17 @@ constexpr auto kMaxOnlyInHeader = 80 * kPartSize;
 constexpr auto kPartsOutsideFirstSliceGood = 8;
 constexpr auto kSlicesInMemory = 2;
 
-// 1 MB of parts are requested from cloud ahead of reading demand.
+// 1 MB of parts are requested from cloud ahead of reading demand,
+// up to 4 MB if that much can be downloaded in kPreloadAheadTime.
 constexpr auto kPreloadPartsAhead = 8;
+constexpr auto kPreloadPartsAheadMax = 32;
+constexpr auto kPreloadAheadTime = crl::time(1000);
 constexpr auto kDownloaderRequestsLimit = 4;
 
+// Parts requested around a likely seek target, starting at the keyframe.
+constexpr auto kPrefetchPartsMin = 2;
+constexpr auto kPrefetchPartsMax = 16;
+
 using PartsMap = base::flat_map<uint32, QByteArray>;
 
 struct ParsedCacheEntry {
@@ -34,7 +52,26 @@ struct ParsedCacheEntry {
 	std::optional<PartsMap> included;
 };
 
-bool IsContiguousSerialization(int serializedSize, int maxSliceSize) {
+void MarkSparse(QFile &file) {
+#ifdef Q_OS_WIN
+	// NTFS fills the skipped ranges with zeros unless told otherwise.
+	const auto handle = HANDLE(_get_osfhandle(file.handle()));
+	if (handle && handle != INVALID_HANDLE_VALUE) {
+		auto returned = DWORD();
+		DeviceIoControl(
+			handle,
+			FSCTL_SET_SPARSE,
+			nullptr,
+			0,
+			nullptr,
+			0,
+			&returned,
+			nullptr);
+	}
+#endif // Q_OS_WIN
+}
+
+bool IsContiguousSerialization(int serializedSize, int64 maxSliceSize) {
 	return !(serializedSize % kPartSize) || (serializedSize == maxSliceSize);
 }
 
@@ -55,25 +92,26 @@ bool ComputeIsGoodHeader(int64 size, const PartsMap &header) {
 	return (outsideFirstSlice <= kPartsOutsideFirstSliceGood);
 }
 
-int SlicesCount(uint32 size) {
+int SlicesCount(int64 size) {
 	const auto result = (size + kInSlice - 1) / kInSlice;
 
-	Ensures(result < 0x1FFU);
-	return result;
+	// Slice numbers are added to the cache key of the file.
+	Ensures(result < 0xFFFF);
+	return int(result);
 }
 
-int MaxSliceSize(int sliceNumber, uint32 size) {
+int64 MaxSliceSize(int sliceNumber, int64 size) {
 	return !sliceNumber
 		? size
 		: (sliceNumber == SlicesCount(size))
-		? (size - (sliceNumber - 1) * kInSlice)
-		: kInSlice;
+		? (size - (sliceNumber - 1) * int64(kInSlice))
+		: int64(kInSlice);
 }
 
 bytes::const_span ParseComplexCachedMap(
 		PartsMap &result,
 		bytes::const_span data,
-		int maxSize) {
+		int64 maxSize) {
 	const auto takeInt = [&]() -> std::optional<uint32> {
 		if (data.size() < sizeof(uint32)) {
 			return std::nullopt;
@@ -121,7 +159,7 @@ bytes::const_span ParseComplexCachedMap(
 bytes::const_span ParseCachedMap(
 		PartsMap &result,
 		bytes::const_span data,
-		int maxSize) {
+		int64 maxSize) {
 	const auto size = int(data.size());
 	if (IsContiguousSerialization(size, maxSize)) {
 		if (size > maxSize) {
@@ -197,10 +235,10 @@ void CopyLoaded(
 } // namespace
 
 template <int Size>
-bool Reader::StackIntVector<Size>::add(uint32 value) {
+bool Reader::StackIntVector<Size>::add(int64 value) {
 	using namespace rpl::mappers;
 
-	const auto i = ranges::find_if(_storage, _1 == uint32(-1));
+	const auto i = ranges::find_if(_storage, _1 == int64(-1));
 	if (i == end(_storage)) {
 		return false;
 	}
@@ -218,7 +256,7 @@ auto Reader::StackIntVector<Size>::values() const {
 
 	return ranges::views::all(
 		_storage
-	) | ranges::views::take_while(_1 != uint32(-1));
+	) | ranges::views::take_while(_1 != int64(-1));
 }
 
 struct Reader::CacheHelper {
@@ -270,13 +308,14 @@ void Reader::Slice::addPart(uint32 offset, QByteArray bytes) {
 
 auto Reader::Slice::prepareFill(
 		uint32 from,
-		uint32 till) -> PrepareFillResult {
+		uint32 till,
+		int preloadParts) -> PrepareFillResult {
 	auto result = PrepareFillResult();
 
 	result.ready = false;
 	const auto fromOffset = (from / kPartSize) * kPartSize;
 	const auto tillPart = (till + kPartSize - 1) / kPartSize;
-	const auto preloadTillOffset = (tillPart + kPreloadPartsAhead)
+	const auto preloadTillOffset = (tillPart + preloadParts)
 		* kPartSize;
 
 	const auto after = ranges::upper_bound(
@@ -340,8 +379,119 @@ auto Reader::Slice::offsetsFromLoader(uint32 from, uint32 till) const
 	return result;
 }
 
-Reader::Slices::Slices(uint32 size, bool useCache)
-: _size(size) {
+Reader::MappedSlices::MappedSlices(int64 size) : _size(size) {
+}
+
+Reader::MappedSlices::~MappedSlices() = default;
+
+bool Reader::MappedSlices::open() {
+	if (_file) {
+		return true;
+	} else if (_failed) {
+		return false;
+	}
+	auto file = std::make_unique<QTemporaryFile>();
+	if (!file->open()) {
+		_failed = true;
+		return false;
+	}
+	MarkSparse(*file);
+
+	// Slices are encrypted with a key that lives only in memory, so the
+	// file is useless to anyone else, even if left behind after a crash.
+	base::RandomFill(_key.data(), _key.size());
+	base::RandomFill(_nonce.data(), _nonce.size());
+	_file = std::move(file);
+	_stored.resize(SlicesCount(_size));
+	return true;
+}
+
+uchar *Reader::MappedSlices::map(int sliceIndex) {
+	Expects(_file != nullptr);
+
+	// The file grows only up to the slices that were really stored.
+	const auto offset = sliceIndex * int64(kInSlice);
+	const auto size = MaxSliceSize(sliceIndex + 1, _size);
+	if (_file->size() < offset + size && !_file->resize(offset + size)) {
+		return nullptr;
+	}
+
+	// Only one slice is mapped at a time to keep the address space small.
+	return _file->map(offset, size);
+}
+
+void Reader::MappedSlices::crypt(bytes::span data, int64 position) const {
+	Expects(!(position % MTP::CTRState::IvecSize));
+
+	// Counter is the nonce followed by the index of the first block.
+	auto state = MTP::CTRState();
+	bytes::copy(
+		bytes::make_span(state.ivec).subspan(0, _nonce.size()),
+		_nonce);
+	const auto block = uint64(position / MTP::CTRState::IvecSize);
+	for (auto i = 0; i != 8; ++i) {
+		state.ivec[MTP::CTRState::IvecSize - 1 - i] = uchar(block >> (8 * i));
+	}
+	MTP::aesCtrEncrypt(data, _key.data(), &state);
+}
+
+bool Reader::MappedSlices::contains(int sliceIndex) const {
+	return _unloaded.contains(sliceIndex);
+}
+
+void Reader::MappedSlices::store(int sliceIndex, const PartsMap &parts) {
+	if (parts.empty() || !open()) {
+		return;
+	}
+	const auto data = map(sliceIndex);
+	if (!data) {
+		return;
+	}
+	const auto guard = gsl::finally([&] { _file->unmap(data); });
+	auto &stored = _stored[sliceIndex];
+	for (const auto &[offset, part] : parts) {
+		auto &size = stored[offset];
+		if (size != part.size()) {
+			size = part.size();
+
+			// Plain data never reaches the mapped pages.
+			auto encrypted = part;
+			crypt(
+				bytes::make_detached_span(encrypted),
+				sliceIndex * int64(kInSlice) + offset);
+			memcpy(data + offset, encrypted.constData(), size);
+		}
+	}
+	_unloaded.emplace(sliceIndex);
+}
+
+Reader::PartsMap Reader::MappedSlices::take(int sliceIndex) {
+	Expects(contains(sliceIndex));
+
+	_unloaded.remove(sliceIndex);
+	const auto data = map(sliceIndex);
+	auto result = PartsMap();
+	if (!data) {
+		return result;
+	}
+	const auto guard = gsl::finally([&] { _file->unmap(data); });
+	const auto &stored = _stored[sliceIndex];
+	result.reserve(stored.size());
+	for (const auto &[offset, size] : stored) {
+		auto part = QByteArray(
+			reinterpret_cast<const char*>(data + offset),
+			size);
+		crypt(
+			bytes::make_detached_span(part),
+			sliceIndex * int64(kInSlice) + offset);
+		result.emplace(offset, std::move(part));
+	}
+	return result;
+}
+
+Reader::Slices::Slices(int64 size, bool useCache)
+: _mapped(size)
+, _size(size) {
 	Expects(size > 0);
 
 	if (useCache) {
@@ -419,7 +569,7 @@ void Reader::Slices::applyHeaderCacheData() {
 				break;
 			}
 			_data[index].addPart(
-				offset - index * kInSlice,
+				uint32(offset - index * int64(kInSlice)),
 				base::duplicate(part));
 		}
 	};
@@ -477,8 +627,8 @@ void Reader::Slices::processCachedSizes(const std::vector<int> &sizes) {
 	for (auto i = 0; i != count; ++i) {
 		const auto sliceNumber = (i + 1);
 		const auto sliceSize = (sliceNumber < _data.size())
-			? kInSlice
-			: (_size - (sliceNumber - 1) * kInSlice);
+			? int64(kInSlice)
+			: (_size - (sliceNumber - 1) * int64(kInSlice));
 		const auto loaded = (sizes[i] == sliceSize);
 
 		if (_data[i].flags & Flag::FullInCache) {
@@ -501,8 +651,8 @@ void Reader::Slices::checkSliceFullLoaded(int sliceNumber) {
 		}
 		return (sliceNumber < _data.size())
 			? kPartsInSlice
-			: ((_size - (sliceNumber - 1) * kInSlice + kPartSize - 1)
-				/ kPartSize);
+			: ((_size - (sliceNumber - 1) * int64(kInSlice) - 1)
+				/ kPartSize + 1);
 	}();
 	auto &slice = (sliceNumber ? _data[sliceNumber - 1] : _header);
 	const auto loaded = (slice.parts.size() == partsCount);
@@ -528,12 +678,12 @@ bool Reader::Slices::checkFullInCache() const {
 }
 
 void Reader::Slices::processPart(
-		uint32 offset,
+		int64 offset,
 		QByteArray &&bytes) {
 	Expects(isFullInHeader() || (offset / kInSlice < _data.size()));
 
 	if (isFullInHeader()) {
-		_header.addPart(offset, bytes);
+		_header.addPart(uint32(offset), bytes);
 		checkSliceFullLoaded(0);
 		return;
 	//} else if (_headerMode == HeaderMode::Unknown) {
@@ -543,12 +693,31 @@ void Reader::Slices::processPart(
 	//		_header.addPart(offset, bytes);
 	//	}
 	}
-	const auto index = offset / kInSlice;
-	_data[index].addPart(offset - index * kInSlice, std::move(bytes));
+	const auto index = int(offset / kInSlice);
+	_data[index].addPart(
+		uint32(offset - index * int64(kInSlice)),
+		std::move(bytes));
 	checkSliceFullLoaded(index + 1);
 }
 
-auto Reader::Slices::fill(uint32 offset, bytes::span buffer) -> FillResult {
+auto Reader::Slices::processPrefetchedPart(
+		int64 offset,
+		QByteArray &&bytes) -> SerializedSlice {
+	processPart(offset, std::move(bytes));
+	if (isFullInHeader()) {
+		return {};
+	}
+
+	// Nothing reads the prefetched slice until the seek, so it must be in
+	// the LRU _usedSlices to be unloaded if the seek never happens.
+	markSliceUsed(int(offset / kInSlice));
+	return serializeAndUnloadUnused();
+}
+
+auto Reader::Slices::fill(
+		int64 offset,
+		bytes::span buffer,
+		int preloadParts) -> FillResult {
 	Expects(!buffer.empty());
 	Expects(offset < _size);
 	Expects(offset + buffer.size() <= _size);
@@ -562,13 +731,13 @@ auto Reader::Slices::fill(uint32 offset, bytes::span buffer) -> FillResult {
 		Assert(waitingForHeaderCache());
 		return {};
 	} else if (isFullInHeader()) {
-		return fillFromHeader(offset, buffer);
+		return fillFromHeader(offset, buffer, preloadParts);
 	}
 
 	auto result = FillResult();
-	const auto till = uint32(offset + buffer.size());
-	const auto fromSlice = offset / kInSlice;
-	const auto tillSlice = (till + kInSlice - 1) / kInSlice;
+	const auto till = int64(offset + buffer.size());
+	const auto fromSlice = int(offset / kInSlice);
+	const auto tillSlice = int((till + kInSlice - 1) / kInSlice);
 	Assert((fromSlice + 1 == tillSlice || fromSlice + 2 == tillSlice)
 		&& tillSlice <= _data.size());
 
@@ -584,7 +753,7 @@ auto Reader::Slices::fill(uint32 offset, bytes::span buffer) -> FillResult {
 			return;
 		}
 		for (const auto offset : prepared.offsetsFromLoader.values()) {
-			const auto full = offset + sliceIndex * kInSlice;
+			const auto full = offset + sliceIndex * int64(kInSlice);
 			if (offset < kInSlice && full < _size) {
 				result.offsetsFromLoader.add(full);
 			}
@@ -602,23 +771,44 @@ auto Reader::Slices::fill(uint32 offset, bytes::span buffer) -> FillResult {
 	const auto addToHeader = [&](int slice, auto parts) {
 		if (_headerMode == HeaderMode::Unknown) {
 			for (const auto &part : parts) {
-				const auto totalOffset = slice * kInSlice + part.first;
-				if (!_header.parts.contains(totalOffset)
+				const auto full = slice * int64(kInSlice) + part.first;
+				const auto totalOffset = uint32(full);
+				if (full != totalOffset) {
+					// Header parts are cached with 32 bit offsets.
+					break;
+				} else if (!_header.parts.contains(totalOffset)
 					&& _header.parts.size() < kMaxPartsInHeader) {
 					_header.addPart(totalOffset, part.second);
 				}
 			}
 		}
 	};
-	const auto firstFrom = offset - fromSlice * kInSlice;
-	const auto firstTill = std::min(kInSlice, till - fromSlice * kInSlice);
-	const auto secondFrom = 0;
-	const auto secondTill = (till > (fromSlice + 1) * kInSlice)
-		? (till - (fromSlice + 1) * kInSlice)
-		: 0;
-	const auto first = _data[fromSlice].prepareFill(firstFrom, firstTill);
+	const auto restore = [&](int sliceIndex) {
+		if (_mapped.contains(sliceIndex)) {
+			restoreFromMapped(sliceIndex);
+		}
+	};
+	restore(fromSlice);
+	if (fromSlice + 1 < tillSlice) {
+		restore(fromSlice + 1);
+	}
+	const auto fromSliceStart = fromSlice * int64(kInSlice);
+	const auto firstFrom = uint32(offset - fromSliceStart);
+	const auto firstTill = uint32(
+		std::min(int64(kInSlice), till - fromSliceStart));
+	const auto secondFrom = uint32(0);
+	const auto secondTill = (till > fromSliceStart + kInSlice)
+		? uint32(till - fromSliceStart - kInSlice)
+		: uint32(0);
+	const auto first = _data[fromSlice].prepareFill(
+		firstFrom,
+		firstTill,
+		preloadParts);
 	const auto second = (fromSlice + 1 < tillSlice)
-		? _data[fromSlice + 1].prepareFill(secondFrom, secondTill)
+		? _data[fromSlice + 1].prepareFill(
+			secondFrom,
+			secondTill,
+			preloadParts)
 		: Slice::PrepareFillResult();
 	handlePrepareResult(fromSlice, first);
 	if (fromSlice + 1 < tillSlice) {
@@ -650,13 +840,15 @@ auto Reader::Slices::fill(uint32 offset, bytes::span buffer) -> FillResult {
 	return result;
 }
 
-auto Reader::Slices::fillFromHeader(uint32 offset, bytes::span buffer)
--> FillResult {
+auto Reader::Slices::fillFromHeader(
+		int64 offset,
+		bytes::span buffer,
+		int preloadParts) -> FillResult {
 	auto result = FillResult();
-	const auto from = offset;
+	const auto from = uint32(offset);
 	const auto till = uint32(offset + buffer.size());
 
-	const auto prepared = _header.prepareFill(from, till);
+	const auto prepared = _header.prepareFill(from, till, preloadParts);
 	for (const auto full : prepared.offsetsFromLoader.values()) {
 		if (full < _size) {
 			result.offsetsFromLoader.add(full);
@@ -673,17 +865,20 @@ auto Reader::Slices::fillFromHeader(uint32 offset, bytes::span buffer)
 	return result;
 }
 
-QByteArray Reader::Slices::partForDownloader(uint32 offset) const {
+QByteArray Reader::Slices::partForDownloader(int64 offset) const {
 	Expects(offset < _size);
 
-	if (const auto i = _header.parts.find(offset); i != end(_header.parts)) {
-		return i->second;
+	const auto inHeader = (offset <= std::numeric_limits<uint32>::max())
+		? _header.parts.find(uint32(offset))
+		: end(_header.parts);
+	if (inHeader != end(_header.parts)) {
+		return inHeader->second;
 	} else if (isFullInHeader()) {
 		return QByteArray();
 	}
-	const auto index = offset / kInSlice;
+	const auto index = int(offset / kInSlice);
 	const auto &slice = _data[index];
-	const auto i = slice.parts.find(offset - index * kInSlice);
+	const auto i = slice.parts.find(uint32(offset - index * int64(kInSlice)));
 	return (i != end(slice.parts)) ? i->second : QByteArray();
 }
 
@@ -691,14 +886,14 @@ bool Reader::Slices::waitingForHeaderCache() const {
 	return (_header.flags & Slice::Flag::LoadingFromCache);
 }
 
-bool Reader::Slices::readCacheForDownloaderRequired(uint32 offset) {
+bool Reader::Slices::readCacheForDownloaderRequired(int64 offset) {
 	Expects(offset < _size);
 	Expects(!waitingForHeaderCache());
 
 	if (isFullInHeader()) {
 		return false;
 	}
-	const auto index = offset / kInSlice;
+	const auto index = int(offset / kInSlice);
 	auto &slice = _data[index];
 	return !(slice.flags & Slice::Flag::LoadedFromCache);
 }
@@ -716,7 +911,28 @@ void Reader::Slices::markSliceUsed(int sliceIndex) {
 	}
 }
 
-int Reader::Slices::maxSliceSize(int sliceNumber) const {
+void Reader::Slices::restoreFromMapped(int sliceIndex) {
+	using Flag = Slice::Flag;
+
+	auto &slice = _data[sliceIndex];
+	if (slice.flags & (Flag::LoadingFromCache | Flag::LoadedFromCache)) {
+		return;
+	}
+	const auto changed = !slice.parts.empty();
+	for (auto &[offset, bytes] : _mapped.take(sliceIndex)) {
+		slice.parts.emplace(offset, std::move(bytes));
+	}
+
+	// Whatever was stored in the mapped file is in the cache already,
+	// parts received while the slice was unloaded are not.
+	slice.flags |= Flag::LoadedFromCache;
+	if (changed && _headerMode != HeaderMode::NoCache) {
+		slice.flags |= Flag::ChangedSinceCache;
+	}
+	checkSliceFullLoaded(sliceIndex + 1);
+}
+
+int64 Reader::Slices::maxSliceSize(int sliceNumber) const {
 	return MaxSliceSize(sliceNumber, _size);
 }
 
@@ -733,6 +949,7 @@ Reader::SerializedSlice Reader::Slices::serializeAndUnloadUnused() {
 		// If the only data in this slice was from _header, just leave it.
 		return {};
 	}
+	_mapped.store(purgeSlice, _data[purgeSlice].parts);
 	const auto noNeedToSaveToCache = [&] {
 		if (_headerMode == HeaderMode::NoCache) {
 			// Cache is not used.
@@ -870,13 +1087,85 @@ Reader::Reader(
 		}
 	}, _lifetime);
 
+	applySpeedEstimate({});
+	_loader->speedEstimate(
+	) | rpl::start_with_next([=](SpeedEstimate estimate) {
+		applySpeedEstimate(estimate);
+	}, _lifetime);
+
 	if (_cacheHelper) {
 		readFromCache(0);
 	}
 }
 
+void Reader::applySpeedEstimate(SpeedEstimate estimate) {
+	const auto parts = (estimate.unreliable || !estimate.bytesPerSecond)
+		? kPreloadPartsAhead
+		: int(std::clamp(
+			(estimate.bytesPerSecond * kPreloadAheadTime)
+				/ (crl::time(1000) * kPartSize),
+			int64(kPreloadPartsAhead),
+			int64(kPreloadPartsAheadMax)));
+	_preloadParts.store(parts, std::memory_order_relaxed);
+}
+
+void Reader::setKeyframes(std::vector<KeyframeOffset> keyframes) {
+	QMutexLocker lock(&_prefetchMutex);
+	_keyframes = std::move(keyframes);
+}
+
+void Reader::prefetchAt(crl::time position) {
+	QMutexLocker lock(&_prefetchMutex);
+	const auto after = ranges::upper_bound(
+		_keyframes,
+		position,
+		ranges::less(),
+		&KeyframeOffset::position);
+	if (after == begin(_keyframes)) {
+		return;
+	}
+	const auto from = ((after - 1)->offset / kPartSize) * kPartSize;
+	const auto till = std::clamp(
+		(after != end(_keyframes)) ? after->offset : size(),
+		from + kPrefetchPartsMin * kPartSize,
+		from + kPrefetchPartsMax * kPartSize);
+	_prefetchRequest = std::make_pair(from, std::min(till, size()));
+	lock.unlock();
+
+	wakeFromSleep();
+}
+
+void Reader::processPrefetchRequest() {
+	QMutexLocker lock(&_prefetchMutex);
+	const auto request = base::take(_prefetchRequest);
+	lock.unlock();
+
+	if (!request || _slices.waitingForHeaderCache()) {
+		return;
+	}
+	const auto [from, till] = *request;
+	for (const auto offset : base::take(_prefetchOffsets)) {
+		if ((offset < from || offset >= till)
+			&& _loadingOffsets.remove(offset)
+			&& !_downloaderOffsetsRequested.contains(offset)) {
+			_loader->cancel(offset);
+		}
+	}
+	for (auto offset = from; offset < till; offset += kPartSize) {
+		if (!_slices.partForDownloader(offset).isEmpty()
+			|| (_cacheHelper
+				&& _slices.readCacheForDownloaderRequired(offset))) {
+			// Either we have it or it will be read from the local cache.
+			continue;
+		}
+		_prefetchOffsets.emplace(offset);
+		loadAtOffset(offset);
+	}
+}
+
 void Reader::startSleep(not_null<crl::semaphore*> wake) {
 	_sleeping.store(wake, std::memory_order_release);
+	processPrefetchRequest();
 	processDownloaderRequests();
 }
 
@@ -922,6 +1211,7 @@ void Reader::stopStreaming(bool stillActive) {
 		_streamingActive = false;
 		refreshLoaderPriority();
 		_loadingOffsets.clear();
+		_prefetchOffsets.clear();
 		processDownloaderRequests();
 	}
 }
@@ -933,7 +1223,7 @@ rpl::producer<LoadedPart> Reader::partsForDownloader() const {
 void Reader::loadForDownloader(
 		not_null<Storage::StreamedFileDownloader*> downloader,
 		int64 offset) {
-	Expects(offset >= 0 && offset <= std::numeric_limits<uint32>::max());
+	Expects(offset >= 0 && offset < size());
 
 	if (_attachedDownloader != downloader) {
 		if (_attachedDownloader) {
@@ -942,13 +1232,13 @@ void Reader::loadForDownloader(
 		_attachedDownloader = downloader;
 		_loader->attachDownloader(downloader);
 	}
-	_downloaderOffsetRequests.emplace(uint32(offset));
+	_downloaderOffsetRequests.emplace(offset);
 	// Will be processed in continueDownloaderFromMainThread()
 	// from StreamedFileDownloader::requestParts().
 }
 
 void Reader::doneForDownloader(int64 offset) {
-	Expects(offset >= 0 && offset <= std::numeric_limits<uint32>::max());
+	Expects(offset >= 0 && offset < size());
 
 	_downloaderOffsetAcks.emplace(offset);
 	// Will be processed in continueDownloaderFromMainThread()
@@ -989,7 +1279,7 @@ void Reader::checkForDownloaderChange(int checkItemsCount) {
 	const auto changed = std::adjacent_find(
 		end - checkItemsCount,
 		end,
-		[](uint32 first, uint32 second) { return (second <= first); });
+		[](int64 first, int64 second) { return (second <= first); });
 	if (changed != end) {
 		_offsetsForDownloader.erase(
 			begin(_offsetsForDownloader),
@@ -1002,29 +1292,30 @@ void Reader::checkForDownloaderChange(int checkItemsCount) {
 void Reader::checkForDownloaderReadyOffsets() {
 	// If a requested part is available right now we simply fire it on the
 	// main thread, until the first not-available-right-now offset is found.
-	const auto unavailableInBytes = [&](uint32 offset, QByteArray &&bytes) {
+	const auto unavailableInBytes = [&](int64 offset, QByteArray &&bytes) {
 		if (bytes.isEmpty()) {
 			return true;
 		}
 		crl::on_main(this, [=, bytes = std::move(bytes)]() mutable {
-			_partsForDownloader.fire({ int64(offset), std::move(bytes) });
+			_partsForDownloader.fire({ offset, std::move(bytes) });
 		});
 		return false;
 	};
-	const auto unavailableInCache = [&](uint32 offset) {
-		const auto index = (offset / kInSlice);
-		const auto sliceNumber = index + 1;
+	const auto unavailableInCache = [&](int64 offset) {
+		const auto index = int(offset / kInSlice);
+		const auto sliceNumber = uint32(index + 1);
 		const auto i = _downloaderReadCache.find(sliceNumber);
 		if (i == end(_downloaderReadCache) || !i->second) {
 			return true;
 		}
-		const auto j = i->second->find(offset - index * kInSlice);
+		const auto j = i->second->find(
+			uint32(offset - index * int64(kInSlice)));
 		if (j == end(*i->second)) {
 			return true;
 		}
 		return unavailableInBytes(offset, std::move(j->second));
 	};
-	const auto unavailable = [&](uint32 offset) {
+	const auto unavailable = [&](int64 offset) {
 		return unavailableInBytes(offset, _slices.partForDownloader(offset))
 			&& unavailableInCache(offset);
 	};
@@ -1044,8 +1335,8 @@ void Reader::processDownloaderRequests() {
 	}
 }
 
-void Reader::pruneDownloaderCache(uint32 minimalOffset) {
-	const auto minimalSliceNumber = (minimalOffset / kInSlice) + 1;
+void Reader::pruneDownloaderCache(int64 minimalOffset) {
+	const auto minimalSliceNumber = uint32(minimalOffset / kInSlice) + 1;
 	const auto removeTill = ranges::lower_bound(
 		_downloaderReadCache,
 		minimalSliceNumber,
@@ -1076,14 +1367,14 @@ void Reader::sendDownloaderRequests() {
 	}
 }
 
-bool Reader::downloaderWaitForCachedSlice(uint32 offset) {
+bool Reader::downloaderWaitForCachedSlice(int64 offset) {
 	if (_slices.waitingForHeaderCache()) {
 		return true;
 	}
 	if (!_slices.readCacheForDownloaderRequired(offset)) {
 		return false;
 	}
-	const auto sliceNumber = (offset / kInSlice) + 1;
+	const auto sliceNumber = int(offset / kInSlice) + 1;
 	auto i = _downloaderReadCache.find(sliceNumber);
 	if (i == _downloaderReadCache.end()) {
 		// If we didn't request that slice yet, try requesting it.
@@ -1208,6 +1499,21 @@ void Reader::putToCache(SerializedSlice &&slice) {
 	_cache->put(_cacheHelper->key(slice.number), std::move(slice.data));
 }
 
+void Reader::putUnloadedToCache(SerializedSlice &&slice) {
+	if (!_cacheHelper || slice.number < 0) {
+		return;
+	}
+	// If we put to cache the header (number == 0) that means we're in
+	// HeaderMode::Good and really are putting the first slice to cache.
+	Assert(slice.number > 0 || _slices.isGoodHeader());
+
+	const auto index = std::max(slice.number, 1) - 1;
+	cancelLoadInRange(
+		index * int64(kInSlice),
+		(index + 1) * int64(kInSlice));
+	putToCache(std::move(slice));
+}
+
 int64 Reader::size() const {
 	return _loader->size();
 }
@@ -1232,8 +1538,7 @@ Reader::FillState Reader::fill(
 		int64 offset,
 		bytes::span buffer,
 		not_null<crl::semaphore*> notify) {
-	Expects(offset + buffer.size() <= size());
-	Expects(offset >= 0 && size() <= std::numeric_limits<uint32>::max());
+	Expects(offset >= 0 && offset + buffer.size() <= size());
 
 	const auto startWaiting = [&] {
 		if (_cacheHelper) {
@@ -1264,7 +1569,7 @@ Reader::FillState Reader::fill(
 
 	auto lastResult = FillState();
 	do {
-		lastResult = fillFromSlices(uint32(offset), buffer);
+		lastResult = fillFromSlices(offset, buffer);
 		if (lastResult == FillState::Success) {
 			return done();
 		}
@@ -1274,10 +1579,13 @@ Reader::FillState Reader::fill(
 	return _streamingError ? failed() : lastResult;
 }
 
-Reader::FillState Reader::fillFromSlices(uint32 offset, bytes::span buffer) {
+Reader::FillState Reader::fillFromSlices(int64 offset, bytes::span buffer) {
 	using namespace rpl::mappers;
 
-	auto result = _slices.fill(offset, buffer);
+	auto result = _slices.fill(
+		offset,
+		buffer,
+		_preloadParts.load(std::memory_order_relaxed));
 	if (result.state != FillState::Success && _slices.headerWontBeFilled()) {
 		_streamingError = Error::NotStreamable;
 		return FillState::Failed;
@@ -1287,15 +1595,7 @@ Reader::FillState Reader::fillFromSlices(uint32 offset, bytes::span buffer) {
 		readFromCache(sliceNumber);
 	}
 
-	if (_cacheHelper && result.toCache.number >= 0) {
-		// If we put to cache the header (number == 0) that means we're in
-		// HeaderMode::Good and really are putting the first slice to cache.
-		Assert(result.toCache.number > 0 || _slices.isGoodHeader());
-
-		const auto index = std::max(result.toCache.number, 1) - 1;
-		cancelLoadInRange(index * kInSlice, (index + 1) * kInSlice);
-		putToCache(std::move(result.toCache));
-	}
+	putUnloadedToCache(std::move(result.toCache));
 	auto checkPriority = true;
 	for (const auto offset : result.offsetsFromLoader.values()) {
 		if (checkPriority) {
@@ -1307,7 +1607,7 @@ Reader::FillState Reader::fillFromSlices(uint32 offset, bytes::span buffer) {
 	return result.state;
 }
 
-void Reader::cancelLoadInRange(uint32 from, uint32 till) {
+void Reader::cancelLoadInRange(int64 from, int64 till) {
 	Expects(from < till);
 
 	for (const auto offset : _loadingOffsets.takeInRange(from, till)) {
@@ -1317,7 +1617,7 @@ void Reader::cancelLoadInRange(uint32 from, uint32 till) {
 	}
 }
 
-void Reader::checkLoadWillBeFirst(uint32 offset) {
+void Reader::checkLoadWillBeFirst(int64 offset) {
 	if (_loadingOffsets.front().value_or(offset) != offset) {
 		_loadingOffsets.resetPriorities();
 		_loader->resetPriorities();
@@ -1373,6 +1673,11 @@ bool Reader::processLoadedParts() {
 			return false;
 		} else if (!_loadingOffsets.remove(part.offset)) {
 			continue;
+		} else if (_prefetchOffsets.remove(part.offset)) {
+			putUnloadedToCache(_slices.processPrefetchedPart(
+				part.offset,
+				std::move(part.bytes)));
+			continue;
 		}
 		_slices.processPart(
 			part.offset,
@@ -1384,10 +1689,11 @@ bool Reader::processLoadedParts() {
 bool Reader::checkForSomethingMoreReceived() {
 	const auto result1 = processCacheResults();
 	const auto result2 = processLoadedParts();
+	processPrefetchRequest();
 	return result1 || result2;
 }
 
-void Reader::loadAtOffset(uint32 offset) {
+void Reader::loadAtOffset(int64 offset) {
 	if (_loadingOffsets.add(offset)) {
 		_loader->load(offset);
 	}
@@ -13,6 +13,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "base/weak_ptr.h"
 #include "base/thread_safe_wrap.h"
 
+class QTemporaryFile;
+
 namespace Storage {
 class StreamedFileDownloader;
 } // namespace Storage
@@ -31,6 +33,11 @@ class Loader;
 struct LoadedPart;
 enum class Error;
 
+struct KeyframeOffset {
+	crl::time position = 0;
+	int64 offset = 0;
+};
+
 class Reader final : public base::has_weak_ptr {
 public:
 	enum class FillState : uchar {
@@ -61,7 +68,11 @@ public:
 	[[nodiscard]] int headerSize() const;
 	[[nodiscard]] bool fullInCache() const;
 
+	// Keyframes of the main stream from the container index.
+	void setKeyframes(std::vector<KeyframeOffset> keyframes);
+
 	// Thread safe.
+	void prefetchAt(crl::time position);
 	void startSleep(not_null<crl::semaphore*> wake);
 	void wakeFromSleep();
 	void stopSleep();
@@ -88,18 +99,18 @@ private:
 
 	struct CacheHelper;
 
-	// FileSize: Right now any file size fits 32 bit.
-
+	// Offsets inside of a slice and inside of the header fit 32 bit,
+	// so the cache format stays the same, absolute offsets are 64 bit.
 	using PartsMap = base::flat_map<uint32, QByteArray>;
 
 	template <int Size>
 	class StackIntVector {
 	public:
-		bool add(uint32 value);
+		bool add(int64 value);
 		auto values() const;
 
 	private:
-		std::array<uint32, Size> _storage = { uint32(-1) };
+		std::array<int64, Size> _storage = { int64(-1) };
 
 	};
 
@@ -134,7 +145,10 @@ private:
 
 		void processCacheData(PartsMap &&data);
 		void addPart(uint32 offset, QByteArray bytes);
-		PrepareFillResult prepareFill(uint32 from, uint32 till);
+		PrepareFillResult prepareFill(
+			uint32 from,
+			uint32 till,
+			int preloadParts);
 
 		// Get up to kLoadFromRemoteMax not loaded parts in from-till range.
 		StackIntVector<kLoadFromRemoteMax> offsetsFromLoader(
@@ -146,9 +160,38 @@ private:
 
 	};
 
+	// Slices unloaded from memory are kept in a sparse temporary file,
+	// so seeking back does not read and decrypt them from the cache
+	// or download them again.
+	class MappedSlices {
+	public:
+		explicit MappedSlices(int64 size);
+		MappedSlices(const MappedSlices &other) = delete;
+		MappedSlices &operator=(const MappedSlices &other) = delete;
+		~MappedSlices();
+
+		[[nodiscard]] bool contains(int sliceIndex) const;
+		void store(int sliceIndex, const PartsMap &parts);
+		[[nodiscard]] PartsMap take(int sliceIndex);
+
+	private:
+		[[nodiscard]] bool open();
+		[[nodiscard]] uchar *map(int sliceIndex);
+		void crypt(bytes::span data, int64 position) const;
+
+		const int64 _size = 0;
+		std::unique_ptr<QTemporaryFile> _file;
+		std::array<bytes::type, 32> _key = {};
+		std::array<bytes::type, 8> _nonce = {};
+		std::vector<base::flat_map<uint32, int>> _stored;
+		base::flat_set<int> _unloaded;
+		bool _failed = false;
+
+	};
+
 	class Slices {
 	public:
-		Slices(uint32 size, bool useCache);
+		Slices(int64 size, bool useCache);
 
 		void headerDone(bool fromCache);
 		[[nodiscard]] int headerSize() const;
@@ -163,13 +206,19 @@ private:
 
 		void processCacheResult(int sliceNumber, PartsMap &&result);
 		void processCachedSizes(const std::vector<int> &sizes);
-		void processPart(uint32 offset, QByteArray &&bytes);
-
-		[[nodiscard]] FillResult fill(uint32 offset, bytes::span buffer);
+		void processPart(int64 offset, QByteArray &&bytes);
+		[[nodiscard]] SerializedSlice processPrefetchedPart(
+			int64 offset,
+			QByteArray &&bytes);
+
+		[[nodiscard]] FillResult fill(
+			int64 offset,
+			bytes::span buffer,
+			int preloadParts);
 		[[nodiscard]] SerializedSlice unloadToCache();
 
-		[[nodiscard]] QByteArray partForDownloader(uint32 offset) const;
-		[[nodiscard]] bool readCacheForDownloaderRequired(uint32 offset);
+		[[nodiscard]] QByteArray partForDownloader(int64 offset) const;
+		[[nodiscard]] bool readCacheForDownloaderRequired(int64 offset);
 
 	private:
 		enum class HeaderMode {
@@ -181,7 +230,7 @@ private:
 		};
 
 		void applyHeaderCacheData();
-		[[nodiscard]] int maxSliceSize(int sliceNumber) const;
+		[[nodiscard]] int64 maxSliceSize(int sliceNumber) const;
 		[[nodiscard]] SerializedSlice serializeAndUnloadSlice(
 			int sliceNumber);
 		[[nodiscard]] SerializedSlice serializeAndUnloadUnused();
@@ -189,18 +238,21 @@ private:
 			const Slice &slice) const;
 		[[nodiscard]] QByteArray serializeAndUnloadFirstSliceNoHeader();
 		void markSliceUsed(int sliceIndex);
+		void restoreFromMapped(int sliceIndex);
 		[[nodiscard]] bool computeIsGoodHeader() const;
 		[[nodiscard]] FillResult fillFromHeader(
-			uint32 offset,
-			bytes::span buffer);
+			int64 offset,
+			bytes::span buffer,
+			int preloadParts);
 		void unloadSlice(Slice &slice) const;
 		void checkSliceFullLoaded(int sliceNumber);
 		[[nodiscard]] bool checkFullInCache() const;
 
+		MappedSlices _mapped;
 		std::vector<Slice> _data;
 		Slice _header;
 		std::deque<int> _usedSlices;
-		uint32 _size = 0;
+		int64 _size = 0;
 		HeaderMode _headerMode = HeaderMode::Unknown;
 		bool _fullInCache = false;
 
@@ -212,29 +264,32 @@ private:
 	[[nodiscard]] bool readFromCacheForDownloader(int sliceNumber);
 	bool processCacheResults();
 	void putToCache(SerializedSlice &&data);
+	void putUnloadedToCache(SerializedSlice &&slice);
 
-	void cancelLoadInRange(uint32 from, uint32 till);
-	void loadAtOffset(uint32 offset);
-	void checkLoadWillBeFirst(uint32 offset);
+	void cancelLoadInRange(int64 from, int64 till);
+	void loadAtOffset(int64 offset);
+	void checkLoadWillBeFirst(int64 offset);
 	bool processLoadedParts();
 
 	bool checkForSomethingMoreReceived();
+	void processPrefetchRequest();
 
-	FillState fillFromSlices(uint32 offset, bytes::span buffer);
+	FillState fillFromSlices(int64 offset, bytes::span buffer);
 
 	void finalizeCache();
 
 	void processDownloaderRequests();
 	void checkCacheResultsForDownloader();
-	void pruneDownloaderCache(uint32 minimalOffset);
+	void pruneDownloaderCache(int64 minimalOffset);
 	void pruneDoneDownloaderRequests();
 	void sendDownloaderRequests();
-	[[nodiscard]] bool downloaderWaitForCachedSlice(uint32 offset);
+	[[nodiscard]] bool downloaderWaitForCachedSlice(int64 offset);
 	void enqueueDownloaderOffsets();
 	void checkForDownloaderChange(int checkItemsCount);
 	void checkForDownloaderReadyOffsets();
 
 	void refreshLoaderPriority();
+	void applySpeedEstimate(SpeedEstimate estimate);
 
 	static std::shared_ptr<CacheHelper> InitCacheHelper(
 		Storage::Cache::Key baseKey);
@@ -249,8 +304,17 @@ private:
 	std::atomic<crl::semaphore*> _waiting = nullptr;
 	std::atomic<crl::semaphore*> _sleeping = nullptr;
 	std::atomic<bool> _stopStreamingAsync = false;
+	std::atomic<int> _preloadParts = 0;
 	PriorityQueue _loadingOffsets;
 
+	// Seek targets come from the main thread, keyframes from streaming.
+	QMutex _prefetchMutex;
+	std::vector<KeyframeOffset> _keyframes;
+	std::optional<std::pair<int64, int64>> _prefetchRequest;
+
+	// Streaming thread.
+	base::flat_set<int64> _prefetchOffsets;
+
 	Slices _slices;
 
 	// Even if streaming had failed, the Reader can work for the downloader.
@@ -266,14 +330,14 @@ private:
 	bool _streamingActive = false;
 
 	// Streaming thread.
-	std::deque<uint32> _offsetsForDownloader;
-	base::flat_set<uint32> _downloaderOffsetsRequested;
+	std::deque<int64> _offsetsForDownloader;
+	base::flat_set<int64> _downloaderOffsetsRequested;
 	base::flat_map<uint32, std::optional<PartsMap>> _downloaderReadCache;
 
 	// Communication from main thread to streaming thread.
 	// Streaming thread to main thread communicates using crl::on_main.
-	base::thread_safe_queue<uint32> _downloaderOffsetRequests;
-	base::thread_safe_queue<uint32> _downloaderOffsetAcks;
+	base::thread_safe_queue<int64> _downloaderOffsetRequests;
+	base::thread_safe_queue<int64> _downloaderOffsetAcks;
 
 	rpl::lifetime _lifetime;
 
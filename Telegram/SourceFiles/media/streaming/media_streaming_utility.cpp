@@ -18,6 +18,51 @@ namespace {
 
 constexpr auto kSkipInvalidDataPackets = 10;
 
+// Even, so that the 4:2:0 chroma rows are split between the slices evenly.
+constexpr auto kPremultiplySliceHeight = 16;
+
+// Feed swscale by slices and premultiply the output rows it returns
+// while they are still in the cache instead of a separate full frame pass.
+void ScaleAndPremultiply(
+		SwsContext *context,
+		not_null<AVFrame*> frame,
+		uint8_t *const data[],
+		const int linesize[],
+		QImage &storage) {
+	Expects(frame->format == AV_PIX_FMT_YUVA420P);
+
+	auto ready = 0;
+	for (auto top = 0; top < frame->height;) {
+		const auto height = std::min(
+			kPremultiplySliceHeight,
+			frame->height - top);
+		const auto chroma = top / 2;
+		const uint8_t *const slice[] = {
+			frame->data[0] + top * frame->linesize[0],
+			frame->data[1] + chroma * frame->linesize[1],
+			frame->data[2] + chroma * frame->linesize[2],
+			frame->data[3] + top * frame->linesize[3],
+		};
+		const auto written = sws_scale(
+			context,
+			slice,
+			frame->linesize,
+			top,
+			height,
+			data,
+			linesize);
+		if (written > 0) {
+			const auto till = std::min(ready + written, storage.height());
+			FFmpeg::PremultiplyRowsInplace(storage, ready, till);
+			ready = till;
+		}
+		top += height;
+	}
+	if (ready < storage.height()) {
+		FFmpeg::PremultiplyRowsInplace(storage, ready, storage.height());
+	}
+}
+
 } // namespace
 
 crl::time FramePosition(const Stream &stream) {
@@ -187,17 +232,22 @@ QImage ConvertFrame(
 		uint8_t *data[AV_NUM_DATA_POINTERS] = { storage.bits(), nullptr };
 		int linesize[AV_NUM_DATA_POINTERS] = { int(storage.bytesPerLine()), 0 };
 
-		sws_scale(
-			stream.swscale.get(),
-			frame->data,
-			frame->linesize,
-			0,
-			frame->height,
-			data,
-			linesize);
-
 		if (frame->format == AV_PIX_FMT_YUVA420P) {
-			FFmpeg::PremultiplyInplace(storage);
+			ScaleAndPremultiply(
+				stream.swscale.get(),
+				frame,
+				data,
+				linesize,
+				storage);
+		} else {
+			sws_scale(
+				stream.swscale.get(),
+				frame->data,
+				frame->linesize,
+				0,
+				frame->height,
+				data,
+				linesize);
 		}
 	}
 
@@ -353,6 +403,9 @@ void PaintFrameContent(
 
 void ApplyFrameRounding(QImage &storage, const FrameRequest &request) {
 	if (!request.mask.isNull()) {
+		if (FFmpeg::ApplyMaskInplace(storage, request.mask)) {
+			return;
+		}
 		auto p = QPainter(&storage);
 		p.setCompositionMode(QPainter::CompositionMode_DestinationIn);
 		p.drawImage(
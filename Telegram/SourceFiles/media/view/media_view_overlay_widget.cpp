@@ -4525,6 +4525,7 @@ void OverlayWidget::restartAtSeekPosition(crl::time position) {
 void OverlayWidget::playbackControlsSeekProgress(crl::time position) {
 	Expects(_streamed != nullptr);
 
+	_streamed->instance.prefetchAt(position);
 	if (!_streamed->instance.player().paused()
 		&& !_streamed->instance.player().finished()) {
 		_streamed->pausedBySeek = true;
@@ -1171,6 +1171,7 @@ void Pip::seekProgress(float64 value) {
 		_lastDurationMs);
 	if (_seekPositionMs != positionMs) {
 		_seekPositionMs = positionMs;
+		_instance->prefetchAt(positionMs);
 		if (!_instance->player().paused()
 			&& !_instance->player().finished()) {
 			_pausedBySeek = true;
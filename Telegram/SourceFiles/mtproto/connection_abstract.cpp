@@ -20,6 +20,9 @@ namespace {
 
 std::atomic<int> GlobalConnectionCounter/* = 0*/;
 
+constexpr auto kReceivedPoolSize = 8;
+constexpr auto kReceivedPoolBufferMax = 64 * 1024; // In mtpPrime-s.
+
 } // namespace
 
 ConnectionPointer::ConnectionPointer() = default;
@@ -212,6 +215,25 @@ void AbstractConnection::logError(const QString &message) {
 	DEBUG_LOG(("Connection %1 Error: ").arg(_debugId) + message);
 }
 
+void AbstractConnection::recycleReceived(mtpBuffer &&buffer) {
+	// Shared buffers would be detached on the next write anyway.
+	if (_receivedPool.size() < kReceivedPoolSize
+		&& buffer.isDetached()
+		&& buffer.capacity() <= kReceivedPoolBufferMax) {
+		_receivedPool.push_back(std::move(buffer));
+	}
+}
+
+mtpBuffer AbstractConnection::takeReceivedBuffer(int size) {
+	if (_receivedPool.empty()) {
+		return mtpBuffer(size);
+	}
+	auto result = std::move(_receivedPool.back());
+	_receivedPool.pop_back();
+	result.resize(size);
+	return result;
+}
+
 uint32 AbstractConnection::extendedNotSecurePadding() const {
 	return uint32(base::RandomValue<uchar>() & 0x3F);
 }
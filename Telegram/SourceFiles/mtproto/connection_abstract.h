@@ -114,6 +114,9 @@ public:
 		return _receivedQueue;
 	}
 
+	// Give a processed packet back, its storage is reused for the next one.
+	void recycleReceived(mtpBuffer &&buffer);
+
 	template <typename Request>
 	[[nodiscard]] mtpBuffer prepareNotSecurePacket(
 		const Request &request,
@@ -160,10 +163,13 @@ protected:
 	[[nodiscard]] std::optional<MTPResPQ> readPQFakeReply(
 		const mtpBuffer &buffer) const;
 
+	[[nodiscard]] mtpBuffer takeReceivedBuffer(int size);
+
 private:
 	[[nodiscard]] uint32 extendedNotSecurePadding() const;
 
 	uint64 _sentEncryptedWithKeyId = 0;
+	std::vector<mtpBuffer> _receivedPool;
 
 };
 
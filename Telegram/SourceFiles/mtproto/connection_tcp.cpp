@@ -374,6 +374,14 @@ void TcpConnection::socketRead() {
 					}
 				}
 			}
+
+			// Hand all the packets of this read to the session at once.
+			if (!_receivedQueue.empty()) {
+				receivedData();
+				if (!_socket || !_socket->isConnected()) {
+					return;
+				}
+			}
 		} else if (readCount < 0) {
 			CONNECTION_LOG_ERROR(u"Socket read return %1."_q.arg(readCount));
 			error(kErrorCodeOther);
@@ -403,7 +411,7 @@ mtpBuffer TcpConnection::parsePacket(bytes::const_span bytes) {
 		}
 		return mtpBuffer(1, ints[0]);
 	}
-	auto result = mtpBuffer(ints.size());
+	auto result = takeReceivedBuffer(ints.size());
 	memcpy(result.data(), ints.data(), ints.size() * sizeof(mtpPrime));
 	return result;
 }
@@ -586,7 +594,7 @@ void TcpConnection::socketPacket(bytes::const_span bytes) {
 	Expects(_socket != nullptr);
 
 	// old quickack?..
-	const auto data = parsePacket(bytes);
+	auto data = parsePacket(bytes);
 	if (data.size() == 1) {
 		if (data[0] != 0) {
 			error(data[0]);
@@ -596,8 +604,7 @@ void TcpConnection::socketPacket(bytes::const_span bytes) {
 	//} else if (data.size() == 2) {
 		// new quickack?..
 	} else if (_status == Status::Ready) {
-		_receivedQueue.push_back(data);
-		receivedData();
+		_receivedQueue.push_back(std::move(data));
 	} else if (_status == Status::Waiting) {
 		if (const auto res_pq = readPQFakeReply(data)) {
 			const auto &data = res_pq->c_resPQ();
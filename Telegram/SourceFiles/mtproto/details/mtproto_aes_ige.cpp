@@ -0,0 +1,280 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "mtproto/details/mtproto_aes_ige.h"
+
+#include <openssl/aes.h>
+#include <openssl/evp.h>
+
+#if defined _M_X64 || defined _M_IX86 || defined __x86_64__ || defined __i386__
+#define MTP_AES_IGE_USE_AESNI
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MTP_AESNI_TARGET
+#else // _MSC_VER
+#include <cpuid.h>
+#define MTP_AESNI_TARGET __attribute__((target("aes,sse2")))
+#endif // _MSC_VER
+#endif // _M_X64 || _M_IX86 || __x86_64__ || __i386__
+
+namespace MTP::details {
+namespace {
+
+constexpr auto kBlockSize = 16;
+
+void ProcessGeneric(gsl::span<const AesIgeItem> items, bool encrypt) {
+	for (const auto &item : items) {
+		uchar iv[32];
+		memcpy(iv, item.iv, 32);
+
+		const auto key = static_cast<const uchar*>(item.key);
+		AES_KEY aes;
+		if (encrypt) {
+			AES_set_encrypt_key(key, 256, &aes);
+		} else {
+			AES_set_decrypt_key(key, 256, &aes);
+		}
+		AES_ige_encrypt(
+			static_cast<const uchar*>(item.src),
+			static_cast<uchar*>(item.dst),
+			item.len,
+			&aes,
+			iv,
+			encrypt ? AES_ENCRYPT : AES_DECRYPT);
+	}
+}
+
+#ifdef MTP_AES_IGE_USE_AESNI
+
+constexpr auto kLanes = 4;
+constexpr auto kRounds = 14;
+
+struct Lane {
+	__m128i keys[kRounds + 1];
+	__m128i previousCipher;
+	__m128i previousPlain;
+	const uchar *src = nullptr;
+	uchar *dst = nullptr;
+	uint32 blocks = 0;
+};
+
+[[nodiscard]] bool DetectAesNi() {
+#ifdef _MSC_VER
+	int info[4] = { 0 };
+	__cpuid(info, 1);
+	return (info[2] & (1 << 25)) != 0;
+#else // _MSC_VER
+	unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+	return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES);
+#endif // _MSC_VER
+}
+
+MTP_AESNI_TARGET inline __m128i ShiftXor(__m128i key) {
+	auto shifted = _mm_slli_si128(key, 4);
+	key = _mm_xor_si128(key, shifted);
+	shifted = _mm_slli_si128(shifted, 4);
+	key = _mm_xor_si128(key, shifted);
+	shifted = _mm_slli_si128(shifted, 4);
+	return _mm_xor_si128(key, shifted);
+}
+
+MTP_AESNI_TARGET inline __m128i ExpandEven(__m128i key, __m128i assist) {
+	return _mm_xor_si128(ShiftXor(key), _mm_shuffle_epi32(assist, 0xFF));
+}
+
+MTP_AESNI_TARGET inline __m128i ExpandOdd(__m128i key, __m128i previous) {
+	const auto assist = _mm_aeskeygenassist_si128(previous, 0x00);
+	return _mm_xor_si128(ShiftXor(key), _mm_shuffle_epi32(assist, 0xAA));
+}
+
+MTP_AESNI_TARGET void ExpandKey(const void *key, __m128i *keys, bool encrypt) {
+	const auto bytes = static_cast<const uchar*>(key);
+	auto even = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+	auto odd = _mm_loadu_si128(
+		reinterpret_cast<const __m128i*>(bytes + kBlockSize));
+	keys[0] = even;
+	keys[1] = odd;
+
+	// The round constant must be an immediate value.
+#define MTP_EXPAND_ROUND(index, rcon) \
+	even = ExpandEven(even, _mm_aeskeygenassist_si128(odd, rcon)); \
+	keys[index] = even; \
+	if (index + 1 <= kRounds) { \
+		odd = ExpandOdd(odd, even); \
+		keys[index + 1] = odd; \
+	}
+
+	MTP_EXPAND_ROUND(2, 0x01);
+	MTP_EXPAND_ROUND(4, 0x02);
+	MTP_EXPAND_ROUND(6, 0x04);
+	MTP_EXPAND_ROUND(8, 0x08);
+	MTP_EXPAND_ROUND(10, 0x10);
+	MTP_EXPAND_ROUND(12, 0x20);
+	MTP_EXPAND_ROUND(14, 0x40);
+
+#undef MTP_EXPAND_ROUND
+
+	if (!encrypt) {
+		// Equivalent inverse cipher key schedule.
+		std::reverse(keys, keys + kRounds + 1);
+		for (auto i = 1; i != kRounds; ++i) {
+			keys[i] = _mm_aesimc_si128(keys[i]);
+		}
+	}
+}
+
+template <int Count, bool Encrypt>
+MTP_AESNI_TARGET void ProcessLanes(Lane *lanes, uint32 steps) {
+	for (auto step = uint32(0); step != steps; ++step) {
+		__m128i input[Count];
+		__m128i state[Count];
+		for (auto i = 0; i != Count; ++i) {
+			auto &lane = lanes[i];
+			input[i] = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(lane.src));
+			state[i] = _mm_xor_si128(
+				_mm_xor_si128(
+					input[i],
+					Encrypt ? lane.previousCipher : lane.previousPlain),
+				lane.keys[0]);
+		}
+		for (auto round = 1; round != kRounds; ++round) {
+			for (auto i = 0; i != Count; ++i) {
+				state[i] = Encrypt
+					? _mm_aesenc_si128(state[i], lanes[i].keys[round])
+					: _mm_aesdec_si128(state[i], lanes[i].keys[round]);
+			}
+		}
+		for (auto i = 0; i != Count; ++i) {
+			auto &lane = lanes[i];
+			state[i] = Encrypt
+				? _mm_aesenclast_si128(state[i], lane.keys[kRounds])
+				: _mm_aesdeclast_si128(state[i], lane.keys[kRounds]);
+			const auto output = _mm_xor_si128(
+				state[i],
+				Encrypt ? lane.previousPlain : lane.previousCipher);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lane.dst), output);
+			if constexpr (Encrypt) {
+				lane.previousCipher = output;
+				lane.previousPlain = input[i];
+			} else {
+				lane.previousCipher = input[i];
+				lane.previousPlain = output;
+			}
+			lane.src += kBlockSize;
+			lane.dst += kBlockSize;
+		}
+	}
+	for (auto i = 0; i != Count; ++i) {
+		lanes[i].blocks -= steps;
+	}
+}
+
+template <bool Encrypt>
+MTP_AESNI_TARGET void ProcessAesNi(gsl::span<const AesIgeItem> items) {
+	Lane lanes[kLanes];
+	auto active = 0;
+	auto next = items.begin();
+	while (true) {
+		for (; active < kLanes && next != items.end(); ++next) {
+			if (next->len < kBlockSize) {
+				continue;
+			}
+			auto &lane = lanes[active++];
+			const auto iv = static_cast<const uchar*>(next->iv);
+			ExpandKey(next->key, lane.keys, Encrypt);
+			lane.previousCipher = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(iv));
+			lane.previousPlain = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(iv + kBlockSize));
+			lane.src = static_cast<const uchar*>(next->src);
+			lane.dst = static_cast<uchar*>(next->dst);
+			lane.blocks = next->len / kBlockSize;
+		}
+		if (!active) {
+			break;
+		}
+		auto steps = lanes[0].blocks;
+		for (auto i = 1; i != active; ++i) {
+			steps = std::min(steps, lanes[i].blocks);
+		}
+		switch (active) {
+		case 1: ProcessLanes<1, Encrypt>(lanes, steps); break;
+		case 2: ProcessLanes<2, Encrypt>(lanes, steps); break;
+		case 3: ProcessLanes<3, Encrypt>(lanes, steps); break;
+		case 4: ProcessLanes<4, Encrypt>(lanes, steps); break;
+		}
+		for (auto i = 0; i != active;) {
+			if (!lanes[i].blocks) {
+				lanes[i] = lanes[--active];
+			} else {
+				++i;
+			}
+		}
+	}
+}
+
+#endif // MTP_AES_IGE_USE_AESNI
+
+} // namespace
+
+bool AesIgeAccelerated() {
+#ifdef MTP_AES_IGE_USE_AESNI
+	static const auto result = DetectAesNi();
+	return result;
+#else // MTP_AES_IGE_USE_AESNI
+	return false;
+#endif // MTP_AES_IGE_USE_AESNI
+}
+
+void AesIgeEncryptBatch(gsl::span<const AesIgeItem> items) {
+#ifdef MTP_AES_IGE_USE_AESNI
+	if (AesIgeAccelerated()) {
+		ProcessAesNi<true>(items);
+		return;
+	}
+#endif // MTP_AES_IGE_USE_AESNI
+	ProcessGeneric(items, true);
+}
+
+void AesIgeDecryptBatch(gsl::span<const AesIgeItem> items) {
+#ifdef MTP_AES_IGE_USE_AESNI
+	if (AesIgeAccelerated()) {
+		ProcessAesNi<false>(items);
+		return;
+	}
+#endif // MTP_AES_IGE_USE_AESNI
+	ProcessGeneric(items, false);
+}
+
+bool AesCtrEncryptBlocks(
+		bytes::span data,
+		const void *key,
+		const void *ivec) {
+	Expects(data.size() % kBlockSize == 0);
+
+	const auto context = EVP_CIPHER_CTX_new();
+	if (!context) {
+		return false;
+	}
+	const auto size = int(data.size());
+	const auto bytes = reinterpret_cast<uchar*>(data.data());
+	auto written = 0;
+	const auto done = EVP_EncryptInit_ex(
+		context,
+		EVP_aes_256_ctr(),
+		nullptr,
+		static_cast<const uchar*>(key),
+		static_cast<const uchar*>(ivec))
+		&& EVP_EncryptUpdate(context, bytes, &written, bytes, size)
+		&& (written == size);
+	EVP_CIPHER_CTX_free(context);
+	return done;
+}
+
+} // namespace MTP::details
@@ -0,0 +1,37 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "base/bytes.h"
+
+namespace MTP::details {
+
+struct AesIgeItem {
+	const void *src = nullptr;
+	void *dst = nullptr; // May be equal to src.
+	uint32 len = 0; // Multiple of the 16 bytes block size.
+	const void *key = nullptr; // 32 bytes.
+	const void *iv = nullptr; // 32 bytes, left unchanged.
+};
+
+// Whether the batches run on AES-NI instead of the generic OpenSSL code.
+[[nodiscard]] bool AesIgeAccelerated();
+
+// IGE is sequential inside a message, so independent messages are
+// interleaved instead, up to four at a time, to keep the AES unit busy.
+void AesIgeEncryptBatch(gsl::span<const AesIgeItem> items);
+void AesIgeDecryptBatch(gsl::span<const AesIgeItem> items);
+
+// Whole 16 byte blocks in CTR mode through EVP, which pipelines counter
+// blocks on AES-NI / VAES when available. The counter is not advanced.
+[[nodiscard]] bool AesCtrEncryptBlocks(
+	bytes::span data,
+	const void *key,
+	const void *ivec);
+
+} // namespace MTP::details
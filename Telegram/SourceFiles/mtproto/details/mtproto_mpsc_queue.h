@@ -0,0 +1,75 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace MTP::details {
+
+// Any thread may push without blocking, the consumer takes everything
+// pushed so far with a single exchange and owns it from then on.
+template <typename Value>
+class MpscQueue final {
+public:
+	MpscQueue() = default;
+	MpscQueue(const MpscQueue &other) = delete;
+	MpscQueue &operator=(const MpscQueue &other) = delete;
+	~MpscQueue() {
+		destroy(_head.exchange(nullptr, std::memory_order_acquire));
+	}
+
+	// Returns true if the queue was empty before this push.
+	bool push(Value value) {
+		const auto node = new Node{ std::move(value) };
+		auto head = _head.load(std::memory_order_relaxed);
+		do {
+			node->next = head;
+		} while (!_head.compare_exchange_weak(
+			head,
+			node,
+			std::memory_order_release,
+			std::memory_order_relaxed));
+		return (head == nullptr);
+	}
+
+	[[nodiscard]] bool empty() const {
+		return (_head.load(std::memory_order_acquire) == nullptr);
+	}
+
+	// Values are returned in the order they were pushed.
+	[[nodiscard]] std::vector<Value> takeAll() {
+		auto node = _head.exchange(nullptr, std::memory_order_acquire);
+		auto result = std::vector<Value>();
+		while (node) {
+			result.push_back(std::move(node->value));
+			delete std::exchange(node, node->next);
+		}
+		std::reverse(begin(result), end(result));
+		return result;
+	}
+
+private:
+	struct Node {
+		Value value;
+		Node *next = nullptr;
+	};
+
+	static void destroy(Node *node) {
+		while (node) {
+			delete std::exchange(node, node->next);
+		}
+	}
+
+	std::atomic<Node*> _head = nullptr;
+
+};
+
+} // namespace MTP::details
@@ -7,11 +7,27 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #include "mtproto/mtproto_auth_key.h"
 
+#include "mtproto/details/mtproto_aes_ige.h"
 #include "base/openssl_help.h"
 
 #include <QtCore/QDataStream>
 
 namespace MTP {
+namespace {
+
+// Below that the cipher context setup costs more than it saves.
+constexpr auto kCtrCipherMinSize = 256;
+
+void IncrementCtrCounter(uchar *counter, uint64 blocks) {
+	for (auto i = CTRState::IvecSize; i != 0 && blocks != 0;) {
+		--i;
+		const auto sum = uint64(counter[i]) + (blocks & 0xFF);
+		counter[i] = uchar(sum & 0xFF);
+		blocks = (blocks >> 8) + (sum >> 8);
+	}
+}
+
+} // namespace
 
 AuthKey::AuthKey(Type type, DcId dcId, const Data &data)
 : _type(type)
@@ -149,41 +165,75 @@ void AuthKey::countKeyId() {
 }
 
 void aesIgeEncryptRaw(const void *src, void *dst, uint32 len, const void *key, const void *iv) {
-	uchar aes_key[32], aes_iv[32];
-	memcpy(aes_key, key, 32);
-	memcpy(aes_iv, iv, 32);
-
-	AES_KEY aes;
-	AES_set_encrypt_key(aes_key, 256, &aes);
-	AES_ige_encrypt(static_cast<const uchar*>(src), static_cast<uchar*>(dst), len, &aes, aes_iv, AES_ENCRYPT);
+	const auto item = details::AesIgeItem{
+		.src = src,
+		.dst = dst,
+		.len = len,
+		.key = key,
+		.iv = iv,
+	};
+	details::AesIgeEncryptBatch({ &item, 1 });
 }
 
 void aesIgeDecryptRaw(const void *src, void *dst, uint32 len, const void *key, const void *iv) {
-	uchar aes_key[32], aes_iv[32];
-	memcpy(aes_key, key, 32);
-	memcpy(aes_iv, iv, 32);
-
-	AES_KEY aes;
-	AES_set_decrypt_key(aes_key, 256, &aes);
-	AES_ige_encrypt(static_cast<const uchar*>(src), static_cast<uchar*>(dst), len, &aes, aes_iv, AES_DECRYPT);
+	const auto item = details::AesIgeItem{
+		.src = src,
+		.dst = dst,
+		.len = len,
+		.key = key,
+		.iv = iv,
+	};
+	details::AesIgeDecryptBatch({ &item, 1 });
 }
 
 void aesCtrEncrypt(bytes::span data, const void *key, CTRState *state) {
-	AES_KEY aes;
-	AES_set_encrypt_key(static_cast<const uchar*>(key), 256, &aes);
-
 	static_assert(CTRState::IvecSize == AES_BLOCK_SIZE, "Wrong size of ctr ivec!");
 	static_assert(CTRState::EcountSize == AES_BLOCK_SIZE, "Wrong size of ctr ecount!");
 
-	CRYPTO_ctr128_encrypt(
-		reinterpret_cast<const uchar*>(data.data()),
-		reinterpret_cast<uchar*>(data.data()),
-		data.size(),
-		&aes,
-		state->ivec,
-		state->ecount,
-		&state->num,
-		(block128_f)AES_encrypt);
+	const auto generic = [&](bytes::span part) {
+		AES_KEY aes;
+		AES_set_encrypt_key(static_cast<const uchar*>(key), 256, &aes);
+
+		CRYPTO_ctr128_encrypt(
+			reinterpret_cast<const uchar*>(part.data()),
+			reinterpret_cast<uchar*>(part.data()),
+			part.size(),
+			&aes,
+			state->ivec,
+			state->ecount,
+			&state->num,
+			(block128_f)AES_encrypt);
+	};
+	if (data.size() < kCtrCipherMinSize) {
+		generic(data);
+		return;
+	}
+
+	// Use up the current key stream block, then whole blocks go through
+	// the pipelined EVP cipher.
+	if (state->num) {
+		const auto rest = std::min(
+			std::size_t(CTRState::EcountSize - state->num),
+			data.size());
+		generic(data.subspan(0, rest));
+		data = data.subspan(rest);
+	}
+	const auto blocks = data.size() / AES_BLOCK_SIZE;
+	if (blocks) {
+		const auto size = blocks * AES_BLOCK_SIZE;
+		const auto whole = data.subspan(0, size);
+		if (!details::AesCtrEncryptBlocks(whole, key, state->ivec)) {
+			LOG(("AES Error: could not encrypt %1 bytes in CTR mode."
+				).arg(size));
+			generic(data);
+			return;
+		}
+		IncrementCtrCounter(state->ivec, blocks);
+		data = data.subspan(size);
+	}
+	if (!data.empty()) {
+		generic(data);
+	}
 }
 
 } // namespace MTP
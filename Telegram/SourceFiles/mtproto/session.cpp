@@ -16,6 +16,18 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 namespace MTP {
 namespace details {
+namespace {
+
+void LockForWrite(
+		not_null<QReadWriteLock*> lock,
+		std::atomic<uint64> &waits) {
+	if (!lock->tryLockForWrite()) {
+		++waits;
+		lock->lockForWrite();
+	}
+}
+
+} // namespace
 
 SessionOptions::SessionOptions(
 	const QString &systemLangCode,
@@ -63,6 +75,113 @@ void SessionData::notifyConnectionInited(const SessionOptions &options) {
 	}
 }
 
+void SessionData::queueToSend(SerializedRequest request) {
+	forgetAppliedQueuedIds();
+	if (const auto requestId = request->requestId) {
+		_toSendQueuedIds.emplace_back(_toSendQueuedTotal, requestId);
+	}
+	++_toSendQueuedTotal;
+	++_requestsQueued;
+	_toSendQueue.push(std::move(request));
+}
+
+void SessionData::queueCancel(mtpRequestId requestId, mtpMsgId msgId) {
+	++_cancelsQueued;
+	_cancelQueue.push({ .requestId = requestId, .msgId = msgId });
+}
+
+void SessionData::forgetAppliedQueuedIds() {
+	// The queue keeps the order, so the first requests queued are the
+	// ones applyQueued() has already moved to _toSend.
+	const auto applied = _toSendAppliedTotal.load(std::memory_order_acquire);
+	while (!_toSendQueuedIds.empty()
+		&& _toSendQueuedIds.front().first < applied) {
+		_toSendQueuedIds.pop_front();
+	}
+}
+
+bool SessionData::toSendContains(mtpRequestId requestId) {
+	// applyQueued() counts requests as applied only after they are added
+	// to _toSend, so a queued request is always found in one of the two.
+	forgetAppliedQueuedIds();
+	const auto queued = ranges::contains(
+		_toSendQueuedIds,
+		requestId,
+		&std::pair<uint64, mtpRequestId>::second);
+	if (queued) {
+		return true;
+	}
+	LockForWrite(&_toSendLock, _toSendLockWaits);
+	const auto result = _toSend.contains(requestId);
+	_toSendLock.unlock();
+	return result;
+}
+
+void SessionData::applyQueued() {
+	// Cancels are taken first, so that a request cancelled after it was
+	// queued is always found either in this batch or in the map already.
+	const auto cancels = _cancelQueue.takeAll();
+	auto requests = _toSendQueue.takeAll();
+	if (cancels.empty() && requests.empty()) {
+		return;
+	}
+	++_queueDrains;
+	if (!requests.empty()) {
+		LockForWrite(&_toSendLock, _toSendLockWaits);
+		for (const auto &request : requests) {
+			*(mtpMsgId*)(request->data() + 4) = 0;
+			*(request->data() + 6) = 0;
+			_toSend.emplace(request->requestId, request);
+		}
+		_toSendLock.unlock();
+		_toSendAppliedTotal.fetch_add(
+			requests.size(),
+			std::memory_order_release);
+	}
+	if (cancels.empty()) {
+		return;
+	}
+	LockForWrite(&_toSendLock, _toSendLockWaits);
+	for (const auto &cancel : cancels) {
+		if (cancel.requestId) {
+			_toSend.remove(cancel.requestId);
+		}
+	}
+	_toSendLock.unlock();
+
+	LockForWrite(&_haveSentLock, _haveSentLockWaits);
+	for (const auto &cancel : cancels) {
+		if (cancel.msgId) {
+			_haveSent.remove(cancel.msgId);
+		}
+	}
+	_haveSentLock.unlock();
+}
+
+void SessionData::pushReceived(Response &&response) {
+	++_responsesQueued;
+	_receivedMessages.push(std::move(response));
+}
+
+bool SessionData::haveReceived() const {
+	return !_receivedMessages.empty();
+}
+
+std::vector<Response> SessionData::takeReceived() {
+	return _receivedMessages.takeAll();
+}
+
+SessionContention SessionData::contention() const {
+	return {
+		.requestsQueued = _requestsQueued.load(),
+		.cancelsQueued = _cancelsQueued.load(),
+		.responsesQueued = _responsesQueued.load(),
+		.queueDrains = _queueDrains.load(),
+		.toSendLockWaits = _toSendLockWaits.load(),
+		.haveSentLockWaits = _haveSentLockWaits.load(),
+	};
+}
+
 void SessionData::queueTryToReceive() {
 	withSession([](not_null<Session*> session) {
 		session->tryToReceive();
@@ -279,6 +398,18 @@ void Session::kill() {
 	_killed = true;
 	_data->detach();
 	DEBUG_LOG(("Session Info: marked session dcWithShift %1 as killed").arg(_shiftedDcId));
+
+	const auto stats = contention();
+	DEBUG_LOG(("Session Info: dcWithShift %1 queued %2 requests, "
+		"%3 cancels, %4 responses in %5 drains, "
+		"lock waits toSend %6, haveSent %7"
+		).arg(_shiftedDcId
+		).arg(stats.requestsQueued
+		).arg(stats.cancelsQueued
+		).arg(stats.responsesQueued
+		).arg(stats.queueDrains
+		).arg(stats.toSendLockWaits
+		).arg(stats.haveSentLockWaits));
 }
 
 void Session::unpaused() {
@@ -349,13 +480,8 @@ void Session::resetDone() {
 }
 
 void Session::cancel(mtpRequestId requestId, mtpMsgId msgId) {
-	if (requestId) {
-		QWriteLocker locker(_data->toSendMutex());
-		_data->toSendMap().remove(requestId);
-	}
-	if (msgId) {
-		QWriteLocker locker(_data->haveSentMutex());
-		_data->haveSentMap().remove(msgId);
+	if (requestId || msgId) {
+		_data->queueCancel(requestId, msgId);
 	}
 }
 
@@ -388,12 +514,15 @@ int32 Session::requestState(mtpRequestId requestId) const {
 		return MTP::RequestSent;
 	}
 
-	QWriteLocker locker(_data->toSendMutex());
-	return _data->toSendMap().contains(requestId)
+	return _data->toSendContains(requestId)
 		? MTP::RequestSending
 		: MTP::RequestSent;
 }
 
+SessionContention Session::contention() const {
+	return _data->contention();
+}
+
 int32 Session::getState() const {
 	int32 result = -86400000;
 
@@ -422,16 +551,11 @@ QString Session::transport() const {
 void Session::sendPrepared(
 		const SerializedRequest &request,
 		crl::time msCanWait) {
-	DEBUG_LOG(("MTP Info: adding request to toSendMap, msCanWait %1"
+	DEBUG_LOG(("MTP Info: queueing request to send, msCanWait %1"
 		).arg(msCanWait));
-	{
-		QWriteLocker locker(_data->toSendMutex());
-		_data->toSendMap().emplace(request->requestId, request);
-		*(mtpMsgId*)(request->data() + 4) = 0;
-		*(request->data() + 6) = 0;
-	}
+	_data->queueToSend(request);
 
-	DEBUG_LOG(("MTP Info: added, requestId %1").arg(request->requestId));
+	DEBUG_LOG(("MTP Info: queued, requestId %1").arg(request->requestId));
 	if (msCanWait >= 0) {
 		InvokeQueued(this, [=] {
 			sendAnything(msCanWait);
@@ -549,9 +673,7 @@ void Session::tryToReceive() {
 		return;
 	}
 	while (true) {
-		auto lock = QWriteLocker(_data->haveReceivedMutex());
-		const auto messages = base::take(_data->haveReceivedMessages());
-		lock.unlock();
+		const auto messages = _data->takeReceived();
 		if (messages.empty()) {
 			break;
 		}
@@ -10,6 +10,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "base/timer.h"
 #include "mtproto/mtproto_response.h"
 #include "mtproto/mtproto_proxy_data.h"
+#include "mtproto/details/mtproto_mpsc_queue.h"
 #include "mtproto/details/mtproto_serialized_request.h"
 
 #include <QtCore/QTimer>
@@ -52,6 +53,16 @@ struct SessionOptions {
 
 };
 
+// How often the threads met each other while exchanging requests.
+struct SessionContention {
+	uint64 requestsQueued = 0;
+	uint64 cancelsQueued = 0;
+	uint64 responsesQueued = 0;
+	uint64 queueDrains = 0;
+	uint64 toSendLockWaits = 0;
+	uint64 haveSentLockWaits = 0;
+};
+
 class Session;
 class SessionData final {
 public:
@@ -74,9 +85,6 @@ public:
 	not_null<QReadWriteLock*> haveSentMutex() {
 		return &_haveSentLock;
 	}
-	not_null<QReadWriteLock*> haveReceivedMutex() {
-		return &_haveReceivedLock;
-	}
 
 	base::flat_map<mtpRequestId, SerializedRequest> &toSendMap() {
 		return _toSend;
@@ -84,9 +92,22 @@ public:
 	base::flat_map<mtpMsgId, SerializedRequest> &haveSentMap() {
 		return _haveSent;
 	}
-	std::vector<Response> &haveReceivedMessages() {
-		return _receivedMessages;
-	}
+
+	// Session -> SessionPrivate handoff, never blocks the producer.
+	// Requests are queued and looked up from the main thread.
+	void queueToSend(SerializedRequest request);
+	void queueCancel(mtpRequestId requestId, mtpMsgId msgId);
+	[[nodiscard]] bool toSendContains(mtpRequestId requestId);
+
+	// Connection thread, moves everything queued to toSend / haveSent.
+	void applyQueued();
+
+	// SessionPrivate -> Session handoff.
+	void pushReceived(Response &&response);
+	[[nodiscard]] bool haveReceived() const;
+	[[nodiscard]] std::vector<Response> takeReceived();
+
+	[[nodiscard]] SessionContention contention() const;
 
 	// SessionPrivate -> Session interface.
 	void queueTryToReceive();
@@ -112,6 +133,7 @@ public:
 private:
 	template <typename Callback>
 	void withSession(Callback &&callback);
+	void forgetAppliedQueuedIds();
 
 	Session *_owner = nullptr;
 	mutable QMutex _ownerMutex;
@@ -125,8 +147,27 @@ private:
 	base::flat_map<mtpMsgId, SerializedRequest> _haveSent; // map of msg_id -> request, that was sent
 	QReadWriteLock _haveSentLock;
 
-	std::vector<Response> _receivedMessages; // list of responses / updates that should be processed in the main thread
-	QReadWriteLock _haveReceivedLock;
+	struct QueuedCancel {
+		mtpRequestId requestId = 0;
+		mtpMsgId msgId = 0;
+	};
+	MpscQueue<SerializedRequest> _toSendQueue;
+	MpscQueue<QueuedCancel> _cancelQueue;
+
+	// Main thread, ids of the requests in _toSendQueue for
+	// toSendContains(), with the number of requests queued before them.
+	std::deque<std::pair<uint64, mtpRequestId>> _toSendQueuedIds;
+	uint64 _toSendQueuedTotal = 0;
+	std::atomic<uint64> _toSendAppliedTotal = 0;
+
+	MpscQueue<Response> _receivedMessages; // list of responses / updates that should be processed in the main thread
+
+	std::atomic<uint64> _requestsQueued = 0;
+	std::atomic<uint64> _cancelsQueued = 0;
+	std::atomic<uint64> _responsesQueued = 0;
+	std::atomic<uint64> _queueDrains = 0;
+	std::atomic<uint64> _toSendLockWaits = 0;
+	std::atomic<uint64> _haveSentLockWaits = 0;
 
 };
 
@@ -159,6 +200,7 @@ public:
 	void sendPrepared(
 		const SerializedRequest &request,
 		crl::time msCanWait = 0);
+	[[nodiscard]] SessionContention contention() const;
 
 	// SessionPrivate thread.
 	[[nodiscard]] CreatingKeyType acquireKeyCreation(DcType type);
@@ -8,6 +8,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "base/options.h"
 #include "mtproto/session_private.h"
 
+#include "mtproto/details/mtproto_aes_ige.h"
 #include "mtproto/details/mtproto_bound_key_creator.h"
 #include "mtproto/details/mtproto_dcenter.h"
 #include "mtproto/details/mtproto_dump_to_text.h"
@@ -63,6 +64,10 @@ constexpr auto kAckSendWaiting = 10 * crl::time(1000);
 
 constexpr auto kCutContainerOnSize = 16 * 1024;
 
+// Buffers for unpacking gzip_packed containers, reused between packets.
+constexpr auto kUnpackedPoolSize = 4;
+constexpr auto kUnpackedPoolBufferMax = 256 * 1024; // In mtpPrime-s.
+
 auto SyncTimeRequestDuration = kFastRequestDuration;
 
 using namespace details;
@@ -76,6 +81,26 @@ using namespace details;
 	return idsStr + "]";
 }
 
+// Serialized TL bytes / string, without copying them out of the packet.
+[[nodiscard]] bytes::const_span ReadSerializedBytes(
+		const mtpPrime *from,
+		const mtpPrime *end) {
+	if (from >= end) {
+		return {};
+	}
+	const auto data = reinterpret_cast<const uchar*>(from);
+	const auto available = (end - from) * kIntSize;
+	const auto large = (data[0] == 254);
+	const auto length = large
+		? (data[1] | (data[2] << 8) | (data[3] << 16))
+		: data[0];
+	const auto offset = large ? 4 : 1;
+	if (data[0] == 255 || offset + length > available) {
+		return {};
+	}
+	return bytes::make_span(data + offset, length);
+}
+
 [[nodiscard]] QString ComputeAppVersion() {
 #if defined Q_OS_WIN && defined Q_PROCESSOR_X86_64
 	const auto arch = u" x64"_q;
@@ -571,6 +596,7 @@ MTPVector<MTPJSONObjectValue> SessionPrivate::prepareInitParams() {
 
 void SessionPrivate::tryToSend() {
 	DEBUG_LOG(("MTP Info: tryToSend for dc %1.").arg(_shiftedDcId));
+	_sessionData->applyQueued();
 	if (!_connection) {
 		DEBUG_LOG(("MTP Info: not yet connected in dc %1.").arg(_shiftedDcId));
 		return;
@@ -1272,14 +1298,48 @@ void SessionPrivate::handleReceived() {
 
 	onReceivedSome();
 
+	constexpr auto kExternalHeaderIntsCount = 6U; // 2 auth_key_id, 4 msg_key
+	constexpr auto kEncryptedHeaderIntsCount = 8U; // 2 salt, 2 session, 2 msg_id, 1 seq_no, 1 length
+	constexpr auto kMinimalEncryptedIntsCount = kEncryptedHeaderIntsCount + 4U; // + 1 data + 3 padding
+	constexpr auto kMinimalIntsCount = kExternalHeaderIntsCount + kMinimalEncryptedIntsCount;
+
+	// Decrypt in one pass all the packets up to the first bad one,
+	// the bad one is reported in the loop below with the same checks.
+	auto decryptedAhead = 0;
+	{
+		auto &received = _connection->received();
+		auto keys = std::vector<std::pair<MTPint256, MTPint256>>();
+		auto items = std::vector<AesIgeItem>();
+		keys.reserve(received.size());
+		items.reserve(received.size());
+		for (auto &buffer : received) {
+			const auto intsCount = uint32(buffer.size());
+			if ((intsCount < kMinimalIntsCount)
+				|| (intsCount > kMaxMessageLength / kIntSize)
+				|| (_keyId != *(const uint64*)buffer.constData())) {
+				break;
+			}
+			const auto ints = buffer.data();
+			const auto msgKey = *(MTPint128*)(ints + 2);
+			auto &[aesKey, aesIV] = keys.emplace_back();
+			_encryptionKey->prepareAES(msgKey, aesKey, aesIV, false);
+			const auto encryptedInts = ints + kExternalHeaderIntsCount;
+			items.push_back({
+				.src = encryptedInts,
+				.dst = encryptedInts,
+				.len = ((intsCount - kExternalHeaderIntsCount) & ~0x03U) * kIntSize,
+				.key = &aesKey,
+				.iv = &aesIV,
+			});
+		}
+		AesIgeDecryptBatch(items);
+		decryptedAhead = int(items.size());
+	}
+
 	while (!_connection->received().empty()) {
 		auto intsBuffer = std::move(_connection->received().front());
 		_connection->received().pop_front();
 
-		constexpr auto kExternalHeaderIntsCount = 6U; // 2 auth_key_id, 4 msg_key
-		constexpr auto kEncryptedHeaderIntsCount = 8U; // 2 salt, 2 session, 2 msg_id, 1 seq_no, 1 length
-		constexpr auto kMinimalEncryptedIntsCount = kEncryptedHeaderIntsCount + 4U; // + 1 data + 3 padding
-		constexpr auto kMinimalIntsCount = kExternalHeaderIntsCount + kMinimalEncryptedIntsCount;
 		auto intsCount = uint32(intsBuffer.size());
 		auto ints = intsBuffer.constData();
 		if ((intsCount < kMinimalIntsCount) || (intsCount > kMaxMessageLength / kIntSize)) {
@@ -1294,15 +1354,17 @@ void SessionPrivate::handleReceived() {
 		constexpr auto kMinPaddingSize = 12U;
 		constexpr auto kMaxPaddingSize = 1024U;
 
-		auto encryptedInts = ints + kExternalHeaderIntsCount;
 		auto encryptedIntsCount = (intsCount - kExternalHeaderIntsCount) & ~0x03U;
 		auto encryptedBytesCount = encryptedIntsCount * kIntSize;
-		auto decryptedBuffer = QByteArray(encryptedBytesCount, Qt::Uninitialized);
 		auto msgKey = *(MTPint128*)(ints + 2);
 
-		aesIgeDecrypt(encryptedInts, decryptedBuffer.data(), encryptedBytesCount, _encryptionKey, msgKey);
-
-		auto decryptedInts = reinterpret_cast<const mtpPrime*>(decryptedBuffer.constData());
+		// The packet buffer is ours, decrypt it in place.
+		const auto decryptedInts = intsBuffer.data() + kExternalHeaderIntsCount;
+		if (decryptedAhead > 0) {
+			--decryptedAhead;
+		} else {
+			aesIgeDecrypt(decryptedInts, decryptedInts, encryptedBytesCount, _encryptionKey, msgKey);
+		}
 		auto serverSalt = *(uint64*)&decryptedInts[0];
 		auto session = *(uint64*)&decryptedInts[2];
 		auto msgId = *(uint64*)&decryptedInts[4];
@@ -1408,18 +1470,18 @@ void SessionPrivate::handleReceived() {
 		}
 		_receivedMessageIds.shrink();
 
+		if (_connection) {
+			_connection->recycleReceived(std::move(intsBuffer));
+		}
+
 		// send acks
 		if (const auto toAckSize = _ackRequestData.size()) {
 			DEBUG_LOG(("MTP Info: will send %1 acks, ids: %2").arg(toAckSize).arg(LogIdsVector(_ackRequestData)));
 			_sessionData->queueSendAnything(kAckSendWaiting);
 		}
 
-		auto lock = QReadLocker(_sessionData->haveReceivedMutex());
-		const auto tryToReceive = !_sessionData->haveReceivedMessages().empty();
-		lock.unlock();
-
-		if (tryToReceive) {
-			DEBUG_LOG(("MTP Info: queueTryToReceive() - need to parse in another thread, %1 messages.").arg(_sessionData->haveReceivedMessages().size()));
+		if (_sessionData->haveReceived()) {
+			DEBUG_LOG(("MTP Info: queueTryToReceive() - need to parse in another thread."));
 			_sessionData->queueTryToReceive();
 		}
 
@@ -1457,11 +1519,21 @@ SessionPrivate::HandleResult SessionPrivate::handleOneReceived(
 
 	case mtpc_gzip_packed: {
 		DEBUG_LOG(("Message Info: gzip container"));
-		mtpBuffer response = ungzip(++from, end);
+		auto buffer = mtpBuffer();
+		if (!_unpackedPool.empty()) {
+			buffer = std::move(_unpackedPool.back());
+			_unpackedPool.pop_back();
+		}
+		auto response = ungzip(++from, end, std::move(buffer));
 		if (response.empty()) {
 			return HandleResult::RestartConnection;
 		}
-		return handleOneReceived(response.data(), response.data() + response.size(), msgId, info);
+		const auto result = handleOneReceived(response.data(), response.data() + response.size(), msgId, info);
+		if (_unpackedPool.size() < kUnpackedPoolSize
+			&& response.capacity() <= kUnpackedPoolBufferMax) {
+			_unpackedPool.push_back(std::move(response));
+		}
+		return result;
 	}
 
 	case mtpc_msg_container: {
@@ -1641,8 +1713,7 @@ SessionPrivate::HandleResult SessionPrivate::handleOneReceived(
 				)).write(reply);
 
 				// Save rpc_error for processing in the main thread.
-				QWriteLocker locker(_sessionData->haveReceivedMutex());
-				_sessionData->haveReceivedMessages().push_back({
+				_sessionData->pushReceived({
 					.reply = std::move(reply),
 					.outerMsgId = info.outerMsgId,
 					.requestId = requestId,
@@ -1871,8 +1942,7 @@ SessionPrivate::HandleResult SessionPrivate::handleOneReceived(
 		const auto requestId = wasSent(requestMsgId);
 		if (requestId && requestId != mtpRequestId(0xFFFFFFFF)) {
 			// Save rpc_result for processing in the main thread.
-			QWriteLocker locker(_sessionData->haveReceivedMutex());
-			_sessionData->haveReceivedMessages().push_back({
+			_sessionData->pushReceived({
 				.reply = std::move(response),
 				.outerMsgId = info.outerMsgId,
 				.requestId = requestId,
@@ -1924,8 +1994,7 @@ SessionPrivate::HandleResult SessionPrivate::handleOneReceived(
 		if (from > start) memcpy(update.data(), start, (from - start) * sizeof(mtpPrime));
 
 		// Notify main process about new session - need to get difference.
-		QWriteLocker locker(_sessionData->haveReceivedMutex());
-		_sessionData->haveReceivedMessages().push_back({
+		_sessionData->pushReceived({
 			.reply = update,
 			.outerMsgId = info.outerMsgId,
 		});
@@ -1974,8 +2043,7 @@ SessionPrivate::HandleResult SessionPrivate::handleOneReceived(
 		}
 
 		// Notify main process about the new updates.
-		QWriteLocker locker(_sessionData->haveReceivedMutex());
-		_sessionData->haveReceivedMessages().push_back({
+		_sessionData->pushReceived({
 			.reply = update,
 			.outerMsgId = info.outerMsgId,
 		});
@@ -2017,16 +2085,23 @@ SessionPrivate::HandleResult SessionPrivate::handleBindResponse(
 	Unexpected("Result of BoundKeyCreator::handleBindResponse.");
 }
 
-mtpBuffer SessionPrivate::ungzip(const mtpPrime *from, const mtpPrime *end) const {
-	mtpBuffer result; // * 4 because of mtpPrime type
-	result.resize(0);
+mtpBuffer SessionPrivate::ungzip(
+		const mtpPrime *from,
+		const mtpPrime *end,
+		mtpBuffer &&buffer) const {
+	auto result = std::move(buffer);
+	result.resize(0); // Keeps the capacity of a reused buffer.
 
-	MTPstring packed;
-	if (!packed.read(from, end)) { // read packed string as serialized mtp string type
+	// Inflate right from the serialized string, without copying it.
+	const auto packed = ReadSerializedBytes(from, end);
+	if (packed.empty()) {
 		LOG(("RPC Error: could not read gziped bytes."));
-		return result;
+		return mtpBuffer();
 	}
-	uint32 packedLen = packed.v.size(), unpackedChunk = packedLen;
+	const auto packedLen = uint32(packed.size());
+	const auto unpackedChunk = std::max(
+		packedLen,
+		uint32(result.capacity()));
 
 	z_stream stream;
 	stream.zalloc = 0;
@@ -2037,21 +2112,25 @@ mtpBuffer SessionPrivate::ungzip(const mtpPrime *from, const mtpPrime *end) cons
 	int res = inflateInit2(&stream, 16 + MAX_WBITS);
 	if (res != Z_OK) {
 		LOG(("RPC Error: could not init zlib stream, code: %1").arg(res));
-		return result;
+		return mtpBuffer();
 	}
 	stream.avail_in = packedLen;
-	stream.next_in = reinterpret_cast<Bytef*>(packed.v.data());
+	stream.next_in = reinterpret_cast<Bytef*>(
+		const_cast<std::byte*>(packed.data()));
 
 	stream.avail_out = 0;
 	while (!stream.avail_out) {
-		result.resize(result.size() + unpackedChunk);
-		stream.avail_out = unpackedChunk * sizeof(mtpPrime);
-		stream.next_out = (Bytef*)&result[result.size() - unpackedChunk];
+		const auto chunk = result.isEmpty()
+			? unpackedChunk
+			: std::max(packedLen, uint32(result.size()));
+		result.resize(result.size() + chunk);
+		stream.avail_out = chunk * sizeof(mtpPrime);
+		stream.next_out = (Bytef*)&result[result.size() - chunk];
 		int res = inflate(&stream, Z_NO_FLUSH);
 		if (res != Z_OK && res != Z_STREAM_END) {
 			inflateEnd(&stream);
 			LOG(("RPC Error: could not unpack gziped data, code: %1").arg(res));
-			DEBUG_LOG(("RPC Error: bad gzip: %1").arg(Logs::mb(packed.v.constData(), packedLen).str()));
+			DEBUG_LOG(("RPC Error: bad gzip: %1").arg(Logs::mb(packed.data(), packedLen).str()));
 			return mtpBuffer();
 		}
 	}
@@ -2265,6 +2344,7 @@ void SessionPrivate::resend(mtpMsgId msgId, crl::time msCanWait) {
 		}
 		return;
 	}
+	_sessionData->applyQueued();
 	auto lock = QWriteLocker(_sessionData->haveSentMutex());
 	auto &haveSent = _sessionData->haveSentMap();
 	auto i = haveSent.find(msgId);
@@ -2285,6 +2365,7 @@ void SessionPrivate::resend(mtpMsgId msgId, crl::time msCanWait) {
 }
 
 void SessionPrivate::resendAll() {
+	_sessionData->applyQueued();
 	auto lock = QWriteLocker(_sessionData->haveSentMutex());
 	auto haveSent = base::take(_sessionData->haveSentMap());
 	lock.unlock();
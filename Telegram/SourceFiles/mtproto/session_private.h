@@ -133,7 +133,10 @@ private:
 	[[nodiscard]] HandleResult handleBindResponse(
 		mtpMsgId requestMsgId,
 		const mtpBuffer &response);
-	mtpBuffer ungzip(const mtpPrime *from, const mtpPrime *end) const;
+	mtpBuffer ungzip(
+		const mtpPrime *from,
+		const mtpPrime *end,
+		mtpBuffer &&buffer = mtpBuffer()) const;
 	void handleMsgsStates(const QVector<MTPlong> &ids, const QByteArray &states);
 
 	// _sessionDataMutex must be locked for read.
@@ -229,6 +232,7 @@ private:
 	QVector<MTPlong> _resendRequestData;
 	base::flat_set<mtpMsgId> _stateRequestData;
 	ReceivedIdsManager _receivedMessageIds;
+	std::vector<mtpBuffer> _unpackedPool;
 	base::flat_map<mtpMsgId, mtpRequestId> _resendingIds;
 	base::flat_map<mtpMsgId, mtpRequestId> _ackedIds;
 	base::flat_map<mtpMsgId, SerializedRequest> _stateAndResendRequests;
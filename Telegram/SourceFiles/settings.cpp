@@ -37,6 +37,7 @@ bool gQuit = false;
 int32 gLastUpdateCheck = 0;
 bool gNoStartUpdate = false;
 bool gStartToSettings = false;
+bool gTraceStartup = false;
 bool gDebugMode = false;
 
 uint32 gConnectionsInSession = 1;
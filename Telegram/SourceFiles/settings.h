@@ -79,6 +79,7 @@ DeclareSetting(bool, WriteProtected);
 DeclareSetting(int32, LastUpdateCheck);
 DeclareSetting(bool, NoStartUpdate);
 DeclareSetting(bool, StartToSettings);
+DeclareSetting(bool, TraceStartup);
 DeclareSetting(bool, DebugMode);
 DeclareReadSetting(bool, ManyInstance);
 DeclareSetting(bool, Quit);
@@ -0,0 +1,107 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "statistics/min_max_pyramid.h"
+
+namespace Statistic {
+namespace {
+
+constexpr auto kMinArraySize = 64;
+
+} // namespace
+
+MinMaxPyramid::MinMaxPyramid(const std::vector<ChartValue> &array)
+: _size(int(array.size())) {
+	if (_size < kMinArraySize) {
+		return;
+	}
+	const auto pick = [&](int a, int b, bool max) {
+		if (a < 0) {
+			return b;
+		} else if (b < 0) {
+			return a;
+		}
+		return (max ? (array[b] > array[a]) : (array[b] < array[a]))
+			? b
+			: a;
+	};
+
+	auto first = std::vector<Bucket>((_size + 1) / 2);
+	for (auto i = 0; i != int(first.size()); ++i) {
+		const auto a = (array[2 * i] >= 0) ? (2 * i) : -1;
+		const auto b = (2 * i + 1 < _size && array[2 * i + 1] >= 0)
+			? (2 * i + 1)
+			: -1;
+		first[i] = { pick(a, b, false), pick(a, b, true) };
+	}
+	_levels.push_back(std::move(first));
+	while (_levels.back().size() > 1) {
+		const auto &previous = _levels.back();
+		const auto count = int(previous.size());
+		auto next = std::vector<Bucket>((count + 1) / 2);
+		for (auto i = 0; i != int(next.size()); ++i) {
+			const auto &a = previous[2 * i];
+			const auto b = (2 * i + 1 < count) ? previous[2 * i + 1] : Bucket();
+			next[i] = { pick(a.min, b.min, false), pick(a.max, b.max, true) };
+		}
+		_levels.push_back(std::move(next));
+	}
+}
+
+void MinMaxPyramid::collect(
+		int from,
+		int to,
+		int pixels,
+		std::vector<int> &indices) const {
+	indices.clear();
+	from = std::max(from, 0);
+	to = std::min(to, _size - 1);
+	if (from > to) {
+		return;
+	}
+	const auto count = to - from + 1;
+	auto level = 0;
+	if (pixels > 0) {
+		while (level < int(_levels.size())
+			&& (count >> (level + 1)) >= pixels) {
+			++level;
+		}
+	}
+	if (!level) {
+		indices.resize(count);
+		for (auto i = 0; i != count; ++i) {
+			indices[i] = from + i;
+		}
+		return;
+	}
+
+	// Buckets on the edges may stick out of the range, their outer points
+	// are kept as well so that the line reaches the sides of the chart.
+	const auto &buckets = _levels[level - 1];
+	const auto shift = level;
+	const auto first = (from >> shift);
+	const auto last = (to >> shift);
+	indices.reserve(2 * (last - first + 1) + 2);
+	indices.push_back(first << shift);
+	for (auto i = first; i <= last; ++i) {
+		const auto &bucket = buckets[i];
+		const auto a = std::min(bucket.min, bucket.max);
+		const auto b = std::max(bucket.min, bucket.max);
+		if (a >= 0 && a != indices.back()) {
+			indices.push_back(a);
+		}
+		if (b >= 0 && b != indices.back()) {
+			indices.push_back(b);
+		}
+	}
+	const auto end = std::min(((last + 1) << shift), _size) - 1;
+	if (end != indices.back()) {
+		indices.push_back(end);
+	}
+}
+
+} // namespace Statistic
@@ -0,0 +1,44 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "statistics/statistics_types.h"
+
+namespace Statistic {
+
+// Level k keeps the indices of the smallest and the largest value in
+// each bucket of 2 ^ k points, so a line can be drawn with a couple of
+// points per pixel whatever the zoom is. Negative values are gaps.
+class MinMaxPyramid final {
+public:
+	MinMaxPyramid() = default;
+	explicit MinMaxPyramid(const std::vector<ChartValue> &array);
+
+	[[nodiscard]] bool empty() const {
+		return !_size;
+	}
+	[[nodiscard]] explicit operator bool() const {
+		return !empty();
+	}
+
+	// Fills indices in the increasing order, enough to keep the shape
+	// of the [from, to] range when drawn across the given pixel width.
+	void collect(int from, int to, int pixels, std::vector<int> &indices) const;
+
+private:
+	struct Bucket final {
+		int min = -1;
+		int max = -1;
+	};
+
+	int _size = 0;
+	std::vector<std::vector<Bucket>> _levels;
+
+};
+
+} // namespace Statistic
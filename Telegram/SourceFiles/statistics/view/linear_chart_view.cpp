@@ -35,7 +35,22 @@ void PaintChartLine(
 
 	const auto ratio = ratios.ratio(line.id);
 
-	for (auto i = localStart; i <= localEnd; i++) {
+	// Only the extremes of each pixel column are drawn on long ranges.
+	auto indices = std::vector<int>();
+	if (line.minMaxPyramid) {
+		line.minMaxPyramid.collect(
+			localStart,
+			localEnd,
+			int(c.rect.width() * style::DevicePixelRatio()),
+			indices);
+	} else {
+		for (auto i = localStart; i <= localEnd; i++) {
+			indices.push_back(i);
+		}
+	}
+	chartPoints.reserve(indices.size());
+
+	for (const auto i : indices) {
 		if (line.y[i] < 0) {
 			continue;
 		}
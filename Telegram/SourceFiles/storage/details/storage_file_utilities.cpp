@@ -13,6 +13,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "base/random.h"
 
 #include <crl/crl_object_on_thread.h>
+#include <crl/crl_semaphore.h>
 #include <QtCore/QtEndian>
 #include <QtCore/QSaveFile>
 
@@ -25,13 +26,110 @@ constexpr auto TdfMagicLen = int(sizeof(TdfMagic));
 
 constexpr auto kStrongIterationsCount = 100'000;
 
+constexpr auto kJournalCompactSize = 512 * 1024;
+constexpr auto kJournalMaxEntrySize = 64 * 1024;
+constexpr auto kJournalWrite = quint32(1);
+constexpr auto kJournalRemove = quint32(2);
+
 struct WriteEntry {
 	QString basePath;
 	QString base;
 	QByteArray data;
 	QByteArray md5;
+	qint32 version = AppVersion;
+};
+
+// Small asynchronous writes are appended to a journal in their folder,
+// with one flush for the whole batch. The files themselves are written
+// only with the latest data for each of them, when the journal grows,
+// when a pending file is read or cleared and on sync.
+struct Journal {
+	QString basePath;
+	QFile file;
+	int64 size = 0;
+	base::flat_map<QString, WriteEntry> pending;
 };
 
+[[nodiscard]] QString JournalPath(const QString &basePath) {
+	return basePath + u"journal"_q;
+}
+
+void AppendJournalRecord(
+		QByteArray &block,
+		const QString &name,
+		const WriteEntry *entry) {
+	auto record = QByteArray();
+	{
+		auto stream = QDataStream(&record, QIODevice::WriteOnly);
+		stream.setVersion(QDataStream::Qt_5_1);
+		if (entry) {
+			stream
+				<< kJournalWrite
+				<< name
+				<< entry->version
+				<< entry->data
+				<< entry->md5;
+		} else {
+			stream << kJournalRemove << name;
+		}
+	}
+	HashMd5 md5;
+	md5.feed(record.constData(), record.size());
+	const auto size = qToBigEndian(quint32(record.size()));
+	block.append((const char*)&size, sizeof(size));
+	block.append(record);
+	block.append((const char*)md5.result(), 0x10);
+}
+
+[[nodiscard]] base::flat_map<QString, WriteEntry> ReadJournal(
+		const QString &basePath,
+		const QByteArray &bytes) {
+	auto result = base::flat_map<QString, WriteEntry>();
+	auto offset = 0;
+	const auto total = int(bytes.size());
+	while (total - offset >= int(sizeof(quint32))) {
+		const auto size = qFromBigEndian<quint32>(bytes.constData() + offset);
+		offset += sizeof(quint32);
+
+		// The last record could be written only partially.
+		const auto left = uint32(total - offset);
+		if (size > left || left - size < 0x10) {
+			break;
+		}
+		const auto record = QByteArray::fromRawData(
+			bytes.constData() + offset,
+			size);
+		offset += size;
+		HashMd5 md5;
+		md5.feed(record.constData(), record.size());
+		if (memcmp(md5.result(), bytes.constData() + offset, 0x10)) {
+			break;
+		}
+		offset += 0x10;
+
+		auto stream = QDataStream(record);
+		stream.setVersion(QDataStream::Qt_5_1);
+		auto type = quint32();
+		auto name = QString();
+		stream >> type >> name;
+		auto entry = WriteEntry{
+			.basePath = basePath,
+			.base = basePath + name,
+		};
+		if (type == kJournalWrite) {
+			stream >> entry.version >> entry.data >> entry.md5;
+		}
+		if (stream.status() != QDataStream::Ok) {
+			break;
+		} else if (type == kJournalWrite) {
+			result[entry.base] = std::move(entry);
+		} else {
+			result.remove(entry.base);
+		}
+	}
+	return result;
+}
+
 class WriteManager final {
 public:
 	explicit WriteManager(crl::weak_on_thread<WriteManager> weak);
@@ -39,12 +137,21 @@ public:
 	void write(WriteEntry &&entry);
 	void writeSync(WriteEntry &&entry);
 	void writeSyncAll();
+	void prepareRead(const QString &basePath, const QString &base);
+	void clear(const QString &basePath, const QString &base);
 
 private:
 	void scheduleWrite();
 	void writeScheduled();
-	bool writeOneScheduledNow();
 	void writeNow(WriteEntry &&entry);
+	void writeNowSkipJournal(WriteEntry &&entry);
+
+	[[nodiscard]] not_null<Journal*> journal(const QString &basePath);
+	void recover(not_null<Journal*> journal);
+	[[nodiscard]] bool append(
+		not_null<Journal*> journal,
+		const QByteArray &block);
+	void compact(not_null<Journal*> journal);
 
 	template <typename File>
 	[[nodiscard]] bool open(File &file, const WriteEntry &entry, char postfix);
@@ -52,10 +159,12 @@ private:
 	[[nodiscard]] QString path(const WriteEntry &entry, char postfix) const;
 	[[nodiscard]] bool writeHeader(
 		const QString &basePath,
-		QFileDevice &file);
+		QFileDevice &file,
+		qint32 version);
 
 	crl::weak_on_thread<WriteManager> _weak;
 	std::deque<WriteEntry> _scheduled;
+	base::flat_map<QString, std::unique_ptr<Journal>> _journals;
 
 };
 
@@ -63,6 +172,8 @@ class AsyncWriteManager final {
 public:
 	void write(WriteEntry &&entry);
 	void writeSync(WriteEntry &&entry);
+	void prepareRead(const QString &basePath, const QString &base);
+	void clear(const QString &basePath, const QString &base);
 	void sync();
 	void stop();
 
@@ -91,6 +202,15 @@ void WriteManager::writeSync(WriteEntry &&entry) {
 	if (i != end(_scheduled)) {
 		_scheduled.erase(i);
 	}
+	writeNowSkipJournal(std::move(entry));
+}
+
+void WriteManager::writeNowSkipJournal(WriteEntry &&entry) {
+	// An older version of this file in the journal must not be replayed.
+	const auto journal = this->journal(entry.basePath);
+	if (journal->pending.contains(entry.base)) {
+		compact(journal);
+	}
 	writeNow(std::move(entry));
 }
 
@@ -136,23 +256,114 @@ void WriteManager::writeNow(WriteEntry &&entry) {
 }
 
 void WriteManager::writeSyncAll() {
-	while (writeOneScheduledNow()) {
+	while (!_scheduled.empty()) {
+		auto entry = std::move(_scheduled.front());
+		_scheduled.pop_front();
+
+		const auto journal = this->journal(entry.basePath);
+		journal->pending[entry.base] = std::move(entry);
+	}
+	for (const auto &[basePath, journal] : _journals) {
+		compact(journal.get());
 	}
 }
 
-bool WriteManager::writeOneScheduledNow() {
-	if (_scheduled.empty()) {
-		return false;
+void WriteManager::prepareRead(const QString &basePath, const QString &base) {
+	const auto i = ranges::find(_scheduled, base, &WriteEntry::base);
+	if (i != end(_scheduled)) {
+		auto entry = std::move(*i);
+		_scheduled.erase(i);
+		writeNowSkipJournal(std::move(entry));
+	} else if (journal(basePath)->pending.contains(base)) {
+		compact(journal(basePath));
 	}
+}
 
-	auto entry = std::move(_scheduled.front());
-	_scheduled.pop_front();
+void WriteManager::clear(const QString &basePath, const QString &base) {
+	const auto i = ranges::find(_scheduled, base, &WriteEntry::base);
+	if (i != end(_scheduled)) {
+		_scheduled.erase(i);
+	}
+	const auto journal = this->journal(basePath);
+	if (journal->pending.remove(base)) {
+		auto block = QByteArray();
+		AppendJournalRecord(block, base.mid(basePath.size()), nullptr);
+		if (!append(journal, block)) {
+			compact(journal);
+		}
+	}
+	QFile::remove(base + '0');
+	QFile::remove(base + '1');
+	QFile::remove(base + 's');
+}
 
-	writeNow(std::move(entry));
+not_null<Journal*> WriteManager::journal(const QString &basePath) {
+	auto i = _journals.find(basePath);
+	if (i == end(_journals)) {
+		i = _journals.emplace(
+			basePath,
+			std::make_unique<Journal>()).first;
+		i->second->basePath = basePath;
+		i->second->file.setFileName(JournalPath(basePath));
+		recover(i->second.get());
+	}
+	return i->second.get();
+}
+
+void WriteManager::recover(not_null<Journal*> journal) {
+	auto &file = journal->file;
+	if (!file.exists()) {
+		return;
+	} else if (file.open(QIODevice::ReadOnly)) {
+		journal->pending = ReadJournal(journal->basePath, file.readAll());
+		file.close();
+	}
+	if (!journal->pending.empty()) {
+		LOG(("Storage Info: Recovering %1 files from '%2'."
+			).arg(journal->pending.size()
+			).arg(file.fileName()));
+	}
+	compact(journal);
+}
+
+bool WriteManager::append(
+		not_null<Journal*> journal,
+		const QByteArray &block) {
+	auto &file = journal->file;
+	if (!file.isOpen()
+		&& !file.open(QIODevice::Append)
+		&& !(QDir().mkpath(journal->basePath)
+			&& file.open(QIODevice::Append))) {
+		LOG(("Storage Error: Could not open '%1' for writing."
+			).arg(file.fileName()));
+		return false;
+	} else if (file.write(block) != block.size() || !file.flush()) {
+		LOG(("Storage Error: Could not write to '%1'."
+			).arg(file.fileName()));
+		return false;
+	}
+	base::Platform::FlushFileData(file);
+	journal->size += block.size();
 	return true;
 }
 
-bool WriteManager::writeHeader(const QString &basePath, QFileDevice &file) {
+void WriteManager::compact(not_null<Journal*> journal) {
+	for (auto &[base, entry] : base::take(journal->pending)) {
+		writeNow(std::move(entry));
+	}
+	if (journal->file.isOpen()) {
+		journal->file.close();
+	}
+	if (journal->size > 0 || journal->file.exists()) {
+		journal->file.remove();
+	}
+	journal->size = 0;
+}
+
+bool WriteManager::writeHeader(
+		const QString &basePath,
+		QFileDevice &file,
+		qint32 version) {
 	if (!file.open(QIODevice::WriteOnly)) {
 		const auto dir = QDir(basePath);
 		if (dir.exists()) {
@@ -164,7 +375,6 @@ bool WriteManager::writeHeader(const QString &basePath, QFileDevice &file) {
 		}
 	}
 	file.write(TdfMagic, TdfMagicLen);
-	const auto version = qint32(AppVersion);
 	file.write((const char*)&version, sizeof(version));
 	return true;
 }
@@ -177,7 +387,7 @@ template <typename File>
 bool WriteManager::open(File &file, const WriteEntry &entry, char postfix) {
 	const auto name = path(entry, postfix);
 	file.setFileName(name);
-	if (!writeHeader(entry.basePath, file)) {
+	if (!writeHeader(entry.basePath, file, entry.version)) {
 		LOG(("Storage Error: Could not open '%1' for writing.").arg(name));
 		return false;
 	}
@@ -191,8 +401,37 @@ void WriteManager::scheduleWrite() {
 }
 
 void WriteManager::writeScheduled() {
-	if (writeOneScheduledNow() && !_scheduled.empty()) {
-		scheduleWrite();
+	if (_scheduled.empty()) {
+		return;
+	}
+	auto entries = base::take(_scheduled);
+
+	// Large files skip the journal, they would be written twice otherwise.
+	// They go first, so that compacting the journal because of them won't
+	// leave records of this batch in it without the pending entries.
+	const auto small = std::stable_partition(
+		begin(entries),
+		end(entries),
+		[](const WriteEntry &entry) {
+			return entry.data.size() > kJournalMaxEntrySize;
+		});
+	for (auto i = begin(entries); i != small; ++i) {
+		writeNowSkipJournal(std::move(*i));
+	}
+	auto blocks = base::flat_map<not_null<Journal*>, QByteArray>();
+	for (auto &entry : ranges::make_subrange(small, end(entries))) {
+		const auto journal = this->journal(entry.basePath);
+		AppendJournalRecord(
+			blocks[journal],
+			entry.base.mid(entry.basePath.size()),
+			&entry);
+		journal->pending[entry.base] = std::move(entry);
+	}
+	for (const auto &[journal, block] : blocks) {
+		if (!append(journal, block)
+			|| journal->size > kJournalCompactSize) {
+			compact(journal);
+		}
 	}
 }
 
@@ -218,6 +457,35 @@ void AsyncWriteManager::writeSync(WriteEntry &&entry) {
 	});
 }
 
+void AsyncWriteManager::prepareRead(
+		const QString &basePath,
+		const QString &base) {
+	if (_finished
+		|| (!_manager && !QFile::exists(JournalPath(basePath)))) {
+		return;
+	} else if (!_manager) {
+		_manager.emplace();
+	}
+	_manager->with_sync([&](WriteManager &manager) {
+		manager.prepareRead(basePath, base);
+	});
+}
+
+void AsyncWriteManager::clear(const QString &basePath, const QString &base) {
+	if (_finished
+		|| (!_manager && !QFile::exists(JournalPath(basePath)))) {
+		QFile::remove(base + '0');
+		QFile::remove(base + '1');
+		QFile::remove(base + 's');
+		return;
+	} else if (!_manager) {
+		_manager.emplace();
+	}
+	_manager->with_sync([&](WriteManager &manager) {
+		manager.clear(basePath, base);
+	});
+}
+
 void AsyncWriteManager::sync() {
 	if (_manager) {
 		_manager->with_sync([](WriteManager &manager) {
@@ -280,14 +548,7 @@ FileKey GenerateKey(const QString &basePath) {
 }
 
 void ClearKey(const FileKey &key, const QString &basePath) {
-	QString name;
-	name.reserve(basePath.size() + 0x11);
-	name.append(basePath).append(ToFilePart(key)).append('0');
-	QFile::remove(name);
-	name[name.size() - 1] = '1';
-	QFile::remove(name);
-	name[name.size() - 1] = 's';
-	QFile::remove(name);
+	Manager.clear(basePath, basePath + ToFilePart(key));
 }
 
 bool CheckStreamStatus(QDataStream &stream) {
@@ -471,7 +732,10 @@ void FileWriteDescriptor::finish() {
 	return encrypted;
 }
 
-bool ReadFile(
+namespace {
+
+// Expects Manager.prepareRead() to be already called for this file.
+bool ReadPreparedFile(
 		FileReadDescriptor &result,
 		const QString &name,
 		const QString &basePath) {
@@ -582,6 +846,49 @@ bool ReadFile(
 	return false;
 }
 
+bool DecryptReadFile(
+		FileReadDescriptor &result,
+		const MTP::AuthKeyPtr &key) {
+	QByteArray encrypted;
+	result.stream >> encrypted;
+
+	EncryptedDescriptor data;
+	if (!DecryptLocal(data, encrypted, key)) {
+		result.stream.setDevice(nullptr);
+		if (result.buffer.isOpen()) result.buffer.close();
+		result.buffer.setBuffer(nullptr);
+		result.data = QByteArray();
+		result.version = 0;
+		return false;
+	}
+
+	result.stream.setDevice(0);
+	if (result.buffer.isOpen()) {
+		result.buffer.close();
+	}
+	result.buffer.setBuffer(0);
+	result.data = data.data;
+	result.buffer.setBuffer(&result.data);
+	result.buffer.open(QIODevice::ReadOnly);
+	result.buffer.seek(data.buffer.pos());
+	result.stream.setDevice(&result.buffer);
+	result.stream.setVersion(QDataStream::Qt_5_1);
+
+	return true;
+}
+
+} // namespace
+
+bool ReadFile(
+		FileReadDescriptor &result,
+		const QString &name,
+		const QString &basePath) {
+	// The latest data for this file could be still in the journal.
+	Manager.prepareRead(basePath, basePath + name);
+
+	return ReadPreparedFile(result, name, basePath);
+}
+
 bool DecryptLocal(
 		EncryptedDescriptor &result,
 		const QByteArray &encrypted,
@@ -626,45 +933,81 @@ bool ReadEncryptedFile(
 		const QString &name,
 		const QString &basePath,
 		const MTP::AuthKeyPtr &key) {
-	if (!ReadFile(result, name, basePath)) {
-		return false;
-	}
-	QByteArray encrypted;
-	result.stream >> encrypted;
+	return ReadFile(result, name, basePath)
+		&& DecryptReadFile(result, key);
+}
 
-	EncryptedDescriptor data;
-	if (!DecryptLocal(data, encrypted, key)) {
-		result.stream.setDevice(nullptr);
-		if (result.buffer.isOpen()) result.buffer.close();
-		result.buffer.setBuffer(nullptr);
-		result.data = QByteArray();
-		result.version = 0;
-		return false;
+bool ReadEncryptedFile(
+		FileReadDescriptor &result,
+		const FileKey &fkey,
+		const QString &basePath,
+		const MTP::AuthKeyPtr &key) {
+	return ReadEncryptedFile(result, ToFilePart(fkey), basePath, key);
+}
+
+PrefetchedFiles::PrefetchedFiles(
+		const std::vector<Request> &requests,
+		const MTP::AuthKeyPtr &key) {
+	// Pending journal writes for these files are applied here, on the
+	// calling thread. The workers below read the files without going
+	// through Manager, so it is never entered from several threads.
+	for (const auto &request : requests) {
+		Manager.prepareRead(
+			request.basePath,
+			request.basePath + request.name);
+	}
+
+	auto prepared = std::vector<Prepared>(requests.size());
+	auto semaphore = crl::semaphore();
+	for (auto i = 0, count = int(requests.size()); i != count; ++i) {
+		crl::async([&, i] {
+			const auto &request = requests[i];
+			auto &file = prepared[i];
+			FileReadDescriptor descriptor;
+			if (ReadPreparedFile(descriptor, request.name, request.basePath)
+				&& DecryptReadFile(descriptor, key)) {
+				file.read = true;
+				file.version = descriptor.version;
+				file.data = descriptor.data;
+				file.position = descriptor.buffer.pos();
+			}
+			semaphore.release();
+		});
+	}
+	for (auto i = 0, count = int(requests.size()); i != count; ++i) {
+		semaphore.acquire();
 	}
+	for (auto i = 0, count = int(requests.size()); i != count; ++i) {
+		const auto &request = requests[i];
+		_files.emplace(
+			request.basePath + request.name,
+			std::move(prepared[i]));
+	}
+}
 
-	result.stream.setDevice(0);
-	if (result.buffer.isOpen()) {
-		result.buffer.close();
+std::optional<bool> PrefetchedFiles::take(
+		FileReadDescriptor &result,
+		const QString &name,
+		const QString &basePath) {
+	const auto i = _files.find(basePath + name);
+	if (i == end(_files)) {
+		return std::nullopt;
 	}
-	result.buffer.setBuffer(0);
-	result.data = data.data;
+	auto file = std::move(i->second);
+	_files.erase(i);
+	if (!file.read) {
+		return false;
+	}
+	result.version = file.version;
+	result.data = std::move(file.data);
 	result.buffer.setBuffer(&result.data);
 	result.buffer.open(QIODevice::ReadOnly);
-	result.buffer.seek(data.buffer.pos());
+	result.buffer.seek(file.position);
 	result.stream.setDevice(&result.buffer);
 	result.stream.setVersion(QDataStream::Qt_5_1);
-
 	return true;
 }
 
-bool ReadEncryptedFile(
-		FileReadDescriptor &result,
-		const FileKey &fkey,
-		const QString &basePath,
-		const MTP::AuthKeyPtr &key) {
-	return ReadEncryptedFile(result, ToFilePart(fkey), basePath, key);
-}
-
 void Sync() {
 	Manager.sync();
 }
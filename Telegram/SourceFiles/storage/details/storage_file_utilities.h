@@ -106,6 +106,38 @@ bool ReadEncryptedFile(
 	const QString &basePath,
 	const MTP::AuthKeyPtr &key);
 
+// Reads and decrypts a few independent files on background threads,
+// so that they can be parsed on the calling thread without waiting.
+class PrefetchedFiles final {
+public:
+	struct Request {
+		QString name;
+		QString basePath;
+	};
+
+	PrefetchedFiles(
+		const std::vector<Request> &requests,
+		const MTP::AuthKeyPtr &key);
+
+	// std::nullopt if the file was not requested or was already taken,
+	// otherwise the same as ReadEncryptedFile() result.
+	[[nodiscard]] std::optional<bool> take(
+		FileReadDescriptor &result,
+		const QString &name,
+		const QString &basePath);
+
+private:
+	struct Prepared {
+		bool read = false;
+		int32 version = 0;
+		QByteArray data;
+		qint64 position = 0;
+	};
+
+	base::flat_map<QString, Prepared> _files;
+
+};
+
 void Sync();
 void Finish();
 
@@ -21,7 +21,7 @@ namespace {
 
 constexpr auto kKillSessionTimeout = 15 * crl::time(1000);
 constexpr auto kStartWaitedInSession = 4 * kDownloadPartSize;
-constexpr auto kMaxWaitedInSession = 16 * kDownloadPartSize;
+constexpr auto kMaxWaitedInSession = 8 * kDownloadPartSizeMax;
 constexpr auto kStartSessionsCount = 1;
 constexpr auto kMaxSessionsCount = 8;
 constexpr auto kMaxTrackedSessionRemoves = 64;
@@ -33,6 +33,18 @@ constexpr auto kRemoveSessionAfterTimeouts = 4;
 constexpr auto kResetDownloadPrioritiesTimeout = crl::time(200);
 constexpr auto kBadRequestDurationThreshold = 8 * crl::time(1000);
 
+// We keep in flight twice the bandwidth-delay product of the session,
+// measured as the delivery rate times the smallest recent request duration.
+// The smallest duration is forgotten from time to time, so that it follows
+// the route changes, and the rate is an exponential moving average.
+constexpr auto kBandwidthDelayFactor = 2;
+constexpr auto kMinDurationLifetime = 10 * crl::time(1000);
+constexpr auto kRateAverageWeight = 4;
+
+// We want several parts of the window in flight, so that a single
+// slow request does not stall the whole session.
+constexpr auto kPartsInWindow = 4;
+
 // Each (session remove by timeouts) we wait for time:
 // kRetryAddSessionTimeout * max(removesCount, kMaxTrackedSessionRemoves)
 // and for successes in all remaining sessions:
@@ -40,6 +52,26 @@ constexpr auto kBadRequestDurationThreshold = 8 * crl::time(1000);
 
 } // namespace
 
+int ChooseDownloadPartSize(int64 offset, int64 till, int maxLimit) {
+	Expects(!(offset % kDownloadPartSize));
+
+	// The server requires 1 MB to be divisible by the limit and
+	// the part not to cross a 1 MB boundary, so we use powers-of-two
+	// multiples of the base part size with offset aligned by the limit.
+	const auto tillAligned = (till > 0)
+		? ((till + kDownloadPartSize - 1) / kDownloadPartSize)
+			* kDownloadPartSize
+		: int64(0);
+	auto result = kDownloadPartSize;
+	while (result < kDownloadPartSizeMax
+		&& result * 2 <= maxLimit
+		&& !(offset % (result * 2))
+		&& (!tillAligned || offset + result * 2 <= tillAligned)) {
+		result *= 2;
+	}
+	return result;
+}
+
 void DownloadManagerMtproto::Queue::enqueue(
 		not_null<Task*> task,
 		int priority) {
@@ -196,12 +228,25 @@ bool DownloadManagerMtproto::trySendNextPart(MTP::DcId dcId, Queue &queue) {
 	}
 	const auto onlyHighestPriority = (balanceData.totalRequested > 0);
 	if (const auto task = queue.nextTask(onlyHighestPriority)) {
-		task->loadPart(bestIndex);
+		task->loadPart(bestIndex, chooseMaxPartSize(sessions[bestIndex]));
 		return true;
 	}
 	return false;
 }
 
+int DownloadManagerMtproto::chooseMaxPartSize(
+		const DcSessionBalanceData &session) const {
+	const auto available = session.maxWaitedAmount - session.requested;
+	const auto desired = session.maxWaitedAmount / kPartsInWindow;
+	auto result = kDownloadPartSize;
+	while (result < kDownloadPartSizeMax
+		&& result * 2 <= available
+		&& result * 2 <= desired) {
+		result *= 2;
+	}
+	return result;
+}
+
 int DownloadManagerMtproto::changeRequestedAmount(
 		MTP::DcId dcId,
 		int index,
@@ -229,6 +274,7 @@ int DownloadManagerMtproto::changeRequestedAmount(
 void DownloadManagerMtproto::requestSucceeded(
 		MTP::DcId dcId,
 		int index,
+		int limit,
 		int amountAtRequestStart,
 		crl::time timeAtRequestStart) {
 	using namespace rpl::mappers;
@@ -240,13 +286,14 @@ void DownloadManagerMtproto::requestSucceeded(
 	auto &data = dc.sessions[index];
 	const auto overloaded = (timeAtRequestStart <= dc.lastSessionRemove)
 		|| (amountAtRequestStart > data.maxWaitedAmount);
-	const auto parts = amountAtRequestStart / kDownloadPartSize;
 	const auto duration = (crl::now() - timeAtRequestStart);
-	DEBUG_LOG(("Download (%1,%2) request done, duration: %3, parts: %4%5"
+	DEBUG_LOG(("Download (%1,%2) request done, duration: %3, "
+		"limit: %4, in flight: %5%6"
 		).arg(dcId
 		).arg(index
 		).arg(duration
-		).arg(parts
+		).arg(limit
+		).arg(amountAtRequestStart
 		).arg(overloaded ? " (overloaded)" : ""));
 	if (overloaded) {
 		return;
@@ -259,16 +306,13 @@ void DownloadManagerMtproto::requestSucceeded(
 		});
 		return;
 	}
-	if (amountAtRequestStart == data.maxWaitedAmount
-		&& data.maxWaitedAmount < kMaxWaitedInSession) {
-		data.maxWaitedAmount = std::min(
-			data.maxWaitedAmount + kDownloadPartSize,
-			kMaxWaitedInSession);
-		DEBUG_LOG(("Download (%1,%2) increased max waited amount %3."
-			).arg(dcId
-			).arg(index
-			).arg(data.maxWaitedAmount));
-	}
+	updateBandwidthEstimate(
+		dcId,
+		index,
+		data,
+		limit,
+		amountAtRequestStart,
+		duration);
 	data.successes = std::min(data.successes + 1, kMaxTrackedSuccesses);
 	const auto notEnough = ranges::any_of(
 		dc.sessions,
@@ -298,6 +342,55 @@ void DownloadManagerMtproto::requestSucceeded(
 		).arg(dc.sessions.size()));
 }
 
+void DownloadManagerMtproto::updateBandwidthEstimate(
+		MTP::DcId dcId,
+		int index,
+		DcSessionBalanceData &data,
+		int limit,
+		int amountAtRequestStart,
+		crl::time duration) {
+	const auto now = crl::now();
+	duration = std::max(duration, crl::time(1));
+	if (!data.minDuration
+		|| duration <= data.minDuration
+		|| now - data.minDurationUpdated > kMinDurationLifetime) {
+		data.minDuration = duration;
+		data.minDurationUpdated = now;
+	}
+
+	// Everything that was in flight when the request was sent
+	// is delivered approximately by the time the request is finished.
+	const auto rate = int64(amountAtRequestStart) * 1000 / duration;
+	data.bytesPerSecond = data.bytesPerSecond
+		? ((data.bytesPerSecond * (kRateAverageWeight - 1) + rate)
+			/ kRateAverageWeight)
+		: rate;
+
+	const auto product = data.bytesPerSecond * data.minDuration / 1000;
+	const auto target = int(std::clamp(
+		product * kBandwidthDelayFactor,
+		int64(kStartWaitedInSession),
+		int64(kMaxWaitedInSession)));
+	const auto was = data.maxWaitedAmount;
+	if (amountAtRequestStart + limit > data.maxWaitedAmount) {
+		// The window was full, probe for more bandwidth.
+		data.maxWaitedAmount = std::min(
+			std::max(data.maxWaitedAmount + limit, target),
+			kMaxWaitedInSession);
+	} else if (target > data.maxWaitedAmount) {
+		data.maxWaitedAmount = target;
+	}
+	if (data.maxWaitedAmount != was) {
+		DEBUG_LOG(("Download (%1,%2) increased max waited amount %3, "
+			"speed: %4, min duration: %5."
+			).arg(dcId
+			).arg(index
+			).arg(data.maxWaitedAmount
+			).arg(data.bytesPerSecond
+			).arg(data.minDuration));
+	}
+}
+
 int DownloadManagerMtproto::chooseSessionIndex(MTP::DcId dcId) const {
 	const auto i = _balanceData.find(dcId);
 	Assert(i != end(_balanceData));
@@ -475,20 +568,34 @@ void DownloadMtprotoTask::refreshFileReferenceFrom(
 	}
 }
 
-void DownloadMtprotoTask::loadPart(int sessionIndex) {
-	makeRequest({ takeNextRequestOffset(), sessionIndex });
+auto DownloadMtprotoTask::takeNextRequest(int maxLimit) -> PartRequest {
+	return { takeNextRequestOffset(), kDownloadPartSize };
+}
+
+void DownloadMtprotoTask::loadPart(int sessionIndex, int maxLimit) {
+	const auto request = takeNextRequest(maxLimit);
+	Assert(request.limit >= kDownloadPartSize
+		&& request.limit <= kDownloadPartSizeMax
+		&& !(request.offset % request.limit));
+
+	makeRequest({ request.offset, sessionIndex, request.limit });
 }
 
 void DownloadMtprotoTask::removeSession(int sessionIndex) {
 	struct Redirect {
 		mtpRequestId requestId = 0;
 		int64 offset = 0;
+		int limit = 0;
 	};
 	auto redirect = std::vector<Redirect>();
 	for (const auto &[requestId, requestData] : _sentRequests) {
 		if (requestData.sessionIndex == sessionIndex) {
 			redirect.reserve(_sentRequests.size());
-			redirect.push_back({ requestId, requestData.offset });
+			redirect.push_back({
+				requestId,
+				requestData.offset,
+				requestData.limit,
+			});
 		}
 	}
 	for (auto &[requestData, bytes] : _cdnUncheckedParts) {
@@ -498,13 +605,13 @@ void DownloadMtprotoTask::removeSession(int sessionIndex) {
 			requestData.sessionIndex = newIndex;
 		}
 	}
-	for (const auto &[requestId, offset] : redirect) {
+	for (const auto &[requestId, offset, limit] : redirect) {
 		const auto needMakeRequest = (requestId != _cdnHashesRequestId);
 		cancelRequest(requestId);
 		if (needMakeRequest) {
 			const auto newIndex = _owner->chooseSessionIndex(dcId());
 			Assert(newIndex < sessionIndex);
-			makeRequest({ offset, newIndex });
+			makeRequest({ offset, newIndex, limit });
 		}
 	}
 }
@@ -512,7 +619,7 @@ void DownloadMtprotoTask::removeSession(int sessionIndex) {
 mtpRequestId DownloadMtprotoTask::sendRequest(
 		const RequestData &requestData) {
 	const auto offset = requestData.offset;
-	const auto limit = Storage::kDownloadPartSize;
+	const auto limit = requestData.limit;
 	const auto shiftedDcId = MTP::downloadDcId(
 		_cdnDcId ? _cdnDcId : dcId(),
 		requestData.sessionIndex);
@@ -603,13 +710,17 @@ void DownloadMtprotoTask::requestMoreCdnFileHashes() {
 		return;
 	}
 
-	const auto requestData = _cdnUncheckedParts.cbegin()->first;
+	const auto &[requestData, unchecked] = *_cdnUncheckedParts.cbegin();
+	const auto missing = firstMissingCdnHashOffset(
+		requestData.offset,
+		unchecked.size());
+	Assert(missing.has_value());
 	const auto shiftedDcId = MTP::downloadDcId(
 		dcId(),
 		requestData.sessionIndex);
 	_cdnHashesRequestId = api().request(MTPupload_GetCdnFileHashes(
 		MTP_bytes(_cdnToken),
-		MTP_long(requestData.offset)
+		MTP_long(*missing)
 	)).done([=](const MTPVector<MTPFileHash> &result, mtpRequestId id) {
 		getCdnFileHashesDone(result, id);
 	}).fail([=](const MTP::Error &error, mtpRequestId id) {
@@ -724,18 +835,48 @@ void DownloadMtprotoTask::cdnPartLoaded(const MTPupload_CdnFile &result, mtpRequ
 DownloadMtprotoTask::CheckCdnHashResult DownloadMtprotoTask::checkCdnFileHash(
 		int64 offset,
 		bytes::const_span buffer) {
-	const auto cdnFileHashIt = _cdnFileHashes.find(offset);
-	if (cdnFileHashIt == _cdnFileHashes.cend()) {
+	if (firstMissingCdnHashOffset(offset, buffer.size())) {
 		return CheckCdnHashResult::NoHash;
 	}
-	const auto realHash = openssl::Sha256(buffer);
-	const auto receivedHash = bytes::make_span(cdnFileHashIt->second.hash);
-	if (bytes::compare(realHash, receivedHash)) {
-		return CheckCdnHashResult::Invalid;
+
+	// A part may be larger than a hashed range, check them one by one.
+	auto checked = int64(0);
+	while (checked < buffer.size()) {
+		const auto i = _cdnFileHashes.find(offset + checked);
+		Assert(i != _cdnFileHashes.cend());
+		if (i->second.limit <= 0) {
+			return CheckCdnHashResult::Invalid;
+		}
+		const auto size = std::min(
+			int64(i->second.limit),
+			int64(buffer.size()) - checked);
+		const auto realHash = openssl::Sha256(buffer.subspan(checked, size));
+		const auto receivedHash = bytes::make_span(i->second.hash);
+		if (bytes::compare(realHash, receivedHash)) {
+			return CheckCdnHashResult::Invalid;
+		}
+		checked += i->second.limit;
 	}
 	return CheckCdnHashResult::Good;
 }
 
+std::optional<int64> DownloadMtprotoTask::firstMissingCdnHashOffset(
+		int64 offset,
+		int64 size) const {
+	auto checked = int64(0);
+	do {
+		const auto i = _cdnFileHashes.find(offset + checked);
+		if (i == _cdnFileHashes.cend()) {
+			return offset + checked;
+		} else if (i->second.limit <= 0) {
+			// Bad limit, check it as if it was the last range.
+			return std::nullopt;
+		}
+		checked += i->second.limit;
+	} while (checked < size);
+	return std::nullopt;
+}
+
 void DownloadMtprotoTask::reuploadDone(
 		const MTPVector<MTPFileHash> &result,
 		mtpRequestId requestId) {
@@ -754,7 +895,7 @@ void DownloadMtprotoTask::getCdnFileHashesDone(
 	const auto requestData = finishSentRequest(
 		requestId,
 		FinishRequestReason::Redirect);
-	addCdnHashes(result.v);
+	const auto someMoreHashes = (addCdnHashes(result.v) > 0);
 	auto someMoreChecked = false;
 	for (auto i = _cdnUncheckedParts.begin(); i != _cdnUncheckedParts.cend();) {
 		const auto uncheckedData = i->first;
@@ -786,7 +927,7 @@ void DownloadMtprotoTask::getCdnFileHashesDone(
 		default: Unexpected("Result of checkCdnFileHash()");
 		}
 	}
-	if (!someMoreChecked) {
+	if (!someMoreChecked && !someMoreHashes) {
 		LOG(("API Error: "
 			"Could not find cdnFileHash for offset %1 "
 			"after getCdnFileHashes request."
@@ -807,7 +948,7 @@ void DownloadMtprotoTask::placeSentRequest(
 	const auto amount = _owner->changeRequestedAmount(
 		dcId(),
 		requestData.sessionIndex,
-		Storage::kDownloadPartSize);
+		requestData.limit);
 	const auto &[i, ok1] = _sentRequests.emplace(requestId, requestData);
 	const auto &[j, ok2] = _requestByOffset.emplace(
 		requestData.offset,
@@ -851,7 +992,7 @@ auto DownloadMtprotoTask::finishSentRequest(
 	_owner->changeRequestedAmount(
 		dcId(),
 		result.sessionIndex,
-		-Storage::kDownloadPartSize);
+		-result.limit);
 	_sentRequests.erase(it);
 	const auto ok = _requestByOffset.remove(result.offset);
 
@@ -863,6 +1004,7 @@ auto DownloadMtprotoTask::finishSentRequest(
 		_owner->requestSucceeded(
 			dcId(),
 			result.sessionIndex,
+			result.limit,
 			result.requestedInSession,
 			result.sent);
 	}
@@ -987,15 +1129,20 @@ void DownloadMtprotoTask::switchToCDN(
 		redirect.vfile_hashes().v);
 }
 
-void DownloadMtprotoTask::addCdnHashes(
+int DownloadMtprotoTask::addCdnHashes(
 		const QVector<MTPFileHash> &hashes) {
+	auto result = 0;
 	for (const auto &hash : hashes) {
 		hash.match([&](const MTPDfileHash &data) {
-			_cdnFileHashes.emplace(
+			const auto &[i, ok] = _cdnFileHashes.emplace(
 				data.voffset().v,
 				CdnFileHash{ data.vlimit().v, data.vhash().v });
+			if (ok) {
+				++result;
+			}
 		});
 	}
+	return result;
 }
 
 void DownloadMtprotoTask::changeCDNParams(
@@ -19,11 +19,18 @@ class Error;
 
 namespace Storage {
 
-// Different part sizes are not supported for now :(
-// Because we start downloading with some part size
-// and then we get a CDN-redirect where we support only
-// fixed part size download for hash checking.
+// Base part size, all the offsets are aligned at least by it.
+// Larger parts are powers-of-two multiples of it up to the max size,
+// CDN hashes are checked for each hashed range inside a larger part.
 constexpr auto kDownloadPartSize = 128 * 1024;
+constexpr auto kDownloadPartSizeMax = 1024 * 1024;
+
+// Largest allowed part size for a request starting at offset,
+// not exceeding maxLimit and not reaching too far after till (if set).
+[[nodiscard]] int ChooseDownloadPartSize(
+	int64 offset,
+	int64 till,
+	int maxLimit);
 
 class DownloadMtprotoTask;
 
@@ -52,6 +59,7 @@ public:
 	void requestSucceeded(
 		MTP::DcId dcId,
 		int index,
+		int limit,
 		int amountAtRequestStart,
 		crl::time timeAtRequestStart);
 	void checkSendNextAfterSuccess(MTP::DcId dcId);
@@ -88,6 +96,11 @@ private:
 		int requested = 0;
 		int successes = 0; // Since last timeout in this dc in any session.
 		int maxWaitedAmount = 0;
+
+		// Bandwidth-delay product estimation.
+		crl::time minDuration = 0;
+		crl::time minDurationUpdated = 0;
+		int64 bytesPerSecond = 0;
 	};
 	struct DcBalanceData {
 		DcBalanceData();
@@ -103,6 +116,15 @@ private:
 	void checkSendNext();
 	void checkSendNext(MTP::DcId dcId, Queue &queue);
 	bool trySendNextPart(MTP::DcId dcId, Queue &queue);
+	[[nodiscard]] int chooseMaxPartSize(
+		const DcSessionBalanceData &session) const;
+	void updateBandwidthEstimate(
+		MTP::DcId dcId,
+		int index,
+		DcSessionBalanceData &data,
+		int limit,
+		int amountAtRequestStart,
+		crl::time duration);
 
 	void killSessionsSchedule(MTP::DcId dcId);
 	void killSessionsCancel(MTP::DcId dcId);
@@ -155,7 +177,7 @@ public:
 	[[nodiscard]] const Location &location() const;
 
 	[[nodiscard]] virtual bool readyToRequest() const = 0;
-	void loadPart(int sessionIndex);
+	void loadPart(int sessionIndex, int maxLimit);
 	void removeSession(int sessionIndex);
 
 	void refreshFileReferenceFrom(
@@ -176,10 +198,16 @@ protected:
 		return _owner->api();
 	}
 
+	struct PartRequest {
+		int64 offset = 0;
+		int limit = kDownloadPartSize;
+	};
+
 private:
 	struct RequestData {
 		int64 offset = 0;
 		mutable int sessionIndex = 0;
+		int limit = kDownloadPartSize;
 		int requestedInSession = 0;
 		crl::time sent = 0;
 
@@ -206,6 +234,11 @@ private:
 
 	// Called only if readyToRequest() == true.
 	[[nodiscard]] virtual int64 takeNextRequestOffset() = 0;
+
+	// Called only if readyToRequest() == true.
+	// Tasks that accept larger parts may request up to maxLimit bytes,
+	// the returned limit should come from ChooseDownloadPartSize().
+	[[nodiscard]] virtual PartRequest takeNextRequest(int maxLimit);
 	virtual bool feedPart(int64 offset, const QByteArray &bytes) = 0;
 	virtual bool setWebFileSizeHook(int64 size);
 	virtual void cancelOnFail() = 0;
@@ -248,7 +281,10 @@ private:
 	void switchToCDN(
 		const RequestData &requestData,
 		const MTPDupload_fileCdnRedirect &redirect);
-	void addCdnHashes(const QVector<MTPFileHash> &hashes);
+	int addCdnHashes(const QVector<MTPFileHash> &hashes);
+	[[nodiscard]] std::optional<int64> firstMissingCdnHashOffset(
+		int64 offset,
+		int64 size) const;
 	void changeCDNParams(
 		const RequestData &requestData,
 		MTP::DcId dcId,
@@ -135,11 +135,23 @@ bool mtpFileLoader::readyToRequest() const {
 }
 
 int64 mtpFileLoader::takeNextRequestOffset() {
+	return takeNextRequest(Storage::kDownloadPartSize).offset;
+}
+
+auto mtpFileLoader::takeNextRequest(int maxLimit) -> PartRequest {
 	Expects(readyToRequest());
 
+	// Web files are requested by int offsets, keep them in base parts.
+	const auto large = v::is<StorageFileLocation>(location().data);
+	const auto limit = large
+		? Storage::ChooseDownloadPartSize(
+			_nextRequestOffset,
+			_fullSize ? _loadSize : 0,
+			maxLimit)
+		: Storage::kDownloadPartSize;
 	const auto result = _nextRequestOffset;
-	_nextRequestOffset += Storage::kDownloadPartSize;
-	return result;
+	_nextRequestOffset += limit;
+	return { result, limit };
 }
 
 bool mtpFileLoader::feedPart(int64 offset, const QByteArray &bytes) {
@@ -7,6 +7,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #include "storage/file_upload.h"
 
+#include "storage/file_upload_source.h"
 #include "api/api_editing.h"
 #include "api/api_send_progress.h"
 #include "storage/localimageloader.h"
@@ -26,11 +27,26 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 namespace Storage {
 namespace {
 
-// max 1mb uploaded at the same time in each session
-constexpr auto kMaxUploadPerSession = 1024 * 1024;
+// Start with 1mb uploaded at the same time in each session,
+// then follow twice the measured bandwidth-delay product of it.
+constexpr auto kStartUploadPerSession = 1024 * 1024;
+constexpr auto kMinUploadPerSession = 512 * 1024;
+constexpr auto kMaxUploadPerSession = 8 * 1024 * 1024;
+constexpr auto kBandwidthDelayFactor = 2;
+constexpr auto kMinDurationLifetime = 10 * crl::time(1000);
+constexpr auto kRateAverageWeight = 4;
+
+// Larger parts are used if a part is sent faster than that.
+constexpr auto kTargetPartDuration = crl::time(250);
+
+// Parts of that many files from the queue front are sent in parallel.
+constexpr auto kMaxFilesInParallel = 4;
 
 constexpr auto kDocumentMaxPartsCountDefault = 4000;
 
+// 32kb for photos and thumbnails
+constexpr auto kPhotoUploadPartSize = 32 * 1024;
+
 // 32kb for tiny document ( < 1mb )
 constexpr auto kDocumentUploadPartSize0 = 32 * 1024;
 
@@ -46,9 +62,6 @@ constexpr auto kDocumentUploadPartSize3 = 256 * 1024;
 // 512kb for large document ( <= 1500mb )
 constexpr auto kDocumentUploadPartSize4 = 512 * 1024;
 
-// One part each half second, if not uploaded faster.
-constexpr auto kUploadRequestInterval = crl::time(250);
-
 // How much time without upload causes additional session kill.
 constexpr auto kKillSessionTimeout = 15 * crl::time(1000);
 
@@ -70,24 +83,24 @@ constexpr auto kAcceptAsFastIfTotalAtLeast = 512 * 1024;
 } // namespace
 
 struct Uploader::Entry {
-	Entry(FullMsgId itemId, const std::shared_ptr<FilePrepareResult> &file);
+	Entry(
+		FullMsgId itemId,
+		const std::shared_ptr<FilePrepareResult> &file,
+		int preferredPartSize);
 
-	void setDocSize(int64 size);
-	bool setPartSize(int partSize);
+	void setDocSize(int64 size, int preferredPartSize);
 
 	// const, but non-const for the move-assignment in the
 	FullMsgId itemId;
 	std::shared_ptr<FilePrepareResult> file;
-	not_null<std::vector<QByteArray>*> parts;
+	UploadSource parts;
 	uint64 partsOfId = 0;
 
 	int64 sentSize = 0;
 	ushort partsSent = 0;
 	ushort partsWaiting = 0;
 
-	HashMd5 md5Hash;
-
-	std::unique_ptr<QFile> docFile;
+	UploadSource doc;
 	int64 docSize = 0;
 	int64 docSentSize = 0;
 	int docPartSize = 0;
@@ -109,15 +122,29 @@ struct Uploader::Request {
 	bool nonPremiumDelayed = false;
 };
 
+struct Uploader::DcIndex {
+	int sent = 0;
+	int window = kStartUploadPerSession;
+
+	// Bandwidth-delay product estimation.
+	int64 bytesPerSecond = 0;
+	crl::time minDuration = 0;
+	crl::time minDurationUpdated = 0;
+};
+
 Uploader::Entry::Entry(
 	FullMsgId itemId,
-	const std::shared_ptr<FilePrepareResult> &file)
+	const std::shared_ptr<FilePrepareResult> &file,
+	int preferredPartSize)
 : itemId(itemId)
 , file(file)
 , parts((file->type == SendMediaType::Photo
 	|| file->type == SendMediaType::Secure)
-		? &file->fileparts
-		: &file->thumbparts)
+		? file->filedata
+		: file->thumbbytes, std::clamp(
+			preferredPartSize,
+			kPhotoUploadPartSize,
+			kDocumentUploadPartSize2))
 , partsOfId((file->type == SendMediaType::Photo
 	|| file->type == SendMediaType::Secure)
 		? file->id
@@ -126,34 +153,42 @@ Uploader::Entry::Entry(
 		|| file->type == SendMediaType::ThemeFile
 		|| file->type == SendMediaType::Audio
 		|| file->type == SendMediaType::Round) {
-		setDocSize(file->filesize);
+		setDocSize(file->filesize, preferredPartSize);
 	}
 }
 
-void Uploader::Entry::setDocSize(int64 size) {
+void Uploader::Entry::setDocSize(int64 size, int preferredPartSize) {
 	docSize = size;
 	constexpr auto limit0 = 1024 * 1024;
 	constexpr auto limit1 = 32 * limit0;
-	if (docSize >= limit0 || !setPartSize(kDocumentUploadPartSize0)) {
-		if (docSize > limit1 || !setPartSize(kDocumentUploadPartSize1)) {
-			if (!setPartSize(kDocumentUploadPartSize2)) {
-				if (!setPartSize(kDocumentUploadPartSize3)) {
-					setPartSize(kDocumentUploadPartSize4);
-				}
-			}
-		}
+	const auto fits = [&](int partSize) {
+		return ((docSize + partSize - 1) / partSize)
+			<= kDocumentMaxPartsCountDefault;
+	};
+	docPartSize = (docSize < limit0 && fits(kDocumentUploadPartSize0))
+		? kDocumentUploadPartSize0
+		: (docSize <= limit1 && fits(kDocumentUploadPartSize1))
+		? kDocumentUploadPartSize1
+		: fits(kDocumentUploadPartSize2)
+		? kDocumentUploadPartSize2
+		: fits(kDocumentUploadPartSize3)
+		? kDocumentUploadPartSize3
+		: kDocumentUploadPartSize4;
+
+	// Fast connections use larger parts than the size requires.
+	docPartSize = std::max(docPartSize, preferredPartSize);
+	doc = !file->content.isEmpty()
+		? UploadSource(file->content, docPartSize)
+		: UploadSource(file->filepath, docSize, docPartSize);
+	docPartsCount = doc.partsCount();
+	if (docSize > kUseBigFilesFrom) {
+		// MTP big files are uploaded without md5 checksum.
+		doc.disableHashing();
 	}
 }
 
-bool Uploader::Entry::setPartSize(int partSize) {
-	docPartSize = partSize;
-	docPartsCount = (docSize + docPartSize - 1) / docPartSize;
-	return (docPartsCount <= kDocumentMaxPartsCountDefault);
-}
-
 Uploader::Uploader(not_null<ApiWrap*> api)
 : _api(api)
-, _nextTimer([=] { maybeSend(); })
 , _stopSessionsTimer([=] { stopSessions(); }) {
 	const auto session = &_api->session();
 	photoReady(
@@ -341,10 +376,8 @@ void Uploader::upload(
 				file->videoCover->photoThumbs);
 		}
 	}
-	_queue.push_back({ itemId, file });
-	if (!_nextTimer.isActive()) {
-		maybeSend();
-	}
+	_queue.push_back({ itemId, file, preferredPartSize() });
+	maybeSend();
 }
 
 void Uploader::failed(FullMsgId itemId) {
@@ -399,64 +432,32 @@ void Uploader::notifyFailed(const Entry &entry) {
 }
 
 void Uploader::stopSessions() {
-	if (ranges::any_of(_sentPerDcIndex, rpl::mappers::_1 != 0)) {
+	if (ranges::any_of(_dcIndices, rpl::mappers::_1 != 0, &DcIndex::sent)) {
 		_stopSessionsTimer.callOnce(kKillSessionTimeout);
 	} else {
-		for (auto i = 0; i != int(_sentPerDcIndex.size()); ++i) {
+		for (auto i = 0; i != int(_dcIndices.size()); ++i) {
 			_api->instance().stopSession(MTP::uploadDcId(i));
 		}
-		_sentPerDcIndex.clear();
+		_dcIndices.clear();
 		_dcIndicesWithFastRequests.clear();
 	}
 }
 
-QByteArray Uploader::readDocPart(not_null<Entry*> entry) {
-	const auto checked = [&](QByteArray result) {
-		if ((entry->file->type == SendMediaType::File
-			|| entry->file->type == SendMediaType::ThemeFile
-			|| entry->file->type == SendMediaType::Audio
-			|| entry->file->type == SendMediaType::Round)
-			&& entry->docSize <= kUseBigFilesFrom) {
-			entry->md5Hash.feed(result.data(), result.size());
-		}
-		if (result.isEmpty()
-			|| (result.size() > entry->docPartSize)
-			|| ((result.size() < entry->docPartSize
-				&& entry->docPartsSent + 1 != entry->docPartsCount))) {
-			return QByteArray();
-		}
-		return result;
-	};
-	auto &content = entry->file->content;
-	if (!content.isEmpty()) {
-		const auto offset = entry->docPartsSent * entry->docPartSize;
-		return checked(content.mid(offset, entry->docPartSize));
-	} else if (!entry->docFile) {
-		const auto filepath = entry->file->filepath;
-		entry->docFile = std::make_unique<QFile>(filepath);
-		if (!entry->docFile->open(QIODevice::ReadOnly)) {
-			return QByteArray();
-		}
-	}
-	return checked(entry->docFile->read(entry->docPartSize));
-}
-
 bool Uploader::canAddDcIndex() const {
-	const auto count = int(_sentPerDcIndex.size());
+	const auto count = int(_dcIndices.size());
 	return (count < kMaxSessionsCount)
 		&& (count == int(_dcIndicesWithFastRequests.size()));
 }
 
-std::optional<uchar> Uploader::chooseDcIndexForNextRequest(
-		const base::flat_set<uchar> &used) {
-	for (auto i = 0, count = int(_sentPerDcIndex.size()); i != count; ++i) {
-		if (!_sentPerDcIndex[i] && !used.contains(i)) {
+std::optional<uchar> Uploader::chooseDcIndexForNextRequest(int bytes) {
+	for (auto i = 0, count = int(_dcIndices.size()); i != count; ++i) {
+		if (!_dcIndices[i].sent) {
 			return i;
 		}
 	}
 	if (canAddDcIndex()) {
-		const auto result = int(_sentPerDcIndex.size());
-		_sentPerDcIndex.push_back(0);
+		const auto result = int(_dcIndices.size());
+		_dcIndices.push_back({});
 		_dcIndicesWithFastRequests.clear();
 		_latestDcIndexAdded = crl::now();
 
@@ -464,11 +465,12 @@ std::optional<uchar> Uploader::chooseDcIndexForNextRequest(
 		return result;
 	}
 	auto result = std::optional<int>();
-	for (auto i = 0, count = int(_sentPerDcIndex.size()); i != count; ++i) {
-		if (!used.contains(i)
-			&& (!result.has_value()
-				|| _sentPerDcIndex[i] < _sentPerDcIndex[*result])) {
+	auto resultFree = 0;
+	for (auto i = 0, count = int(_dcIndices.size()); i != count; ++i) {
+		const auto free = _dcIndices[i].window - _dcIndices[i].sent;
+		if (free >= bytes && (!result.has_value() || free > resultFree)) {
 			result = i;
+			resultFree = free;
 		}
 	}
 	return result;
@@ -482,27 +484,63 @@ Uploader::Entry *Uploader::chooseEntryForNextRequest() {
 		return &*i;
 	}
 
-	for (auto i = begin(_queue); i != end(_queue); ++i) {
-		if (i->partsSent < i->parts->size()
-			|| i->docPartsSent < i->docPartsCount) {
-			return &*i;
+	// Share the sessions between several files from the queue front,
+	// so that small photos of an album are not stuck behind a video.
+	auto result = (Entry*)nullptr;
+	auto resultInFlight = 0;
+	auto candidates = 0;
+	for (auto &entry : _queue) {
+		if (entry.partsSent >= entry.parts.partsCount()
+			&& entry.docPartsSent >= entry.docPartsCount) {
+			continue;
+		}
+		const auto inFlight = entry.partsWaiting * entry.parts.partSize()
+			+ entry.docPartsWaiting * entry.docPartSize;
+		if (!result || inFlight < resultInFlight) {
+			result = &entry;
+			resultInFlight = inFlight;
+		}
+		if (++candidates == kMaxFilesInParallel) {
+			break;
 		}
 	}
-	return nullptr;
+	return result;
+}
+
+int Uploader::nextPartSize(not_null<const Entry*> entry) const {
+	return !_pendingFromRemovedDcIndices.empty()
+		? int(_pendingFromRemovedDcIndices.front().bytes.size())
+		: (entry->partsSent < entry->parts.partsCount())
+		? entry->parts.partSize()
+		: entry->docPartSize;
+}
+
+int Uploader::preferredPartSize() const {
+	const auto bytes = _bytesPerSecond * kTargetPartDuration / 1000;
+	for (const auto size : {
+			kDocumentUploadPartSize4,
+			kDocumentUploadPartSize3,
+			kDocumentUploadPartSize2,
+			kDocumentUploadPartSize1 }) {
+		if (bytes >= size) {
+			return size;
+		}
+	}
+	return kDocumentUploadPartSize0;
 }
 
 auto Uploader::sendPart(not_null<Entry*> entry, uchar dcIndex)
 -> SendResult {
 	return !_pendingFromRemovedDcIndices.empty()
 		? sendPendingPart(entry, dcIndex)
-		: (entry->partsSent < entry->parts->size())
+		: (entry->partsSent < entry->parts.partsCount())
 		? sendSlicedPart(entry, dcIndex)
 		: sendDocPart(entry, dcIndex);
 }
 
 template <typename Prepared>
 void Uploader::sendPreparedRequest(Prepared &&prepared, Request &&request) {
-	auto &sentInSession = _sentPerDcIndex[request.dcIndex];
+	auto &sentInSession = _dcIndices[request.dcIndex].sent;
 	const auto queued = sentInSession;
 	sentInSession += int(request.bytes.size());
 
@@ -551,15 +589,16 @@ auto Uploader::sendPendingPart(not_null<Entry*> entry, uchar dcIndex)
 auto Uploader::sendDocPart(not_null<Entry*> entry, uchar dcIndex)
 -> SendResult {
 	const auto itemId = entry->itemId;
-	const auto alreadySent = _sentPerDcIndex[dcIndex];
+	const auto &index = _dcIndices[dcIndex];
 	const auto willProbablyBeSent = entry->docPartSize;
-	if (alreadySent + willProbablyBeSent > kMaxUploadPerSession) {
+	if (index.sent && index.sent + willProbablyBeSent > index.window) {
 		return SendResult::DcIndexFull;
 	}
 
 	Assert(entry->docPartsSent < entry->docPartsCount);
 
-	const auto partBytes = readDocPart(entry);
+	Assert(entry->doc.partsRead() == entry->docPartsSent);
+	const auto partBytes = entry->doc.readNextPart();
 	if (partBytes.isEmpty()) {
 		failed(itemId);
 		return SendResult::Failed;
@@ -597,15 +636,20 @@ auto Uploader::sendDocPart(not_null<Entry*> entry, uchar dcIndex)
 auto Uploader::sendSlicedPart(not_null<Entry*> entry, uchar dcIndex)
 -> SendResult {
 	const auto itemId = entry->itemId;
-	const auto alreadySent = _sentPerDcIndex[dcIndex];
-	const auto willBeSent = entry->parts->at(entry->partsSent).size();
-	if (alreadySent + willBeSent >= kMaxUploadPerSession) {
+	const auto &index = _dcIndices[dcIndex];
+	const auto willBeSent = entry->parts.partSize();
+	if (index.sent && index.sent + willBeSent > index.window) {
 		return SendResult::DcIndexFull;
 	}
 
+	Assert(entry->parts.partsRead() == entry->partsSent);
+	const auto partBytes = entry->parts.readNextPart();
+	if (partBytes.isEmpty()) {
+		failed(itemId);
+		return SendResult::Failed;
+	}
 	++entry->partsWaiting;
 	const auto index = entry->partsSent++;
-	const auto partBytes = entry->parts->at(index);
 	sendPreparedRequest(MTPupload_SaveFilePart(
 		MTP_long(entry->partsOfId),
 		MTP_int(index),
@@ -632,34 +676,23 @@ void Uploader::maybeSend() {
 		_stopSessionsTimer.cancel();
 	}
 
-	auto usedDcIndices = base::flat_set<uchar>();
+	// No fixed pacing, each session is filled up to its window and
+	// the next parts are sent when the previous ones are done.
 	while (true) {
-		const auto maybeDcIndex = chooseDcIndexForNextRequest(usedDcIndices);
-		if (!maybeDcIndex.has_value()) {
-			break;
+		const auto entry = chooseEntryForNextRequest();
+		if (!entry) {
+			return;
 		}
-		const auto dcIndex = *maybeDcIndex;
-		while (true) {
-			const auto entry = chooseEntryForNextRequest();
-			if (!entry) {
-				return;
-			}
-			const auto result = sendPart(entry, dcIndex);
-			if (result == SendResult::DcIndexFull) {
-				return;
-			} else if (result == SendResult::Success) {
-				break;
-			}
-			// If this entry failed, we try the next one.
+		const auto dcIndex = chooseDcIndexForNextRequest(
+			nextPartSize(entry));
+		if (!dcIndex.has_value()) {
+			return;
 		}
-		if (_sentPerDcIndex[dcIndex] >= kAcceptAsFastIfTotalAtLeast) {
-			usedDcIndices.emplace(dcIndex);
+		const auto result = sendPart(entry, *dcIndex);
+		if (result == SendResult::DcIndexFull) {
+			return;
 		}
-	}
-	if (usedDcIndices.empty()) {
-		_nextTimer.cancel();
-	} else {
-		_nextTimer.callOnce(kUploadRequestInterval);
+		// If this entry failed, we try the next one.
 	}
 }
 
@@ -688,7 +721,7 @@ void Uploader::cancelRequests(FullMsgId itemId) {
 	for (auto i = begin(_requests); i != end(_requests);) {
 		if (i->second.itemId == itemId) {
 			const auto bytes = int(i->second.bytes.size());
-			_sentPerDcIndex[i->second.dcIndex] -= bytes;
+			_dcIndices[i->second.dcIndex].sent -= bytes;
 			_api->request(i->first).cancel();
 			i = _requests.erase(i);
 		} else {
@@ -706,7 +739,9 @@ void Uploader::cancelAllRequests() {
 	for (const auto &[requestId, request] : base::take(_requests)) {
 		_api->request(requestId).cancel();
 	}
-	ranges::fill(_sentPerDcIndex, 0);
+	for (auto &index : _dcIndices) {
+		index.sent = 0;
+	}
 }
 
 void Uploader::clear() {
@@ -720,7 +755,7 @@ Uploader::Request Uploader::finishRequest(mtpRequestId requestId) {
 	const auto taken = _requests.take(requestId);
 	Assert(taken.has_value());
 
-	_sentPerDcIndex[taken->dcIndex] -= int(taken->bytes.size());
+	_dcIndices[taken->dcIndex].sent -= int(taken->bytes.size());
 	return *taken;
 }
 
@@ -745,12 +780,13 @@ void Uploader::partLoaded(const MTPBool &result, mtpRequestId requestId) {
 	const auto slowish = !fast;
 	const auto slow = (duration >= kSlowRequestThreshold);
 
+	updateBandwidthEstimate(request, duration);
 	if (slowish) {
 		_dcIndicesWithFastRequests.clear();
 		if (slow) {
 			const auto elapsed = (now - _latestDcIndexRemoved);
 			const auto remove = (elapsed >= kWaitForNormalizeTimeout);
-			if (remove && _sentPerDcIndex.size() > 1) {
+			if (remove && _dcIndices.size() > 1) {
 				DEBUG_LOG(("Uploader: Slow request, removing dc index."));
 				removeDcIndex();
 				_latestDcIndexRemoved = now;
@@ -765,7 +801,7 @@ void Uploader::partLoaded(const MTPBool &result, mtpRequestId requestId) {
 		if (_dcIndicesWithFastRequests.emplace(request.dcIndex).second) {
 			DEBUG_LOG(("Uploader: Mark %1 of %2 as fast."
 				).arg(request.dcIndex
-				).arg(_sentPerDcIndex.size()));
+				).arg(_dcIndices.size()));
 		}
 	}
 
@@ -812,14 +848,56 @@ void Uploader::partLoaded(const MTPBool &result, mtpRequestId requestId) {
 	maybeSend();
 }
 
+void Uploader::updateBandwidthEstimate(
+		const Request &request,
+		crl::time duration) {
+	auto &index = _dcIndices[request.dcIndex];
+	const auto now = crl::now();
+	const auto bytes = int(request.bytes.size());
+	duration = std::max(duration, crl::time(1));
+	if (duration >= kSlowRequestThreshold) {
+		index = DcIndex{ .sent = index.sent };
+		return;
+	}
+	if (!index.minDuration
+		|| duration <= index.minDuration
+		|| now - index.minDurationUpdated > kMinDurationLifetime) {
+		index.minDuration = duration;
+		index.minDurationUpdated = now;
+	}
+
+	// Everything that was in flight when the request was sent
+	// is delivered approximately by the time the request is finished.
+	const auto rate = int64(request.queued + bytes) * 1000 / duration;
+	index.bytesPerSecond = index.bytesPerSecond
+		? ((index.bytesPerSecond * (kRateAverageWeight - 1) + rate)
+			/ kRateAverageWeight)
+		: rate;
+	_bytesPerSecond = index.bytesPerSecond;
+
+	const auto product = index.bytesPerSecond * index.minDuration / 1000;
+	const auto target = int(std::clamp(
+		product * kBandwidthDelayFactor,
+		int64(kMinUploadPerSession),
+		int64(kMaxUploadPerSession)));
+	if (request.queued + bytes >= index.window) {
+		// The window was full, probe for more bandwidth.
+		index.window = std::min(
+			std::max(index.window + bytes, target),
+			kMaxUploadPerSession);
+	} else if (target > index.window) {
+		index.window = target;
+	}
+}
+
 void Uploader::removeDcIndex() {
-	Expects(_sentPerDcIndex.size() > 1);
+	Expects(_dcIndices.size() > 1);
 
-	const auto dcIndex = int(_sentPerDcIndex.size()) - 1;
+	const auto dcIndex = int(_dcIndices.size()) - 1;
 	for (auto i = begin(_requests); i != end(_requests);) {
 		if (i->second.dcIndex == dcIndex) {
 			const auto bytes = int(i->second.bytes.size());
-			_sentPerDcIndex[dcIndex] -= bytes;
+			_dcIndices[dcIndex].sent -= bytes;
 			_api->request(i->first).cancel();
 			_pendingFromRemovedDcIndices.push_back(std::move(i->second));
 			i = _requests.erase(i);
@@ -827,8 +905,8 @@ void Uploader::removeDcIndex() {
 			++i;
 		}
 	}
-	Assert(_sentPerDcIndex.back() == 0);
-	_sentPerDcIndex.pop_back();
+	Assert(_dcIndices.back().sent == 0);
+	_dcIndices.pop_back();
 	_dcIndicesWithFastRequests.remove(dcIndex);
 	_api->instance().stopSession(MTP::uploadDcId(dcIndex));
 	DEBUG_LOG(("Uploader: Removed dc index %1.").arg(dcIndex));
@@ -837,7 +915,7 @@ void Uploader::removeDcIndex() {
 void Uploader::maybeFinishFront() {
 	while (!_queue.empty()) {
 		const auto &entry = _queue.front();
-		if (entry.partsSent >= entry.parts->size()
+		if (entry.partsSent >= entry.parts.partsCount()
 			&& entry.docPartsSent >= entry.docPartsCount
 			&& !entry.partsWaiting
 			&& !entry.docPartsWaiting) {
@@ -870,10 +948,12 @@ void Uploader::finishFront() {
 			// because the filename from inputFile is not used anywhere.
 			photoFilename += u".jpg"_q;
 		}
-		const auto md5 = entry.file->filemd5;
+		const auto md5 = entry.file->filemd5.isEmpty()
+			? entry.parts.md5Hex()
+			: entry.file->filemd5;
 		const auto file = MTP_inputFile(
 			MTP_long(entry.file->id),
-			MTP_int(entry.parts->size()),
+			MTP_int(entry.parts.partsCount()),
 			MTP_string(photoFilename),
 			MTP_bytes(md5));
 		auto ready = UploadedMedia{
@@ -896,9 +976,6 @@ void Uploader::finishFront() {
 		|| entry.file->type == SendMediaType::ThemeFile
 		|| entry.file->type == SendMediaType::Audio
 		|| entry.file->type == SendMediaType::Round) {
-		QByteArray docMd5(32, Qt::Uninitialized);
-		hashMd5Hex(entry.md5Hash.result(), docMd5.data());
-
 		const auto file = (entry.docSize > kUseBigFilesFrom)
 			? MTP_inputFileBig(
 				MTP_long(entry.file->id),
@@ -908,16 +985,16 @@ void Uploader::finishFront() {
 				MTP_long(entry.file->id),
 				MTP_int(entry.docPartsCount),
 				MTP_string(entry.file->filename),
-				MTP_bytes(docMd5));
+				MTP_bytes(entry.doc.md5Hex()));
 		const auto thumb = [&]() -> std::optional<MTPInputFile> {
-			if (entry.parts->empty()) {
+			if (entry.parts.empty()) {
 				return std::nullopt;
 			}
 			const auto thumbFilename = entry.file->thumbname;
-			const auto thumbMd5 = entry.file->thumbmd5;
+			const auto thumbMd5 = entry.parts.md5Hex();
 			return MTP_inputFile(
 				MTP_long(entry.file->thumbId),
-				MTP_int(entry.parts->size()),
+				MTP_int(entry.parts.partsCount()),
 				MTP_string(thumbFilename),
 				MTP_bytes(thumbMd5));
 		}();
@@ -941,7 +1018,7 @@ void Uploader::finishFront() {
 		_secureReady.fire({
 			entry.itemId,
 			entry.file->id,
-			int(entry.parts->size()),
+			entry.parts.partsCount(),
 		});
 	}
 }
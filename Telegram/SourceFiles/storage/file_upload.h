@@ -103,6 +103,7 @@ public:
 private:
 	struct Entry;
 	struct Request;
+	struct DcIndex;
 
 	enum class SendResult : uchar {
 		Success,
@@ -113,8 +114,11 @@ private:
 	void maybeSend();
 	[[nodiscard]] bool canAddDcIndex() const;
 	[[nodiscard]] std::optional<uchar> chooseDcIndexForNextRequest(
-		const base::flat_set<uchar> &used);
+		int bytes);
 	[[nodiscard]] Entry *chooseEntryForNextRequest();
+	[[nodiscard]] int nextPartSize(not_null<const Entry*> entry) const;
+	[[nodiscard]] int preferredPartSize() const;
+	void updateBandwidthEstimate(const Request &request, crl::time duration);
 	[[nodiscard]] SendResult sendPart(not_null<Entry*> entry, uchar dcIndex);
 	[[nodiscard]] auto sendPendingPart(not_null<Entry*> entry, uchar dcIndex)
 		-> SendResult;
@@ -122,7 +126,6 @@ private:
 		-> SendResult;
 	[[nodiscard]] auto sendSlicedPart(not_null<Entry*> entry, uchar dcIndex)
 		-> SendResult;
-	[[nodiscard]] QByteArray readDocPart(not_null<Entry*> entry);
 	void removeDcIndex();
 
 	template <typename Prepared>
@@ -161,7 +164,8 @@ private:
 	std::vector<Entry> _queue;
 
 	base::flat_map<mtpRequestId, Request> _requests;
-	std::vector<int> _sentPerDcIndex;
+	std::vector<DcIndex> _dcIndices;
+	int64 _bytesPerSecond = 0; // Latest estimate in any session.
 
 	// Fast requests since the latest dc index addition.
 	base::flat_set<uchar> _dcIndicesWithFastRequests;
@@ -173,7 +177,7 @@ private:
 	base::flat_map<FullMsgId, UploadedMedia> _videoWaitingCover;
 
 	FullMsgId _pausedId;
-	base::Timer _nextTimer, _stopSessionsTimer;
+	base::Timer _stopSessionsTimer;
 
 	rpl::event_stream<UploadedMedia> _photoReady;
 	rpl::event_stream<UploadedMedia> _documentReady;
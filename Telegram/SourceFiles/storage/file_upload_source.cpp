@@ -0,0 +1,116 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "storage/file_upload_source.h"
+
+namespace Storage {
+namespace {
+
+[[nodiscard]] int CountParts(int64 size, int partSize) {
+	return partSize ? int((size + partSize - 1) / partSize) : 0;
+}
+
+} // namespace
+
+UploadSource::UploadSource(QByteArray data, int partSize)
+: _data(std::move(data))
+, _size(_data.size())
+, _partSize(partSize)
+, _partsCount(CountParts(_size, _partSize))
+, _md5(std::make_unique<HashMd5>()) {
+}
+
+UploadSource::UploadSource(QString path, int64 size, int partSize)
+: _path(std::move(path))
+, _size(size)
+, _partSize(partSize)
+, _partsCount(CountParts(_size, _partSize))
+, _md5(std::make_unique<HashMd5>()) {
+}
+
+UploadSource::UploadSource(UploadSource &&other) = default;
+
+UploadSource &UploadSource::operator=(UploadSource &&other) = default;
+
+UploadSource::~UploadSource() = default;
+
+bool UploadSource::empty() const {
+	return !_partsCount;
+}
+
+int64 UploadSource::size() const {
+	return _size;
+}
+
+int UploadSource::partSize() const {
+	return _partSize;
+}
+
+int UploadSource::partsCount() const {
+	return _partsCount;
+}
+
+int UploadSource::partsRead() const {
+	return _partsRead;
+}
+
+bool UploadSource::finished() const {
+	return (_partsRead >= _partsCount);
+}
+
+void UploadSource::disableHashing() {
+	Expects(!_partsRead);
+
+	_md5 = nullptr;
+}
+
+QByteArray UploadSource::readNextPart() {
+	if (finished()) {
+		return QByteArray();
+	}
+	const auto last = (_partsRead + 1 == _partsCount);
+	const auto offset = int64(_partsRead) * _partSize;
+	auto result = QByteArray();
+	if (!_data.isEmpty()) {
+		result = _data.mid(offset, _partSize);
+	} else {
+		if (!_file) {
+			_file = std::make_unique<QFile>(_path);
+			if (!_file->open(QIODevice::ReadOnly)) {
+				return QByteArray();
+			}
+		}
+		result = _file->read(_partSize);
+	}
+	if (result.isEmpty()
+		|| (result.size() > _partSize)
+		|| (result.size() < _partSize && !last)) {
+		return QByteArray();
+	}
+	if (_md5) {
+		_md5->feed(result.constData(), result.size());
+	}
+	if (++_partsRead == _partsCount) {
+		// Don't keep the file open while waiting for the last requests.
+		_file = nullptr;
+	}
+	return result;
+}
+
+QByteArray UploadSource::md5Hex() {
+	Expects(finished());
+	Expects(_md5 != nullptr || !_md5Hex.isEmpty());
+
+	if (_md5Hex.isEmpty()) {
+		_md5Hex.resize(32);
+		hashMd5Hex(_md5->result(), _md5Hex.data());
+		_md5 = nullptr;
+	}
+	return _md5Hex;
+}
+
+} // namespace Storage
@@ -0,0 +1,53 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+namespace Storage {
+
+// Sequentially reads an upload from memory or from disk part by part.
+// Each part is hashed once while it is read, so neither the whole file
+// nor a sliced copy of it is kept in memory during the upload.
+class UploadSource final {
+public:
+	UploadSource() = default;
+	UploadSource(QByteArray data, int partSize);
+	UploadSource(QString path, int64 size, int partSize);
+	UploadSource(UploadSource &&other);
+	UploadSource &operator=(UploadSource &&other);
+	~UploadSource();
+
+	[[nodiscard]] bool empty() const;
+	[[nodiscard]] int64 size() const;
+	[[nodiscard]] int partSize() const;
+	[[nodiscard]] int partsCount() const;
+	[[nodiscard]] int partsRead() const;
+	[[nodiscard]] bool finished() const;
+
+	void disableHashing();
+
+	// Returns an empty array if the part could not be read.
+	[[nodiscard]] QByteArray readNextPart();
+
+	// Hex md5 of the whole data, available after all parts were read.
+	[[nodiscard]] QByteArray md5Hex();
+
+private:
+	QByteArray _data;
+	QString _path;
+	std::unique_ptr<QFile> _file;
+	int64 _size = 0;
+	int _partSize = 0;
+	int _partsCount = 0;
+	int _partsRead = 0;
+
+	std::unique_ptr<HashMd5> _md5;
+	QByteArray _md5Hex;
+
+};
+
+} // namespace Storage
@@ -17,6 +17,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "base/options.h"
 #include "base/unixtime.h"
 #include "base/random.h"
+#include "base/invoke_queued.h"
 #include "editor/scene/scene_item_sticker.h"
 #include "editor/scene/scene.h"
 #include "media/audio/media_audio.h"
@@ -46,7 +47,6 @@ namespace {
 
 constexpr auto kThumbnailQuality = 87;
 constexpr auto kThumbnailSize = 320;
-constexpr auto kPhotoUploadPartSize = 32 * 1024;
 constexpr auto kRecompressAfterBpp = 4;
 
 using Ui::ValidateThumbDimensions;
@@ -222,7 +222,8 @@ int PhotoSideLimit() {
 	return PhotoSideLimit(SendLargePhotos.value());
 }
 
-TaskQueue::TaskQueue(crl::time stopTimeoutMs) {
+TaskQueue::TaskQueue(crl::time stopTimeoutMs, int threadsCount)
+: _threadsCount(std::max(threadsCount, 1)) {
 	if (stopTimeoutMs > 0) {
 		_stopTimer = new QTimer(this);
 		connect(_stopTimer, SIGNAL(timeout()), this, SLOT(stop()));
@@ -231,64 +232,141 @@ TaskQueue::TaskQueue(crl::time stopTimeoutMs) {
 	}
 }
 
-TaskId TaskQueue::addTask(std::unique_ptr<Task> &&task) {
+TaskId TaskQueue::addTask(std::unique_ptr<Task> &&task, int priority) {
 	const auto result = task->id();
 	{
 		QMutexLocker lock(&_tasksToProcessMutex);
-		_tasksToProcess.push_back(std::move(task));
+		enqueue(std::move(task), priority);
 	}
 
-	wakeThread();
+	wakeThreads();
 
 	return result;
 }
 
-void TaskQueue::addTasks(std::vector<std::unique_ptr<Task>> &&tasks) {
+void TaskQueue::addTasks(
+		std::vector<std::unique_ptr<Task>> &&tasks,
+		int priority) {
 	{
 		QMutexLocker lock(&_tasksToProcessMutex);
 		for (auto &task : tasks) {
-			_tasksToProcess.push_back(std::move(task));
+			enqueue(std::move(task), priority);
 		}
 	}
 
-	wakeThread();
+	wakeThreads();
 }
 
-void TaskQueue::wakeThread() {
-	if (!_thread) {
-		_thread = new QThread();
+void TaskQueue::enqueue(std::unique_ptr<Task> &&task, int priority) {
+	const auto order = ++_lastOrder;
+	{
+		QMutexLocker lock(&_tasksToFinishMutex);
+		_ordersToFinish.push_back(order);
+	}
+	const auto i = ranges::find_if(_tasksToProcess, [&](const Queued &q) {
+		return (q.priority < priority);
+	});
+	_tasksToProcess.insert(i, Queued{ std::move(task), order, priority });
+}
 
-		_worker = new TaskQueueWorker(this);
-		_worker->moveToThread(_thread);
+void TaskQueue::wakeThreads() {
+	if (_threads.empty()) {
+		for (auto i = 0; i != _threadsCount; ++i) {
+			const auto thread = new QThread();
+			const auto worker = new TaskQueueWorker(this);
+			worker->moveToThread(thread);
 
-		connect(this, SIGNAL(taskAdded()), _worker, SLOT(onTaskAdded()));
-		connect(_worker, SIGNAL(taskProcessed()), this, SLOT(onTaskProcessed()));
+			connect(this, SIGNAL(taskAdded()), worker, SLOT(onTaskAdded()));
+			connect(worker, SIGNAL(taskProcessed()), this, SLOT(onTaskProcessed()));
 
-		_thread->start();
+			thread->start();
+			_threads.push_back(thread);
+			_workers.push_back(worker);
+		}
 	}
 	if (_stopTimer) _stopTimer->stop();
 	taskAdded();
 }
 
+auto TaskQueue::takeTaskToProcess() -> Queued {
+	QMutexLocker lock(&_tasksToProcessMutex);
+	if (_tasksToProcess.empty()) {
+		return {};
+	}
+	auto result = std::move(_tasksToProcess.front());
+	_tasksToProcess.pop_front();
+	_tasksInProcess.push_back({ result.task.get(), result.order });
+	return result;
+}
+
+bool TaskQueue::taskProcessed(Queued &&queued) {
+	QMutexLocker lockToProcess(&_tasksToProcessMutex);
+	const auto i = ranges::find(
+		_tasksInProcess,
+		queued.task.get(),
+		&InProcess::task);
+	Assert(i != end(_tasksInProcess));
+	_tasksInProcess.erase(i);
+	if (queued.task->cancelled()) {
+		return false;
+	}
+
+	QMutexLocker lockToFinish(&_tasksToFinishMutex);
+	Assert(!_ordersToFinish.empty());
+	_tasksToFinish.emplace(queued.order, std::move(queued.task));
+
+	// Only the earliest task may be finished right now.
+	return (_ordersToFinish.front() == queued.order);
+}
+
 void TaskQueue::cancelTask(TaskId id) {
-	const auto removeFrom = [&](std::deque<std::unique_ptr<Task>> &queue) {
-		const auto proj = [](const std::unique_ptr<Task> &task) {
-			return task->id();
-		};
-		auto i = ranges::find(queue, id, proj);
-		if (i != queue.end()) {
-			queue.erase(i);
-		}
+	const auto proj = [](const auto &entry) {
+		return entry.task->id();
 	};
+	auto order = std::optional<uint64>();
+	auto removed = std::unique_ptr<Task>();
+	auto canFinishMore = false;
 	{
 		QMutexLocker lock(&_tasksToProcessMutex);
-		removeFrom(_tasksToProcess);
-		if (_taskInProcessId == id) {
-			_taskInProcessId = TaskId();
+		const auto i = ranges::find(_tasksToProcess, id, proj);
+		if (i != end(_tasksToProcess)) {
+			order = i->order;
+			removed = std::move(i->task);
+			_tasksToProcess.erase(i);
+		} else {
+			const auto j = ranges::find(_tasksInProcess, id, proj);
+			if (j != end(_tasksInProcess)) {
+				// The worker will drop it when process() returns.
+				j->task->_cancelled.store(true, std::memory_order_release);
+				order = j->order;
+			}
+		}
+
+		QMutexLocker lockToFinish(&_tasksToFinishMutex);
+		if (!order) {
+			const auto k = ranges::find(_tasksToFinish, id, [](const auto &p) {
+				return p.second->id();
+			});
+			if (k != end(_tasksToFinish)) {
+				order = k->first;
+				removed = std::move(k->second);
+				_tasksToFinish.erase(k);
+			}
+		}
+		if (order) {
+			const auto wasFirst = !_ordersToFinish.empty()
+				&& (_ordersToFinish.front() == *order);
+			_ordersToFinish.erase(
+				ranges::remove(_ordersToFinish, *order),
+				end(_ordersToFinish));
+			canFinishMore = wasFirst
+				&& !_ordersToFinish.empty()
+				&& _tasksToFinish.contains(_ordersToFinish.front());
 		}
 	}
-	QMutexLocker lock(&_tasksToFinishMutex);
-	removeFrom(_tasksToFinish);
+	if (canFinishMore) {
+		InvokeQueued(this, [=] { onTaskProcessed(); });
+	}
 }
 
 void TaskQueue::onTaskProcessed() {
@@ -296,33 +374,45 @@ void TaskQueue::onTaskProcessed() {
 		auto task = std::unique_ptr<Task>();
 		{
 			QMutexLocker lock(&_tasksToFinishMutex);
-			if (_tasksToFinish.empty()) break;
-			task = std::move(_tasksToFinish.front());
-			_tasksToFinish.pop_front();
+			if (_ordersToFinish.empty()) break;
+			const auto i = _tasksToFinish.find(_ordersToFinish.front());
+			if (i == end(_tasksToFinish)) break;
+			task = std::move(i->second);
+			_tasksToFinish.erase(i);
+			_ordersToFinish.pop_front();
 		}
 		task->finish();
 	} while (true);
 
 	if (_stopTimer) {
 		QMutexLocker lock(&_tasksToProcessMutex);
-		if (_tasksToProcess.empty() && !_taskInProcessId) {
+		if (_tasksToProcess.empty() && _tasksInProcess.empty()) {
 			_stopTimer->start();
 		}
 	}
 }
 
 void TaskQueue::stop() {
-	if (_thread) {
-		_thread->requestInterruption();
-		_thread->quit();
-		DEBUG_LOG(("Waiting for taskThread to finish"));
-		_thread->wait();
-		delete base::take(_worker);
-		delete base::take(_thread);
+	for (const auto thread : _threads) {
+		thread->requestInterruption();
+		thread->quit();
+	}
+	if (!_threads.empty()) {
+		DEBUG_LOG(("Waiting for taskThreads to finish"));
+	}
+	for (const auto thread : _threads) {
+		thread->wait();
+	}
+	for (const auto worker : base::take(_workers)) {
+		delete worker;
+	}
+	for (const auto thread : base::take(_threads)) {
+		delete thread;
 	}
 	_tasksToProcess.clear();
+	_tasksInProcess.clear();
 	_tasksToFinish.clear();
-	_taskInProcessId = TaskId();
+	_ordersToFinish.clear();
 }
 
 TaskQueue::~TaskQueue() {
@@ -334,38 +424,17 @@ void TaskQueueWorker::onTaskAdded() {
 	if (_inTaskAdded) return;
 	_inTaskAdded = true;
 
-	bool someTasksLeft = false;
-	do {
-		auto task = std::unique_ptr<Task>();
-		{
-			QMutexLocker lock(&_queue->_tasksToProcessMutex);
-			if (!_queue->_tasksToProcess.empty()) {
-				task = std::move(_queue->_tasksToProcess.front());
-				_queue->_tasksToProcess.pop_front();
-				_queue->_taskInProcessId = task->id();
-			}
+	while (!thread()->isInterruptionRequested()) {
+		auto queued = _queue->takeTaskToProcess();
+		if (!queued.task) {
+			break;
 		}
-
-		if (task) {
-			task->process();
-			bool emitTaskProcessed = false;
-			{
-				QMutexLocker lockToProcess(&_queue->_tasksToProcessMutex);
-				if (_queue->_taskInProcessId == task->id()) {
-					_queue->_taskInProcessId = TaskId();
-					someTasksLeft = !_queue->_tasksToProcess.empty();
-
-					QMutexLocker lockToFinish(&_queue->_tasksToFinishMutex);
-					emitTaskProcessed = _queue->_tasksToFinish.empty();
-					_queue->_tasksToFinish.push_back(std::move(task));
-				}
-			}
-			if (emitTaskProcessed) {
-				taskProcessed();
-			}
+		queued.task->process();
+		if (_queue->taskProcessed(std::move(queued))) {
+			taskProcessed();
 		}
 		QCoreApplication::processEvents();
-	} while (someTasksLeft && !thread()->isInterruptionRequested());
+	}
 
 	_inTaskAdded = false;
 }
@@ -433,32 +502,12 @@ FilePrepareResult::FilePrepareResult(FilePrepareDescriptor &&descriptor)
 }
 
 void FilePrepareResult::setFileData(const QByteArray &filedata) {
-	if (filedata.isEmpty()) {
-		partssize = 0;
-	} else {
-		partssize = filedata.size();
-		fileparts.reserve(
-			(partssize + kPhotoUploadPartSize - 1) / kPhotoUploadPartSize);
-		for (int32 i = 0, part = 0; i < partssize; i += kPhotoUploadPartSize, ++part) {
-			fileparts.push_back(filedata.mid(i, kPhotoUploadPartSize));
-		}
-		filemd5.resize(32);
-		hashMd5Hex(filedata.constData(), filedata.size(), filemd5.data());
-	}
+	this->filedata = filedata;
+	partssize = filedata.size();
 }
 
 void FilePrepareResult::setThumbData(const QByteArray &thumbdata) {
-	if (!thumbdata.isEmpty()) {
-		thumbbytes = thumbdata;
-		int32 size = thumbdata.size();
-		thumbparts.reserve(
-			(size + kPhotoUploadPartSize - 1) / kPhotoUploadPartSize);
-		for (int32 i = 0, part = 0; i < size; i += kPhotoUploadPartSize, ++part) {
-			thumbparts.push_back(thumbdata.mid(i, kPhotoUploadPartSize));
-		}
-		thumbmd5.resize(32);
-		hashMd5Hex(thumbdata.constData(), thumbdata.size(), thumbmd5.data());
-	}
+	thumbbytes = thumbdata;
 }
 
 std::shared_ptr<FilePrepareResult> MakePreparedFile(
@@ -697,11 +746,14 @@ void FileLoadTask::process(Args &&args) {
 		cover->process();
 		if (const auto &result = cover->peekResult()) {
 			if (result->type == SendMediaType::Photo
-				&& !result->fileparts.empty()) {
+				&& !result->filedata.isEmpty()) {
 				_result->videoCover = result;
 			}
 		}
 	}
+	if (cancelled()) {
+		return;
+	}
 
 	QString filename, filemime;
 	qint64 filesize = 0;
@@ -818,7 +870,7 @@ void FileLoadTask::process(Args &&args) {
 	}
 	_result->filesize = qMin(filesize, qint64(UINT_MAX));
 
-	if (!filesize || filesize > kFileSizePremiumLimit) {
+	if (!filesize || filesize > kFileSizePremiumLimit || cancelled()) {
 		return;
 	}
 
@@ -988,6 +1040,9 @@ void FileLoadTask::process(Args &&args) {
 			thumbnail = PrepareFileThumbnail(std::move(fullimage));
 		}
 	}
+	if (cancelled()) {
+		return;
+	}
 	thumbnail = FinalizeFileThumbnail(
 		std::move(thumbnail),
 		filemime,
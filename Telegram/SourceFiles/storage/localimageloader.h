@@ -50,6 +50,16 @@ public:
 		return static_cast<TaskId>(const_cast<Task*>(this));
 	}
 
+	// May be checked from process() to stop early, finish() won't be called.
+	[[nodiscard]] bool cancelled() const {
+		return _cancelled.load(std::memory_order_acquire);
+	}
+
+private:
+	friend class TaskQueue;
+
+	std::atomic<bool> _cancelled = false;
+
 };
 
 class TaskQueueWorker;
@@ -57,10 +67,15 @@ class TaskQueue : public QObject {
 	Q_OBJECT
 
 public:
-	explicit TaskQueue(crl::time stopTimeoutMs = 0); // <= 0 - never stop worker
-
-	TaskId addTask(std::unique_ptr<Task> &&task);
-	void addTasks(std::vector<std::unique_ptr<Task>> &&tasks);
+	// stopTimeoutMs <= 0 - never stop workers.
+	explicit TaskQueue(crl::time stopTimeoutMs = 0, int threadsCount = 1);
+
+	// Tasks with higher priority are processed first, but finish() calls
+	// are always made in the order in which the tasks were added.
+	TaskId addTask(std::unique_ptr<Task> &&task, int priority = 0);
+	void addTasks(
+		std::vector<std::unique_ptr<Task>> &&tasks,
+		int priority = 0);
 	void cancelTask(TaskId id); // this task finish() won't be called
 
 	~TaskQueue();
@@ -75,14 +90,36 @@ public Q_SLOTS:
 private:
 	friend class TaskQueueWorker;
 
-	void wakeThread();
+	struct Queued {
+		std::unique_ptr<Task> task;
+		uint64 order = 0;
+		int priority = 0;
+	};
+	struct InProcess {
+		not_null<Task*> task;
+		uint64 order = 0;
+	};
+
+	void enqueue(std::unique_ptr<Task> &&task, int priority);
+	void wakeThreads();
+
+	// Called from worker threads.
+	[[nodiscard]] Queued takeTaskToProcess();
+	[[nodiscard]] bool taskProcessed(Queued &&queued);
+
+	const int _threadsCount = 1;
+
+	std::deque<Queued> _tasksToProcess; // Sorted by priority, then order.
+	std::vector<InProcess> _tasksInProcess;
+	uint64 _lastOrder = 0;
+	QMutex _tasksToProcessMutex;
+
+	std::deque<uint64> _ordersToFinish;
+	base::flat_map<uint64, std::unique_ptr<Task>> _tasksToFinish;
+	QMutex _tasksToFinishMutex;
 
-	std::deque<std::unique_ptr<Task>> _tasksToProcess;
-	std::deque<std::unique_ptr<Task>> _tasksToFinish;
-	TaskId _taskInProcessId = TaskId();
-	QMutex _tasksToProcessMutex, _tasksToFinishMutex;
-	QThread *_thread = nullptr;
-	TaskQueueWorker *_worker = nullptr;
+	std::vector<QThread*> _threads;
+	std::vector<TaskQueueWorker*> _workers;
 	QTimer *_stopTimer = nullptr;
 
 };
@@ -149,7 +186,6 @@ struct FileLoadTo {
 	MsgId replaceMediaOf;
 };
 
-using UploadFileParts = std::vector<QByteArray>;
 struct FilePrepareDescriptor {
 	TaskId taskId = kEmptyTaskId;
 	base::required<uint64> id;
@@ -173,15 +209,13 @@ struct FilePrepareResult {
 	QString filename;
 	QString filemime;
 	int64 filesize = 0;
-	UploadFileParts fileparts;
-	QByteArray filemd5;
+	QByteArray filedata; // Sliced in parts by the Uploader.
+	QByteArray filemd5; // Counted by the Uploader, if not known.
 	int64 partssize = 0;
 
 	uint64 thumbId = 0; // id is always file-id of media, thumbId is file-id of thumb ( == id for photos)
 	QString thumbname;
-	UploadFileParts thumbparts;
 	QByteArray thumbbytes;
-	QByteArray thumbmd5;
 	QImage thumb;
 
 	QImage goodThumbnail;
@@ -11,6 +11,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "storage/storage_account.h"
 #include "storage/details/storage_file_utilities.h"
 #include "storage/details/storage_settings_scheme.h"
+#include "storage/cache/storage_cache_database.h"
 #include "data/data_session.h"
 #include "data/data_document.h"
 #include "data/data_document_media.h"
@@ -44,7 +45,6 @@ namespace Local {
 namespace {
 
 constexpr auto kThemeFileSizeLimit = 5 * 1024 * 1024;
-constexpr auto kFileLoaderQueueStopTimeout = crl::time(5000);
 
 constexpr auto kSavedBackgroundFormat = QImage::Format_ARGB32_Premultiplied;
 constexpr auto kWallPaperLegacySerializeTagId = int32(-111);
@@ -60,8 +60,6 @@ using Database = Storage::Cache::Database;
 
 QString _basePath, _userBasePath, _userDbPath;
 
-TaskQueue *_localLoader = nullptr;
-
 QByteArray _settingsSalt;
 
 auto OldKey = MTP::AuthKeyPtr();
@@ -342,7 +340,6 @@ void sync() {
 }
 
 void finish() {
-	delete base::take(_localLoader);
 	Storage::details::Finish();
 }
 
@@ -353,8 +350,6 @@ void readLangPack();
 void start() {
 	Expects(_basePath.isEmpty());
 
-	_localLoader = new TaskQueue(kFileLoaderQueueStopTimeout);
-
 	_basePath = cWorkingDir() + u"tdata/"_q;
 	if (!QDir().exists(_basePath)) QDir().mkpath(_basePath);
 
@@ -789,10 +784,6 @@ void moveLegacyBackground(
 }
 
 void reset() {
-	if (_localLoader) {
-		_localLoader->stop();
-	}
-
 	Window::Theme::Background()->reset();
 	_oldSettingsVersion = 0;
 	Core::App().settings().resetOnLastLogout();
@@ -803,74 +794,97 @@ int32 oldSettingsVersion() {
 	return _oldSettingsVersion;
 }
 
-class CountWaveformTask : public Task {
-public:
-	CountWaveformTask(not_null<Data::DocumentMedia*> media)
-	: _doc(media->owner())
-	, _loc(_doc->location(true))
-	, _data(media->bytes())
-	, _wavemax(0) {
-		if (_data.isEmpty() && !_loc.accessEnable()) {
-			_doc = nullptr;
-		}
-	}
-	void process() override {
-		if (!_doc) return;
+namespace {
 
-		_waveform = audioCountWaveform(_loc, _data);
-		_wavemax = _waveform.empty()
-			? char(0)
-			: *ranges::max_element(_waveform);
-	}
-	void finish() override {
-		if (const auto voice = _doc ? _doc->voice() : nullptr) {
-			if (!_waveform.isEmpty()) {
-				voice->waveform = _waveform;
-				voice->wavemax = _wavemax;
-			}
-			if (voice->waveform.isEmpty()) {
-				voice->waveform.resize(1);
-				voice->waveform[0] = -2;
-				voice->wavemax = 0;
-			} else if (voice->waveform[0] < 0) {
-				voice->waveform[0] = -2;
-				voice->wavemax = 0;
-			}
-			_doc->owner().requestDocumentViewRepaint(_doc);
+void ApplyCountedWaveform(
+		base::weak_ptr<Main::Session> guard,
+		not_null<DocumentData*> document,
+		VoiceWaveform waveform,
+		bool store) {
+	crl::on_main(guard, [=] {
+		if (store) {
+			// Remember failures as well, so that they are not counted again.
+			auto bytes = waveform.isEmpty()
+				? QByteArray(1, char(-2))
+				: QByteArray(
+					reinterpret_cast<const char*>(waveform.constData()),
+					waveform.size());
+			document->owner().cache().putIfEmpty(
+				document->waveformCacheKey(),
+				Storage::Cache::Database::TaggedValue(
+					std::move(bytes),
+					Data::kVoiceMessageCacheTag));
 		}
-	}
-	~CountWaveformTask() {
-		if (_data.isEmpty() && _doc) {
-			_loc.accessDisable();
+		const auto voice = document->voice();
+		if (!voice) {
+			return;
 		}
-	}
-
-protected:
-	DocumentData *_doc = nullptr;
-	Core::FileLocation _loc;
-	QByteArray _data;
-	VoiceWaveform _waveform;
-	char _wavemax;
+		if (!waveform.isEmpty()) {
+			voice->waveform = waveform;
+			voice->wavemax = *ranges::max_element(waveform);
+		}
+		if (voice->waveform.isEmpty()) {
+			voice->waveform.resize(1);
+			voice->waveform[0] = -2;
+			voice->wavemax = 0;
+		} else if (voice->waveform[0] < 0) {
+			voice->waveform[0] = -2;
+			voice->wavemax = 0;
+		}
+		document->owner().requestDocumentViewRepaint(document);
+	});
+}
 
-};
+} // namespace
 
 void countVoiceWaveform(not_null<Data::DocumentMedia*> media) {
 	const auto document = media->owner();
-	if (const auto voice = document->voice()) {
-		if (_localLoader) {
-			voice->waveform.resize(1 + sizeof(TaskId));
-			voice->waveform[0] = -1; // counting
-			TaskId taskId = _localLoader->addTask(
-				std::make_unique<CountWaveformTask>(media));
-			memcpy(voice->waveform.data() + 1, &taskId, sizeof(taskId));
-		}
+	const auto voice = document->voice();
+	if (!voice) {
+		return;
 	}
-}
+	voice->waveform.resize(1);
+	voice->waveform[0] = -1; // counting
 
-void cancelTask(TaskId id) {
-	if (_localLoader) {
-		_localLoader->cancelTask(id);
+	const auto data = media->bytes();
+	auto location = document->location(true);
+	if (data.isEmpty() && !location.accessEnable()) {
+		return;
 	}
+
+	// The cache lookup and the decoding both run off the main thread.
+	const auto guard = base::make_weak(&document->session());
+	const auto key = document->waveformCacheKey();
+	document->owner().cache().get(key, [=](QByteArray value) mutable {
+		if (!value.isEmpty()) {
+			if (data.isEmpty()) {
+				location.accessDisable();
+			}
+			ApplyCountedWaveform(
+				guard,
+				document,
+				VoiceWaveform(value.cbegin(), value.cend()),
+				false);
+			return;
+		}
+		// Start decoding only if the session is still alive,
+		// the document pointer is used only through the guard.
+		crl::on_main([=]() mutable {
+			if (!guard) {
+				if (data.isEmpty()) {
+					location.accessDisable();
+				}
+				return;
+			}
+			crl::async([=]() mutable {
+				const auto waveform = audioCountWaveform(location, data);
+				if (data.isEmpty()) {
+					location.accessDisable();
+				}
+				ApplyCountedWaveform(guard, document, waveform, true);
+			});
+		});
+	});
 }
 
 Window::Theme::Saved readThemeUsingKey(FileKey key) {
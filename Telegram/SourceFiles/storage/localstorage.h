@@ -72,8 +72,6 @@ int32 oldSettingsVersion();
 
 void countVoiceWaveform(not_null<Data::DocumentMedia*> media);
 
-void cancelTask(TaskId id);
-
 void writeTheme(const Window::Theme::Saved &saved);
 void clearTheme();
 [[nodiscard]] Window::Theme::Saved readThemeAfterSwitch();
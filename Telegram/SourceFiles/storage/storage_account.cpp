@@ -39,6 +39,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "webview/webview_interface.h"
 #include "window/themes/window_theme.h"
 
+#include <xxhash.h>
+
 namespace Storage {
 namespace {
 
@@ -50,7 +52,7 @@ constexpr auto kWriteSearchSuggestionsDelay = 5 * crl::time(1000);
 constexpr auto kMaxSavedPlaybackPositions = 256;
 
 constexpr auto kStickersVersionTag = quint32(-1);
-constexpr auto kStickersSerializeVersion = 4;
+constexpr auto kStickersSerializeVersion = 5; // Set contents in own files.
 constexpr auto kMaxSavedStickerSetsCount = 1000;
 constexpr auto kDefaultStickerInstallDate = TimeId(1);
 
@@ -69,6 +71,56 @@ constexpr auto kMultiDraftCursorsTag = quint64(0xFFFF'FFFF'FFFF'FF04ULL);
 constexpr auto kRichDraftsTag = quint64(0xFFFF'FFFF'FFFF'FF05ULL);
 constexpr auto kDraftsTag2 = quint64(0xFFFF'FFFF'FFFF'FF06ULL);
 
+[[nodiscard]] uint32 StickerSetInfoSize(const Data::StickersSet &set) {
+	// id
+	// + accessHash
+	// + hash
+	// + title
+	// + shortName
+	// + stickersCount
+	// + flags
+	// + installDate
+	// + thumbnailDocumentId
+	// + thumbnailType
+	// + thumbnailLocation
+	return sizeof(quint64) * 3
+		+ Serialize::stringSize(set.title)
+		+ Serialize::stringSize(set.shortName)
+		+ sizeof(qint32) * 3
+		+ sizeof(quint64)
+		+ sizeof(qint32)
+		+ Serialize::imageLocationSize(set.thumbnailLocation());
+}
+
+[[nodiscard]] uint32 StickerSetContentsSize(const Data::StickersSet &set) {
+	auto result = uint32(0);
+	for (const auto sticker : set.stickers) {
+		result += Serialize::Document::sizeInStream(sticker);
+	}
+
+	result += sizeof(qint32); // datesCount
+	if (!set.dates.empty()) {
+		Assert(set.stickers.size() == set.dates.size());
+		result += set.dates.size() * sizeof(qint32);
+	}
+
+	result += sizeof(qint32); // emojiCount
+	for (const auto &[emoji, pack] : set.emoji) {
+		result += Serialize::stringSize(emoji->id())
+			+ sizeof(qint32)
+			+ (pack.size() * sizeof(quint64));
+	}
+	return result;
+}
+
+// Covers the serialized documents as well, so that a changed file
+// reference or thumbnail of a sticker rewrites the set file.
+[[nodiscard]] uint64 StickerSetContentsFingerprint(
+		const QByteArray &contents) {
+	const auto result = XXH64(contents.constData(), contents.size(), 0);
+	return result ? result : 1; // Zero means "not written yet".
+}
+
 enum { // Local Storage Keys
 	lskUserMap = 0x00,
 	lskDraft = 0x01, // data: PeerId peer
@@ -100,6 +152,7 @@ enum { // Local Storage Keys
 	lskInlineBotsDownloads = 0x1b, // no data
 	lskMediaLastPlaybackPositions = 0x1c, // no data
 	lskBotStorages = 0x1d, // data: PeerId botId
+	lskStickerSetFiles = 0x1e, // data: FileKey listKey, quint64 setId
 };
 
 auto EmptyMessageDraftSources()
@@ -287,6 +340,9 @@ base::flat_set<QString> Account::collectGoodNames() const {
 	for (const auto &[key, value] : _botStoragesMap) {
 		push(value);
 	}
+	for (const auto &[key, file] : _stickerSetFiles) {
+		push(file.key);
+	}
 	for (const auto &value : keys) {
 		push(value);
 	}
@@ -342,6 +398,7 @@ Account::ReadMapResult Account::readMapWith(
 	base::flat_map<PeerId, bool> draftsNotReadMap;
 	base::flat_map<PeerId, FileKey> botStoragesMap;
 	base::flat_map<PeerId, bool> botStoragesNotReadMap;
+	base::flat_map<std::pair<FileKey, uint64>, StickerSetFile> stickerSetFiles;
 	quint64 locationsKey = 0, reportSpamStatusesKey = 0, trustedPeersKey = 0;
 	quint64 recentStickersKeyOld = 0;
 	quint64 installedStickersKey = 0, featuredStickersKey = 0, recentStickersKey = 0, favedStickersKey = 0, archivedStickersKey = 0;
@@ -489,6 +546,18 @@ Account::ReadMapResult Account::readMapWith(
 				botStoragesNotReadMap.emplace(peerId, true);
 			}
 		} break;
+		case lskStickerSetFiles: {
+			quint32 count = 0;
+			map.stream >> count;
+			for (quint32 i = 0; i < count; ++i) {
+				FileKey key = 0, listKey = 0;
+				quint64 setId = 0;
+				map.stream >> key >> listKey >> setId;
+				stickerSetFiles.emplace(
+					std::make_pair(listKey, setId),
+					StickerSetFile{ .key = key });
+			}
+		} break;
 		default:
 			LOG(("App Error: unknown key type in encrypted map: %1").arg(keyType));
 			return ReadMapResult::Failed;
@@ -505,6 +574,7 @@ Account::ReadMapResult Account::readMapWith(
 	_draftsNotReadMap = draftsNotReadMap;
 	_botStoragesMap = botStoragesMap;
 	_botStoragesNotReadMap = botStoragesNotReadMap;
+	_stickerSetFiles = stickerSetFiles;
 
 	_locationsKey = locationsKey;
 	_trustedPeersKey = trustedPeersKey;
@@ -540,6 +610,18 @@ Account::ReadMapResult Account::readMapWith(
 		_mapChanged = false;
 	}
 
+	// These files don't depend on each other, decrypt them in parallel.
+	auto prefetch = std::vector<PrefetchedFiles::Request>();
+	prefetch.push_back({ ToFilePart(_dataNameKey), BaseGlobalPath() });
+	if (_settingsKey) {
+		prefetch.push_back({ ToFilePart(_settingsKey), _basePath });
+	}
+	if (_locationsKey) {
+		prefetch.push_back({ ToFilePart(_locationsKey), _basePath });
+	}
+	_prefetched = std::make_unique<PrefetchedFiles>(prefetch, _localKey);
+	const auto guard = gsl::finally([&] { _prefetched = nullptr; });
+
 	if (_locationsKey) {
 		readLocations();
 	}
@@ -648,6 +730,7 @@ void Account::writeMap() {
 	if (_inlineBotsDownloadsKey) mapSize += sizeof(quint32) + sizeof(quint64);
 	if (_mediaLastPlaybackPositionsKey) mapSize += sizeof(quint32) + sizeof(quint64);
 	if (!_botStoragesMap.empty()) mapSize += sizeof(quint32) * 2 + _botStoragesMap.size() * sizeof(quint64) * 2;
+	if (!_stickerSetFiles.empty()) mapSize += sizeof(quint32) * 2 + _stickerSetFiles.size() * sizeof(quint64) * 3;
 
 	EncryptedDescriptor mapData(mapSize);
 	if (!self.isEmpty()) {
@@ -736,6 +819,15 @@ void Account::writeMap() {
 			mapData.stream << quint64(value) << SerializePeerId(key);
 		}
 	}
+	if (!_stickerSetFiles.empty()) {
+		mapData.stream << quint32(lskStickerSetFiles) << quint32(_stickerSetFiles.size());
+		for (const auto &[key, file] : _stickerSetFiles) {
+			mapData.stream
+				<< quint64(file.key)
+				<< quint64(key.first)
+				<< quint64(key.second);
+		}
+	}
 	map.writeEncrypted(mapData, _localKey);
 
 	_mapChanged = false;
@@ -750,6 +842,7 @@ void Account::reset() {
 	_draftsNotReadMap.clear();
 	_botStoragesMap.clear();
 	_botStoragesNotReadMap.clear();
+	_stickerSetFiles.clear();
 	_locationsKey = _trustedPeersKey = 0;
 	_recentStickersKeyOld = 0;
 	_installedStickersKey = 0;
@@ -914,9 +1007,21 @@ void Account::writeLocationsDelayed() {
 	_writeLocationsTimer.callOnce(kDelayedWriteTimeout);
 }
 
+bool Account::readEncryptedFile(
+		FileReadDescriptor &result,
+		const QString &name,
+		const QString &basePath) {
+	if (_prefetched) {
+		if (const auto read = _prefetched->take(result, name, basePath)) {
+			return *read;
+		}
+	}
+	return ReadEncryptedFile(result, name, basePath, _localKey);
+}
+
 void Account::readLocations() {
 	FileReadDescriptor locations;
-	if (!ReadEncryptedFile(locations, _locationsKey, _basePath, _localKey)) {
+	if (!readEncryptedFile(locations, ToFilePart(_locationsKey), _basePath)) {
 		ClearKey(_locationsKey, _basePath);
 		_locationsKey = 0;
 		writeMapDelayed();
@@ -1050,7 +1155,7 @@ ReadSettingsContext Account::prepareReadSettingsContext() const {
 std::unique_ptr<Main::SessionSettings> Account::readSessionSettings() {
 	ReadSettingsContext context;
 	FileReadDescriptor userSettings;
-	if (!ReadEncryptedFile(userSettings, _settingsKey, _basePath, _localKey)) {
+	if (!readEncryptedFile(userSettings, ToFilePart(_settingsKey), _basePath)) {
 		LOG(("App Info: could not read encrypted user settings..."));
 
 		Local::readOldUserSettings(true, context);
@@ -1139,7 +1244,7 @@ void Account::readMtpData() {
 	auto context = prepareReadSettingsContext();
 
 	FileReadDescriptor mtp;
-	if (!ReadEncryptedFile(mtp, ToFilePart(_dataNameKey), BaseGlobalPath(), _localKey)) {
+	if (!readEncryptedFile(mtp, ToFilePart(_dataNameKey), BaseGlobalPath())) {
 		if (_localKey) {
 			Local::readOldMtpData(true, context);
 			applyReadContext(std::move(context));
@@ -1864,7 +1969,8 @@ Cache::Database::Settings Account::cacheBigFileSettings() const {
 
 void Account::writeStickerSet(
 		QDataStream &stream,
-		const Data::StickersSet &set) {
+		const Data::StickersSet &set,
+		uint64 fingerprint) {
 	using SetFlag = Data::StickersSetFlag;
 	const auto writeInfo = [&](int count) {
 		stream
@@ -1887,7 +1993,14 @@ void Account::writeStickerSet(
 		return;
 	}
 
+	// The contents themselves are in a separate file for each set.
 	writeInfo(set.stickers.size());
+	stream << quint64(fingerprint);
+}
+
+void Account::writeStickerSetContents(
+		QDataStream &stream,
+		const Data::StickersSet &set) {
 	for (const auto &sticker : set.stickers) {
 		Serialize::Document::writeToStream(stream, sticker);
 	}
@@ -1907,6 +2020,68 @@ void Account::writeStickerSet(
 	}
 }
 
+QByteArray Account::serializeStickerSetContents(
+		const Data::StickersSet &set) {
+	auto result = QByteArray();
+	result.reserve(StickerSetContentsSize(set));
+	{
+		QBuffer buffer(&result);
+		buffer.open(QIODevice::WriteOnly);
+		QDataStream stream(&buffer);
+		stream.setVersion(QDataStream::Qt_5_1);
+		writeStickerSetContents(stream, set);
+	}
+	return result;
+}
+
+void Account::writeStickerSetFile(
+		FileKey listKey,
+		const Data::StickersSet &set,
+		const QByteArray &contents,
+		uint64 fingerprint) {
+	auto &file = _stickerSetFiles[std::make_pair(listKey, set.id)];
+	if (file.key && file.fingerprint == fingerprint) {
+		return;
+	} else if (!file.key) {
+		file.key = GenerateKey(_basePath);
+		writeMapQueued();
+	}
+	file.fingerprint = fingerprint;
+
+	// versionTag + version + setId + contents
+	const auto size = sizeof(quint32)
+		+ sizeof(qint32)
+		+ sizeof(quint64)
+		+ contents.size();
+	EncryptedDescriptor data(size);
+	data.stream
+		<< quint32(kStickersVersionTag)
+		<< qint32(kStickersSerializeVersion)
+		<< quint64(set.id);
+	data.stream.writeRawData(contents.constData(), contents.size());
+
+	FileWriteDescriptor(file.key, _basePath).writeEncrypted(data, _localKey);
+}
+
+void Account::clearStickerSetFiles(
+		FileKey listKey,
+		const base::flat_set<uint64> &keepSetIds) {
+	auto removed = false;
+	auto i = _stickerSetFiles.lower_bound(std::make_pair(listKey, uint64()));
+	while (i != end(_stickerSetFiles) && i->first.first == listKey) {
+		if (keepSetIds.contains(i->first.second)) {
+			++i;
+			continue;
+		}
+		ClearKey(i->second.key, _basePath);
+		i = _stickerSetFiles.erase(i);
+		removed = true;
+	}
+	if (removed) {
+		writeMapDelayed();
+	}
+}
+
 // In generic method _writeStickerSets() we look through all the sets and call a
 // callback on each set to see, if we write it, skip it or abort the whole write.
 enum class StickerSetCheckResult {
@@ -1923,20 +2098,28 @@ void Account::writeStickerSets(
 		const Data::StickersSetsOrder &order) {
 	using SetFlag = Data::StickersSetFlag;
 
-	const auto &sets = _owner->session().data().stickers().sets();
-	if (sets.empty()) {
+	const auto clear = [&] {
 		if (stickersKey) {
+			clearStickerSetFiles(stickersKey);
 			ClearKey(stickersKey, _basePath);
 			stickersKey = 0;
 			writeMapDelayed();
 		}
-		return;
+	};
+	const auto &sets = _owner->session().data().stickers().sets();
+	if (sets.empty()) {
+		return clear();
 	}
 
 	// versionTag + version + count
 	quint32 size = sizeof(quint32) + sizeof(qint32) + sizeof(qint32);
 
-	int32 setsCount = 0;
+	struct Written {
+		not_null<const Data::StickersSet*> set;
+		QByteArray contents;
+		uint64 fingerprint = 0;
+	};
+	auto written = std::vector<Written>();
 	for (const auto &[id, set] : sets) {
 		const auto raw = set.get();
 		auto result = checkSet(*raw);
@@ -1946,52 +2129,25 @@ void Account::writeStickerSets(
 			continue;
 		}
 
-		// id
-		// + accessHash
-		// + hash
-		// + title
-		// + shortName
-		// + stickersCount
-		// + flags
-		// + installDate
-		// + thumbnailDocumentId
-		// + thumbnailType
-		// + thumbnailLocation
-		size += sizeof(quint64) * 3
-			+ Serialize::stringSize(raw->title)
-			+ Serialize::stringSize(raw->shortName)
-			+ sizeof(qint32) * 3
-			+ sizeof(quint64)
-			+ sizeof(qint32)
-			+ Serialize::imageLocationSize(raw->thumbnailLocation());
 		if (raw->flags & SetFlag::NotLoaded) {
+			// Only the header with -count, there is no set file.
+			size += StickerSetInfoSize(*raw);
+			written.push_back({ .set = raw });
+			continue;
+		} else if (raw->stickers.isEmpty()) {
 			continue;
 		}
-
-		for (const auto sticker : std::as_const(raw->stickers)) {
-			size += Serialize::Document::sizeInStream(sticker);
-		}
-
-		size += sizeof(qint32); // datesCount
-		if (!raw->dates.empty()) {
-			Assert(raw->stickers.size() == raw->dates.size());
-			size += raw->dates.size() * sizeof(qint32);
-		}
-
-		size += sizeof(qint32); // emojiCount
-		for (auto j = raw->emoji.cbegin(), e = raw->emoji.cend(); j != e; ++j) {
-			size += Serialize::stringSize(j->first->id()) + sizeof(qint32) + (j->second.size() * sizeof(quint64));
-		}
-
-		++setsCount;
+		size += StickerSetInfoSize(*raw) + sizeof(quint64); // fingerprint
+		auto contents = serializeStickerSetContents(*raw);
+		const auto fingerprint = StickerSetContentsFingerprint(contents);
+		written.push_back({
+			.set = raw,
+			.contents = std::move(contents),
+			.fingerprint = fingerprint,
+		});
 	}
-	if (!setsCount && order.isEmpty()) {
-		if (stickersKey) {
-			ClearKey(stickersKey, _basePath);
-			stickersKey = 0;
-			writeMapDelayed();
-		}
-		return;
+	if (written.empty() && order.isEmpty()) {
+		return clear();
 	}
 	size += sizeof(qint32) + (order.size() * sizeof(quint64));
 
@@ -1999,19 +2155,25 @@ void Account::writeStickerSets(
 		stickersKey = GenerateKey(_basePath);
 		writeMapQueued();
 	}
+
+	// Only the sets that changed since the last write are written again.
+	auto keep = base::flat_set<uint64>();
+	keep.reserve(written.size());
+	for (const auto &[set, contents, fingerprint] : written) {
+		if (fingerprint) {
+			writeStickerSetFile(stickersKey, *set, contents, fingerprint);
+			keep.emplace(set->id);
+		}
+	}
+	clearStickerSetFiles(stickersKey, keep);
+
 	EncryptedDescriptor data(size);
 	data.stream
 		<< quint32(kStickersVersionTag)
 		<< qint32(kStickersSerializeVersion)
-		<< qint32(setsCount);
-	for (const auto &[id, set] : sets) {
-		auto result = checkSet(*set);
-		if (result == StickerSetCheckResult::Abort) {
-			return;
-		} else if (result == StickerSetCheckResult::Skip) {
-			continue;
-		}
-		writeStickerSet(data.stream, *set);
+		<< qint32(written.size());
+	for (const auto &[set, contents, fingerprint] : written) {
+		writeStickerSet(data.stream, *set, fingerprint);
 	}
 	data.stream << order;
 
@@ -2019,6 +2181,147 @@ void Account::writeStickerSets(
 	file.writeEncrypted(data, _localKey);
 }
 
+bool Account::readStickerSetContents(
+		QDataStream &stream,
+		int streamVersion,
+		not_null<Data::StickersSet*> set,
+		int count,
+		bool fillStickers) {
+	using SetFlag = Data::StickersSetFlag;
+
+	const auto inputSet = set->identifier();
+	if (fillStickers) {
+		set->stickers.reserve(count);
+		set->count = 0;
+	}
+
+	Serialize::Document::StickerSetInfo info(
+		set->id,
+		set->accessHash,
+		set->shortName);
+	base::flat_set<DocumentId> read;
+	for (int32 j = 0; j < count; ++j) {
+		auto document = Serialize::Document::readStickerFromStream(
+			&_owner->session(),
+			streamVersion,
+			stream, info);
+		if (!CheckStreamStatus(stream)) {
+			return false;
+		} else if (!document
+			|| !document->sticker()
+			|| read.contains(document->id)) {
+			continue;
+		}
+		read.emplace(document->id);
+		if (fillStickers) {
+			set->stickers.push_back(document);
+			if (!(set->flags & SetFlag::Special)) {
+				if (!document->sticker()->set.id) {
+					document->sticker()->set = inputSet;
+				}
+			}
+			++set->count;
+		}
+	}
+
+	qint32 datesCount = 0;
+	stream >> datesCount;
+	if (datesCount > 0) {
+		if (datesCount != count) {
+			return false;
+		}
+		const auto fillDates
+			= ((set->id == Data::Stickers::CloudRecentSetId)
+				|| (set->id == Data::Stickers::CloudRecentAttachedSetId))
+			&& (set->stickers.size() == datesCount);
+		if (fillDates) {
+			set->dates.clear();
+			set->dates.reserve(datesCount);
+		}
+		for (auto i = 0; i != datesCount; ++i) {
+			qint32 date = 0;
+			stream >> date;
+			if (fillDates) {
+				set->dates.push_back(TimeId(date));
+			}
+		}
+	}
+
+	qint32 emojiCount = 0;
+	stream >> emojiCount;
+	if (!CheckStreamStatus(stream) || emojiCount < 0) {
+		return false;
+	}
+	for (int32 j = 0; j < emojiCount; ++j) {
+		QString emojiString;
+		qint32 stickersCount;
+		stream >> emojiString >> stickersCount;
+		Data::StickersPack pack;
+		pack.reserve(stickersCount);
+		for (int32 k = 0; k < stickersCount; ++k) {
+			quint64 id;
+			stream >> id;
+			const auto doc = _owner->session().data().document(id);
+			if (!doc->sticker()) continue;
+
+			pack.push_back(doc);
+		}
+		if (fillStickers) {
+			if (auto emoji = Ui::Emoji::Find(emojiString)) {
+				emoji = emoji->original();
+				set->emoji[emoji] = std::move(pack);
+			}
+		}
+	}
+	return CheckStreamStatus(stream);
+}
+
+bool Account::readStickerSetFile(
+		FileKey listKey,
+		not_null<Data::StickersSet*> set,
+		int count,
+		bool fillStickers,
+		uint64 fingerprint) {
+	const auto i = _stickerSetFiles.find(std::make_pair(listKey, set->id));
+	if (i == end(_stickerSetFiles)) {
+		return false;
+	} else if (!fillStickers) {
+		// The contents are already in memory, no need to read them.
+		i->second.fingerprint = fingerprint;
+		return true;
+	}
+	const auto failed = [&] {
+		ClearKey(i->second.key, _basePath);
+		_stickerSetFiles.erase(i);
+		writeMapDelayed();
+		return false;
+	};
+
+	FileReadDescriptor contents;
+	if (!ReadEncryptedFile(contents, i->second.key, _basePath, _localKey)) {
+		return failed();
+	}
+	quint32 versionTag = 0;
+	qint32 version = 0;
+	quint64 setId = 0;
+	contents.stream >> versionTag >> version >> setId;
+	if (!CheckStreamStatus(contents.stream)
+		|| versionTag != kStickersVersionTag
+		|| version < 5
+		|| setId != set->id) {
+		return failed();
+	} else if (!readStickerSetContents(
+			contents.stream,
+			contents.version,
+			set,
+			count,
+			fillStickers)) {
+		return failed();
+	}
+	i->second.fingerprint = fingerprint;
+	return true;
+}
+
 void Account::readStickerSets(
 		FileKey &stickersKey,
 		Data::StickersSetsOrder *outOrder,
@@ -2027,6 +2330,7 @@ void Account::readStickerSets(
 
 	FileReadDescriptor stickers;
 	if (!ReadEncryptedFile(stickers, stickersKey, _basePath, _localKey)) {
+		clearStickerSetFiles(stickersKey);
 		ClearKey(stickersKey, _basePath);
 		stickersKey = 0;
 		writeMapDelayed();
@@ -2034,6 +2338,7 @@ void Account::readStickerSets(
 	}
 
 	const auto failed = [&] {
+		clearStickerSetFiles(stickersKey);
 		ClearKey(stickersKey, _basePath);
 		stickersKey = 0;
 	};
@@ -2055,6 +2360,7 @@ void Account::readStickerSets(
 		|| (count > kMaxSavedStickerSetsCount)) {
 		return failed();
 	}
+	auto readSetIds = base::flat_set<uint64>();
 	for (auto i = 0; i != count; ++i) {
 		quint64 setId = 0, setAccessHash = 0, setHash = 0;
 		quint64 setThumbnailDocumentId = 0;
@@ -2134,7 +2440,6 @@ void Account::readStickerSets(
 			it->second->thumbnailDocumentId = setThumbnailDocumentId;
 		}
 		const auto set = it->second.get();
-		const auto inputSet = set->identifier();
 		const auto fillStickers = set->stickers.isEmpty();
 
 		if (scnt < 0) { // disabled not loaded set
@@ -2144,86 +2449,36 @@ void Account::readStickerSets(
 			continue;
 		}
 
-		if (fillStickers) {
-			set->stickers.reserve(scnt);
-			set->count = 0;
-		}
-
-		Serialize::Document::StickerSetInfo info(
-			setId,
-			setAccessHash,
-			setShortName);
-		base::flat_set<DocumentId> read;
-		for (int32 j = 0; j < scnt; ++j) {
-			auto document = Serialize::Document::readStickerFromStream(
-				&_owner->session(),
-				stickers.version,
-				stickers.stream, info);
-			if (!CheckStreamStatus(stickers.stream)) {
+		if (version < 5) {
+			if (!readStickerSetContents(
+					stickers.stream,
+					stickers.version,
+					set,
+					scnt,
+					fillStickers)) {
 				return failed();
-			} else if (!document
-				|| !document->sticker()
-				|| read.contains(document->id)) {
-				continue;
-			}
-			read.emplace(document->id);
-			if (fillStickers) {
-				set->stickers.push_back(document);
-				if (!(set->flags & SetFlag::Special)) {
-					if (!document->sticker()->set.id) {
-						document->sticker()->set = inputSet;
-					}
-				}
-				++set->count;
 			}
-		}
-
-		qint32 datesCount = 0;
-		stickers.stream >> datesCount;
-		if (datesCount > 0) {
-			if (datesCount != scnt) {
+		} else {
+			auto fingerprint = quint64();
+			stickers.stream >> fingerprint;
+			if (!CheckStreamStatus(stickers.stream)) {
 				return failed();
 			}
-			const auto fillDates
-				= ((set->id == Data::Stickers::CloudRecentSetId)
-					|| (set->id == Data::Stickers::CloudRecentAttachedSetId))
-				&& (set->stickers.size() == datesCount);
-			if (fillDates) {
+			readSetIds.emplace(setId);
+			const auto read = readStickerSetFile(
+				stickersKey,
+				set,
+				scnt,
+				fillStickers,
+				fingerprint);
+			if (!read && fillStickers) {
+				set->stickers.clear();
 				set->dates.clear();
-				set->dates.reserve(datesCount);
-			}
-			for (auto i = 0; i != datesCount; ++i) {
-				qint32 date = 0;
-				stickers.stream >> date;
-				if (fillDates) {
-					set->dates.push_back(TimeId(date));
-				}
-			}
-		}
-
-		qint32 emojiCount = 0;
-		stickers.stream >> emojiCount;
-		if (!CheckStreamStatus(stickers.stream) || emojiCount < 0) {
-			return failed();
-		}
-		for (int32 j = 0; j < emojiCount; ++j) {
-			QString emojiString;
-			qint32 stickersCount;
-			stickers.stream >> emojiString >> stickersCount;
-			Data::StickersPack pack;
-			pack.reserve(stickersCount);
-			for (int32 k = 0; k < stickersCount; ++k) {
-				quint64 id;
-				stickers.stream >> id;
-				const auto doc = _owner->session().data().document(id);
-				if (!doc->sticker()) continue;
-
-				pack.push_back(doc);
-			}
-			if (fillStickers) {
-				if (auto emoji = Ui::Emoji::Find(emojiString)) {
-					emoji = emoji->original();
-					set->emoji[emoji] = std::move(pack);
+				set->emoji.clear();
+				set->count = scnt;
+				if (!(set->flags & SetFlag::Special)) {
+					// Will be requested from the server when needed.
+					set->flags |= SetFlag::NotLoaded;
 				}
 			}
 		}
@@ -2269,6 +2524,9 @@ void Account::readStickerSets(
 	}
 	if (!CheckStreamStatus(stickers.stream)) {
 		return failed();
+	} else if (version >= 5) {
+		// Forget the files left from an interrupted write.
+		clearStickerSetFiles(stickersKey, readSetIds);
 	}
 
 	// Set flags that we dropped above from the order.
@@ -2892,6 +3150,7 @@ void Account::writeExportSettings(const Export::Settings &settings) {
 		&& settings.fullChats == check.fullChats
 		&& settings.media.types == check.media.types
 		&& settings.media.sizeLimit == check.media.sizeLimit
+		&& settings.media.parallelDownloads == check.media.parallelDownloads
 		&& settings.path == check.path
 		&& settings.format == check.format
 		&& settings.availableAt == check.availableAt
@@ -2909,7 +3168,7 @@ void Account::writeExportSettings(const Export::Settings &settings) {
 	}
 	quint32 size = sizeof(quint32) * 6
 		+ Serialize::stringSize(settings.path)
-		+ sizeof(qint32) * 2 + sizeof(quint64);
+		+ sizeof(qint32) * 3 + sizeof(quint64);
 	EncryptedDescriptor data(size);
 	data.stream
 		<< quint32(settings.types)
@@ -2942,6 +3201,7 @@ void Account::writeExportSettings(const Export::Settings &settings) {
 	});
 	data.stream << qint32(settings.singlePeerFrom);
 	data.stream << qint32(settings.singlePeerTill);
+	data.stream << qint32(settings.media.parallelDownloads);
 
 	FileWriteDescriptor file(_exportSettingsKey, _basePath);
 	file.writeEncrypted(data, _localKey);
@@ -2964,6 +3224,7 @@ Export::Settings Account::readExportSettings() {
 	quint64 singlePeerBareId = 0;
 	quint64 singlePeerAccessHash = 0;
 	qint32 singlePeerFrom = 0, singlePeerTill = 0;
+	qint32 parallelDownloads = Export::MediaSettings().parallelDownloads;
 	file.stream
 		>> types
 		>> fullChats
@@ -2994,11 +3255,15 @@ Export::Settings Account::readExportSettings() {
 	if (!file.stream.atEnd()) {
 		file.stream >> singlePeerFrom >> singlePeerTill;
 	}
+	if (!file.stream.atEnd()) {
+		file.stream >> parallelDownloads;
+	}
 	auto result = Export::Settings();
 	result.types = Export::Settings::Types::from_raw(types);
 	result.fullChats = Export::Settings::Types::from_raw(fullChats);
 	result.media.types = Export::MediaSettings::Types::from_raw(mediaTypes);
 	result.media.sizeLimit = mediaSizeLimit;
+	result.media.parallelDownloads = parallelDownloads;
 	result.format = Export::Output::Format(format);
 	result.path = path;
 	result.availableAt = availableAt;
@@ -43,6 +43,7 @@ namespace Storage {
 namespace details {
 struct ReadSettingsContext;
 struct FileReadDescriptor;
+class PrefetchedFiles;
 } // namespace details
 
 class EncryptionKey;
@@ -233,6 +234,11 @@ private:
 	void writeMapQueued();
 	void writeMap();
 
+	[[nodiscard]] bool readEncryptedFile(
+		details::FileReadDescriptor &result,
+		const QString &name,
+		const QString &basePath);
+
 	void readLocations();
 	void writeLocations();
 	void writeLocationsQueued();
@@ -258,14 +264,45 @@ private:
 		details::FileReadDescriptor &draft,
 		quint64 draftPeerSerialized);
 
+	struct StickerSetFile {
+		FileKey key = 0;
+		uint64 fingerprint = 0;
+	};
+
 	void writeStickerSet(
+		QDataStream &stream,
+		const Data::StickersSet &set,
+		uint64 fingerprint);
+	void writeStickerSetContents(
 		QDataStream &stream,
 		const Data::StickersSet &set);
+	[[nodiscard]] QByteArray serializeStickerSetContents(
+		const Data::StickersSet &set);
+	void writeStickerSetFile(
+		FileKey listKey,
+		const Data::StickersSet &set,
+		const QByteArray &contents,
+		uint64 fingerprint);
 	template <typename CheckSet>
 	void writeStickerSets(
 		FileKey &stickersKey,
 		CheckSet checkSet,
 		const Data::StickersSetsOrder &order);
+	void clearStickerSetFiles(
+		FileKey listKey,
+		const base::flat_set<uint64> &keepSetIds = {});
+	[[nodiscard]] bool readStickerSetContents(
+		QDataStream &stream,
+		int streamVersion,
+		not_null<Data::StickersSet*> set,
+		int count,
+		bool fillStickers);
+	[[nodiscard]] bool readStickerSetFile(
+		FileKey listKey,
+		not_null<Data::StickersSet*> set,
+		int count,
+		bool fillStickers,
+		uint64 fingerprint);
 	void readStickerSets(
 		FileKey &stickersKey,
 		Data::StickersSetsOrder *outOrder = nullptr,
@@ -290,6 +327,7 @@ private:
 	const QString _databasePath;
 
 	MTP::AuthKeyPtr _localKey;
+	std::unique_ptr<details::PrefetchedFiles> _prefetched;
 
 	base::flat_map<PeerId, FileKey> _draftsMap;
 	base::flat_map<PeerId, FileKey> _draftCursorsMap;
@@ -300,6 +338,9 @@ private:
 	base::flat_map<PeerId, FileKey> _botStoragesMap;
 	base::flat_map<PeerId, bool> _botStoragesNotReadMap;
 
+	// (sticker sets list file key, set id) -> file with the set contents.
+	base::flat_map<std::pair<FileKey, uint64>, StickerSetFile> _stickerSetFiles;
+
 	QMultiMap<MediaKey, Core::FileLocation> _fileLocations;
 	QMap<QString, QPair<MediaKey, Core::FileLocation>> _fileLocationPairs;
 	QMap<MediaKey, MediaKey> _fileLocationAliases;
@@ -0,0 +1,154 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "mtproto/details/mtproto_aes_ige.h"
+
+#include <openssl/aes.h>
+#include <openssl/modes.h>
+#include <openssl/rand.h>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+using namespace MTP::details;
+
+// Each measurement processes this many bytes in total.
+constexpr auto kTotalBytes = 64 * 1024 * 1024;
+constexpr auto kBatch = 4;
+constexpr auto kSizes = std::array{ 1024, 16 * 1024, 512 * 1024 };
+
+template <typename Callback>
+[[nodiscard]] double Measure(int bytesPerCall, Callback &&callback) {
+	using Clock = std::chrono::steady_clock;
+
+	callback();
+	const auto calls = std::max(kTotalBytes / bytesPerCall, 1);
+	const auto started = Clock::now();
+	for (auto i = 0; i != calls; ++i) {
+		callback();
+	}
+	const auto seconds = std::chrono::duration<double>(
+		Clock::now() - started).count();
+	return (double(bytesPerCall) * calls) / (1024. * 1024.) / seconds;
+}
+
+[[nodiscard]] bytes::vector RandomBytes(int size) {
+	auto result = bytes::vector(size);
+	RAND_bytes(reinterpret_cast<uchar*>(result.data()), size);
+	return result;
+}
+
+// What aesIgeDecryptRaw did before the batch API.
+void OpenSSLIgeDecrypt(const AesIgeItem &item) {
+	uchar iv[32];
+	memcpy(iv, item.iv, 32);
+
+	AES_KEY aes;
+	AES_set_decrypt_key(static_cast<const uchar*>(item.key), 256, &aes);
+	AES_ige_encrypt(
+		static_cast<const uchar*>(item.src),
+		static_cast<uchar*>(item.dst),
+		item.len,
+		&aes,
+		iv,
+		AES_DECRYPT);
+}
+
+// What aesCtrEncrypt did before the pipelined cipher.
+void OpenSSLCtrEncrypt(bytes::span data, const void *key, uchar *ivec) {
+	uchar ecount[16] = { 0 };
+	uint32 num = 0;
+
+	AES_KEY aes;
+	AES_set_encrypt_key(static_cast<const uchar*>(key), 256, &aes);
+	CRYPTO_ctr128_encrypt(
+		reinterpret_cast<const uchar*>(data.data()),
+		reinterpret_cast<uchar*>(data.data()),
+		data.size(),
+		&aes,
+		ivec,
+		ecount,
+		&num,
+		(block128_f)AES_encrypt);
+}
+
+void BenchIge(int size) {
+	const auto key = RandomBytes(32);
+	const auto iv = RandomBytes(32);
+	auto buffers = std::vector<bytes::vector>();
+	auto items = std::vector<AesIgeItem>();
+	for (auto i = 0; i != kBatch; ++i) {
+		buffers.push_back(RandomBytes(size));
+	}
+	for (auto &buffer : buffers) {
+		items.push_back({
+			.src = buffer.data(),
+			.dst = buffer.data(),
+			.len = uint32(size),
+			.key = key.data(),
+			.iv = iv.data(),
+		});
+	}
+	const auto openssl = Measure(size, [&] {
+		OpenSSLIgeDecrypt(items.front());
+	});
+	const auto single = Measure(size, [&] {
+		AesIgeDecryptBatch({ items.data(), 1 });
+	});
+	const auto batch = Measure(size * kBatch, [&] {
+		AesIgeDecryptBatch(items);
+	});
+	std::printf(
+		"IGE decrypt %7d bytes: OpenSSL %8.1f MB/s, "
+		"batch of 1 %8.1f MB/s, batch of %d %8.1f MB/s\n",
+		size,
+		openssl,
+		single,
+		kBatch,
+		batch);
+}
+
+void BenchCtr(int size) {
+	const auto key = RandomBytes(32);
+	auto ivec = RandomBytes(16);
+	auto buffer = RandomBytes(size);
+	const auto counter = reinterpret_cast<uchar*>(ivec.data());
+	const auto openssl = Measure(size, [&] {
+		OpenSSLCtrEncrypt(buffer, key.data(), counter);
+	});
+	const auto pipelined = Measure(size, [&] {
+		if (!AesCtrEncryptBlocks(buffer, key.data(), counter)) {
+			std::printf("CTR encrypt failed.\n");
+			std::exit(1);
+		}
+	});
+	std::printf(
+		"CTR encrypt %7d bytes: OpenSSL %8.1f MB/s, "
+		"EVP %8.1f MB/s\n",
+		size,
+		openssl,
+		pipelined);
+}
+
+} // namespace
+
+int main() {
+	std::printf(
+		"AES-NI IGE path: %s\n",
+		AesIgeAccelerated() ? "enabled" : "disabled");
+	for (const auto size : kSizes) {
+		BenchIge(size);
+	}
+	for (const auto size : kSizes) {
+		BenchCtr(size);
+	}
+	return 0;
+}
@@ -0,0 +1,277 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "iv/iv_prepare.h"
+
+#include "iv/iv_data.h"
+#include "ui/style/style_core.h"
+
+#include <QtCore/QFile>
+#include <QtGui/QGuiApplication>
+
+#include <chrono>
+#include <cstdio>
+
+// Runs Iv::Prepare() over serialized MTPPage fixtures and prints the
+// time per page and the output rate.
+//
+// bench_iv [page.bin ...]
+// bench_iv --write-fixture page.bin
+//
+// A fixture is an MTPPage written with MTPPage::write() into an mtpBuffer.
+// Without arguments a generated page is serialized and read back. Besides
+// headers, formatted paragraphs and lists it has large tables, collages
+// of more than ten photos and nested details with blockquotes.
+
+namespace Lang::details {
+
+// There is no language pack here, page markup doesn't depend on it.
+QString Current(ushort key) {
+	return QString();
+}
+
+bool IsNonDefaultPlural(ushort keyBase) {
+	return false;
+}
+
+} // namespace Lang::details
+
+namespace {
+
+constexpr auto kIterations = 100;
+constexpr auto kGeneratedSections = 200;
+constexpr auto kSectionsPerTable = 20;
+constexpr auto kTableRows = 60;
+constexpr auto kTableColumns = 6;
+constexpr auto kCollagePhotos = 24;
+constexpr auto kDetailsDepth = 4;
+
+[[nodiscard]] MTPRichText Text(const QString &text) {
+	return MTP_textPlain(MTP_string(text));
+}
+
+[[nodiscard]] MTPPageCaption Caption(const QString &text) {
+	return MTP_pageCaption(Text(text), MTP_textEmpty());
+}
+
+[[nodiscard]] MTPPhoto GeneratePhoto(uint64 id) {
+	const auto width = 640 + int(id % 7) * 80;
+	const auto height = 480 + int(id % 5) * 60;
+	return MTP_photo(
+		MTP_flags(0),
+		MTP_long(id),
+		MTP_long(0),
+		MTP_bytes(),
+		MTP_int(0),
+		MTP_vector<MTPPhotoSize>({
+			MTP_photoSize(
+				MTP_string("x"),
+				MTP_int(width),
+				MTP_int(height),
+				MTP_int(0)),
+		}),
+		MTPVector<MTPVideoSize>(),
+		MTP_int(2));
+}
+
+[[nodiscard]] MTPPageBlock GenerateTable(int index) {
+	using Flag = MTPDpageTableCell::Flag;
+	auto rows = QVector<MTPPageTableRow>();
+	rows.reserve(kTableRows);
+	for (auto row = 0; row != kTableRows; ++row) {
+		auto cells = QVector<MTPPageTableCell>();
+		cells.reserve(kTableColumns);
+		for (auto column = 0; column != kTableColumns; ++column) {
+			const auto text = (row > 0)
+				? MTP_textConcat(MTP_vector<MTPRichText>({
+					Text(u"Cell %1:%2 "_q.arg(row).arg(column)),
+					MTP_textBold(Text(u"value"_q)),
+				}))
+				: Text(u"Column %1"_q.arg(column + 1));
+			auto flags = MTPDpageTableCell::Flags(Flag::f_text);
+			if (!row) {
+				flags |= Flag::f_header;
+			}
+			if (column % 2) {
+				flags |= Flag::f_align_center;
+			}
+			cells.push_back(MTP_pageTableCell(
+				MTP_flags(flags),
+				text,
+				MTPint(),
+				MTPint()));
+		}
+		rows.push_back(MTP_pageTableRow(
+			MTP_vector<MTPPageTableCell>(std::move(cells))));
+	}
+	return MTP_pageBlockTable(
+		MTP_flags(MTPDpageBlockTable::Flag::f_bordered
+			| MTPDpageBlockTable::Flag::f_striped),
+		Text(u"Table %1"_q.arg(index + 1)),
+		MTP_vector<MTPPageTableRow>(std::move(rows)));
+}
+
+[[nodiscard]] MTPPageBlock GenerateCollage(
+		int index,
+		QVector<MTPPhoto> &photos) {
+	auto items = QVector<MTPPageBlock>();
+	items.reserve(kCollagePhotos);
+	for (auto i = 0; i != kCollagePhotos; ++i) {
+		const auto id = uint64(index * kCollagePhotos + i + 1);
+		photos.push_back(GeneratePhoto(id));
+		items.push_back(MTP_pageBlockPhoto(
+			MTP_flags(0),
+			MTP_long(id),
+			Caption(u"Photo %1"_q.arg(id)),
+			MTPstring(),
+			MTPlong()));
+	}
+	return MTP_pageBlockCollage(
+		MTP_vector<MTPPageBlock>(std::move(items)),
+		Caption(u"Collage %1"_q.arg(index + 1)));
+}
+
+[[nodiscard]] MTPPageBlock GenerateDetails(int depth) {
+	auto blocks = QVector<MTPPageBlock>();
+	blocks.push_back(MTP_pageBlockBlockquote(
+		Text(u"Quote on level %1"_q.arg(depth)),
+		Text(u"Author"_q)));
+	blocks.push_back(MTP_pageBlockParagraph(
+		Text(u"Details paragraph on level %1."_q.arg(depth))));
+	if (depth + 1 < kDetailsDepth) {
+		blocks.push_back(GenerateDetails(depth + 1));
+	}
+	return MTP_pageBlockDetails(
+		MTP_flags(MTPDpageBlockDetails::Flag::f_open),
+		MTP_vector<MTPPageBlock>(std::move(blocks)),
+		Text(u"Details %1"_q.arg(depth + 1)));
+}
+
+[[nodiscard]] MTPPage GeneratePage() {
+	auto photos = QVector<MTPPhoto>();
+	auto blocks = QVector<MTPPageBlock>();
+	blocks.push_back(MTP_pageBlockTitle(Text(u"Benchmark page"_q)));
+	for (auto i = 0; i != kGeneratedSections; ++i) {
+		blocks.push_back(MTP_pageBlockHeader(
+			Text(u"Section %1"_q.arg(i + 1))));
+		blocks.push_back(MTP_pageBlockParagraph(MTP_textConcat(
+			MTP_vector<MTPRichText>({
+				Text(u"Lorem ipsum dolor sit amet, "_q),
+				MTP_textBold(Text(u"consectetur adipiscing elit"_q)),
+				Text(u", sed do eiusmod tempor incididunt ut labore "
+					"et dolore magna aliqua. Ut enim ad minim veniam, "
+					"quis nostrud exercitation <ullamco> & laboris."_q),
+			}))));
+		blocks.push_back(MTP_pageBlockList(MTP_vector<MTPPageListItem>({
+			MTP_pageListItemText(Text(u"First item"_q)),
+			MTP_pageListItemText(MTP_textItalic(Text(u"Second item"_q))),
+		})));
+		if (!(i % kSectionsPerTable)) {
+			const auto index = i / kSectionsPerTable;
+			blocks.push_back(GenerateTable(index));
+			blocks.push_back(GenerateCollage(index, photos));
+			blocks.push_back(GenerateDetails(0));
+		}
+	}
+	return MTP_page(
+		MTP_flags(0),
+		MTP_string(u"https://example.com/benchmark"_q),
+		MTP_vector<MTPPageBlock>(std::move(blocks)),
+		MTP_vector<MTPPhoto>(std::move(photos)),
+		MTP_vector<MTPDocument>(),
+		MTPint());
+}
+
+[[nodiscard]] QByteArray Serialize(const MTPPage &page) {
+	auto buffer = mtpBuffer();
+	page.write(buffer);
+	return QByteArray(
+		reinterpret_cast<const char*>(buffer.constData()),
+		buffer.size() * sizeof(mtpPrime));
+}
+
+[[nodiscard]] std::optional<MTPPage> Deserialize(const QByteArray &bytes) {
+	if (bytes.isEmpty() || (bytes.size() % sizeof(mtpPrime))) {
+		return std::nullopt;
+	}
+	auto buffer = mtpBuffer(bytes.size() / sizeof(mtpPrime));
+	memcpy(buffer.data(), bytes.constData(), bytes.size());
+	auto from = buffer.constData();
+	const auto end = from + buffer.size();
+	auto result = MTPPage();
+	if (!result.read(from, end) || from != end) {
+		return std::nullopt;
+	}
+	return result;
+}
+
+void Bench(const QString &name, const MTPPage &page) {
+	using Clock = std::chrono::steady_clock;
+
+	const auto source = Iv::Source{
+		.pageId = 1,
+		.page = page,
+		.name = name,
+	};
+	const auto options = Iv::Options();
+	auto size = int64();
+	const auto started = Clock::now();
+	for (auto i = 0; i != kIterations; ++i) {
+		size += Iv::Prepare(source, options).content.size();
+	}
+	const auto seconds = std::chrono::duration<double>(
+		Clock::now() - started).count();
+	std::printf(
+		"%s: %.3f ms per page, %lld bytes of HTML, %.1f MB/s\n",
+		name.toUtf8().constData(),
+		seconds * 1000. / kIterations,
+		static_cast<long long>(size / kIterations),
+		size / (1024. * 1024.) / seconds);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	qputenv("QT_QPA_PLATFORM", "offscreen");
+	auto app = QGuiApplication(argc, argv);
+
+	// Album layouts use the chat style values.
+	style::StartManager(style::kScaleDefault);
+
+	const auto arguments = app.arguments().mid(1);
+	if (arguments.size() == 2 && arguments[0] == u"--write-fixture"_q) {
+		auto file = QFile(arguments[1]);
+		if (!file.open(QIODevice::WriteOnly)
+			|| file.write(Serialize(GeneratePage())) < 0) {
+			std::printf("Could not write the fixture.\n");
+			return 1;
+		}
+		return 0;
+	} else if (arguments.isEmpty()) {
+		const auto page = Deserialize(Serialize(GeneratePage()));
+		if (!page) {
+			std::printf("Could not read the generated page back.\n");
+			return 1;
+		}
+		Bench(u"generated"_q, *page);
+		return 0;
+	}
+	for (const auto &path : arguments) {
+		auto file = QFile(path);
+		const auto page = file.open(QIODevice::ReadOnly)
+			? Deserialize(file.readAll())
+			: std::nullopt;
+		if (!page) {
+			std::printf(
+				"Could not read a page from %s.\n",
+				path.toUtf8().constData());
+			return 1;
+		}
+		Bench(path, *page);
+	}
+	return 0;
+}
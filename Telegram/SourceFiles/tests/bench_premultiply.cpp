@@ -0,0 +1,113 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "ffmpeg/ffmpeg_utility.h"
+
+#include <QtGui/QImage>
+#include <QtGui/QPainter>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace {
+
+constexpr auto kWidth = 1920;
+constexpr auto kHeight = 1080;
+constexpr auto kIterations = 200;
+
+template <typename Callback>
+[[nodiscard]] double Measure(Callback &&callback) {
+	using Clock = std::chrono::steady_clock;
+
+	callback();
+	const auto started = Clock::now();
+	for (auto i = 0; i != kIterations; ++i) {
+		callback();
+	}
+	const auto seconds = std::chrono::duration<double>(
+		Clock::now() - started).count();
+	return (double(kWidth) * kHeight * kIterations) / 1'000'000. / seconds;
+}
+
+// Opaque video frames and stickers with transparent areas and soft edges.
+[[nodiscard]] QImage GenerateFrame(bool opaque) {
+	auto result = FFmpeg::CreateFrameStorage({ kWidth, kHeight });
+	auto generator = std::mt19937(opaque ? 1 : 2);
+	auto distribution = std::uniform_int_distribution<uint32>();
+	for (auto y = 0; y != kHeight; ++y) {
+		const auto line = reinterpret_cast<uint32*>(result.scanLine(y));
+		for (auto x = 0; x != kWidth; ++x) {
+			const auto color = distribution(generator) & 0x00FFFFFFU;
+			const auto alpha = opaque
+				? 0xFFU
+				: (x < kWidth / 4)
+				? 0x00U
+				: (x < kWidth / 2)
+				? (distribution(generator) & 0xFFU)
+				: 0xFFU;
+			line[x] = color | (alpha << 24);
+		}
+	}
+	return result;
+}
+
+void BenchFrame(const char *name, bool opaque) {
+	const auto original = GenerateFrame(opaque);
+	auto image = original;
+	image.detach();
+
+	const auto premultiplyGeneric = Measure([&] {
+		FFmpeg::PremultiplyInplaceGeneric(image);
+	});
+	const auto premultiply = Measure([&] {
+		FFmpeg::PremultiplyInplace(image);
+	});
+
+	auto unpremultiplied = QImage();
+	const auto unpremultiplyGeneric = Measure([&] {
+		FFmpeg::UnPremultiplyGeneric(unpremultiplied, original);
+	});
+	const auto unpremultiply = Measure([&] {
+		FFmpeg::UnPremultiply(unpremultiplied, original);
+	});
+
+	const auto mask = GenerateFrame(false);
+	const auto maskPainter = Measure([&] {
+		auto p = QPainter(&image);
+		p.setCompositionMode(QPainter::CompositionMode_DestinationIn);
+		p.drawImage(0, 0, mask);
+	});
+	const auto maskInplace = Measure([&] {
+		if (!FFmpeg::ApplyMaskInplace(image, mask)) {
+			std::printf("Mask fast path is not available.\n");
+			std::exit(1);
+		}
+	});
+
+	std::printf(
+		"%s, MPix/s\n"
+		"  premultiply:   generic %8.1f, vectorized %8.1f\n"
+		"  unpremultiply: generic %8.1f, vectorized %8.1f\n"
+		"  mask:          QPainter %7.1f, vectorized %8.1f\n",
+		name,
+		premultiplyGeneric,
+		premultiply,
+		unpremultiplyGeneric,
+		unpremultiply,
+		maskPainter,
+		maskInplace);
+}
+
+} // namespace
+
+int main() {
+	BenchFrame("Opaque 1920x1080 frame", true);
+	BenchFrame("Transparent 1920x1080 frame", false);
+	return 0;
+}
@@ -22,6 +22,8 @@ PRIVATE
     export/data/export_data_types.h
     export/output/export_output_abstract.cpp
     export/output/export_output_abstract.h
+    export/output/export_output_checkpoint.cpp
+    export/output/export_output_checkpoint.h
     export/output/export_output_file.cpp
     export/output/export_output_file.h
     export/output/export_output_html.cpp
@@ -30,6 +32,8 @@ PRIVATE
     export/output/export_output_html_and_json.h
     export/output/export_output_json.cpp
     export/output/export_output_json.h
+    export/output/export_output_json_lines.cpp
+    export/output/export_output_json_lines.h
     export/output/export_output_result.h
     export/output/export_output_stats.cpp
     export/output/export_output_stats.h
@@ -42,3 +42,78 @@ set_target_properties(test_text PROPERTIES RUNTIME_OUTPUT_DIRECTORY ${CMAKE_BINA
 add_dependencies(Telegram test_text)
 
 target_prepare_qrc(test_text)
+
+add_executable(bench_crypto)
+init_target(bench_crypto "(tests)")
+
+target_include_directories(bench_crypto PRIVATE ${src_loc})
+
+nice_target_sources(bench_crypto ${src_loc}
+PRIVATE
+    mtproto/details/mtproto_aes_ige.cpp
+    mtproto/details/mtproto_aes_ige.h
+    tests/bench_crypto.cpp
+)
+
+target_link_libraries(bench_crypto
+PRIVATE
+    desktop-app::lib_base
+    desktop-app::external_openssl
+    desktop-app::external_qt
+)
+
+set_target_properties(bench_crypto PROPERTIES RUNTIME_OUTPUT_DIRECTORY ${CMAKE_BINARY_DIR})
+
+add_dependencies(Telegram bench_crypto)
+
+add_executable(bench_premultiply)
+init_target(bench_premultiply "(tests)")
+
+target_include_directories(bench_premultiply PRIVATE ${src_loc})
+
+nice_target_sources(bench_premultiply ${src_loc}
+PRIVATE
+    tests/bench_premultiply.cpp
+)
+
+target_link_libraries(bench_premultiply
+PRIVATE
+    desktop-app::lib_ffmpeg
+    desktop-app::external_qt
+)
+
+set_target_properties(bench_premultiply PROPERTIES RUNTIME_OUTPUT_DIRECTORY ${CMAKE_BINARY_DIR})
+
+add_dependencies(Telegram bench_premultiply)
+
+add_executable(bench_iv)
+init_target(bench_iv "(tests)")
+
+target_include_directories(bench_iv PRIVATE ${src_loc})
+
+target_precompile_headers(bench_iv PRIVATE ${src_loc}/iv/iv_pch.h)
+nice_target_sources(bench_iv ${src_loc}
+PRIVATE
+    iv/iv_data.cpp
+    iv/iv_data.h
+    iv/iv_prepare.cpp
+    iv/iv_prepare.h
+    tests/bench_iv.cpp
+)
+
+target_link_libraries(bench_iv
+PRIVATE
+    desktop-app::lib_base
+    desktop-app::lib_crl
+    desktop-app::lib_ui
+    desktop-app::lib_webview
+    desktop-app::external_qt
+    desktop-app::external_qt_static_plugins
+    tdesktop::td_lang
+    tdesktop::td_scheme
+    tdesktop::td_ui
+)
+
+set_target_properties(bench_iv PROPERTIES RUNTIME_OUTPUT_DIRECTORY ${CMAKE_BINARY_DIR})
+
+add_dependencies(Telegram bench_iv)